@@ -0,0 +1,256 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+/*
+ * sscont_pool and sscont_arena against glibc malloc for the sizes of the
+ * nodes libsscont allocates: heap_node, hash_entry, a hash_entry with a
+ * short key and an auto_array. Each pattern is timed per allocation and
+ * free: n allocations freed last in first out, first in first out, and
+ * churn, where n objects stay live while random ones are replaced. Arena
+ * frees are no-ops and it is reset after each round. Churn is also run by
+ * 4 threads at once, for malloc and a threaded pool. malloc is called
+ * through glibc's entry point so bench.h doesn't count it.
+ */
+
+#define ROUNDS 5
+#define THREADS 4
+
+typedef struct {
+	const char* name;
+	void* (*create) (size_t size);
+	void* (*alloc) (void* ctx);
+	void (*free) (void* ctx, void* object);
+	void (*reset) (void* ctx);
+	void (*delete) (void* ctx);
+} allocator_ops;
+
+static void* malloc_create (size_t size) {
+	size_t* ctx = __libc_malloc (sizeof (size_t));
+	*ctx = size;
+	return ctx;
+}
+
+static void* malloc_alloc (void* ctx) {
+	return __libc_malloc (*(size_t*) ctx);
+}
+
+static void malloc_free (void* ctx, void* object) {
+	__libc_free (object);
+}
+
+static void malloc_delete (void* ctx) {
+	__libc_free (ctx);
+}
+
+static void* pool_create (size_t size) {
+	return sscont_pool_create (size, 0);
+}
+
+static void* pool_create_threaded (size_t size) {
+	return sscont_pool_create (size, SSCONT_POOL_THREADED);
+}
+
+static void* pool_alloc (void* ctx) {
+	return sscont_pool_alloc (ctx);
+}
+
+static void pool_free (void* ctx, void* object) {
+	sscont_pool_free (ctx, object);
+}
+
+static void pool_delete (void* ctx) {
+	sscont_pool_delete (ctx);
+}
+
+typedef struct {
+	sscont_arena* arena;
+	size_t size;
+} arena_ctx;
+
+static void* arena_create (size_t size) {
+	arena_ctx* ctx = malloc (sizeof (arena_ctx));
+	ctx->arena = sscont_arena_create (64 * 1024);
+	ctx->size = size;
+	return ctx;
+}
+
+static void* arena_alloc (void* ctx) {
+	return sscont_arena_alloc (((arena_ctx*) ctx)->arena, ((arena_ctx*) ctx)->size);
+}
+
+static void arena_free (void* ctx, void* object) {
+}
+
+static void arena_reset (void* ctx) {
+	sscont_arena_reset (((arena_ctx*) ctx)->arena);
+}
+
+static void arena_delete (void* ctx) {
+	sscont_arena_delete (((arena_ctx*) ctx)->arena);
+	free (ctx);
+}
+
+static const allocator_ops variants[] = {
+	{ "malloc", malloc_create, malloc_alloc, malloc_free, NULL, malloc_delete },
+	{ "pool", pool_create, pool_alloc, pool_free, NULL, pool_delete },
+	{ "pool_threaded", pool_create_threaded, pool_alloc, pool_free, NULL, pool_delete },
+	{ "arena", arena_create, arena_alloc, arena_free, arena_reset, arena_delete }
+};
+
+/* touches the object as a container would when it fills in a node */
+static inline void* take (const allocator_ops* ops, void* ctx) {
+	void** object = ops->alloc (ctx);
+	if (object == NULL) {
+		PMSG ("allocation failed");
+		exit (EXIT_FAILURE);
+	}
+	object[0] = ctx;
+
+	return object;
+}
+
+static void lifo (const allocator_ops* ops, void* ctx, void** objects, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		objects[i] = take (ops, ctx);
+	}
+	for (size_t i = n; i > 0; --i) {
+		ops->free (ctx, objects[i - 1]);
+	}
+}
+
+static void fifo (const allocator_ops* ops, void* ctx, void** objects, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		objects[i] = take (ops, ctx);
+	}
+	for (size_t i = 0; i < n; ++i) {
+		ops->free (ctx, objects[i]);
+	}
+}
+
+static void churn (const allocator_ops* ops, void* ctx, void** objects, size_t n) {
+	uint64_t seed = 31;
+	for (size_t i = 0; i < n; ++i) {
+		objects[i] = take (ops, ctx);
+	}
+	for (size_t i = 0; i < n; ++i) {
+		size_t victim = bench_rand (&seed) % n;
+		ops->free (ctx, objects[victim]);
+		objects[victim] = take (ops, ctx);
+	}
+	for (size_t i = 0; i < n; ++i) {
+		ops->free (ctx, objects[i]);
+	}
+}
+
+typedef struct {
+	const allocator_ops* ops;
+	void* ctx;
+	size_t n;
+} churn_arg;
+
+static void* churn_thread (void* arg) {
+	churn_arg* ca = arg;
+	void** objects = malloc (ca->n * sizeof (void*));
+	for (int r = 0; r < ROUNDS; ++r) {
+		churn (ca->ops, ca->ctx, objects, ca->n);
+	}
+	free (objects);
+
+	return NULL;
+}
+
+static void run (const char* node, size_t size, size_t n) {
+	const char* pattern_names[] = { "alloc_free_lifo", "alloc_free_fifo", "alloc_free_churn" };
+	void (*patterns[]) (const allocator_ops*, void*, void**, size_t) = { lifo, fifo, churn };
+	// churn allocates and frees 2n objects per round, the others n
+	size_t ops_per_round[] = { n, n, 2 * n };
+	void** objects = malloc (n * sizeof (void*));
+	char variant[64];
+
+	for (size_t v = 0; v < sizeof (variants) / sizeof (variants[0]); ++v) {
+		const allocator_ops* ops = &variants[v];
+		snprintf (variant, sizeof (variant), "%s_%s_%zuB", ops->name, node, size);
+
+		for (size_t p = 0; p < sizeof (patterns) / sizeof (patterns[0]); ++p) {
+			void* ctx = ops->create (size);
+
+			uint64_t start = bench_start ();
+			for (int r = 0; r < ROUNDS; ++r) {
+				patterns[p] (ops, ctx, objects, n);
+				if (ops->reset != NULL) {
+					ops->reset (ctx);
+				}
+			}
+			bench_report (pattern_names[p], variant, n, 1, bench_now_ns () - start, ROUNDS * ops_per_round[p]);
+
+			ops->delete (ctx);
+		}
+
+		if (ops->reset != NULL || ops->create == pool_create) {
+			continue;
+		}
+
+		// the threads share one allocator
+		void* ctx = ops->create (size);
+		pthread_t threads[THREADS];
+		churn_arg arg = { ops, ctx, n / THREADS };
+
+		uint64_t start = bench_start ();
+		for (int t = 0; t < THREADS; ++t) {
+			pthread_create (&threads[t], NULL, churn_thread, &arg);
+		}
+		for (int t = 0; t < THREADS; ++t) {
+			pthread_join (threads[t], NULL);
+		}
+		bench_report ("alloc_free_churn", variant, n, THREADS, bench_now_ns () - start, ROUNDS * 2 * n);
+
+		ops->delete (ctx);
+	}
+
+	free (objects);
+}
+
+int main (int argc, char** argv) {
+	const char* nodes[] = { "heap_node", "hash_entry", "hash_entry_key", "auto_array" };
+	size_t sizes[] = { sizeof (heap_node), sizeof (hash_entry), sizeof (hash_entry) + 16, sizeof (auto_array) };
+	size_t counts[] = { 1000, 1000000 };
+
+	bench_header ();
+
+	for (size_t c = 0; c < sizeof (counts) / sizeof (counts[0]); ++c) {
+		for (size_t s = 0; s < sizeof (sizes) / sizeof (sizes[0]); ++s) {
+			run (nodes[s], sizes[s], counts[c]);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,112 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * auto_array_add of n items, auto_array_get at positions drawn uniformly 
+ * and from a Zipfian distribution, and auto_array_insert and 
+ * auto_array_remove at uniform positions, at the front and at the back. 
+ * Inserts and removes away from the back move the items after them, so 
+ * they run n / 10 times, and only up to the size given as the first argument.
+ * usage: auto_array_bench [largest size for inserts and removes]
+ */
+
+static void run (size_t n, size_t shift_max) {
+	size_t* uniform = malloc (n * sizeof (size_t));
+	size_t* zipfian = malloc (n * sizeof (size_t));
+	bench_zipf zipf;
+	if (uniform == NULL || zipfian == NULL || bench_zipf_init (&zipf, n, 1.0) == -1) {
+		PMSG ("allocation failed");
+		exit (EXIT_FAILURE);
+	}
+
+	uint64_t seed = 23;
+	for (size_t i = 0; i < n; ++i) {
+		uniform[i] = bench_rand (&seed) % n;
+		zipfian[i] = (bench_zipf_next (&zipf, &seed) * 2654435761u) % n;
+	}
+
+	auto_array* aa = auto_array_create (16);
+
+	uint64_t start = bench_start ();
+	for (size_t i = 0; i < n; ++i) {
+		auto_array_add (aa, (void*) i);
+	}
+	bench_report ("auto_array_add", "back", n, 1, bench_now_ns () - start, n);
+
+	const char* dists[] = { "uniform", "zipf" };
+	size_t* draws[] = { uniform, zipfian };
+	volatile uintptr_t sum = 0;
+	for (int d = 0; d < 2; ++d) {
+		start = bench_start ();
+		for (size_t i = 0; i < n; ++i) {
+			sum += (uintptr_t) auto_array_get (aa, draws[d][i]);
+		}
+		bench_report ("auto_array_get", dists[d], n, 1, bench_now_ns () - start, n);
+	}
+
+	if (n <= shift_max) {
+		size_t m = n / 10;
+		const char* where[] = { "uniform", "front", "back" };
+		for (int w = 0; w < 3; ++w) {
+			start = bench_start ();
+			for (size_t i = 0; i < m; ++i) {
+				size_t pos = w == 0 ? uniform[i] : w == 1 ? 0 : aa->count;
+				auto_array_insert (aa, pos, (void*) i);
+			}
+			bench_report ("auto_array_insert", where[w], n, 1, bench_now_ns () - start, m);
+
+			start = bench_start ();
+			for (size_t i = 0; i < m; ++i) {
+				size_t pos = w == 0 ? uniform[i] % aa->count : w == 1 ? 0 : aa->count - 1;
+				auto_array_remove (aa, pos);
+			}
+			bench_report ("auto_array_remove", where[w], n, 1, bench_now_ns () - start, m);
+		}
+	}
+
+	auto_array_delete (aa, NULL);
+	bench_zipf_free (&zipf);
+	free (zipfian);
+	free (uniform);
+}
+
+int main (int argc, char** argv) {
+	size_t shift_max = argc > 1 ? strtoul (argv[1], NULL, 10) : 100000;
+	size_t sizes[] = { 1000, 100000, 10000000 };
+
+	bench_header ();
+
+	for (size_t s = 0; s < sizeof (sizes) / sizeof (sizes[0]); ++s) {
+		run (sizes[s], shift_max);
+	}
+
+	return EXIT_SUCCESS;
+}
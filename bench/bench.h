@@ -0,0 +1,220 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+/*
+ * Helpers shared by the benchmarks. Every benchmark prints CSV to stdout:
+ * a header line from bench_header followed by one bench_report line per
+ * measurement. A measurement starts with bench_start and is reported with 
+ * its elapsed time and number of operations; the report adds the 
+ * allocations per operation and the peak resident set size, in KB, during
+ * the measurement. Benchmarks with more columns print them after these.
+ * bench/compare checks two sets of results for regressions.
+ */
+
+/*
+ * Calls to malloc, calloc and realloc are counted. The wrappers replace the
+ * libc functions for the whole program and forward to glibc's internal 
+ * entry points.
+ */
+
+extern void* __libc_malloc (size_t size);
+extern void* __libc_calloc (size_t n, size_t size);
+extern void* __libc_realloc (void* ptr, size_t size);
+extern void __libc_free (void* ptr);
+
+static atomic_size_t bench_alloc_count;
+
+void* malloc (size_t size) {
+	atomic_fetch_add_explicit (&bench_alloc_count, 1, memory_order_relaxed);
+	return __libc_malloc (size);
+}
+
+void* calloc (size_t n, size_t size) {
+	atomic_fetch_add_explicit (&bench_alloc_count, 1, memory_order_relaxed);
+	return __libc_calloc (n, size);
+}
+
+void* realloc (void* ptr, size_t size) {
+	atomic_fetch_add_explicit (&bench_alloc_count, 1, memory_order_relaxed);
+	return __libc_realloc (ptr, size);
+}
+
+void free (void* ptr) {
+	__libc_free (ptr);
+}
+
+/* the number of allocations so far */
+static inline size_t bench_allocs () {
+	return atomic_load_explicit (&bench_alloc_count, memory_order_relaxed);
+}
+
+static inline uint64_t bench_now_ns () {
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/* the allocation count when the measurement started */
+static size_t bench_allocs_mark;
+
+/* resets the kernel's peak resident set size to the current one, Linux 4.0 and later */
+static inline void bench_reset_peak_rss () {
+	FILE* f = fopen ("/proc/self/clear_refs", "w");
+	if (f != NULL) {
+		fputs ("5", f);
+		fclose (f);
+	}
+}
+
+/* the peak resident set size in KB since the last reset, or 0 if it is unavailable */
+static inline size_t bench_peak_rss_kb () {
+	FILE* f = fopen ("/proc/self/status", "r");
+	if (f == NULL) {
+		return 0;
+	}
+
+	char line[256];
+	size_t kb = 0;
+	while (fgets (line, sizeof (line), f) != NULL) {
+		if (strncmp (line, "VmHWM:", 6) == 0) {
+			kb = strtoul (line + 6, NULL, 10);
+			break;
+		}
+	}
+	fclose (f);
+
+	return kb;
+}
+
+/* starts a measurement, returning the time to pass bench_report the elapsed time from */
+static inline uint64_t bench_start () {
+	bench_reset_peak_rss ();
+	bench_allocs_mark = bench_allocs ();
+
+	return bench_now_ns ();
+}
+
+/* the header with extra, a comma separated list of more columns, or NULL */
+static inline void bench_header_extra (const char* extra) {
+	printf ("benchmark,variant,size,threads,ns_per_op,ops_per_sec,allocs_per_op,peak_rss_kb%s%s\n", 
+			extra != NULL ? "," : "", extra != NULL ? extra : "");
+}
+
+static inline void bench_header () {
+	bench_header_extra (NULL);
+}
+
+/* prints the standard columns of a report without ending the line */
+static inline void bench_report_begin (const char* name, const char* variant, size_t size, size_t threads, uint64_t ns, size_t ops) {
+	size_t allocs = bench_allocs () - bench_allocs_mark;
+	double ns_per_op = ops > 0 ? (double) ns / ops : 0.0;
+	double ops_per_sec = ns > 0 ? (ops * 1e9) / ns : 0.0;
+	double allocs_per_op = ops > 0 ? (double) allocs / ops : 0.0;
+
+	printf ("%s,%s,%zu,%zu,%.2f,%.0f,%.4f,%zu", name, variant, size, threads, ns_per_op, ops_per_sec, 
+			allocs_per_op, bench_peak_rss_kb ());
+}
+
+static inline void bench_report (const char* name, const char* variant, size_t size, size_t threads, uint64_t ns, size_t ops) {
+	bench_report_begin (name, variant, size, threads, ns, ops);
+	printf ("\n");
+	fflush (stdout);
+}
+
+/* xorshift64* - a cheap deterministic generator for benchmark input */
+static inline uint64_t bench_rand (uint64_t* state) {
+	uint64_t x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+/* a uniform double in [0, 1) */
+static inline double bench_rand_unit (uint64_t* state) {
+	return (bench_rand (state) >> 11) * 0x1.0p-53;
+}
+
+/*
+ * Keys drawn from a Zipfian distribution: key k of n is drawn with a 
+ * probability proportional to 1 / (k + 1)^s, by a binary search of the
+ * cumulative weights. s = 1 is the classic distribution of word frequencies.
+ */
+typedef struct {
+	size_t n;
+	double* cdf;
+} bench_zipf;
+
+static inline int bench_zipf_init (bench_zipf* z, size_t n, double s) {
+	z->n = n;
+	z->cdf = malloc (n * sizeof (double));
+	if (z->cdf == NULL) {
+		return -1;
+	}
+
+	double sum = 0.0;
+	for (size_t k = 0; k < n; ++k) {
+		sum += s == 1.0 ? 1.0 / (k + 1) : 1.0 / pow (k + 1, s);
+		z->cdf[k] = sum;
+	}
+
+	return 0;
+}
+
+static inline size_t bench_zipf_next (bench_zipf* z, uint64_t* state) {
+	double u = bench_rand_unit (state) * z->cdf[z->n - 1];
+	size_t lo = 0;
+	size_t hi = z->n - 1;
+
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		if (z->cdf[mid] < u) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+static inline void bench_zipf_free (bench_zipf* z) {
+	free (z->cdf);
+	z->cdf = NULL;
+}
+
+#endif // BENCH_H_
@@ -0,0 +1,143 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Membership, union and intersection over a dense universe of 4n integers: 
+ * a set of boxed ints against a bitset. The set operations are only run up 
+ * to the size given as the first argument.
+ * usage: bitset_bench [largest size for set]
+ */
+
+static int int_equals (void* l, void* r) {
+	return *(int*) l == *(int*) r;
+}
+
+static void fill (size_t n, uint64_t seed, int* values, set* s, bitset* bs) {
+	for (size_t i = 0; i < n; ++i) {
+		values[i] = bench_rand (&seed) % (4 * n);
+		if (s != NULL) {
+			set_add_item (s, &values[i]);
+		}
+		bitset_set (bs, values[i]);
+	}
+}
+
+int main (int argc, char** argv) {
+	size_t set_max = argc > 1 ? strtoul (argv[1], NULL, 10) : 10000;
+	size_t sizes[] = { 1000, 10000, 100000, 1000000, 10000000 };
+
+	bench_header ();
+
+	for (size_t z = 0; z < sizeof (sizes) / sizeof (sizes[0]); ++z) {
+		size_t n = sizes[z];
+		int use_set = n <= set_max;
+
+		int* va = malloc (n * sizeof (int));
+		int* vb = malloc (n * sizeof (int));
+		int* probes = malloc (n * sizeof (int));
+		set* sa = use_set ? set_create (n, int_equals) : NULL;
+		set* sb = use_set ? set_create (n, int_equals) : NULL;
+		bitset* ba = bitset_create (4 * n);
+		bitset* bb = bitset_create (4 * n);
+		if (va == NULL || vb == NULL || probes == NULL || ba == NULL || bb == NULL) {
+			PMSG ("allocation failed");
+			return EXIT_FAILURE;
+		}
+
+		fill (n, 1, va, sa, ba);
+		fill (n, 2, vb, sb, bb);
+
+		uint64_t seed = 3;
+		for (size_t i = 0; i < n; ++i) {
+			probes[i] = bench_rand (&seed) % (4 * n);
+		}
+
+		volatile size_t hits = 0;
+		uint64_t start;
+
+		start = bench_start ();
+		for (size_t i = 0; i < n; ++i) {
+			hits += bitset_test (ba, probes[i]);
+		}
+		bench_report ("membership", "bitset", n, 1, bench_now_ns () - start, n);
+
+		if (use_set) {
+			start = bench_start ();
+			for (size_t i = 0; i < n; ++i) {
+				hits += set_get_item_index (sa, &probes[i]) != -1;
+			}
+			bench_report ("membership", "set", n, 1, bench_now_ns () - start, n);
+		}
+
+		bitset* bc = bitset_create (0);
+		int reps = n < 1000000 ? 100 : 10;
+
+		start = bench_start ();
+		for (int r = 0; r < reps; ++r) {
+			bitset_or (bc, ba);
+			bitset_or (bc, bb);
+			bitset_and (bc, ba);
+		}
+		uint64_t elapsed = bench_now_ns () - start;
+		bench_report ("union+intersection", "bitset", n, 1, elapsed / reps, 1);
+
+		start = bench_start ();
+		for (int r = 0; r < reps; ++r) {
+			hits += bitset_count (bc);
+		}
+		bench_report ("popcount", "bitset", n, 1, (bench_now_ns () - start) / reps, 1);
+
+		if (use_set) {
+			start = bench_start ();
+			set* u = set_union (sa, sb);
+			set* i = set_intersection (u, sa);
+			elapsed = bench_now_ns () - start;
+			bench_report ("union+intersection", "set", n, 1, elapsed, 1);
+			set_delete (u, NULL);
+			if (i != NULL) {
+				set_delete (i, NULL);
+			}
+		}
+
+		bitset_delete (bc);
+		bitset_delete (ba);
+		bitset_delete (bb);
+		if (use_set) {
+			set_delete (sa, NULL);
+			set_delete (sb, NULL);
+		}
+		free (va);
+		free (vb);
+		free (probes);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,139 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Encodes and decodes arrays of 10M integers as varints, one at a time and
+ * in bulk, and as fixed width u64s. "small" values fit in one byte, "mixed"
+ * are half 1 byte, 30% 2 bytes, 15% up to 32 bits and 5% up to 64 bits, and
+ * "large" are 64 bit.
+ * usage: byte_buffer_bench [count]
+ */
+
+static uint64_t next_value (const char* dist, uint64_t* seed) {
+	uint64_t r = bench_rand (seed);
+
+	if (dist[0] == 's') {
+		return r & 0x7f;
+	}
+	if (dist[0] == 'l') {
+		return r;
+	}
+
+	int pick = r % 100;
+	r = bench_rand (seed);
+	if (pick < 50) {
+		return r & 0x7f;
+	}
+	if (pick < 80) {
+		return r & 0x3fff;
+	}
+	if (pick < 95) {
+		return r & 0xffffffff;
+	}
+	return r;
+}
+
+static void run (const char* dist, size_t n) {
+	uint64_t* values = malloc (n * sizeof (uint64_t));
+	uint64_t* decoded = malloc (n * sizeof (uint64_t));
+	byte_buffer* bb = byte_buffer_create (n * 10);
+	if (values == NULL || decoded == NULL || bb == NULL) {
+		PMSG ("allocation failed");
+		exit (EXIT_FAILURE);
+	}
+
+	uint64_t seed = 13;
+	for (size_t i = 0; i < n; ++i) {
+		values[i] = next_value (dist, &seed);
+	}
+
+	uint64_t start = bench_start ();
+	for (size_t i = 0; i < n; ++i) {
+		byte_buffer_put_varint (bb, values[i]);
+	}
+	bench_report ("put_varint", dist, n, 1, bench_now_ns () - start, n);
+	size_t encoded = bb->count;
+
+	byte_buffer_clear (bb);
+	start = bench_start ();
+	byte_buffer_put_varints (bb, values, n);
+	bench_report ("put_varints", dist, n, 1, bench_now_ns () - start, n);
+
+	start = bench_start ();
+	for (size_t i = 0; i < n; ++i) {
+		byte_buffer_get_varint (bb, &decoded[i]);
+	}
+	bench_report ("get_varint", dist, n, 1, bench_now_ns () - start, n);
+
+	bb->pos = 0;
+	memset (decoded, 0, n * sizeof (uint64_t));
+	start = bench_start ();
+	size_t got = byte_buffer_get_varints (bb, decoded, n);
+	bench_report ("get_varints", dist, n, 1, bench_now_ns () - start, n);
+
+	if (got != n || bb->count != encoded || memcmp (values, decoded, n * sizeof (uint64_t)) != 0) {
+		PMSG ("decoded values differ");
+		exit (EXIT_FAILURE);
+	}
+
+	byte_buffer_clear (bb);
+	start = bench_start ();
+	for (size_t i = 0; i < n; ++i) {
+		byte_buffer_put_u64 (bb, values[i]);
+	}
+	bench_report ("put_u64", dist, n, 1, bench_now_ns () - start, n);
+
+	start = bench_start ();
+	for (size_t i = 0; i < n; ++i) {
+		byte_buffer_get_u64 (bb, &decoded[i]);
+	}
+	bench_report ("get_u64", dist, n, 1, bench_now_ns () - start, n);
+
+	fprintf (stderr, "%s: %.2f bytes per varint\n", dist, (double) encoded / n);
+
+	byte_buffer_delete (bb);
+	free (values);
+	free (decoded);
+}
+
+int main (int argc, char** argv) {
+	size_t n = argc > 1 ? strtoul (argv[1], NULL, 10) : 10000000;
+	const char* dists[] = { "small", "mixed", "large" };
+
+	bench_header ();
+
+	for (size_t d = 0; d < sizeof (dists) / sizeof (dists[0]); ++d) {
+		run (dists[d], n);
+	}
+
+	return EXIT_SUCCESS;
+}
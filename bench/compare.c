@@ -0,0 +1,179 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Compares two files of benchmark results and flags the rows of the second
+ * that regressed. Rows are matched on benchmark, variant, size and threads.
+ * A row regressed if its ns_per_op grew by more than the threshold percent
+ * or its allocs_per_op grew at all. Columns are found by name in the header
+ * lines, so the results of benches with extra columns can be concatenated.
+ * usage: compare old.csv new.csv [threshold percent, default 10]
+ * exits 1 if any row regressed.
+ */
+
+#define MAX_FIELDS 16
+
+typedef struct {
+	char* key;
+	double ns;
+	double allocs;
+} result;
+
+typedef struct {
+	result* rows;
+	size_t count;
+	size_t size;
+} results;
+
+static size_t split (char* line, char** fields) {
+	size_t n = 0;
+	line[strcspn (line, "\r\n")] = '\0';
+	for (char* f = line; n < MAX_FIELDS; ++n) {
+		fields[n] = f;
+		char* comma = strchr (f, ',');
+		if (comma == NULL) {
+			return n + 1;
+		}
+		*comma = '\0';
+		f = comma + 1;
+	}
+	return n;
+}
+
+static int column (char** fields, size_t n, const char* name) {
+	for (size_t i = 0; i < n; ++i) {
+		if (strcmp (fields[i], name) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static int load (const char* path, results* r) {
+	FILE* f = fopen (path, "r");
+	if (f == NULL) {
+		perror (path);
+		return -1;
+	}
+
+	char* line = NULL;
+	size_t line_size = 0;
+	int ns_col = -1;
+	int allocs_col = -1;
+	while (getline (&line, &line_size, f) != -1) {
+		char* fields[MAX_FIELDS];
+		size_t n = split (line, fields);
+		if (strcmp (fields[0], "benchmark") == 0) {
+			ns_col = column (fields, n, "ns_per_op");
+			allocs_col = column (fields, n, "allocs_per_op");
+			continue;
+		}
+		if (n < 4 || ns_col == -1 || ns_col >= (int) n) {
+			continue;
+		}
+
+		if (r->count == r->size) {
+			r->size = r->size ? r->size * 2 : 64;
+			result* rows = realloc (r->rows, r->size * sizeof (result));
+			if (rows == NULL) {
+				perror ("realloc");
+				exit (EXIT_FAILURE);
+			}
+			r->rows = rows;
+		}
+
+		result* row = &r->rows[r->count++];
+		if (asprintf (&row->key, "%s,%s,%s,%s", fields[0], fields[1], fields[2], fields[3]) == -1) {
+			perror ("asprintf");
+			exit (EXIT_FAILURE);
+		}
+		row->ns = strtod (fields[ns_col], NULL);
+		row->allocs = allocs_col != -1 && allocs_col < (int) n ? strtod (fields[allocs_col], NULL) : 0.0;
+	}
+
+	free (line);
+	fclose (f);
+	return 0;
+}
+
+static result* find (results* r, const char* key) {
+	for (size_t i = 0; i < r->count; ++i) {
+		if (strcmp (r->rows[i].key, key) == 0) {
+			return &r->rows[i];
+		}
+	}
+	return NULL;
+}
+
+int main (int argc, char** argv) {
+	if (argc < 3) {
+		fprintf (stderr, "usage: %s old.csv new.csv [threshold percent]\n", argv[0]);
+		return 2;
+	}
+	double threshold = argc > 3 ? strtod (argv[3], NULL) : 10.0;
+
+	results old = { NULL, 0, 0 };
+	results new = { NULL, 0, 0 };
+	if (load (argv[1], &old) == -1 || load (argv[2], &new) == -1) {
+		return 2;
+	}
+
+	size_t regressions = 0;
+	printf ("benchmark,variant,size,threads,old_ns_per_op,new_ns_per_op,change_pct,old_allocs_per_op,new_allocs_per_op,status\n");
+	for (size_t i = 0; i < new.count; ++i) {
+		result* n = &new.rows[i];
+		result* o = find (&old, n->key);
+		if (o == NULL) {
+			printf ("%s,,%.2f,,,%.4f,new\n", n->key, n->ns, n->allocs);
+			continue;
+		}
+
+		double change = o->ns > 0.0 ? (n->ns - o->ns) * 100.0 / o->ns : 0.0;
+		const char* status = "ok";
+		if (change > threshold || n->allocs > o->allocs + 1e-4) {
+			status = "REGRESSION";
+			++regressions;
+		} else if (change < -threshold) {
+			status = "improved";
+		}
+		printf ("%s,%.2f,%.2f,%+.1f,%.4f,%.4f,%s\n", n->key, o->ns, n->ns, change, o->allocs, n->allocs, status);
+	}
+
+	fprintf (stderr, "%zu of %zu benchmarks regressed by more than %.1f%%\n", regressions, new.count, threshold);
+
+	for (size_t i = 0; i < old.count; ++i) {
+		free (old.rows[i].key);
+	}
+	for (size_t i = 0; i < new.count; ++i) {
+		free (new.rows[i].key);
+	}
+	free (old.rows);
+	free (new.rows);
+
+	return regressions ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,157 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+/*
+ * Ingest of n items split between 1 to 16 producer threads appending to one
+ * array: an auto_array under a mutex, concurrent_array_add and
+ * concurrent_array_add_items in batches of 64. Each producer does a little
+ * work per record, as a parser would. The extra column is the speedup over
+ * one producer of the same variant.
+ * usage: concurrent_array_bench [items] [work per item]
+ */
+
+#define BATCH 64
+
+static size_t work = 16;
+
+typedef struct {
+	int variant;
+	auto_array* aa;
+	pthread_mutex_t* lock;
+	concurrent_array* ca;
+	size_t lo;
+	size_t hi;
+} producer;
+
+static void* record (size_t v) {
+	uint64_t x = v + 1;
+	for (size_t i = 0; i < work; ++i) {
+		x ^= x >> 33;
+		x *= 0xff51afd7ed558ccdULL;
+	}
+
+	return (void*) (uintptr_t) (x | 1);
+}
+
+static void* produce (void* arg) {
+	producer* p = arg;
+	void* batch[BATCH];
+	size_t b = 0;
+
+	for (size_t i = p->lo; i < p->hi; ++i) {
+		void* item = record (i);
+
+		switch (p->variant) {
+			case 0:
+				pthread_mutex_lock (p->lock);
+				auto_array_add (p->aa, item);
+				pthread_mutex_unlock (p->lock);
+				break;
+			case 1:
+				concurrent_array_add (p->ca, item);
+				break;
+			case 2:
+				batch[b++] = item;
+				if (b == BATCH) {
+					concurrent_array_add_items (p->ca, batch, b);
+					b = 0;
+				}
+				break;
+		}
+	}
+
+	if (b > 0) {
+		concurrent_array_add_items (p->ca, batch, b);
+	}
+
+	return NULL;
+}
+
+int main (int argc, char** argv) {
+	size_t n = argc > 1 ? strtoul (argv[1], NULL, 10) : 4000000;
+	work = argc > 2 ? strtoul (argv[2], NULL, 10) : work;
+
+	size_t threads[] = { 1, 2, 4, 8, 16 };
+	const char* variants[] = { "mutex_auto_array", "add", "add_items" };
+	uint64_t base[3] = { 0 };
+
+	bench_header_extra ("speedup");
+
+	for (size_t t = 0; t < sizeof (threads) / sizeof (threads[0]); ++t) {
+		for (int v = 0; v < 3; ++v) {
+			pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+			auto_array* aa = auto_array_create (16);
+			concurrent_array* ca = concurrent_array_create (16);
+			pthread_t tids[16];
+			producer producers[16];
+			if (aa == NULL || ca == NULL) {
+				PMSG ("allocation failed");
+				return EXIT_FAILURE;
+			}
+
+			uint64_t start = bench_start ();
+			for (size_t i = 0; i < threads[t]; ++i) {
+				producers[i] = (producer) { v, aa, &lock, ca, (n * i) / threads[t], (n * (i + 1)) / threads[t] };
+				pthread_create (&tids[i], NULL, produce, &producers[i]);
+			}
+			for (size_t i = 0; i < threads[t]; ++i) {
+				pthread_join (tids[i], NULL);
+			}
+
+			auto_array* sealed = v == 0 ? NULL : concurrent_array_seal (ca);
+			uint64_t elapsed = bench_now_ns () - start;
+
+			size_t count = v == 0 ? aa->count : sealed->count;
+			if (count != n) {
+				PMSG ("lost items");
+				return EXIT_FAILURE;
+			}
+
+			if (t == 0) {
+				base[v] = elapsed;
+			}
+
+			bench_report_begin ("concurrent_ingest", variants[v], n, threads[t], elapsed, n);
+			printf (",%.2f\n", (double) base[v] / elapsed);
+			fflush (stdout);
+
+			auto_array_delete (aa, NULL);
+			if (sealed != NULL) {
+				auto_array_delete (sealed, NULL);
+			} else {
+				concurrent_array_delete (ca, NULL);
+			}
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
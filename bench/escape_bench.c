@@ -0,0 +1,178 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * JSON escaping, URL encoding and UTF-8 validation of 64 MB of ASCII heavy
+ * text, a quote or newline every 80 bytes or so, and of multibyte heavy 
+ * text, mostly 2 and 3 byte sequences between spaces. Each is compared with
+ * the byte at a time code it replaces. Rates are in bytes.
+ * usage: escape_bench [size in MB]
+ */
+
+static const char hex[] = "0123456789ABCDEF";
+
+static void json_bytewise (auto_string* s, const char* p, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		unsigned char c = p[i];
+		switch (c) {
+			case '"': auto_string_append_n (s, "\\\"", 2); break;
+			case '\\': auto_string_append_n (s, "\\\\", 2); break;
+			case '\n': auto_string_append_n (s, "\\n", 2); break;
+			case '\r': auto_string_append_n (s, "\\r", 2); break;
+			case '\t': auto_string_append_n (s, "\\t", 2); break;
+			case '\b': auto_string_append_n (s, "\\b", 2); break;
+			case '\f': auto_string_append_n (s, "\\f", 2); break;
+			default:
+				if (c < 0x20) {
+					char u[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+					auto_string_append_n (s, u, 6);
+				} else {
+					auto_string_append_char (s, c);
+				}
+		}
+	}
+}
+
+static void url_bytewise (auto_string* s, const char* p, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		unsigned char c = p[i];
+		if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') 
+				|| c == '-' || c == '_' || c == '.' || c == '~') {
+			auto_string_append_char (s, c);
+		} else {
+			char e[3] = { '%', hex[c >> 4], hex[c & 0xf] };
+			auto_string_append_n (s, e, 3);
+		}
+	}
+}
+
+static int utf8_bytewise (const unsigned char* p, size_t n) {
+	for (size_t i = 0; i < n; ) {
+		unsigned char c = p[i];
+		size_t len = c < 0x80 ? 1 : c >= 0xc2 && c <= 0xdf ? 2 : c >= 0xe0 && c <= 0xef ? 3 : c >= 0xf0 && c <= 0xf4 ? 4 : 0;
+		if (len == 0 || i + len > n) {
+			return 0;
+		}
+		if ((c == 0xe0 && p[i + 1] < 0xa0) || (c == 0xed && p[i + 1] > 0x9f) 
+				|| (c == 0xf0 && p[i + 1] < 0x90) || (c == 0xf4 && p[i + 1] > 0x8f)) {
+			return 0;
+		}
+		for (size_t k = 1; k < len; ++k) {
+			if ((p[i + k] & 0xc0) != 0x80) {
+				return 0;
+			}
+		}
+		i += len;
+	}
+
+	return 1;
+}
+
+static void generate (auto_string* text, size_t size, int multibyte) {
+	const char* words[] = { "the", "response", "status", "items", "\"quoted\"", "value\n", "ok", "path/to" };
+	const char* multi[] = { "\xd0\xbf\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82", "\xe4\xb8\x96\xe7\x95\x8c", 
+		"\xe3\x81\x93\xe3\x82\x93\xe3\x81\xab\xe3\x81\xa1\xe3\x81\xaf", "caf\xc3\xa9", "\xf0\x9f\x98\x80" };
+	uint64_t seed = 17;
+
+	while (text->count < size) {
+		uint64_t r = bench_rand (&seed);
+		if (multibyte) {
+			auto_string_append (text, (char*) multi[r % 5]);
+		} else if (r % 8 < 4) {
+			// mostly plain words, which JSON copies and URLs only encode the spaces of
+			auto_string_append (text, "lorem ipsum dolor sit amet consectetur");
+		} else {
+			auto_string_append (text, (char*) words[r % 8]);
+		}
+		auto_string_append_char (text, ' ');
+	}
+}
+
+static void run (const char* name, const char* variant, auto_string* text, int fast) {
+	auto_string* out = auto_string_create (1);
+	int valid = 1;
+
+	uint64_t start = bench_start ();
+	switch (name[0]) {
+		case 'j':
+			if (fast) {
+				auto_string_append_json_escaped (out, text->buf, text->count);
+			} else {
+				json_bytewise (out, text->buf, text->count);
+			}
+			break;
+		case 'u':
+			if (name[1] == 'r') {
+				if (fast) {
+					auto_string_append_url_encoded (out, text->buf, text->count);
+				} else {
+					url_bytewise (out, text->buf, text->count);
+				}
+			} else {
+				valid = fast ? utf8_validate (text->buf, text->count) : utf8_bytewise ((unsigned char*) text->buf, text->count);
+			}
+			break;
+	}
+	uint64_t elapsed = bench_now_ns () - start;
+
+	if (!valid) {
+		PMSG ("text is not valid UTF-8");
+		exit (EXIT_FAILURE);
+	}
+
+	char label[64];
+	snprintf (label, sizeof (label), "%s_%s", variant, fast ? "simd" : "bytewise");
+	bench_report (name, label, text->count, 1, elapsed, text->count);
+
+	auto_string_delete (out);
+}
+
+int main (int argc, char** argv) {
+	size_t mb = argc > 1 ? strtoul (argv[1], NULL, 10) : 64;
+	const char* names[] = { "json_escape", "url_encode", "utf8_validate" };
+
+	bench_header ();
+
+	for (int multibyte = 0; multibyte < 2; ++multibyte) {
+		auto_string* text = auto_string_create (1);
+		generate (text, mb << 20, multibyte);
+
+		for (size_t n = 0; n < sizeof (names) / sizeof (names[0]); ++n) {
+			run (names[n], multibyte ? "multibyte" : "ascii", text, 0);
+			run (names[n], multibyte ? "multibyte" : "ascii", text, 1);
+		}
+
+		auto_string_delete (text);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,161 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Formatting log lines, integers and doubles into an auto_string: snprintf
+ * into a stack buffer then auto_string_append, against auto_string_appendf
+ * and the integer and double appenders. The string is emptied every 1 MB.
+ * usage: format_bench [lines]
+ */
+
+static const char* levels[] = { "debug", "info", "warn", "error" };
+
+static uint64_t* stamps;
+static int* ids;
+static double* latencies;
+
+static void reset (auto_string* s) {
+	if (s->count > (1 << 20)) {
+		s->count = 0;
+		s->buf[0] = '\0';
+	}
+}
+
+static void log_lines (auto_string* s, size_t n, int variant) {
+	char tmp[256];
+
+	for (size_t i = 0; i < n; ++i) {
+		const char* level = levels[i & 3];
+
+		switch (variant) {
+			case 0:
+				snprintf (tmp, sizeof (tmp), "ts=%llu level=%s id=%d latency=%.3f msg=%s\n", 
+						(unsigned long long) stamps[i], level, ids[i], latencies[i], "request served");
+				auto_string_append (s, tmp);
+				break;
+			case 1:
+				auto_string_appendf (s, "ts=%llu level=%s id=%d latency=%.3f msg=%s\n", 
+						(unsigned long long) stamps[i], level, ids[i], latencies[i], "request served");
+				break;
+			default:
+				auto_string_append_n (s, "ts=", 3);
+				auto_string_append_uint (s, stamps[i]);
+				auto_string_append_n (s, " level=", 7);
+				auto_string_append (s, (char*) level);
+				auto_string_append_n (s, " id=", 4);
+				auto_string_append_int (s, ids[i]);
+				auto_string_append_n (s, " latency=", 9);
+				auto_string_append_double (s, latencies[i], 3);
+				auto_string_append_n (s, " msg=request served\n", 20);
+				break;
+		}
+
+		reset (s);
+	}
+}
+
+static void ints (auto_string* s, size_t n, int variant) {
+	char tmp[32];
+
+	for (size_t i = 0; i < n; ++i) {
+		if (variant == 0) {
+			snprintf (tmp, sizeof (tmp), "%d,", ids[i]);
+			auto_string_append (s, tmp);
+		} else if (variant == 1) {
+			auto_string_appendf (s, "%d,", ids[i]);
+		} else {
+			auto_string_append_int (s, ids[i]);
+			auto_string_append_char (s, ',');
+		}
+
+		reset (s);
+	}
+}
+
+static void doubles (auto_string* s, size_t n, int variant) {
+	char tmp[64];
+
+	for (size_t i = 0; i < n; ++i) {
+		if (variant == 0) {
+			snprintf (tmp, sizeof (tmp), "%.3f,", latencies[i]);
+			auto_string_append (s, tmp);
+		} else if (variant == 1) {
+			auto_string_appendf (s, "%.3f,", latencies[i]);
+		} else {
+			auto_string_append_double (s, latencies[i], 3);
+			auto_string_append_char (s, ',');
+		}
+
+		reset (s);
+	}
+}
+
+int main (int argc, char** argv) {
+	size_t n = argc > 1 ? strtoul (argv[1], NULL, 10) : 1000000;
+	const char* variants[] = { "snprintf_append", "appendf", "append_typed" };
+	void (*runs[]) (auto_string*, size_t, int) = { log_lines, ints, doubles };
+	const char* names[] = { "log_line", "int", "double" };
+
+	stamps = malloc (n * sizeof (uint64_t));
+	ids = malloc (n * sizeof (int));
+	latencies = malloc (n * sizeof (double));
+	if (stamps == NULL || ids == NULL || latencies == NULL) {
+		PMSG ("allocation failed");
+		return EXIT_FAILURE;
+	}
+
+	uint64_t seed = 5;
+	for (size_t i = 0; i < n; ++i) {
+		stamps[i] = 1700000000000ULL + i;
+		ids[i] = (int) (bench_rand (&seed) % 2000000) - 1000000;
+		latencies[i] = (bench_rand (&seed) % 10000000) / 1000.0;
+	}
+
+	auto_string* s = auto_string_create ((1 << 20) + 4096);
+
+	bench_header ();
+
+	for (int r = 0; r < 3; ++r) {
+		for (int v = 0; v < 3; ++v) {
+			uint64_t start = bench_start ();
+			runs[r] (s, n, v);
+			bench_report (names[r], variants[v], n, 1, bench_now_ns () - start, n);
+		}
+	}
+
+	auto_string_delete (s);
+	free (latencies);
+	free (ids);
+	free (stamps);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,111 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * hash_table_put of n string keys into n buckets, hash_table_get of n keys
+ * drawn uniformly and from a Zipfian distribution, gets of missing keys,
+ * and hash_table_remove of every key.
+ * usage: hash_table_bench
+ */
+
+#define KEY_LEN 32
+
+static void run (size_t n) {
+	char* keys = malloc (n * KEY_LEN);
+	char* missing = malloc (n * KEY_LEN);
+	size_t* uniform = malloc (n * sizeof (size_t));
+	size_t* zipfian = malloc (n * sizeof (size_t));
+	bench_zipf zipf;
+	if (keys == NULL || missing == NULL || uniform == NULL || zipfian == NULL || bench_zipf_init (&zipf, n, 1.0) == -1) {
+		PMSG ("allocation failed");
+		exit (EXIT_FAILURE);
+	}
+
+	// the popular keys are scattered through the insertion order
+	uint64_t seed = 19;
+	for (size_t i = 0; i < n; ++i) {
+		snprintf (keys + (i * KEY_LEN), KEY_LEN, "key-%011zu", i);
+		snprintf (missing + (i * KEY_LEN), KEY_LEN, "nokey-%09zu", i);
+		uniform[i] = bench_rand (&seed) % n;
+		zipfian[i] = (bench_zipf_next (&zipf, &seed) * 2654435761u) % n;
+	}
+
+	hash_table* ht = hash_table_create (n);
+
+	uint64_t start = bench_start ();
+	for (size_t i = 0; i < n; ++i) {
+		hash_table_put (ht, keys + (i * KEY_LEN), keys);
+	}
+	bench_report ("hash_table_put", "uniform", n, 1, bench_now_ns () - start, n);
+
+	const char* dists[] = { "uniform", "zipf" };
+	size_t* draws[] = { uniform, zipfian };
+	volatile size_t found = 0;
+	for (int d = 0; d < 2; ++d) {
+		start = bench_start ();
+		for (size_t i = 0; i < n; ++i) {
+			found += hash_table_get (ht, keys + (draws[d][i] * KEY_LEN)) != NULL;
+		}
+		bench_report ("hash_table_get", dists[d], n, 1, bench_now_ns () - start, n);
+	}
+
+	start = bench_start ();
+	for (size_t i = 0; i < n; ++i) {
+		found += hash_table_get (ht, missing + (i * KEY_LEN)) != NULL;
+	}
+	bench_report ("hash_table_get", "missing", n, 1, bench_now_ns () - start, n);
+
+	start = bench_start ();
+	for (size_t i = 0; i < n; ++i) {
+		hash_table_remove (ht, keys + (i * KEY_LEN));
+	}
+	bench_report ("hash_table_remove", "uniform", n, 1, bench_now_ns () - start, n);
+
+	hash_table_delete (ht, NULL);
+	bench_zipf_free (&zipf);
+	free (zipfian);
+	free (uniform);
+	free (missing);
+	free (keys);
+}
+
+int main (int argc, char** argv) {
+	size_t sizes[] = { 1000, 100000, 1000000 };
+
+	bench_header ();
+
+	for (size_t s = 0; s < sizeof (sizes) / sizeof (sizes[0]); ++s) {
+		run (sizes[s]);
+	}
+
+	return EXIT_SUCCESS;
+}
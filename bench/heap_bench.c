@@ -0,0 +1,145 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * A timer queue workload: n timers are scheduled, then n times the earliest
+ * timer fires and is rescheduled, then the queue is drained. Compares heaps
+ * of arity 2 and 4 with a sorted auto_array maintained with auto_array_insert
+ * (kept in descending order so that the earliest timer is popped from the end).
+ * Each heap run also reschedules n/2 pending timers through heap_update.
+ * usage: heap_bench [largest size for the sorted auto_array]
+ */
+
+static int key_compare (void* l, void* r) {
+	uintptr_t a = (uintptr_t) l;
+	uintptr_t b = (uintptr_t) r;
+
+	return a < b ? -1 : a > b;
+}
+
+static size_t sorted_position (auto_array* aa, uintptr_t key) {
+	size_t lo = 0;
+	size_t hi = aa->count;
+
+	while (lo < hi) {
+		size_t mid = lo + ((hi - lo) / 2);
+		if ((uintptr_t) aa->data[mid] > key) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+static uint64_t run_sorted (size_t n, uint64_t seed) {
+	auto_array* aa = auto_array_create (16);
+	uint64_t start = bench_start ();
+
+	for (size_t i = 0; i < n; ++i) {
+		uintptr_t key = bench_rand (&seed) >> 16;
+		auto_array_insert (aa, sorted_position (aa, key), (void*) key);
+	}
+
+	for (size_t i = 0; i < n; ++i) {
+		uintptr_t key = (uintptr_t) auto_array_remove (aa, aa->count - 1);
+		key += bench_rand (&seed) >> 40;
+		auto_array_insert (aa, sorted_position (aa, key), (void*) key);
+	}
+
+	while (aa->count > 0) {
+		auto_array_remove (aa, aa->count - 1);
+	}
+
+	uint64_t elapsed = bench_now_ns () - start;
+	auto_array_delete (aa, NULL);
+
+	return elapsed;
+}
+
+static uint64_t run_heap (size_t n, size_t arity, uint64_t seed, int update) {
+	heap* h = heap_create (16, arity, key_compare);
+	heap_node** handles = malloc (n * sizeof (heap_node*));
+	if (h == NULL || handles == NULL) {
+		PMSG ("allocation failed");
+		exit (EXIT_FAILURE);
+	}
+
+	uint64_t start = bench_start ();
+
+	for (size_t i = 0; i < n; ++i) {
+		handles[i] = heap_push (h, (void*) (uintptr_t) (bench_rand (&seed) >> 16));
+	}
+
+	if (update) {
+		for (size_t i = 0; i < n; i += 2) {
+			handles[i]->item = (void*) (uintptr_t) (bench_rand (&seed) >> 16);
+			heap_update (h, handles[i]);
+		}
+	}
+
+	for (size_t i = 0; i < n; ++i) {
+		uintptr_t key = (uintptr_t) heap_pop (h);
+		key += bench_rand (&seed) >> 40;
+		heap_push (h, (void*) key);
+	}
+
+	while (heap_pop (h) != NULL);
+
+	uint64_t elapsed = bench_now_ns () - start;
+	heap_delete (h, NULL);
+	free (handles);
+
+	return elapsed;
+}
+
+int main (int argc, char** argv) {
+	size_t sorted_max = argc > 1 ? strtoul (argv[1], NULL, 10) : 100000;
+	size_t sizes[] = { 10000, 100000, 1000000, 10000000 };
+
+	bench_header ();
+
+	for (size_t s = 0; s < sizeof (sizes) / sizeof (sizes[0]); ++s) {
+		size_t n = sizes[s];
+		size_t ops = 3 * n;
+
+		bench_report ("timer_queue", "heap_d2", n, 1, run_heap (n, 2, 42, 0), ops);
+		bench_report ("timer_queue", "heap_d4", n, 1, run_heap (n, 4, 42, 0), ops);
+		bench_report ("timer_queue_update", "heap_d4", n, 1, run_heap (n, 4, 42, 1), ops + (n / 2));
+
+		if (n <= sorted_max) {
+			bench_report ("timer_queue", "sorted_auto_array", n, 1, run_sorted (n, 42), ops);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
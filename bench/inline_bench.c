@@ -0,0 +1,148 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+// only this file sees SSCONT_INLINE, the library sources are built without it
+#ifdef BENCH_INLINE
+#define SSCONT_INLINE
+#endif
+
+#include "container.h"
+#include "debug_utils.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The per call cost of the accessors and of hash_table_get, built three 
+ * ways: calling into a shared library (shared), linked with the library 
+ * objects (static), and with SSCONT_INLINE and link time optimization 
+ * (inline), which lets the compiler inline and vectorize through them.
+ * usage: inline_bench
+ */
+
+#if defined (SSCONT_INLINE)
+#define VARIANT "inline"
+#elif defined (BENCH_SHARED)
+#define VARIANT "shared"
+#else
+#define VARIANT "static"
+#endif
+
+#define ROUNDS 20
+#define KEY_LEN 32
+
+static int key_equals (void* l, void* r) {
+	return strcmp (l, r) == 0;
+}
+
+static uint32_t key_hash (void* item) {
+	return SuperFastHash (item, strlen (item));
+}
+
+static void run (size_t n) {
+	auto_array* aa = auto_array_create (n);
+	set* s = set_create_hashed (n, key_equals, key_hash);
+	bitset* bs = bitset_create (n);
+	hash_table* ht = hash_table_create (n);
+	char* keys = malloc (n * KEY_LEN);
+	if (aa == NULL || s == NULL || bs == NULL || ht == NULL || keys == NULL) {
+		PMSG ("allocation failed");
+		exit (EXIT_FAILURE);
+	}
+
+	uint64_t seed = 29;
+	for (size_t i = 0; i < n; ++i) {
+		auto_array_add (aa, (void*) i);
+		if (bench_rand (&seed) & 1) {
+			bitset_set (bs, i);
+		}
+		snprintf (keys + (i * KEY_LEN), KEY_LEN, "key-%zu", i);
+		hash_table_put (ht, keys + (i * KEY_LEN), (void*) i);
+		set_add_item (s, keys + (i * KEY_LEN));
+	}
+
+	volatile uintptr_t sink = 0;
+	uintptr_t sum = 0;
+
+	uint64_t start = bench_start ();
+	for (int r = 0; r < ROUNDS; ++r) {
+		for (size_t i = 0; i < n; ++i) {
+			sum += (uintptr_t) auto_array_get (aa, i);
+		}
+	}
+	bench_report ("auto_array_get", VARIANT, n, 1, bench_now_ns () - start, ROUNDS * n);
+
+	start = bench_start ();
+	for (int r = 0; r < ROUNDS; ++r) {
+		for (size_t i = 0; i < n; ++i) {
+			sum += (uintptr_t) auto_array_last (aa);
+		}
+	}
+	bench_report ("auto_array_last", VARIANT, n, 1, bench_now_ns () - start, ROUNDS * n);
+
+	start = bench_start ();
+	for (int r = 0; r < ROUNDS; ++r) {
+		for (size_t i = 0; i < n; ++i) {
+			sum += (uintptr_t) set_get_item (s, i);
+		}
+	}
+	bench_report ("set_get_item", VARIANT, n, 1, bench_now_ns () - start, ROUNDS * n);
+
+	start = bench_start ();
+	for (int r = 0; r < ROUNDS; ++r) {
+		for (size_t i = 0; i < n; ++i) {
+			sum += bitset_test (bs, i);
+		}
+	}
+	bench_report ("bitset_test", VARIANT, n, 1, bench_now_ns () - start, ROUNDS * n);
+
+	start = bench_start ();
+	for (size_t i = 0; i < n; ++i) {
+		sum += (uintptr_t) hash_table_get (ht, keys + ((bench_rand (&seed) % n) * KEY_LEN));
+	}
+	bench_report ("hash_table_get", VARIANT, n, 1, bench_now_ns () - start, n);
+
+	sink = sum;
+	(void) sink;
+
+	hash_table_delete (ht, NULL);
+	free (keys);
+	bitset_delete (bs);
+	set_delete (s, NULL);
+	auto_array_delete (aa, NULL);
+}
+
+int main (int argc, char** argv) {
+	size_t sizes[] = { 1000, 100000 };
+
+	bench_header ();
+
+	for (size_t s = 0; s < sizeof (sizes) / sizeof (sizes[0]); ++s) {
+		run (sizes[s]);
+	}
+
+	return EXIT_SUCCESS;
+}
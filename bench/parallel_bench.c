@@ -0,0 +1,137 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Speedup of auto_array_parallel_for, map, filter and reduce from 1 to 32
+ * threads over an array of n items with a CPU bound per item function.
+ * usage: parallel_bench [items] [work per item]
+ */
+
+static size_t work = 64;
+
+static size_t churn (size_t v) {
+	uint64_t x = v + 1;
+	for (size_t i = 0; i < work; ++i) {
+		x ^= x >> 33;
+		x *= 0xff51afd7ed558ccdULL;
+		x ^= x >> 33;
+	}
+
+	return x;
+}
+
+static void for_fn (void* item, size_t pos, void* ctx) {
+	size_t* out = ctx;
+	out[pos] = churn ((size_t) item);
+}
+
+static void* map_fn (void* item, void* ctx) {
+	return (void*) churn ((size_t) item);
+}
+
+static int filter_fn (void* item, void* ctx) {
+	return churn ((size_t) item) & 1;
+}
+
+static void* reduce_fn (void* acc, void* item, void* ctx) {
+	return (void*) ((size_t) acc + churn ((size_t) item));
+}
+
+static void* combine_fn (void* l, void* r, void* ctx) {
+	return (void*) ((size_t) l + (size_t) r);
+}
+
+int main (int argc, char** argv) {
+	size_t n = argc > 1 ? strtoul (argv[1], NULL, 10) : 2000000;
+	work = argc > 2 ? strtoul (argv[2], NULL, 10) : work;
+
+	size_t threads[] = { 1, 2, 4, 8, 16, 32 };
+	const char* ops[] = { "parallel_for", "map", "filter", "reduce" };
+	uint64_t base[4] = { 0 };
+
+	auto_array* aa = auto_array_create (n);
+	size_t* out = malloc (n * sizeof (size_t));
+	if (aa == NULL || out == NULL) {
+		PMSG ("allocation failed");
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < n; ++i) {
+		auto_array_add (aa, (void*) i);
+	}
+
+	bench_header_extra ("speedup");
+
+	for (size_t t = 0; t < sizeof (threads) / sizeof (threads[0]); ++t) {
+		if (auto_array_parallel_threads (threads[t]) == -1) {
+			PMSG ("auto_array_parallel_threads failed");
+			return EXIT_FAILURE;
+		}
+
+		for (int op = 0; op < 4; ++op) {
+			uint64_t best = UINT64_MAX;
+
+			for (int rep = 0; rep < 3; ++rep) {
+				uint64_t start = bench_start ();
+				auto_array* res = NULL;
+
+				switch (op) {
+					case 0: auto_array_parallel_for (aa, for_fn, out); break;
+					case 1: res = auto_array_map (aa, map_fn, NULL); break;
+					case 2: res = auto_array_filter (aa, filter_fn, NULL); break;
+					case 3: auto_array_reduce (aa, NULL, reduce_fn, combine_fn, NULL); break;
+				}
+
+				uint64_t elapsed = bench_now_ns () - start;
+				if (elapsed < best) {
+					best = elapsed;
+				}
+
+				if (res != NULL) {
+					auto_array_delete (res, NULL);
+				}
+			}
+
+			if (t == 0) {
+				base[op] = best;
+			}
+
+			bench_report_begin ("auto_array", ops[op], n, threads[t], best, n);
+			printf (",%.2f\n", (double) base[op] / best);
+			fflush (stdout);
+		}
+	}
+
+	auto_array_delete (aa, NULL);
+	free (out);
+
+	return EXIT_SUCCESS;
+}
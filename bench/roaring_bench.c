@@ -0,0 +1,216 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * roaring against a hashed set of boxed 32 bit values: adds, membership,
+ * union, intersection and andnot of two sets of n values, then the memory
+ * each uses. Values are sparse (uniform over 32 bits), dense (uniform over 
+ * 4n) or clustered (runs of 1000). The set is only built up to the size 
+ * given as the first argument.
+ * usage: roaring_bench [largest size for set]
+ */
+
+static const char* layouts[] = { "sparse", "dense", "clustered" };
+
+static int u32_equals (void* l, void* r) {
+	return *(uint32_t*) l == *(uint32_t*) r;
+}
+
+static uint32_t u32_hash (void* item) {
+	return SuperFastHash (item, sizeof (uint32_t));
+}
+
+static void fill (uint32_t* values, size_t n, int layout, uint64_t* seed) {
+	for (size_t i = 0; i < n; ++i) {
+		switch (layout) {
+			case 0: values[i] = bench_rand (seed); break;
+			case 1: values[i] = bench_rand (seed) % (4 * n); break;
+			default: 
+				values[i] = i % 1000 == 0 ? bench_rand (seed) % (64 * n) : values[i - 1] + 1;
+				break;
+		}
+	}
+}
+
+typedef struct {
+	size_t bytes[2];
+	char variant[32];
+	size_t n;
+} memory_row;
+
+static memory_row rows[64];
+static size_t row_count = 0;
+
+static void run_roaring (uint32_t* va, uint32_t* vb, size_t n, const char* variant) {
+	roaring* a = roaring_create ();
+	roaring* b = roaring_create ();
+
+	uint64_t start = bench_start ();
+	for (size_t i = 0; i < n; ++i) {
+		roaring_add (a, va[i]);
+	}
+	bench_report ("roaring_add", variant, n, 1, bench_now_ns () - start, n);
+
+	for (size_t i = 0; i < n; ++i) {
+		roaring_add (b, vb[i]);
+	}
+
+	start = bench_start ();
+	roaring_optimize (a);
+	roaring_optimize (b);
+	bench_report ("roaring_optimize", variant, n, 1, bench_now_ns () - start, 2 * n);
+
+	volatile size_t hits = 0;
+	start = bench_start ();
+	for (size_t i = 0; i < n; ++i) {
+		hits += roaring_contains (a, vb[i]);
+	}
+	bench_report ("roaring_contains", variant, n, 1, bench_now_ns () - start, n);
+
+	roaring* (*ops[3]) (roaring*, roaring*) = { roaring_union, roaring_intersection, roaring_andnot };
+	const char* names[3] = { "roaring_union", "roaring_intersection", "roaring_andnot" };
+	for (int op = 0; op < 3; ++op) {
+		start = bench_start ();
+		roaring* r = ops[op] (a, b);
+		bench_report (names[op], variant, n, 1, bench_now_ns () - start, 2 * n);
+		roaring_delete (r);
+	}
+
+	start = bench_start ();
+	uint64_t card = roaring_cardinality (a);
+	uint32_t v;
+	for (size_t i = 0; i < n; ++i) {
+		roaring_select (a, vb[i] % card, &v);
+		hits += roaring_rank (a, v);
+	}
+	bench_report ("roaring_rank_select", variant, n, 1, bench_now_ns () - start, n);
+
+	size_t len = roaring_serialized_size (a);
+	void* buf = malloc (len);
+	start = bench_start ();
+	roaring_serialize (a, buf);
+	roaring* copy = roaring_deserialize (buf, len);
+	bench_report ("roaring_serialize_round_trip", variant, n, 1, bench_now_ns () - start, n);
+
+	memory_row* row = &rows[row_count++];
+	snprintf (row->variant, sizeof (row->variant), "%s", variant);
+	row->n = roaring_cardinality (a);
+	row->bytes[0] = roaring_size_in_bytes (a);
+	row->bytes[1] = 0;
+
+	roaring_delete (copy);
+	free (buf);
+	roaring_delete (a);
+	roaring_delete (b);
+}
+
+static void run_set (uint32_t* va, uint32_t* vb, size_t n, const char* variant) {
+	set* a = set_create_hashed (16, u32_equals, u32_hash);
+	set* b = set_create_hashed (16, u32_equals, u32_hash);
+
+	uint64_t start = bench_start ();
+	for (size_t i = 0; i < n; ++i) {
+		set_add_item (a, &va[i]);
+	}
+	bench_report ("set_add_item", variant, n, 1, bench_now_ns () - start, n);
+
+	for (size_t i = 0; i < n; ++i) {
+		set_add_item (b, &vb[i]);
+	}
+
+	volatile size_t hits = 0;
+	start = bench_start ();
+	for (size_t i = 0; i < n; ++i) {
+		hits += set_get_item_index (a, &vb[i]) != -1;
+	}
+	bench_report ("set_get_item_index", variant, n, 1, bench_now_ns () - start, n);
+
+	start = bench_start ();
+	set* u = set_union (a, b);
+	bench_report ("set_union", variant, n, 1, bench_now_ns () - start, 2 * n);
+
+	start = bench_start ();
+	set* i = set_intersection (a, b);
+	bench_report ("set_intersection", variant, n, 1, bench_now_ns () - start, 2 * n);
+
+	// the values are boxed in va, counted once per distinct item
+	rows[row_count - 1].bytes[1] = sizeof (set) + (a->size * sizeof (void*)) 
+		+ (a->index_size * sizeof (set_slot)) + (a->count * sizeof (uint32_t));
+
+	set_delete (u, NULL);
+	set_delete (i, NULL);
+	set_delete (a, NULL);
+	set_delete (b, NULL);
+}
+
+int main (int argc, char** argv) {
+	size_t set_max = argc > 1 ? strtoul (argv[1], NULL, 10) : 1000000;
+	size_t sizes[] = { 100000, 1000000, 10000000 };
+	uint64_t seed = 3;
+
+	bench_header ();
+
+	for (size_t s = 0; s < sizeof (sizes) / sizeof (sizes[0]); ++s) {
+		size_t n = sizes[s];
+		uint32_t* va = malloc (n * sizeof (uint32_t));
+		uint32_t* vb = malloc (n * sizeof (uint32_t));
+		if (va == NULL || vb == NULL) {
+			PMSG ("allocation failed");
+			return EXIT_FAILURE;
+		}
+
+		for (int layout = 0; layout < 3; ++layout) {
+			fill (va, n, layout, &seed);
+			fill (vb, n, layout, &seed);
+
+			run_roaring (va, vb, n, layouts[layout]);
+			if (n <= set_max) {
+				run_set (va, vb, n, layouts[layout]);
+			}
+		}
+
+		free (va);
+		free (vb);
+	}
+
+	printf ("\nmemory,variant,values,roaring_bytes_per_value,set_bytes_per_value\n");
+	for (size_t r = 0; r < row_count; ++r) {
+		printf ("memory,%s,%zu,%.2f,", rows[r].variant, rows[r].n, (double) rows[r].bytes[0] / rows[r].n);
+		if (rows[r].bytes[1] > 0) {
+			printf ("%.2f\n", (double) rows[r].bytes[1] / rows[r].n);
+		} else {
+			printf ("\n");
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
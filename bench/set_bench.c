@@ -0,0 +1,139 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * set_add_items, membership, set_union and set_intersection for hashed and
+ * plain sets of boxed 64 bit integers. Two sets of n items overlap by half.
+ * Membership is measured with the probes in order and drawn from a Zipfian
+ * distribution, which keeps the popular items cached.
+ * Plain sets are quadratic and only run up to the size given as the first
+ * argument.
+ * usage: set_bench [largest size for plain sets]
+ */
+
+static int u64_equals (void* l, void* r) {
+	return *(uint64_t*) l == *(uint64_t*) r;
+}
+
+static uint32_t u64_hash (void* item) {
+	return SuperFastHash (item, sizeof (uint64_t));
+}
+
+static void run (size_t n, int hashed) {
+	const char* variant = hashed ? "hashed" : "plain";
+	uint64_t* va = malloc (n * sizeof (uint64_t));
+	uint64_t* vb = malloc (n * sizeof (uint64_t));
+	if (va == NULL || vb == NULL) {
+		PMSG ("allocation failed");
+		exit (EXIT_FAILURE);
+	}
+
+	uint64_t seed = 7;
+	for (size_t i = 0; i < n; ++i) {
+		va[i] = bench_rand (&seed);
+		vb[i] = (i % 2) ? va[i] : bench_rand (&seed);
+	}
+
+	void** pa = malloc (n * sizeof (void*));
+	void** pb = malloc (n * sizeof (void*));
+	void** pz = malloc (n * sizeof (void*));
+	bench_zipf zipf;
+	if (pa == NULL || pb == NULL || pz == NULL || bench_zipf_init (&zipf, n, 1.0) == -1) {
+		PMSG ("allocation failed");
+		exit (EXIT_FAILURE);
+	}
+	for (size_t i = 0; i < n; ++i) {
+		pa[i] = &va[i];
+		pb[i] = &vb[i];
+	}
+	for (size_t i = 0; i < n; ++i) {
+		pz[i] = pb[bench_zipf_next (&zipf, &seed)];
+	}
+	bench_zipf_free (&zipf);
+
+	set* a = hashed ? set_create_hashed (16, u64_equals, u64_hash) : set_create (n, u64_equals);
+	set* b = hashed ? set_create_hashed (16, u64_equals, u64_hash) : set_create (n, u64_equals);
+
+	uint64_t start = bench_start ();
+	set_add_items (a, pa, n);
+	bench_report ("set_add_items", variant, n, 1, bench_now_ns () - start, n);
+
+	set_add_items (b, pb, n);
+
+	volatile size_t hits = 0;
+	start = bench_start ();
+	for (size_t i = 0; i < n; ++i) {
+		hits += set_get_item_index (a, pb[i]) != -1;
+	}
+	bench_report ("set_get_item_index", variant, n, 1, bench_now_ns () - start, n);
+
+	start = bench_start ();
+	for (size_t i = 0; i < n; ++i) {
+		hits += set_get_item_index (a, pz[i]) != -1;
+	}
+	bench_report ("set_get_item_index", hashed ? "hashed_zipf" : "plain_zipf", n, 1, bench_now_ns () - start, n);
+
+	start = bench_start ();
+	set* u = set_union (a, b);
+	bench_report ("set_union", variant, n, 1, bench_now_ns () - start, 2 * n);
+
+	start = bench_start ();
+	set* i = set_intersection (a, b);
+	bench_report ("set_intersection", variant, n, 1, bench_now_ns () - start, 2 * n);
+
+	set_delete (u, NULL);
+	if (i != NULL) {
+		set_delete (i, NULL);
+	}
+	set_delete (a, NULL);
+	set_delete (b, NULL);
+	free (pa);
+	free (pb);
+	free (pz);
+	free (va);
+	free (vb);
+}
+
+int main (int argc, char** argv) {
+	size_t plain_max = argc > 1 ? strtoul (argv[1], NULL, 10) : 1000;
+	size_t sizes[] = { 1000, 100000, 10000000 };
+
+	bench_header ();
+
+	for (size_t s = 0; s < sizeof (sizes) / sizeof (sizes[0]); ++s) {
+		run (sizes[s], 1);
+		if (sizes[s] <= plain_max) {
+			run (sizes[s], 0);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
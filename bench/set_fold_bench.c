@@ -0,0 +1,154 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Folds k hashed sets into an accumulator, as a pipeline combining many 
+ * sets would, with the allocating operations and their in place forms. 
+ * Each set holds 99.9% of the values [0, n) and n/10 random values from
+ * [n, 2n), so unions grow and intersections shrink slowly. Differences
+ * remove n/100 random values of [0, n) per step. The allocs_per_step column
+ * is the mean number of malloc, calloc and realloc calls per fold step.
+ * usage: set_fold_bench [n] [k]
+ */
+
+static int u64_equals (void* l, void* r) {
+	return *(uint64_t*) l == *(uint64_t*) r;
+}
+
+static uint32_t u64_hash (void* item) {
+	return SuperFastHash (item, sizeof (uint64_t));
+}
+
+static void report (const char* name, size_t n, size_t k, uint64_t ns) {
+	bench_report_begin (name, "hashed", n, 1, ns, n * k);
+	printf (",%.2f\n", (double) (bench_allocs () - bench_allocs_mark) / k);
+	fflush (stdout);
+}
+
+typedef set* (*set_op) (set*, set*);
+typedef ssize_t (*set_into_op) (set*, set*);
+
+int main (int argc, char** argv) {
+	size_t n = argc > 1 ? strtoul (argv[1], NULL, 10) : 100000;
+	size_t k = argc > 2 ? strtoul (argv[2], NULL, 10) : 100;
+
+	uint64_t* universe = malloc (2 * n * sizeof (uint64_t));
+	set** sets = malloc (k * sizeof (set*));
+	set** removals = malloc (k * sizeof (set*));
+	if (universe == NULL || sets == NULL || removals == NULL) {
+		PMSG ("allocation failed");
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < 2 * n; ++i) {
+		universe[i] = i;
+	}
+
+	uint64_t seed = 5;
+	for (size_t j = 0; j < k; ++j) {
+		sets[j] = set_create_hashed (n + (n / 10), u64_equals, u64_hash);
+		for (size_t i = 0; i < n; ++i) {
+			if (bench_rand (&seed) % 1000 != 0) {
+				set_add_item (sets[j], &universe[i]);
+			}
+		}
+		for (size_t i = 0; i < n / 10; ++i) {
+			set_add_item (sets[j], &universe[n + (bench_rand (&seed) % n)]);
+		}
+
+		removals[j] = set_create_hashed (n / 100, u64_equals, u64_hash);
+		for (size_t i = 0; i < n / 100; ++i) {
+			set_add_item (removals[j], &universe[bench_rand (&seed) % n]);
+		}
+	}
+
+	bench_header_extra ("allocs_per_step");
+
+	const char* names[3] = { "union", "intersection", "difference" };
+	set_op ops[3] = { set_union, set_intersection, set_difference };
+	set_into_op into_ops[3] = { set_union_into, set_intersect_into, set_difference_into };
+	char name[64];
+
+	for (int op = 0; op < 3; ++op) {
+		set* acc = set_union (sets[0], sets[0]);
+		uint64_t start = bench_start ();
+
+		for (size_t j = 1; j < k; ++j) {
+			set* next = ops[op] (acc, op == 2 ? removals[j] : sets[j]);
+			set_delete (acc, NULL);
+			acc = next;
+		}
+
+		uint64_t ns = bench_now_ns () - start;
+		snprintf (name, sizeof (name), "set_%s", names[op]);
+		report (name, n, k - 1, ns);
+		set_delete (acc, NULL);
+
+		acc = set_union (sets[0], sets[0]);
+		start = bench_start ();
+
+		for (size_t j = 1; j < k; ++j) {
+			into_ops[op] (acc, op == 2 ? removals[j] : sets[j]);
+		}
+
+		ns = bench_now_ns () - start;
+		snprintf (name, sizeof (name), "set_%s_into", op == 1 ? "intersect" : names[op]);
+		report (name, n, k - 1, ns);
+		set_delete (acc, NULL);
+	}
+
+	// counting alone, against building the intersection to count it
+	volatile size_t total = 0;
+	uint64_t start = bench_start ();
+	for (size_t j = 1; j < k; ++j) {
+		set* i = set_intersection (sets[0], sets[j]);
+		total += i->count;
+		set_delete (i, NULL);
+	}
+	report ("set_intersection_count", n, k - 1, bench_now_ns () - start);
+
+	start = bench_start ();
+	for (size_t j = 1; j < k; ++j) {
+		total += set_intersection_size (sets[0], sets[j]);
+	}
+	report ("set_intersection_size", n, k - 1, bench_now_ns () - start);
+
+	for (size_t j = 0; j < k; ++j) {
+		set_delete (sets[j], NULL);
+		set_delete (removals[j], NULL);
+	}
+	free (removals);
+	free (sets);
+	free (universe);
+
+	return EXIT_SUCCESS;
+}
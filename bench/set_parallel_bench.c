@@ -0,0 +1,177 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Speedup of the parallel union, intersection and difference from 1 to 32
+ * threads, against the serial functions, for hashed sets of boxed 64 bit
+ * integers and for sorted_sets. The two operands of each kind overlap by half.
+ * usage: set_parallel_bench [hashed set size] [sorted_set size]
+ */
+
+static const char* ops[] = { "union", "intersection", "difference" };
+
+static int u64_equals (void* l, void* r) {
+	return *(uint64_t*) l == *(uint64_t*) r;
+}
+
+static uint32_t u64_hash (void* item) {
+	return SuperFastHash (item, sizeof (uint64_t));
+}
+
+static set* set_op (set* a, set* b, int op, int parallel) {
+	switch (op) {
+		case 0: return parallel ? set_parallel_union (a, b) : set_union (a, b);
+		case 1: return parallel ? set_parallel_intersection (a, b) : set_intersection (a, b);
+		default: return parallel ? set_parallel_difference (a, b) : set_difference (a, b);
+	}
+}
+
+static sorted_set* sorted_op (sorted_set* a, sorted_set* b, int op, int parallel) {
+	switch (op) {
+		case 0: return parallel ? sorted_set_parallel_union (a, b) : sorted_set_union (a, b);
+		case 1: return parallel ? sorted_set_parallel_intersection (a, b) : sorted_set_intersection (a, b);
+		default: return parallel ? sorted_set_parallel_difference (a, b) : sorted_set_difference (a, b);
+	}
+}
+
+/* the best of 3 runs of an operation on the hashed sets (kind 0) or the sorted_sets (kind 1) */
+static uint64_t best_of (int kind, void* a, void* b, int op, int parallel) {
+	uint64_t best = UINT64_MAX;
+
+	for (int rep = 0; rep < 3; ++rep) {
+		uint64_t start = bench_start ();
+		void* res = kind == 0 ? (void*) set_op (a, b, op, parallel) : (void*) sorted_op (a, b, op, parallel);
+		uint64_t elapsed = bench_now_ns () - start;
+
+		if (res == NULL) {
+			PMSG ("set operation failed");
+			exit (EXIT_FAILURE);
+		}
+
+		if (kind == 0) {
+			set_delete (res, NULL);
+		} else {
+			sorted_set_delete (res);
+		}
+
+		if (elapsed < best) {
+			best = elapsed;
+		}
+	}
+
+	return best;
+}
+
+static void report (const char* name, const char* variant, size_t n, size_t threads, uint64_t ns, uint64_t base) {
+	bench_report_begin (name, variant, n, threads, ns, n);
+	printf (",%.2f\n", (double) base / ns);
+	fflush (stdout);
+}
+
+int main (int argc, char** argv) {
+	size_t n = argc > 1 ? strtoul (argv[1], NULL, 10) : 2000000;
+	size_t sn = argc > 2 ? strtoul (argv[2], NULL, 10) : 20000000;
+	size_t threads[] = { 1, 2, 4, 8, 16, 32 };
+
+	uint64_t* va = malloc (n * sizeof (uint64_t));
+	uint64_t* vb = malloc (n * sizeof (uint64_t));
+	uint32_t* sa = malloc (sn * sizeof (uint32_t));
+	uint32_t* sb = malloc (sn * sizeof (uint32_t));
+	set* a = set_create_hashed (n, u64_equals, u64_hash);
+	set* b = set_create_hashed (n, u64_equals, u64_hash);
+	if (va == NULL || vb == NULL || sa == NULL || sb == NULL || a == NULL || b == NULL) {
+		PMSG ("allocation failed");
+		return EXIT_FAILURE;
+	}
+
+	uint64_t seed = 7;
+	for (size_t i = 0; i < n; ++i) {
+		va[i] = bench_rand (&seed);
+		vb[i] = (i % 2) ? va[i] : bench_rand (&seed);
+		set_add_item (a, &va[i]);
+		set_add_item (b, &vb[i]);
+	}
+
+	for (size_t i = 0; i < sn; ++i) {
+		sa[i] = bench_rand (&seed);
+		sb[i] = (i % 2) ? sa[i] : bench_rand (&seed);
+	}
+
+	sorted_set* ssa = sorted_set_create_from (sa, sn);
+	sorted_set* ssb = sorted_set_create_from (sb, sn);
+	if (ssa == NULL || ssb == NULL) {
+		PMSG ("allocation failed");
+		return EXIT_FAILURE;
+	}
+
+	const char* names[] = { "set", "sorted_set" };
+	void* lhs[] = { a, ssa };
+	void* rhs[] = { b, ssb };
+	size_t sizes[] = { n, sn };
+	uint64_t base[2][3];
+
+	bench_header_extra ("speedup");
+
+	for (int kind = 0; kind < 2; ++kind) {
+		for (int op = 0; op < 3; ++op) {
+			base[kind][op] = best_of (kind, lhs[kind], rhs[kind], op, 0);
+			report (names[kind], ops[op], sizes[kind], 1, base[kind][op], base[kind][op]);
+		}
+	}
+
+	for (size_t t = 0; t < sizeof (threads) / sizeof (threads[0]); ++t) {
+		if (auto_array_parallel_threads (threads[t]) == -1) {
+			PMSG ("auto_array_parallel_threads failed");
+			return EXIT_FAILURE;
+		}
+
+		for (int kind = 0; kind < 2; ++kind) {
+			for (int op = 0; op < 3; ++op) {
+				char variant[32];
+				snprintf (variant, sizeof (variant), "parallel_%s", ops[op]);
+
+				uint64_t best = best_of (kind, lhs[kind], rhs[kind], op, 1);
+				report (names[kind], variant, sizes[kind], threads[t], best, base[kind][op]);
+			}
+		}
+	}
+
+	sorted_set_delete (ssb);
+	sorted_set_delete (ssa);
+	set_delete (b, NULL);
+	set_delete (a, NULL);
+	free (sb);
+	free (sa);
+	free (vb);
+	free (va);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,147 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <malloc.h>
+
+/*
+ * Distinct counts with hyperloglog and frequencies with count_min, against
+ * counting exactly in a hash_table, over a stream of string keys drawn from
+ * a Zipfian distribution. Memory is the bytes allocated for the structure.
+ * The error of a hyperloglog is relative to the distinct count; the error 
+ * of a count_min is the mean overestimate per distinct key, in occurrences.
+ * usage: sketch_bench [events] [distinct keys]
+ */
+
+#define KEY_LEN 16
+
+static void report (const char* name, const char* variant, size_t n, uint64_t ns, size_t bytes, double error) {
+	bench_report_begin (name, variant, n, 1, ns, n);
+	printf (",%zu,%.6f\n", bytes, error);
+	fflush (stdout);
+}
+
+int main (int argc, char** argv) {
+	size_t n = argc > 1 ? strtoul (argv[1], NULL, 10) : 10000000;
+	size_t keys = argc > 2 ? strtoul (argv[2], NULL, 10) : 1000000;
+
+	char* names = malloc (keys * KEY_LEN);
+	bench_zipf zipf;
+	uint32_t* events = malloc (n * sizeof (uint32_t));
+	uint64_t* exact = calloc (keys, sizeof (uint64_t));
+	if (names == NULL || bench_zipf_init (&zipf, keys, 1.0) == -1 || events == NULL || exact == NULL) {
+		PMSG ("allocation failed");
+		return EXIT_FAILURE;
+	}
+
+	for (size_t k = 0; k < keys; ++k) {
+		snprintf (names + (k * KEY_LEN), KEY_LEN, "event-%08u", (unsigned) (k % 100000000));
+	}
+
+	uint64_t seed = 11;
+	for (size_t i = 0; i < n; ++i) {
+		events[i] = bench_zipf_next (&zipf, &seed);
+		exact[events[i]]++;
+	}
+
+	size_t distinct = 0;
+	for (size_t k = 0; k < keys; ++k) {
+		distinct += exact[k] > 0;
+	}
+
+	bench_header_extra ("bytes,error");
+
+	// exact counts: one heap allocated counter per key
+	size_t before = mallinfo2 ().uordblks;
+	uint64_t start = bench_start ();
+	hash_table* ht = hash_table_create (keys);
+	size_t found = 0;
+	for (size_t i = 0; i < n; ++i) {
+		char* key = names + (events[i] * KEY_LEN);
+		uint64_t* counter = hash_table_get (ht, key);
+		if (counter == NULL) {
+			counter = calloc (1, sizeof (uint64_t));
+			hash_table_put (ht, key, counter);
+			found++;
+		}
+		(*counter)++;
+	}
+	uint64_t elapsed = bench_now_ns () - start;
+	report ("hash_table", "exact", n, elapsed, mallinfo2 ().uordblks - before, fabs ((double) found - distinct) / distinct);
+	hash_table_delete (ht, free);
+
+	unsigned int precisions[] = { 10, 12, 14, 16 };
+	for (size_t p = 0; p < sizeof (precisions) / sizeof (precisions[0]); ++p) {
+		char variant[32];
+		snprintf (variant, sizeof (variant), "p%u", precisions[p]);
+
+		hyperloglog* hll = hyperloglog_create (precisions[p]);
+		start = bench_start ();
+		for (size_t i = 0; i < n; ++i) {
+			hyperloglog_add (hll, names + (events[i] * KEY_LEN), KEY_LEN - 1);
+		}
+		uint64_t estimate = hyperloglog_count (hll);
+		elapsed = bench_now_ns () - start;
+
+		report ("hyperloglog", variant, n, elapsed, hyperloglog_size_in_bytes (hll), fabs ((double) estimate - distinct) / distinct);
+		hyperloglog_delete (hll);
+	}
+
+	size_t dims[][2] = { { 1 << 14, 4 }, { 1 << 16, 4 }, { 1 << 18, 4 }, { 1 << 16, 8 } };
+	for (size_t d = 0; d < sizeof (dims) / sizeof (dims[0]); ++d) {
+		char variant[32];
+		snprintf (variant, sizeof (variant), "%zux%zu", dims[d][0], dims[d][1]);
+
+		count_min* cm = count_min_create (dims[d][0], dims[d][1]);
+		start = bench_start ();
+		for (size_t i = 0; i < n; ++i) {
+			count_min_add (cm, names + (events[i] * KEY_LEN), KEY_LEN - 1, 1);
+		}
+		elapsed = bench_now_ns () - start;
+
+		double over = 0.0;
+		for (size_t k = 0; k < keys; ++k) {
+			if (exact[k] > 0) {
+				over += count_min_estimate (cm, names + (k * KEY_LEN), KEY_LEN - 1) - exact[k];
+			}
+		}
+
+		report ("count_min", variant, n, elapsed, count_min_size_in_bytes (cm), over / distinct);
+		count_min_delete (cm);
+	}
+
+	free (exact);
+	free (events);
+	bench_zipf_free (&zipf);
+	free (names);
+
+	return EXIT_SUCCESS;
+}
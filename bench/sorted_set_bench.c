@@ -0,0 +1,126 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * sorted_set algebra for size ratios from 1:1 to 1:10000 against a hashed
+ * set of boxed integers. The larger set has n values, the first argument,
+ * drawn from a universe of 4n so about a quarter of the smaller set is
+ * common. Ratios above 1:32 gallop whatever the simd level.
+ * usage: sorted_set_bench [n]
+ */
+
+static const char* levels[] = { "scalar", "sse", "avx2" };
+
+static int u32_equals (void* l, void* r) {
+	return *(uint32_t*) l == *(uint32_t*) r;
+}
+
+static uint32_t u32_hash (void* item) {
+	return SuperFastHash (item, sizeof (uint32_t));
+}
+
+static sorted_set* random_set (size_t n, uint32_t universe, uint64_t* seed) {
+	sorted_set* ss = sorted_set_create (n);
+
+	while (ss->count < n) {
+		sorted_set_add (ss, bench_rand (seed) % universe);
+	}
+
+	return ss;
+}
+
+static set* boxed_set (sorted_set* ss) {
+	set* s = set_create_hashed (16, u32_equals, u32_hash);
+
+	for (size_t i = 0; i < ss->count; ++i) {
+		set_add_item (s, &ss->data[i]);
+	}
+
+	return s;
+}
+
+typedef sorted_set* (*set_op) (sorted_set*, sorted_set*);
+
+static void time_op (const char* name, const char* variant, set_op op, sorted_set* a, sorted_set* b, size_t reps) {
+	uint64_t start = bench_start ();
+
+	for (size_t r = 0; r < reps; ++r) {
+		sorted_set_delete (op (a, b));
+	}
+
+	bench_report (name, variant, b->count / a->count, 1, bench_now_ns () - start, reps * (a->count + b->count));
+}
+
+int main (int argc, char** argv) {
+	size_t n = argc > 1 ? strtoul (argv[1], NULL, 10) : 1000000;
+	size_t ratios[] = { 1, 10, 100, 1000, 10000 };
+	uint64_t seed = 11;
+
+	// size is the ratio of the larger set to the smaller
+	bench_header ();
+
+	sorted_set* large = random_set (n, 4 * n, &seed);
+	set* large_boxed = boxed_set (large);
+	int best = sorted_set_simd (SORTED_SET_AVX2);
+
+	for (size_t r = 0; r < sizeof (ratios) / sizeof (ratios[0]); ++r) {
+		if (n / ratios[r] == 0) {
+			break;
+		}
+
+		sorted_set* small = random_set (n / ratios[r], 4 * n, &seed);
+		size_t reps = (10 * n) / (n + small->count) + 1;
+
+		for (int level = SORTED_SET_SCALAR; level <= best; ++level) {
+			sorted_set_simd (level);
+			time_op ("sorted_set_intersection", levels[level], sorted_set_intersection, small, large, reps);
+		}
+
+		time_op ("sorted_set_union", levels[best], sorted_set_union, small, large, reps);
+		time_op ("sorted_set_difference", levels[best], sorted_set_difference, small, large, reps);
+		time_op ("sorted_set_symmetric_difference", levels[best], sorted_set_symmetric_difference, small, large, reps);
+
+		set* small_boxed = boxed_set (small);
+		uint64_t start = bench_start ();
+		set* i = set_intersection (small_boxed, large_boxed);
+		bench_report ("set_intersection", "hashed", ratios[r], 1, bench_now_ns () - start, small->count + large->count);
+
+		set_delete (i, NULL);
+		set_delete (small_boxed, NULL);
+		sorted_set_delete (small);
+	}
+
+	set_delete (large_boxed, NULL);
+	sorted_set_delete (large);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,139 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Builds strings of up to 100 MB from fragments of 1 to 32 chars with 
+ * auto_string_append, append_n, append_char and append_n after a reserve.
+ * The strcat based append that preceded them is quadratic and only runs up
+ * to the size given as the first argument.
+ * usage: string_bench [largest size for the strcat append]
+ */
+
+#define FRAGMENTS 4096
+#define FRAGMENT_MAX 32
+
+static char fragments[FRAGMENTS][FRAGMENT_MAX + 1];
+static size_t lengths[FRAGMENTS];
+
+/* auto_string_append as it was, finding the end of the string with strcat */
+static auto_string* strcat_append (auto_string* s, char* cstr) {
+	size_t n = strlen (cstr);
+
+	if ((s->count + n) >= s->size) {
+		size_t sz = n < s->size ? 2 * s->size : (2 * n) + s->size;
+		char* tmp;
+		if (s->buf == s->small) {
+			tmp = malloc (sz);
+			if (tmp == NULL) {
+				return NULL;
+			}
+			memcpy (tmp, s->small, s->count + 1);
+		} else if ((tmp = realloc (s->buf, sz)) == NULL) {
+			return NULL;
+		}
+
+		s->buf = tmp;
+		s->size = sz;
+	}
+
+	strcat (s->buf, cstr);
+	s->count += n;
+
+	return s;
+}
+
+static void run (const char* variant, size_t target) {
+	auto_string* s = auto_string_create (1);
+	size_t appends = 0;
+	size_t f = 0;
+
+	uint64_t start = bench_start ();
+
+	if (strcmp (variant, "reserve_append_n") == 0) {
+		auto_string_reserve (s, target + FRAGMENT_MAX);
+	}
+
+	while (s->count < target) {
+		f = (f + 1) & (FRAGMENTS - 1);
+		appends++;
+
+		switch (variant[0]) {
+			case 's': strcat_append (s, fragments[f]); break;
+			case 'a': auto_string_append (s, fragments[f]); break;
+			case 'c':
+				for (size_t i = 0; i < lengths[f]; ++i) {
+					auto_string_append_char (s, fragments[f][i]);
+				}
+				break;
+			default: auto_string_append_n (s, fragments[f], lengths[f]); break;
+		}
+	}
+
+	uint64_t elapsed = bench_now_ns () - start;
+
+	if (auto_string_length (s) != strlen (s->buf)) {
+		PMSG ("length mismatch");
+		exit (EXIT_FAILURE);
+	}
+
+	bench_report ("auto_string", variant, target, 1, elapsed, appends);
+	auto_string_delete (s);
+}
+
+int main (int argc, char** argv) {
+	size_t strcat_max = argc > 1 ? strtoul (argv[1], NULL, 10) : 1 << 20;
+	size_t sizes[] = { 1 << 16, 1 << 20, 16 << 20, 100 << 20 };
+	const char* variants[] = { "append", "append_n", "char", "reserve_append_n" };
+
+	uint64_t seed = 3;
+	for (size_t f = 0; f < FRAGMENTS; ++f) {
+		lengths[f] = 1 + (bench_rand (&seed) % FRAGMENT_MAX);
+		for (size_t i = 0; i < lengths[f]; ++i) {
+			fragments[f][i] = 'a' + (bench_rand (&seed) % 26);
+		}
+		fragments[f][lengths[f]] = '\0';
+	}
+
+	bench_header ();
+
+	for (size_t s = 0; s < sizeof (sizes) / sizeof (sizes[0]); ++s) {
+		if (sizes[s] <= strcat_max) {
+			run ("strcat_append", sizes[s]);
+		}
+
+		for (size_t v = 0; v < sizeof (variants) / sizeof (variants[0]); ++v) {
+			run (variants[v], sizes[s]);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,134 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+ * Builds responses of 1 to 100 MB, fragments of 1 to 64 chars with a 64 KB
+ * body after every 256 of them, and writes them to /dev/null. auto_string
+ * copies everything into one buffer that is written with write, 
+ * string_builder copies the fragments into chunks, attaches the bodies and 
+ * writes with writev, and string_builder_copy appends the bodies as well.
+ * usage: string_builder_bench
+ */
+
+#define FRAGMENTS 4096
+#define FRAGMENT_MAX 64
+#define BODY_EVERY 256
+#define BODY_SIZE (64 * 1024)
+
+static char fragments[FRAGMENTS][FRAGMENT_MAX];
+static size_t lengths[FRAGMENTS];
+static char body[BODY_SIZE];
+
+static void write_all (int fd, const char* data, size_t n) {
+	while (n > 0) {
+		ssize_t written = write (fd, data, n);
+		if (written == -1) {
+			PERR ("write");
+			exit (EXIT_FAILURE);
+		}
+		data += written;
+		n -= written;
+	}
+}
+
+static void run (const char* variant, size_t target, int fd) {
+	auto_string* s = auto_string_create (1);
+	string_builder* sb = string_builder_create ();
+	size_t length = 0;
+	size_t appends = 0;
+
+	uint64_t start = bench_start ();
+
+	for (size_t f = 0; length < target; f = (f + 1) & (FRAGMENTS - 1)) {
+		const char* data = fragments[f];
+		size_t n = lengths[f];
+		if (++appends % BODY_EVERY == 0) {
+			data = body;
+			n = BODY_SIZE;
+		}
+		length += n;
+
+		if (variant[0] == 'a') {
+			auto_string_append_n (s, data, n);
+		} else if (n == BODY_SIZE && strcmp (variant, "string_builder") == 0) {
+			string_builder_attach (sb, data, n, NULL);
+		} else {
+			string_builder_append (sb, data, n);
+		}
+	}
+
+	if (variant[0] == 'a') {
+		write_all (fd, s->buf, s->count);
+	} else if (string_builder_write (sb, fd) != (ssize_t) length) {
+		PMSG ("short write");
+		exit (EXIT_FAILURE);
+	}
+
+	bench_report ("response", variant, target, 1, bench_now_ns () - start, appends);
+
+	string_builder_delete (sb);
+	auto_string_delete (s);
+}
+
+int main (int argc, char** argv) {
+	size_t sizes[] = { 1 << 20, 16 << 20, 100 << 20 };
+	const char* variants[] = { "auto_string", "string_builder", "string_builder_copy" };
+
+	int fd = open ("/dev/null", O_WRONLY);
+	if (fd == -1) {
+		PERR ("open");
+		return EXIT_FAILURE;
+	}
+
+	uint64_t seed = 5;
+	for (size_t f = 0; f < FRAGMENTS; ++f) {
+		lengths[f] = 1 + (bench_rand (&seed) % FRAGMENT_MAX);
+		for (size_t i = 0; i < lengths[f]; ++i) {
+			fragments[f][i] = 'a' + (bench_rand (&seed) % 26);
+		}
+	}
+	memset (body, 'b', BODY_SIZE);
+
+	bench_header ();
+
+	for (size_t s = 0; s < sizeof (sizes) / sizeof (sizes[0]); ++s) {
+		for (size_t v = 0; v < sizeof (variants) / sizeof (variants[0]); ++v) {
+			run (variants[v], sizes[s], fd);
+		}
+	}
+
+	close (fd);
+
+	return EXIT_SUCCESS;
+}
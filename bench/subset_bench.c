@@ -0,0 +1,159 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Visits every subset of sets of n items, summing the items of each subset
+ * so the work is comparable: set_all_subsets up to 20 items, the Gray code 
+ * iterator up to the largest size given as the first argument, and the
+ * iterator split into one range per thread with auto_array_parallel_for.
+ * usage: subset_bench [largest size]
+ */
+
+static int never_equal (void* l, void* r) {
+	return 0;
+}
+
+static void free_set (void* v) {
+	set_delete (v, NULL);
+}
+
+static void all_subsets (set* s) {
+	volatile size_t sum = 0;
+
+	set* all = set_all_subsets (s);
+	for (size_t i = 0; i < all->count; ++i) {
+		set* sub = set_get_item (all, i);
+		for (size_t j = 0; j < sub->count; ++j) {
+			sum += (size_t) sub->data[j];
+		}
+	}
+
+	set_delete (all, free_set);
+}
+
+/* keeps a running sum up to date from the item each step toggles */
+static size_t iterate (set* s, uint64_t begin, uint64_t end) {
+	void* buf[64];
+	set_subset_iter it;
+	size_t sum = 0;
+	size_t total = 0;
+
+	set_subsets_begin (&it, s, buf, begin, end);
+	while (set_subset_next (&it)) {
+		if (it.toggled == -1) {
+			sum = 0;
+			for (size_t j = 0; j < it.count; ++j) {
+				sum += (size_t) it.items[j];
+			}
+		} else if (it.mask & (1ULL << it.toggled)) {
+			sum += (size_t) s->data[it.toggled];
+		} else {
+			sum -= (size_t) s->data[it.toggled];
+		}
+		total += sum;
+	}
+
+	return total;
+}
+
+typedef struct {
+	set* s;
+	uint64_t chunk;
+	size_t* totals;
+} split_ctx;
+
+static void split_fn (void* item, size_t pos, void* ctx) {
+	split_ctx* c = ctx;
+	uint64_t begin = pos * c->chunk;
+	uint64_t end = begin + c->chunk < set_subset_count (c->s) ? begin + c->chunk : set_subset_count (c->s);
+
+	c->totals[pos] = iterate (c->s, begin, end);
+}
+
+int main (int argc, char** argv) {
+	size_t largest = argc > 1 ? strtoul (argv[1], NULL, 10) : 28;
+	size_t threads[] = { 1, 2, 4, 8, 16, 32 };
+	size_t ranges = 256;
+
+	bench_header ();
+
+	for (size_t n = 12; n <= largest; n += 4) {
+		set* s = set_create (n, never_equal);
+		for (size_t i = 0; i < n; ++i) {
+			set_add_item (s, (void*) (i + 1));
+		}
+
+		uint64_t subsets = set_subset_count (s);
+		uint64_t start;
+
+		if (n <= 20) {
+			start = bench_start ();
+			all_subsets (s);
+			bench_report ("power_set", "set_all_subsets", n, 1, bench_now_ns () - start, subsets);
+		}
+
+		start = bench_start ();
+		volatile size_t total = iterate (s, 0, subsets);
+		bench_report ("power_set", "gray_iterator", n, 1, bench_now_ns () - start, subsets);
+
+		auto_array* chunks = auto_array_create (ranges);
+		size_t totals[256];
+		for (size_t i = 0; i < ranges; ++i) {
+			auto_array_add (chunks, NULL);
+		}
+
+		split_ctx ctx = { s, (subsets + ranges - 1) / ranges, totals };
+		for (size_t t = 0; t < sizeof (threads) / sizeof (threads[0]); ++t) {
+			auto_array_parallel_threads (threads[t]);
+
+			start = bench_start ();
+			auto_array_parallel_for (chunks, split_fn, &ctx);
+			bench_report ("power_set", "gray_iterator_split", n, threads[t], bench_now_ns () - start, subsets);
+		}
+
+		// a combinations pass over the middle layer
+		void* buf[64];
+		set_subset_iter it;
+		uint64_t k_subsets = set_combination_count (s, n / 2);
+		start = bench_start ();
+		set_combinations_begin (&it, s, n / 2, buf, 0, k_subsets);
+		while (set_subset_next (&it)) {
+			total += it.count;
+		}
+		bench_report ("combinations", "n/2", n, 1, bench_now_ns () - start, k_subsets);
+
+		auto_array_delete (chunks, NULL);
+		set_delete (s, NULL);
+	}
+
+	return EXIT_SUCCESS;
+}
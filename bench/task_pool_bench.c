@@ -0,0 +1,189 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * task_pool from 1 to 16 threads. Fine grained throughput: n empty tasks
+ * spawned from one thread and waited on, and a recursive fib where every
+ * call is a task that spawns one half and waits on it. Load balancing: a
+ * parallel for over n items where the first sixteenth cost 64 times the
+ * rest, with work stealing against a static split into one range per
+ * thread. The extra column is the speedup over one thread.
+ * usage: task_pool_bench [items] [fib n]
+ */
+
+static task_pool* pool;
+static size_t work = 16;
+
+typedef struct {
+	int n;
+	long result;
+} fib_task;
+
+static void empty_task (void* arg) {
+}
+
+static void fib (void* arg) {
+	fib_task* f = arg;
+	if (f->n < 2) {
+		f->result = f->n;
+		return;
+	}
+
+	fib_task left = { f->n - 1, 0 };
+	fib_task right = { f->n - 2, 0 };
+	task_group g = TASK_GROUP_INITIALIZER (pool);
+	if (task_pool_spawn (&g, fib, &left) == -1) {
+		fib (&left);
+	}
+	fib (&right);
+	task_group_wait (&g);
+
+	f->result = left.result + right.result;
+}
+
+/* the calls fib makes, each a task */
+static size_t fib_calls (int n) {
+	return n < 2 ? 1 : 1 + fib_calls (n - 1) + fib_calls (n - 2);
+}
+
+typedef struct {
+	size_t n;
+	uint64_t* out;
+} skewed_args;
+
+static void skewed_body (size_t lo, size_t hi, void* arg) {
+	skewed_args* sa = arg;
+
+	for (size_t i = lo; i < hi; ++i) {
+		size_t rounds = i < sa->n / 16 ? work * 64 : work;
+		uint64_t x = i + 1;
+		for (size_t r = 0; r < rounds; ++r) {
+			x ^= x >> 33;
+			x *= 0xff51afd7ed558ccdULL;
+		}
+		sa->out[i] = x;
+	}
+}
+
+typedef struct {
+	skewed_args* sa;
+	size_t lo;
+	size_t hi;
+} static_range;
+
+static void static_task (void* arg) {
+	static_range* r = arg;
+	skewed_body (r->lo, r->hi, r->sa);
+}
+
+static uint64_t run (int op, size_t n, int fib_n, size_t threads, skewed_args* sa) {
+	uint64_t start = bench_start ();
+	task_group g = TASK_GROUP_INITIALIZER (pool);
+
+	switch (op) {
+		case 0:
+			for (size_t i = 0; i < n; ++i) {
+				task_pool_spawn (&g, empty_task, NULL);
+			}
+			task_group_wait (&g);
+			break;
+		case 1: {
+			fib_task f = { fib_n, 0 };
+			fib (&f);
+			break;
+		}
+		case 2:
+			task_pool_parallel_for (pool, n, 0, skewed_body, sa);
+			break;
+		case 3: {
+			static_range ranges[16];
+			for (size_t t = 0; t < threads; ++t) {
+				ranges[t] = (static_range) { sa, (n * t) / threads, (n * (t + 1)) / threads };
+				task_pool_spawn (&g, static_task, &ranges[t]);
+			}
+			task_group_wait (&g);
+			break;
+		}
+	}
+
+	return bench_now_ns () - start;
+}
+
+int main (int argc, char** argv) {
+	size_t n = argc > 1 ? strtoul (argv[1], NULL, 10) : 1000000;
+	int fib_n = argc > 2 ? atoi (argv[2]) : 25;
+
+	size_t threads[] = { 1, 2, 4, 8, 16 };
+	const char* benchmarks[] = { "task_spawn_wait", "task_fib", "parallel_for_skewed", "parallel_for_skewed" };
+	const char* variants[] = { "empty", "recursive", "work_stealing", "static_split" };
+	uint64_t base[4] = { 0 };
+
+	skewed_args sa = { n, malloc (n * sizeof (uint64_t)) };
+	if (sa.out == NULL) {
+		PMSG ("allocation failed");
+		return EXIT_FAILURE;
+	}
+
+	bench_header_extra ("speedup");
+
+	for (size_t t = 0; t < sizeof (threads) / sizeof (threads[0]); ++t) {
+		pool = task_pool_create (threads[t]);
+		if (pool == NULL) {
+			PMSG ("task_pool_create failed");
+			return EXIT_FAILURE;
+		}
+
+		for (int op = 0; op < 4; ++op) {
+			uint64_t best = UINT64_MAX;
+
+			for (int rep = 0; rep < 3; ++rep) {
+				uint64_t elapsed = run (op, n, fib_n, threads[t], &sa);
+				if (elapsed < best) {
+					best = elapsed;
+				}
+			}
+
+			if (t == 0) {
+				base[op] = best;
+			}
+
+			bench_report_begin (benchmarks[op], variants[op], op == 1 ? fib_calls (fib_n) : n, threads[t], best, op == 1 ? fib_calls (fib_n) : n);
+			printf (",%.2f\n", (double) base[op] / best);
+			fflush (stdout);
+		}
+
+		task_pool_delete (pool);
+	}
+
+	free (sa.out);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,184 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Tokenizes a log, 1 GB of generated access log lines or a file, with strtok
+ * and strstr on a copy and with string_views of an auto_string: counting 
+ * lines, counting space separated tokens, finding "status=503" and looking
+ * tokens up in a hash_table, after strdup or with hash_table_get_n. Rates
+ * are in bytes.
+ * usage: tokenize_bench [size in MB | file]
+ */
+
+#define DELIMS " \n"
+
+static const char* methods[] = { "GET", "POST", "PUT", "DELETE", "HEAD" };
+
+static void generate (auto_string* log, size_t size) {
+	uint64_t seed = 11;
+	int statuses[] = { 200, 200, 200, 304, 404, 503 };
+
+	auto_string_reserve (log, size + 256);
+	while (log->count < size) {
+		uint64_t r = bench_rand (&seed);
+		auto_string_appendf (log, "2026-10-19T%02u:%02u:%02u host%03u %s /api/v1/items/%u status=%d bytes=%u\n",
+				(unsigned) (r % 24), (unsigned) (r >> 8) % 60, (unsigned) (r >> 16) % 60, (unsigned) (r >> 24) % 1000,
+				methods[(r >> 34) % 5], (unsigned) (r >> 40) % 100000, statuses[(r >> 20) % 6], (unsigned) (r >> 44) % 65536);
+	}
+}
+
+static int load (auto_string* log, const char* path) {
+	FILE* f = fopen (path, "r");
+	if (f == NULL) {
+		PERR ("fopen");
+		return -1;
+	}
+
+	char buf[1 << 16];
+	size_t n;
+	while ((n = fread (buf, 1, sizeof (buf), f)) > 0) {
+		auto_string_append_n (log, buf, n);
+	}
+	fclose (f);
+
+	return 0;
+}
+
+static size_t run (const char* name, int views, auto_string* log, char* copy, hash_table* ht) {
+	const char* variant = views ? "string_view" : (name[0] == 'f' ? "strstr" : "strtok");
+	size_t found = 0;
+
+	memcpy (copy, log->buf, log->count + 1);
+
+	uint64_t start = bench_start ();
+
+	string_view rest = auto_string_view (log);
+	string_view sv;
+	switch (name[0]) {
+		case 'l':
+			if (views) {
+				while (string_view_next_line (&rest, &sv)) {
+					found++;
+				}
+			} else {
+				for (char* tok = strtok (copy, "\n"); tok != NULL; tok = strtok (NULL, "\n")) {
+					found++;
+				}
+			}
+			break;
+		case 't':
+			if (views) {
+				while (string_view_next_token (&rest, DELIMS, &sv)) {
+					found++;
+				}
+			} else {
+				for (char* tok = strtok (copy, DELIMS); tok != NULL; tok = strtok (NULL, DELIMS)) {
+					found++;
+				}
+			}
+			break;
+		case 'f':
+			if (views) {
+				string_view needle = string_view_from_cstr ("status=503");
+				ssize_t pos;
+				while ((pos = string_view_find (rest, needle)) != -1) {
+					found++;
+					rest.data += pos + needle.length;
+					rest.length -= pos + needle.length;
+				}
+			} else {
+				for (char* p = strstr (copy, "status=503"); p != NULL; p = strstr (p + 10, "status=503")) {
+					found++;
+				}
+			}
+			break;
+		case 'h':
+			if (views) {
+				while (string_view_next_token (&rest, DELIMS, &sv)) {
+					found += hash_table_get_n (ht, sv.data, sv.length) != NULL;
+				}
+			} else {
+				// the tokens of an auto_string that mustn't change are copied
+				for (char* tok = strtok (copy, DELIMS); tok != NULL; tok = strtok (NULL, DELIMS)) {
+					char* key = strdup (tok);
+					found += hash_table_get (ht, key) != NULL;
+					free (key);
+				}
+			}
+			break;
+	}
+
+	bench_report (name, variant, log->count, 1, bench_now_ns () - start, log->count);
+
+	return found;
+}
+
+int main (int argc, char** argv) {
+	auto_string* log = auto_string_create (1);
+	char* end = NULL;
+	size_t mb = argc > 1 ? strtoul (argv[1], &end, 10) : 1024;
+
+	if (argc > 1 && *end != '\0') {
+		if (load (log, argv[1]) == -1) {
+			return EXIT_FAILURE;
+		}
+	} else {
+		generate (log, mb << 20);
+	}
+
+	char* copy = malloc (log->count + 1);
+	hash_table* ht = hash_table_create (64);
+	if (copy == NULL || ht == NULL) {
+		PMSG ("allocation failed");
+		return EXIT_FAILURE;
+	}
+	for (size_t m = 0; m < sizeof (methods) / sizeof (methods[0]); ++m) {
+		hash_table_put (ht, (char*) methods[m], (void*) methods[m]);
+	}
+
+	const char* names[] = { "lines", "tokens", "find", "hash_get" };
+
+	bench_header ();
+
+	for (size_t n = 0; n < sizeof (names) / sizeof (names[0]); ++n) {
+		if (run (names[n], 0, log, copy, ht) != run (names[n], 1, log, copy, ht)) {
+			PMSG ("results differ");
+			return EXIT_FAILURE;
+		}
+	}
+
+	hash_table_delete (ht, NULL);
+	free (copy);
+	auto_string_delete (log);
+
+	return EXIT_SUCCESS;
+}
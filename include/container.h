@@ -42,11 +42,328 @@
 #include <sys/types.h>
 #endif // SYS_TYPES_HEADER_INCLUDED_
 
+#ifndef STDARG_HEADER_INCLUDED_
+#define STDARG_HEADER_INCLUDED_
+#include <stdarg.h>
+#endif // STDARG_HEADER_INCLUDED_
+
+/*
+ * Define SSCONT_INLINE before including container.h to get static inline 
+ * definitions of the trivial accessors (auto_array_get, auto_array_last, 
+ * set_get_item, heap_peek, heap_count, bitset_test and string_view_of) 
+ * in place of calls into the shared library, so the compiler can inline 
+ * and vectorize through them. The library itself is built without it.
+ * Programs that want the rest of the library inlined too can link with 
+ * -flto against libsscont.a built with LTO=-flto.
+ */
+
+/************************************************************************
+ * 				allocator
+ */
+
+/**
+ * The source of a container's memory. auto_array, hash_table, set and 
+ * auto_string capture an allocator when they are created, from their
+ * *_create_with function or else the process default, and make all of 
+ * their allocations through it, including those of the containers they 
+ * return, e.g. hash_table_keys. The allocator must outlive them.
+ * Temporary buffers that don't outlive a call still come from malloc.
+ * @see sscont_allocator_set_default
+ */
+typedef struct {
+	void* (*alloc) (void* ctx, size_t size); /**< as malloc */
+	void* (*realloc) (void* ctx, void* ptr, size_t size); /**< as realloc, ptr is never NULL */
+	void (*free) (void* ctx, void* ptr); /**< as free, or NULL if the memory is reclaimed all at once, e.g. an arena */
+	void* ctx; /**< passed to each function */
+} sscont_allocator;
+
+/**
+ * The allocator of malloc, realloc and free, the initial process default.
+ */
+extern const sscont_allocator sscont_malloc_allocator;
+
+/**
+ * Sets the allocator of containers created without one. Containers keep 
+ * the allocator they were created with.
+ * @param allocator the new default or NULL for sscont_malloc_allocator
+ */
+void sscont_allocator_set_default (const sscont_allocator* allocator);
+
+/**
+ * @return the allocator of containers created without one
+ */
+const sscont_allocator* sscont_allocator_get_default ();
+
+/**
+ * Allocates through an allocator.
+ * @param allocator the allocator
+ * @param size the number of bytes
+ * @return the memory or NULL if an error occurs
+ */
+static inline void* sscont_alloc (const sscont_allocator* allocator, size_t size) {
+	return allocator->alloc (allocator->ctx, size);
+}
+
+/**
+ * Resizes memory from sscont_alloc through the same allocator.
+ * @param allocator the allocator
+ * @param ptr the memory to resize, not NULL
+ * @param size the new number of bytes
+ * @return the memory, which may have moved, or NULL if an error occurs
+ */
+static inline void* sscont_realloc (const sscont_allocator* allocator, void* ptr, size_t size) {
+	return allocator->realloc (allocator->ctx, ptr, size);
+}
+
+/**
+ * Returns memory to the allocator it came from, a no-op for allocators without free.
+ * @param allocator the allocator
+ * @param ptr the memory or NULL
+ */
+static inline void sscont_free (const sscont_allocator* allocator, void* ptr) {
+	if (allocator->free != NULL && ptr != NULL) {
+		allocator->free (allocator->ctx, ptr);
+	}
+}
+
+/************************************************************************
+ * 				sscont_arena
+ */
+
+/**
+ * used internally
+ */
+typedef struct sscont_arena_block sscont_arena_block;
+
+/**
+ * A bump pointer region allocator. Allocations are carved from large blocks
+ * and are only reclaimed together, by sscont_arena_reset, by rewinding to a
+ * mark or by deleting the arena. Blocks are kept for reuse after a reset.
+ * The arena isn't thread safe.
+ * @see sscont_arena_create
+ */
+typedef struct {
+	sscont_arena_block* first;   /**< the first block, NULL until the first allocation */
+	sscont_arena_block* current; /**< the block being allocated from */
+	size_t offset;               /**< the bytes of current in use */
+	size_t block_size;           /**< the size of new blocks */
+	sscont_allocator allocator;  /**< allocates from the arena, free is NULL. Pass &arena->allocator to *_create_with */
+} sscont_arena;
+
+/**
+ * A position in an arena to rewind to.
+ * @see sscont_arena_get_mark
+ */
+typedef struct {
+	sscont_arena_block* block; /**< the block in use at the mark */
+	size_t offset;             /**< the bytes of block in use at the mark */
+} sscont_arena_mark;
+
+/**
+ * Initializes and returns a pointer to an empty arena. Blocks come from malloc.
+ * @param block_size the size of each block, larger allocations get a block of their own
+ * @return a pointer to an arena or NULL if an error occurs
+ */
+sscont_arena* sscont_arena_create (size_t block_size);
+
+/**
+ * Allocates from an arena in amortized constant time.
+ * @param a the arena
+ * @param size the number of bytes
+ * @return memory aligned to 16 bytes or NULL if an error occurs
+ */
+void* sscont_arena_alloc (sscont_arena* a, size_t size);
+
+/**
+ * @param a the arena
+ * @return the current position of the arena, for sscont_arena_rewind
+ */
+sscont_arena_mark sscont_arena_get_mark (sscont_arena* a);
+
+/**
+ * Reclaims everything allocated since the mark was taken, in constant time. 
+ * @param a the arena
+ * @param mark a mark of this arena taken since its last reset
+ */
+void sscont_arena_rewind (sscont_arena* a, sscont_arena_mark mark);
+
+/**
+ * Reclaims everything allocated from the arena in constant time, keeping its blocks.
+ * @param a the arena
+ */
+void sscont_arena_reset (sscont_arena* a);
+
+/**
+ * Frees the arena and its blocks.
+ * @param a the arena to free
+ */
+void sscont_arena_delete (sscont_arena* a);
+
+/************************************************************************
+ * 				sscont_pool
+ */
+
+/**
+ * sscont_pool flags.
+ * @see sscont_pool_create
+ */
+enum {
+	SSCONT_POOL_THREADED = 1 /**< objects can be allocated and freed by any thread, through per thread magazines */
+};
+
+/**
+ * used internally
+ */
+typedef struct sscont_pool_shared sscont_pool_shared;
+
+/**
+ * A pool of fixed size objects carved from slabs. Freed objects go on a free
+ * list for reuse and the slabs are only returned when the pool is deleted.
+ * A threaded pool gives each thread a magazine of objects so most 
+ * allocations and frees don't take its lock.
+ * @see sscont_pool_create
+ */
+typedef struct {
+	size_t object_size;   /**< the size of each object, a multiple of 8 */
+	size_t slab_objects;  /**< the number of objects in the next slab, doubling up to a limit */
+	void* free_list;      /**< freed objects, linked through their first word */
+	void* slabs;          /**< the slabs, linked through their first word */
+	char* bump;           /**< the next object never allocated from the newest slab */
+	char* bump_end;       /**< the end of the newest slab */
+	const sscont_allocator* parent; /**< the source of the slabs and the pool */
+	sscont_pool_shared* shared; /**< the lock and magazines of a threaded pool or NULL */
+	sscont_allocator allocator; /**< allocates objects of up to object_size bytes from the pool */
+} sscont_pool;
+
+/**
+ * Initializes and returns a pointer to an empty pool. Slabs come from malloc.
+ * @param object_size the size of the objects, rounded up to a multiple of 8
+ * @param flags 0 or SSCONT_POOL_THREADED
+ * @return a pointer to a pool or NULL if an error occurs
+ */
+sscont_pool* sscont_pool_create (size_t object_size, int flags);
+
+/**
+ * As sscont_pool_create with slabs from another allocator.
+ * @param object_size the size of the objects, rounded up to a multiple of 8
+ * @param flags 0 or SSCONT_POOL_THREADED
+ * @param parent the source of the slabs or NULL for sscont_malloc_allocator. 
+ * 	It isn't the process default, which may be this pool's allocator.
+ * @return a pointer to a pool or NULL if an error occurs
+ */
+sscont_pool* sscont_pool_create_with (size_t object_size, int flags, const sscont_allocator* parent);
+
+/**
+ * Allocates an object in constant time.
+ * @param p the pool
+ * @return an object aligned to 8 bytes, 16 if object_size is a multiple of 16, or NULL if an error occurs
+ */
+void* sscont_pool_alloc (sscont_pool* p);
+
+/**
+ * Returns an object to the pool in constant time.
+ * @param p the pool the object came from
+ * @param object the object or NULL
+ */
+void sscont_pool_free (sscont_pool* p, void* object);
+
+/**
+ * Frees the pool and all of its slabs, whether or not their objects were freed.
+ * No thread may be using a threaded pool.
+ * @param p the pool to free
+ */
+void sscont_pool_delete (sscont_pool* p);
+
+/************************************************************************
+ * 				trace
+ */
+
+/*
+ * Tracing of the events behind latency spikes. A hook registered with
+ * sscont_trace_set_hook is called for each event; without one the cost is
+ * a load and a compare at each site. A library built with -DSSCONT_USDT
+ * also has static probes for bpftrace, perf and SystemTap, provider sscont,
+ * with the arguments of sscont_trace_record:
+ *   resize (container, object, old_size, new_size, ns)
+ *   chain_walk (object, entries compared, bucket)
+ *   set_overflow (object, count, count needed)
+ */
+
+/**
+ * Traced events.
+ */
+typedef enum {
+	SSCONT_TRACE_RESIZE, /**< auto_array, hash_table bucket or set storage was resized */
+	SSCONT_TRACE_CHAIN_WALK, /**< a hash_table lookup compared more entries than the threshold */
+	SSCONT_TRACE_SET_OVERFLOW /**< a set without a hash function rejected items for lack of room */
+} sscont_trace_event;
+
+/**
+ * An event passed to the trace hook.
+ */
+typedef struct {
+	sscont_trace_event event;
+	const char* container; /**< "auto_array", "hash_table" or "set" */
+	const void* object; /**< the container */
+	size_t old_size; /**< the capacity before a resize, the entries compared on a chain walk or the count of an overflowing set */
+	size_t new_size; /**< the capacity after a resize, the bucket walked or the count the set would have needed */
+	uint64_t ns; /**< the time a resize took, including any rehash */
+} sscont_trace_record;
+
+/**
+ * The signature of trace hooks.
+ * @param record the event, valid for the duration of the call
+ * @param ctx the context given to sscont_trace_set_hook
+ */
+typedef void (*sscont_trace_hook) (const sscont_trace_record* record, void* ctx);
+
+/**
+ * Sets the function called on each traced event. The hook runs on the thread
+ * that caused the event, inside the container call, and must not use that
+ * container. The hook may be replaced while containers are in use; events
+ * already in progress may still call the old hook, always with its own ctx,
+ * so the old ctx must stay valid.
+ * @param hook the function or NULL to stop tracing
+ * @param ctx passed to the hook
+ */
+void sscont_trace_set_hook (sscont_trace_hook hook, void* ctx);
+
+/**
+ * Sets how many entries a hash_table lookup may compare before it is traced
+ * as a chain walk, 8 by default.
+ * @param threshold the number of entries
+ */
+void sscont_trace_set_chain_threshold (size_t threshold);
 
 /************************************************************************
  * 				auto_array
  */				
 
+/**
+ * auto_array backing modes.
+ * @see auto_array_create_mapped
+ */
+enum {
+	AUTO_ARRAY_HEAP = 0,  /**< data is allocated with malloc/realloc */
+	AUTO_ARRAY_MAPPED = 1, /**< data is an mmap region grown with mremap */
+	AUTO_ARRAY_INLINE = 2  /**< data is the small buffer inside the auto_array */
+};
+
+/**
+ * The number of pointers an auto_array holds inline before it spills to the heap.
+ */
+#define AUTO_ARRAY_SMALL_SIZE 4
+
+/**
+ * Access pattern hints for mapped auto_arrays.
+ * @see auto_array_advise
+ */
+enum {
+	AUTO_ARRAY_ADVICE_NORMAL = 0,     /**< no special treatment */
+	AUTO_ARRAY_ADVICE_SEQUENTIAL = 1, /**< expect sequential access, read ahead aggressively */
+	AUTO_ARRAY_ADVICE_RANDOM = 2      /**< expect random access, don't read ahead */
+};
+
 /**  A generic data store for pointers that auto resizes.
  *  @see auto_array_create.
  */
@@ -54,15 +371,76 @@ typedef struct {
 	size_t size;  /**< current allocated size */
 	size_t count; /**< current number of stored items */
 	void** data;  /**< data table */
+	int backing;  /**< AUTO_ARRAY_HEAP, AUTO_ARRAY_MAPPED or AUTO_ARRAY_INLINE */
+	int fd;       /**< the backing file of a mapped array or -1 */
+	void* small[AUTO_ARRAY_SMALL_SIZE]; /**< inline storage used while the array is small */
+	const sscont_allocator* allocator; /**< the source of data and the auto_array, NULL until an initialized array allocates */
 } auto_array;
 
+/**
+ * Initializer for an auto_array that isn't allocated with auto_array_create, e.g. on
+ * the stack. It starts with inline storage and only allocates if it outgrows it. 
+ * Release it with auto_array_release rather than auto_array_delete.
+ * \code{.c}
+ *	auto_array tmp = AUTO_ARRAY_INITIALIZER (tmp);
+ *	auto_array_add (&tmp, item);
+ *	auto_array_release (&tmp, NULL);
+ *	\endcode
+ * @param name the name of the variable being initialized
+ */
+#define AUTO_ARRAY_INITIALIZER(name) \
+	{ AUTO_ARRAY_SMALL_SIZE, 0, (name).small, AUTO_ARRAY_INLINE, -1, { NULL }, NULL }
+
 /**
  * Initializes a pointer to an auto_array structure.
- * @param initial_size initializes the size of the storage buffer. 
+ * @param initial_size initializes the size of the storage buffer. If it is no
+ * 	larger than AUTO_ARRAY_SMALL_SIZE the items are stored inline, and only
+ * 	the auto_array itself is allocated, until the array outgrows it.
  * @return an auto_array pointer or NULL if an error occurs.
  */
 auto_array* auto_array_create (size_t initial_size);
 
+/**
+ * As auto_array_create with memory from an allocator.
+ * @param initial_size initializes the size of the storage buffer
+ * @param allocator the source of the array's memory or NULL for the process default
+ * @return an auto_array pointer or NULL if an error occurs.
+ */
+auto_array* auto_array_create_with (size_t initial_size, const sscont_allocator* allocator);
+
+/**
+ * Initializes a pointer to an auto_array whose storage is an mmap region.
+ * The region grows with mremap so the stored pointers are never copied.
+ * If path is not NULL the region is a shared mapping of that file: the OS
+ * can page cold regions out to it and an existing file is reopened with 
+ * the count it held at the last auto_array_sync or auto_array_delete.
+ * Only values that remain meaningful across processes (offsets, integers
+ * cast to pointers) should be stored in a file backed array.
+ * All other auto_array functions work unchanged on the returned array.
+ * @param initial_size initializes the size of the storage buffer. It is
+ * 	rounded up to fill whole pages.
+ * @param path the file to back the array with or NULL for an anonymous mapping
+ * @return an auto_array pointer or NULL if an error occurs.
+ */
+auto_array* auto_array_create_mapped (size_t initial_size, const char* path);
+
+/**
+ * Passes an access pattern hint for a mapped auto_array to the kernel.
+ * The hint stays in effect when the mapping grows.
+ * @param aa the auto_array created with auto_array_create_mapped
+ * @param advice one of AUTO_ARRAY_ADVICE_NORMAL, AUTO_ARRAY_ADVICE_SEQUENTIAL
+ * 	or AUTO_ARRAY_ADVICE_RANDOM
+ * @return 0 or -1 if an error occurs or aa is not mapped.
+ */
+int auto_array_advise (auto_array* aa, int advice);
+
+/**
+ * Writes the count and the contents of a file backed auto_array to its file.
+ * @param aa the auto_array created with auto_array_create_mapped
+ * @return 0 or -1 if an error occurs. Arrays that aren't file backed return 0.
+ */
+int auto_array_sync (auto_array* aa);
+
 /**
  * Stores a pointer immediately after the last stored item. 
  * @param aa the auto_array to use for storage
@@ -89,14 +467,26 @@ ssize_t auto_array_put (auto_array* aa, size_t pos, void* data);
  * @param pos the position of the pointer being requested
  * @return an auto_array pointer or NULL if an error occurs 
  */
+#ifdef SSCONT_INLINE
+static inline void* auto_array_get (auto_array* aa, size_t pos) {
+	return pos < aa->count ? aa->data[pos] : NULL;
+}
+#else
 void* auto_array_get (auto_array* aa, size_t pos);
+#endif // SSCONT_INLINE
 
 /**
  * Returns the pointer stored at the last position.
  * @param aa the auto_array to retrieve from
  * @return an auto_array pointer or NULL if an error occurs 
  */
+#ifdef SSCONT_INLINE
+static inline void* auto_array_last (auto_array* aa) {
+	return aa->count ? aa->data[aa->count - 1] : NULL;
+}
+#else
 void* auto_array_last (auto_array* aa);
+#endif // SSCONT_INLINE
 
 /**
  * Inserts a pointer at a specific location. Moves the following pointers up one position. 
@@ -118,7 +508,7 @@ ssize_t auto_array_insert (auto_array* aa, size_t pos, void* data);
 void* auto_array_remove (auto_array* aa, size_t pos);
 
 /**
- * Frees allocated memory.
+ * Frees allocated memory. A file backed array is synced and its file closed.
  * @param aa the auto_array to free
  * @param delete_entry a function pointer that will be called for each stored pointer.
  * 	It can be used to free memory. It may be NULL in which case memory must be 
@@ -126,6 +516,260 @@ void* auto_array_remove (auto_array* aa, size_t pos);
  */
 void auto_array_delete (auto_array* aa, void (*delete_entry)(void* entry));
 
+/**
+ * Frees the storage of an auto_array but not the auto_array itself. 
+ * Used with AUTO_ARRAY_INITIALIZER. The array is left empty and usable.
+ * @param aa the auto_array to release
+ * @param delete_entry a function pointer that will be called for each stored pointer.
+ * 	It may be NULL.
+ */
+void auto_array_release (auto_array* aa, void (*delete_entry)(void* entry));
+
+/**
+ * Sets the number of threads, including the calling thread, used by the parallel
+ * auto_array functions. The pool is otherwise started on first use with one 
+ * thread per online processor. The parallel functions may be called from any
+ * number of threads at once and from within their own callbacks, also while
+ * the thread count is being changed. Calls already running finish on the old
+ * pool, which is stopped when the last of them returns.
+ * @param threads the number of threads or 0 for one per online processor
+ * @return 0 or -1 if an error occurs
+ */
+int auto_array_parallel_threads (size_t threads);
+
+/**
+ * Calls a function on each stored pointer using the library's thread pool.
+ * The items are split into ranges that are rebalanced between threads by work stealing.
+ * @param aa the auto_array to iterate
+ * @param fn the function to call with each item, its position and ctx
+ * @param ctx passed through to fn
+ * @return 0 or -1 if an error occurs
+ */
+int auto_array_parallel_for (auto_array* aa, void (*fn) (void* item, size_t pos, void* ctx), void* ctx);
+
+/**
+ * Returns a new auto_array holding the result of a function applied, in parallel, 
+ * to each stored pointer. The results keep the order of the items.
+ * @param aa the auto_array to map
+ * @param fn the function to call with each item and ctx
+ * @param ctx passed through to fn
+ * @return an auto_array pointer or NULL if an error occurs. 
+ * 	It should be freed with auto_array_delete.
+ */
+auto_array* auto_array_map (auto_array* aa, void* (*fn) (void* item, void* ctx), void* ctx);
+
+/**
+ * Returns a new auto_array holding, in their original order, the pointers for 
+ * which keep returns non zero. The predicate is evaluated in parallel.
+ * @param aa the auto_array to filter
+ * @param keep the predicate to call with each item and ctx
+ * @param ctx passed through to keep
+ * @return an auto_array pointer or NULL if an error occurs.
+ * 	It should be freed with auto_array_delete.
+ */
+auto_array* auto_array_filter (auto_array* aa, int (*keep) (void* item, void* ctx), void* ctx);
+
+/**
+ * Reduces the stored pointers to a single value in parallel. Each chunk of 
+ * items is folded with fn starting from init and the chunk results are then 
+ * folded, in order, with combine. fn and combine should therefore be 
+ * associative and init an identity value.
+ * @param aa the auto_array to reduce
+ * @param init the starting value for each chunk
+ * @param fn folds an item into an accumulated value
+ * @param combine folds two accumulated values
+ * @param ctx passed through to fn and combine
+ * @return the reduced value, init if aa is empty or NULL if an error occurs
+ */
+void* auto_array_reduce (auto_array* aa, void* init, void* (*fn) (void* acc, void* item, void* ctx),
+		void* (*combine) (void* left, void* right, void* ctx), void* ctx);
+
+/***************************************************************************************
+ * 				concurrent_array
+ */
+
+/**
+ * The most segments a concurrent_array can have. Segment k holds
+ * first_size << k items, so this is never the limit in practice.
+ */
+#define CONCURRENT_ARRAY_SEGMENTS 48
+
+/**
+ * An array of pointers that many threads append to at once. Producers reserve
+ * slots with an atomic fetch-add and the array grows by adding segments, each
+ * twice the size of the last, so stored items never move. No producer waits
+ * for another. Items are published in slot order: count covers the prefix of
+ * written slots, which readers may iterate while producers keep appending.
+ * When ingest is done, concurrent_array_seal turns it into an ordinary auto_array.
+ * @see concurrent_array_create
+ */
+typedef struct {
+	void** _Atomic segments[CONCURRENT_ARRAY_SEGMENTS]; /**< the segments, NULL until first used */
+	_Atomic size_t reserved; /**< the number of slots handed to producers */
+	_Atomic size_t count; /**< the number of published items, always a prefix of the slots */
+	_Atomic int failed; /**< set when a segment couldn't be allocated, after which adds fail */
+	unsigned shift; /**< log2 of the size of the first segment */
+	const sscont_allocator* allocator; /**< the source of the segments and the concurrent_array */
+} concurrent_array;
+
+/**
+ * Initializes a pointer to a concurrent_array.
+ * @param first_size the size of the first segment, rounded up to a power of 2 of at least 16
+ * @return a concurrent_array pointer or NULL if an error occurs.
+ */
+concurrent_array* concurrent_array_create (size_t first_size);
+
+/**
+ * As concurrent_array_create with memory from an allocator.
+ * @param first_size the size of the first segment
+ * @param allocator the source of the array's memory or NULL for the process default
+ * @return a concurrent_array pointer or NULL if an error occurs.
+ */
+concurrent_array* concurrent_array_create_with (size_t first_size, const sscont_allocator* allocator);
+
+/**
+ * Appends a pointer. Safe to call from any number of threads. The item is
+ * published once every item before it has been written.
+ * @param ca the concurrent_array to append to
+ * @param item the pointer to store
+ * @return the position of the item or -1 if an error occurs. After an
+ * 	allocation failure every add fails and the count stops at the failed slot.
+ */
+ssize_t concurrent_array_add (concurrent_array* ca, void* item);
+
+/**
+ * Appends n pointers in consecutive positions with one reservation, which
+ * is much cheaper per item than concurrent_array_add under contention.
+ * @param ca the concurrent_array to append to
+ * @param items the pointers to store
+ * @param n the number of pointers
+ * @return the position of the first item or -1 if an error occurs
+ */
+ssize_t concurrent_array_add_items (concurrent_array* ca, void** items, size_t n);
+
+/**
+ * Returns the number of published items. Positions below it may be read with
+ * concurrent_array_get while producers are appending.
+ * @param ca the concurrent_array
+ * @return the count
+ */
+size_t concurrent_array_count (concurrent_array* ca);
+
+/**
+ * Returns the pointer stored at a published position.
+ * @param ca the concurrent_array to retrieve from
+ * @param pos the position, less than a count returned by concurrent_array_count
+ * @return the stored pointer or NULL if pos isn't published
+ */
+void* concurrent_array_get (concurrent_array* ca, size_t pos);
+
+/**
+ * Copies the published items into an auto_array from the same allocator and
+ * frees the concurrent_array. No producer may be running.
+ * @param ca the concurrent_array
+ * @return an auto_array pointer or NULL if an error occurs, in which case ca
+ * 	is left as it was. It should be freed with auto_array_delete.
+ */
+auto_array* concurrent_array_seal (concurrent_array* ca);
+
+/**
+ * Frees memory for the concurrent_array. No producer may be running.
+ * @param ca the concurrent_array to free
+ * @param delete_entry called for each published pointer, may be NULL
+ */
+void concurrent_array_delete (concurrent_array* ca, void (*delete_entry)(void* entry));
+
+/***************************************************************************************
+ * 				task_pool
+ */
+
+/**
+ * The workers, deques and wake up state of a task_pool, private to the library.
+ */
+typedef struct task_pool_shared task_pool_shared;
+
+/**
+ * A work stealing thread pool. Each worker owns a Chase-Lev deque: it pushes
+ * and pops the tasks it spawns at one end while idle workers steal from the
+ * other, so recursive work spreads out from wherever it starts. Threads that
+ * wait on a task_group run tasks too, and one thread outside the pool at a
+ * time gets a deque of its own; tasks spawned by any other thread go through
+ * a shared queue. Workers that find nothing to do sleep until tasks arrive.
+ * The parallel auto_array and set functions run on a task_pool of their own.
+ * @see task_pool_create
+ */
+typedef struct {
+	size_t threads; /**< the threads that run tasks, the workers and one waiting thread */
+	task_pool_shared* shared; /**< private */
+} task_pool;
+
+/**
+ * A set of tasks that can be waited for together. Tasks may spawn more tasks
+ * into their own group or any other.
+ * \code{.c}
+ *	task_group g = TASK_GROUP_INITIALIZER (pool);
+ *	for (size_t i = 0; i < n; ++i) {
+ *		task_pool_spawn (&g, work, items[i]);
+ *	}
+ *	task_group_wait (&g);
+ *	\endcode
+ */
+typedef struct {
+	task_pool* pool; /**< the pool the tasks run on */
+	_Atomic size_t pending; /**< the number of spawned tasks that haven't finished */
+} task_group;
+
+/**
+ * Initializer for a task_group.
+ * @param p the task_pool the group's tasks run on
+ */
+#define TASK_GROUP_INITIALIZER(p) { (p), 0 }
+
+/**
+ * Initializes a pointer to a task_pool and starts its workers.
+ * @param threads the threads that run tasks, including one waiting thread,
+ * 	so threads - 1 workers are started, or 0 for one per online processor
+ * @return a task_pool pointer or NULL if an error occurs.
+ */
+task_pool* task_pool_create (size_t threads);
+
+/**
+ * Schedules fn (arg) to run on the pool as part of a group. Safe to call from
+ * any thread, including from within tasks.
+ * @param g the group, which must not be waited on and finished before the spawn returns
+ * @param fn the function to run
+ * @param arg passed to fn
+ * @return 0 or -1 if an error occurs, in which case fn won't run
+ */
+int task_pool_spawn (task_group* g, void (*fn) (void* arg), void* arg);
+
+/**
+ * Returns when every task of a group, including those spawned while waiting,
+ * has finished. The calling thread runs tasks from the pool in the meantime,
+ * so waiting inside a task doesn't tie up a worker.
+ * @param g the group to wait on
+ */
+void task_group_wait (task_group* g);
+
+/**
+ * Calls body with ranges that together cover [0, n) and returns when all have
+ * finished. Ranges larger than grain are halved, the upper half being spawned
+ * for other threads to steal, so the split adapts to uneven costs.
+ * @param p the pool to run on
+ * @param n the size of the range
+ * @param grain the smallest range worth splitting or 0 to pick one from the thread count
+ * @param body the function to call with each range [lo, hi) and arg
+ * @param arg passed through to body
+ * @return 0 or -1 if an error occurs
+ */
+int task_pool_parallel_for (task_pool* p, size_t n, size_t grain, void (*body) (size_t lo, size_t hi, void* arg), void* arg);
+
+/**
+ * Stops the workers and frees the pool. No group may have tasks pending.
+ * @param p the task_pool to free
+ */
+void task_pool_delete (task_pool* p);
+
 /***************************************************************************************
  * 				hash_table
 */
@@ -155,6 +799,8 @@ typedef struct {
 typedef struct {
 	size_t size;          /**< the number of buckets */
 	hash_bucket** buckets; /**< bucket store */
+	const sscont_allocator* allocator; /**< the source of the table's memory */
+	sscont_pool* entries; /**< the hash_entry objects, with room for short keys */
 } hash_table;
 
 /**
@@ -165,6 +811,36 @@ typedef struct {
  */
 hash_table* hash_table_create (size_t size_table);
 
+/**
+ * As hash_table_create with memory from an allocator. With an allocator 
+ * without free, e.g. an arena, hash_table_delete without delete_value 
+ * doesn't visit the entries.
+ * @param size_table the number of buckets
+ * @param allocator the source of the table's memory or NULL for the process default
+ * @return a pointer to a hash_table or NULL if an error occurs
+ */
+hash_table* hash_table_create_with (size_t size_table, const sscont_allocator* allocator);
+
+/**
+ * Paul Hsieh's fast hash, used by hash_table and available for hashing the 
+ * items of other containers.
+ * @param data the bytes to hash
+ * @param len the number of bytes
+ * @return the hash or 0 if len <= 0 or data is NULL
+ */
+uint32_t SuperFastHash (const char* data, int len);
+
+/**
+ * Austin Appleby's MurmurHash64A, a 64 bit hash that, unlike SuperFastHash,
+ * spreads similar keys well over all of its bits. Used by the sketch containers.
+ * The hash is of little endian hosts; big endian ones give different values.
+ * @param key the bytes to hash
+ * @param len the number of bytes
+ * @param seed selects one of a family of hash functions
+ * @return the hash
+ */
+uint64_t MurmurHash64A (const void* key, size_t len, uint64_t seed);
+
 /**
  * Stores a pointer, using a hash of the key (Paul Hsieh's fast hash is used).
  * @param ht the hash_tale to use for storage
@@ -182,6 +858,27 @@ hash_entry* hash_table_put (hash_table* ht, char* key, void* value);
  */
 void* hash_table_get (hash_table* ht, char* key);
 
+/**
+ * As hash_table_put with a key of n bytes that needn't be nul terminated,
+ * e.g. a string_view. The stored key is a nul terminated copy.
+ * @param ht the hash_table to use for storage
+ * @param key the key to hash, without nul bytes
+ * @param n the length of the key
+ * @param value the pointer to store
+ * @return a pointer to a hash_entry object of NULL if an error occurs
+ */
+hash_entry* hash_table_put_n (hash_table* ht, const char* key, size_t n, void* value);
+
+/**
+ * As hash_table_get with a key of n bytes that needn't be nul terminated,
+ * so tokens can be looked up without copying them.
+ * @param ht the hash_table to search
+ * @param key the key to search on, without nul bytes
+ * @param n the length of the key
+ * @return the pointer stored as the value associated with the key or NULL if an error occurs
+ */
+void* hash_table_get_n (hash_table* ht, const char* key, size_t n);
+
 /**
  * Returns the all entries that match the key.
  * @param ht the hash_table to search
@@ -216,8 +913,17 @@ void hash_table_delete (hash_table* ht, void (*delete_value)(void*));
 
 
 
+/**
+ * A slot in the index of a hashed set, used internally.
+ */
+typedef struct {
+	size_t pos;    /**< the position of the item in data plus one, 0 if the slot is empty */
+	uint32_t hash; /**< the hash of the item */
+} set_slot;
+
 /** 					
- * A fixed size container that models set operations in math. 
+ * A container that models set operations in math. A set created with set_create
+ * has a fixed size, a set created with set_create_hashed grows as needed.
  * @see set_create
  */
 typedef struct {
@@ -225,8 +931,41 @@ typedef struct {
 	size_t count; /**< The number of items in the set */
 	void** data;  /**< data table */
 	int (*equals) (void*, void*); /**< function pointer used to establish equality */
+	uint32_t (*hash) (void*); /**< function pointer used to hash items or NULL */
+	size_t index_size; /**< the number of slots in index, a power of 2 */
+	set_slot* index; /**< open addressed index over data, NULL unless hash is set */
+	const sscont_allocator* allocator; /**< the source of the set's memory */
 } set;
 
+/**
+ * Enumerates the subsets of a set, or those with k items, one at a time 
+ * into a caller owned buffer without allocating. The enumeration is a 
+ * sequence of ranks that can be split into ranges, e.g. one per thread.
+ * \code{.c}
+ *	void* buf[s->count];
+ *	set_subset_iter it;
+ *	set_subsets_begin (&it, s, buf, 0, set_subset_count (s));
+ *	while (set_subset_next (&it)) {
+ *		// it.items [0 .. it.count) is the subset
+ *	}
+ *	\endcode
+ * @see set_subsets_begin
+ * @see set_combinations_begin
+ */
+typedef struct {
+	set* s;          /**< the set being enumerated */
+	void** buf;      /**< the caller's buffer of s->count pointers */
+	void** items;    /**< the items of the current subset in set order, inside buf */
+	size_t count;    /**< the number of items in the current subset */
+	uint64_t mask;   /**< bit i is set when item i of the set is in the current subset */
+	ssize_t toggled; /**< the position in the set of the item the last step added or removed, 
+			      -1 if the subset was filled in from its rank */
+	size_t k;        /**< the number of items per subset, SIZE_MAX for all subsets */
+	uint64_t begin;  /**< the first rank of the range */
+	uint64_t rank;   /**< the rank of the next subset */
+	uint64_t end;    /**< one past the last rank of the range */
+} set_subset_iter;
+
 
 /**
  * Initializes and returns set. 
@@ -237,8 +976,41 @@ typedef struct {
 set* set_create (size_t size, int (*equals) (void*, void*));
 
 /**
- * Get the index of the item equal to the item in the params.
- * @param s the set to search
+ * As set_create with memory from an allocator. Sets computed from the set, 
+ * e.g. by set_union, use the same allocator.
+ * @param size the number of elements the set will hold
+ * @param equals a pointer to a function to be used to test item equality.
+ * @param allocator the source of the set's memory or NULL for the process default
+ * @return a pointer to a set or NULL if an error occurs
+ */
+set* set_create_with (size_t size, int (*equals) (void*, void*), const sscont_allocator* allocator);
+
+/**
+ * Initializes and returns a set that keeps a hash index over its items. Membership
+ * tests and adds take expected constant time, so set_add_items, set_union and 
+ * set_intersection run in expected linear time. The set grows automatically 
+ * instead of failing when it is full. 
+ * @param size the number of elements the set is initially allocated for
+ * @param equals a pointer to a function to be used to test item equality.
+ * @param hash a pointer to a function that hashes items. Items that are equal
+ * 	must have the same hash. SuperFastHash can be used to hash the bytes of an item.
+ * @return a pointer to a set or NULL if an error occurs
+ */
+set* set_create_hashed (size_t size, int (*equals) (void*, void*), uint32_t (*hash) (void*));
+
+/**
+ * As set_create_hashed with memory from an allocator.
+ * @param size the number of elements the set is initially allocated for
+ * @param equals a pointer to a function to be used to test item equality.
+ * @param hash a pointer to a function that hashes items
+ * @param allocator the source of the set's memory or NULL for the process default
+ * @return a pointer to a set or NULL if an error occurs
+ */
+set* set_create_hashed_with (size_t size, int (*equals) (void*, void*), uint32_t (*hash) (void*), const sscont_allocator* allocator);
+
+/**
+ * Get the index of the item equal to the item in the params.
+ * @param s the set to search
  * @param item to search for (equivelence is determined by the 
  * 	function pointer passed in set_create
  * @return the index of the item or -1 if an error occurs.
@@ -268,10 +1040,17 @@ ssize_t set_add_items (set* s, void** items, size_t size);
  * @param pos the position to return
  * @return the pointer stored at that position
  */
+#ifdef SSCONT_INLINE
+static inline void* set_get_item (set* s, size_t pos) {
+	return pos < s->count ? s->data[pos] : NULL;
+}
+#else
 void* set_get_item (set* s, size_t pos);
+#endif // SSCONT_INLINE
 
 /**
- * Returns the power set of a set.
+ * Returns the power set of a set. Each subset is a new set, so this is only
+ * practical for small sets. set_subsets_begin enumerates without allocating.
  * @param s the set to use to form the power set
  * @return a pointer to a set containing all of the subsets of the set 
  * 	or NULL in the case of an error.
@@ -287,9 +1066,61 @@ void* set_get_item (set* s, size_t pos);
  */
 set* set_all_subsets (set* s);
 
+/**
+ * Returns the number of subsets of a set, 2^count.
+ * @param s the set
+ * @return the number of subsets or 0 if the set has more than 63 items
+ */
+uint64_t set_subset_count (set* s);
+
+/**
+ * Returns the number of subsets of a set with k items, count choose k.
+ * @param s the set
+ * @param k the number of items per subset
+ * @return the number of subsets, 0 if k is larger than the count or the 
+ * 	set has more than 63 items
+ */
+uint64_t set_combination_count (set* s, size_t k);
+
+/**
+ * Starts enumerating the subsets of a set in Gray code order. After the
+ * first subset of the range each step adds or removes one item, reported
+ * in the iterator's toggled field, and moves at most 2 pointers. The rank
+ * of a subset is the binary number whose Gray code is its mask.
+ * The set must not change during the enumeration.
+ * @param it the iterator to initialize
+ * @param s the set, which may have up to 63 items
+ * @param buf a buffer of at least s->count pointers that receives the subsets
+ * @param begin the rank of the first subset to visit
+ * @param end one past the rank of the last subset to visit, at most set_subset_count (s)
+ * @return 0 or -1 if the set is too large or the range is out of bounds
+ */
+int set_subsets_begin (set_subset_iter* it, set* s, void** buf, uint64_t begin, uint64_t end);
+
+/**
+ * Starts enumerating the subsets of a set with k items. Ranks are in colex
+ * order, i.e. by increasing mask, and the first subset of a range is found 
+ * from its rank in the combinatorial number system.
+ * @param it the iterator to initialize
+ * @param s the set, which may have up to 63 items
+ * @param k the number of items per subset
+ * @param buf a buffer of at least s->count pointers that receives the subsets
+ * @param begin the rank of the first subset to visit
+ * @param end one past the rank of the last subset to visit, at most set_combination_count (s, k)
+ * @return 0 or -1 if the set is too large or the range is out of bounds
+ */
+int set_combinations_begin (set_subset_iter* it, set* s, size_t k, void** buf, uint64_t begin, uint64_t end);
+
+/**
+ * Moves to the next subset.
+ * @param it an iterator started by set_subsets_begin or set_combinations_begin
+ * @return 1 if it.items and it.count hold the next subset, 0 at the end of the range
+ */
+int set_subset_next (set_subset_iter* it);
+
 /**
  * Returns the union of two sets using the equals function 
- * in the first set.
+ * in the first set. The result is hashed if the first set is.
  * @param s one of the sets to join
  * @param other on of the sets to join
  * @return a pointer to a set containing the union of the 
@@ -300,17 +1131,99 @@ set* set_all_subsets (set* s);
 set* set_union (set* s, set* other);
 
 /**
- * Returns the intersection of two sets using the equals function 
- * in the first set.
+ * Returns the intersection of two sets. Items of the first set are looked up 
+ * in the other, so the lookup is hashed if the other set is. The result is 
+ * hashed if the first set is and keeps the order of the first set.
  * @param s one of the sets to intersect
  * @param other on of the sets to intersect
  * @return a pointer to a set containing the intersection of the 
- * 	two sets of NULL in the case of an error.
+ * 	two sets, which may be empty, or NULL in the case of an error.
  * 	Memory should be reclaimed, when the returned set is no longer
  * 	used, by calling set_delete with a NULL second param 
  */
 set* set_intersection (set* s, set* other);
 
+/**
+ * Returns the items of the first set that are not in the other. Lookups 
+ * and the result are as for set_intersection.
+ * @param s the set to take items from
+ * @param other the set of items to leave out
+ * @return a pointer to a set containing the difference, which may be empty,
+ * 	or NULL in the case of an error.
+ * 	Memory should be reclaimed, when the returned set is no longer
+ * 	used, by calling set_delete with a NULL second param 
+ */
+set* set_difference (set* s, set* other);
+
+/**
+ * Adds the items of the other set to dest. A hashed dest grows as needed. 
+ * A plain dest fails, and is left unchanged, when the items it lacks do not fit.
+ * @param dest the set to add to
+ * @param other the set whose items are added
+ * @return the count of dest or -1 if an error occurs
+ */
+ssize_t set_union_into (set* dest, set* other);
+
+/**
+ * Removes the items of dest that are not in the other set. Nothing is allocated.
+ * The last item of a hashed set is moved into the place of each removed item, 
+ * a plain set keeps the order of its items.
+ * @param dest the set to remove from
+ * @param other the set of items to keep
+ * @return the count of dest
+ */
+ssize_t set_intersect_into (set* dest, set* other);
+
+/**
+ * Removes the items of dest that are in the other set. Nothing is allocated.
+ * Items are moved as for set_intersect_into.
+ * @param dest the set to remove from
+ * @param other the set of items to remove
+ * @return the count of dest
+ */
+ssize_t set_difference_into (set* dest, set* other);
+
+/**
+ * Counts the items two sets have in common without building a set. The
+ * items of one set are looked up in the other, preferring hashed lookups 
+ * into the larger set.
+ * @param s a set
+ * @param other a set
+ * @return the size of the intersection
+ */
+size_t set_intersection_size (set* s, set* other);
+
+/**
+ * set_union on the library's thread pool, for sets with millions of items.
+ * The items of other are looked up in s by chunks in parallel, the chunk 
+ * results are placed with a prefix sum and the index of the result is filled
+ * concurrently with an atomic claim of each slot. The result holds the same
+ * items as set_union's, in the same order.
+ * @param s a set, which must not change during the call
+ * @param other a set, which must not change during the call
+ * @return a pointer to a new set or NULL if an error occurs
+ * @see auto_array_parallel_threads
+ */
+set* set_parallel_union (set* s, set* other);
+
+/**
+ * set_intersection on the library's thread pool. 
+ * @param s a set
+ * @param other a set
+ * @return a pointer to a new set or NULL if an error occurs
+ * @see set_parallel_union
+ */
+set* set_parallel_intersection (set* s, set* other);
+
+/**
+ * set_difference on the library's thread pool. 
+ * @param s a set
+ * @param other a set
+ * @return a pointer to a new set or NULL if an error occurs
+ * @see set_parallel_union
+ */
+set* set_parallel_difference (set* s, set* other);
+
 /**
  * Frees memory for the set.
  * @param s the set to free
@@ -321,6 +1234,12 @@ set* set_intersection (set* s, set* other);
 void set_delete (set* s, void (*delete_item)(void*));
 
 
+/**
+ * The number of chars, including the nul, an auto_string holds inline before it
+ * spills to the heap.
+ */
+#define AUTO_STRING_SMALL_SIZE 40
+
 /** 					
  * An auto sizing char buffer.
  * @see auto_string_create
@@ -329,17 +1248,39 @@ typedef struct {
 	size_t size; /**< current allocated size */
 	size_t count; /**< current count of used elements */
 	char* buf; /**< Nul terminated char buffer */
+	char small[AUTO_STRING_SMALL_SIZE]; /**< inline buffer used while the string is short */
+	const sscont_allocator* allocator; /**< the source of buf and the auto_string, NULL until an initialized string allocates */
 } auto_string;
 
+/**
+ * Initializer for an auto_string that isn't allocated with auto_string_create, e.g. on
+ * the stack. It starts with the inline buffer and only allocates if it outgrows it.
+ * Release it with auto_string_release rather than auto_string_delete.
+ * @param name the name of the variable being initialized
+ */
+#define AUTO_STRING_INITIALIZER(name) \
+	{ AUTO_STRING_SMALL_SIZE, 0, (name).small, { 0 }, NULL }
+
 /**
  * Initialize and return a pointer to an auto_string.
- * @param initial_size the initial size of the buffer
+ * @param initial_size the initial size of the buffer. If it is no larger than 
+ * 	AUTO_STRING_SMALL_SIZE the inline buffer is used, and only the auto_string
+ * 	itself is allocated, until the string outgrows it.
  * @returns a pointer to an auto_string
  */
 auto_string* auto_string_create (size_t initial_size);
 
 /**
- * Appends a nul terminated string to the buffer.
+ * As auto_string_create with memory from an allocator.
+ * @param initial_size the initial size of the buffer
+ * @param allocator the source of the string's memory or NULL for the process default
+ * @returns a pointer to an auto_string or NULL if an error occurs
+ */
+auto_string* auto_string_create_with (size_t initial_size, const sscont_allocator* allocator);
+
+/**
+ * Appends a nul terminated string to the buffer. The chars are copied to the
+ * end of the buffer, which is found from count rather than by scanning it.
  * @param str the auto_string pointer
  * @param cstr the nul terminated strng to append to the string
  * @return the auto_string or NULL if there is an error
@@ -347,7 +1288,116 @@ auto_string* auto_string_create (size_t initial_size);
 auto_string* auto_string_append (auto_string* str, char* cstr);
 
 /**
- * Returns the length of the buffer. The same as strlen (str->buf).
+ * Appends n chars, which need not be nul terminated and may include nuls.
+ * The chars may come from the string's own buffer.
+ * @param str the auto_string pointer
+ * @param data the chars to append
+ * @param n the number of chars
+ * @return the auto_string or NULL if there is an error
+ */
+auto_string* auto_string_append_n (auto_string* str, const char* data, size_t n);
+
+/**
+ * Appends a single char.
+ * @param str the auto_string pointer
+ * @param c the char to append
+ * @return the auto_string or NULL if there is an error
+ */
+auto_string* auto_string_append_char (auto_string* str, char c);
+
+/**
+ * Makes room for n more chars, so that appending them doesn't reallocate.
+ * @param str the auto_string pointer
+ * @param n the number of chars to make room for
+ * @return the auto_string or NULL if there is an error
+ */
+auto_string* auto_string_reserve (auto_string* str, size_t n);
+
+/**
+ * Appends printf style formatted output, formatting directly into the spare
+ * room of the buffer. Output that doesn't fit grows the buffer once and is
+ * formatted again.
+ * @param str the auto_string pointer
+ * @param fmt the printf format
+ * @return the auto_string or NULL if there is an error
+ */
+auto_string* auto_string_appendf (auto_string* str, const char* fmt, ...) __attribute__ ((format (printf, 2, 3)));
+
+/**
+ * auto_string_appendf with a va_list.
+ * @param str the auto_string pointer
+ * @param fmt the printf format
+ * @param ap the arguments, which are consumed
+ * @return the auto_string or NULL if there is an error
+ */
+auto_string* auto_string_vappendf (auto_string* str, const char* fmt, va_list ap);
+
+/**
+ * Appends a signed integer in decimal without going through printf.
+ * @param str the auto_string pointer
+ * @param v the integer
+ * @return the auto_string or NULL if there is an error
+ */
+auto_string* auto_string_append_int (auto_string* str, int64_t v);
+
+/**
+ * Appends an unsigned integer in decimal without going through printf.
+ * @param str the auto_string pointer
+ * @param v the integer
+ * @return the auto_string or NULL if there is an error
+ */
+auto_string* auto_string_append_uint (auto_string* str, uint64_t v);
+
+/**
+ * Appends a double in fixed point notation, rounded as %.*f would round it,
+ * without going through printf or the locale: the decimal point is always '.'.
+ * Magnitudes of 1e15 or more, infinities, NaNs and precisions above 9 are 
+ * formatted by printf.
+ * @param str the auto_string pointer
+ * @param v the value
+ * @param precision the number of digits after the point
+ * @return the auto_string or NULL if there is an error
+ */
+auto_string* auto_string_append_double (auto_string* str, double v, int precision);
+
+/**
+ * Appends n bytes escaped for a JSON string, without the quotes. Quotes, 
+ * backslashes and control characters are escaped, other bytes, including 
+ * UTF-8 sequences, are copied. Runs that need no escaping are found 16 or 
+ * 32 bytes at a time with SSE2 or AVX2 and copied at once.
+ * @param str the auto_string to append to
+ * @param data the bytes to escape
+ * @param n the number of bytes
+ * @return the auto_string or NULL if there is an error
+ */
+auto_string* auto_string_append_json_escaped (auto_string* str, const char* data, size_t n);
+
+/**
+ * Appends n bytes percent encoded for a URL. All but the characters RFC 3986
+ * leaves unreserved, letters, digits and "-._~", are encoded as %XX. Runs
+ * of unreserved characters are found and copied as for 
+ * auto_string_append_json_escaped.
+ * @param str the auto_string to append to
+ * @param data the bytes to encode
+ * @param n the number of bytes
+ * @return the auto_string or NULL if there is an error
+ */
+auto_string* auto_string_append_url_encoded (auto_string* str, const char* data, size_t n);
+
+/**
+ * Checks that n bytes are valid UTF-8: no overlong encodings, surrogates, 
+ * code points past U+10FFFF or sequences cut short. ASCII is skipped 16 or
+ * 32 bytes at a time, and with AVX2 other bytes are validated 32 at a time 
+ * as well.
+ * @param data the bytes to check
+ * @param n the number of bytes
+ * @return 1 if the bytes are valid UTF-8, 0 otherwise
+ */
+int utf8_validate (const char* data, size_t n);
+
+/**
+ * Returns the length of the buffer, which is kept in count. The same as 
+ * strlen (str->buf) unless nuls were appended with auto_string_append_n.
  * @param str the auto_string pointer
  * @return the length of the string
  */
@@ -360,6 +1410,1161 @@ size_t auto_string_length (auto_string* str);
  */
 void auto_string_delete (auto_string* str);
 
+/**
+ * Frees the buffer of an auto_string but not the auto_string itself. 
+ * Used with AUTO_STRING_INITIALIZER. The string is left empty and usable.
+ * @param str the auto_string to release
+ */
+void auto_string_release (auto_string* str);
+
+/***************************************************************************************
+ * 				heap
+*/
+
+/**
+ * A handle to an item stored in a heap. 
+ * @see heap_push
+ */
+typedef struct {
+	void* item; /**< the stored pointer */
+	size_t pos; /**< the node's position in the heap, maintained internally */
+} heap_node;
+
+/**
+ * A d-ary heap priority queue of generic pointers, stored in an auto_array.
+ * @see heap_create
+ */
+typedef struct {
+	size_t arity;       /**< the number of children of each node */
+	auto_array* nodes;  /**< heap ordered heap_node pointers */
+	auto_array* spare;  /**< nodes kept for reuse */
+	int (*compare) (void*, void*); /**< function pointer used to order items */
+} heap;
+
+/**
+ * Initializes and returns a pointer to an empty heap.
+ * @param initial_size the number of items storage is initially allocated for
+ * @param arity the number of children of each node, at least 2. 0 selects 4,
+ * 	which makes the heap shallower than a binary heap and keeps the 
+ * 	children of a node in one cache line.
+ * @param compare a function returning a negative value if its first argument
+ * 	should leave the heap before its second, 0 if they are equal and a positive
+ * 	value otherwise. 
+ * @return a pointer to a heap or NULL if an error occurs.
+ */
+heap* heap_create (size_t initial_size, size_t arity, int (*compare) (void*, void*));
+
+/**
+ * Initializes a heap holding the pointers stored in an auto_array. The heap is
+ * built in O(n) rather than by n pushes. aa is not changed. The items can be
+ * found through their handles in the nodes member of the returned heap.
+ * @param aa the pointers to store
+ * @param arity the number of children of each node, 0 selects 4
+ * @param compare the function used to order items, see heap_create
+ * @return a pointer to a heap or NULL if an error occurs.
+ */
+heap* heap_create_from (auto_array* aa, size_t arity, int (*compare) (void*, void*));
+
+/**
+ * Adds a pointer to the heap in O(log n).
+ * @param h the heap to add to
+ * @param item the pointer to store
+ * @return a handle for the item that can be passed to heap_update and heap_remove
+ * 	or NULL if an error occurs. The handle is valid until the item leaves the heap.
+ */
+heap_node* heap_push (heap* h, void* item);
+
+/**
+ * Returns the pointer that would be removed next by heap_pop.
+ * @param h the heap to examine
+ * @return the first pointer or NULL if the heap is empty
+ */
+#ifdef SSCONT_INLINE
+static inline void* heap_peek (heap* h) {
+	return h->nodes->count ? ((heap_node*) h->nodes->data[0])->item : NULL;
+}
+#else
+void* heap_peek (heap* h);
+#endif // SSCONT_INLINE
+
+/**
+ * Removes and returns the first pointer in O(log n).
+ * @param h the heap to remove from
+ * @return the first pointer or NULL if the heap is empty
+ */
+void* heap_pop (heap* h);
+
+/**
+ * Restores heap order after the priority of an item has changed, in either 
+ * direction, in O(log n).
+ * @param h the heap containing the item
+ * @param node the handle returned by heap_push
+ * @return 0 or -1 if the node isn't in the heap
+ */
+int heap_update (heap* h, heap_node* node);
+
+/**
+ * Removes an item from anywhere in the heap in O(log n).
+ * @param h the heap containing the item
+ * @param node the handle returned by heap_push
+ * @return the removed pointer or NULL if the node isn't in the heap
+ */
+void* heap_remove (heap* h, heap_node* node);
+
+/**
+ * Returns the number of items in the heap.
+ * @param h the heap
+ * @return the item count
+ */
+#ifdef SSCONT_INLINE
+static inline size_t heap_count (heap* h) {
+	return h->nodes->count;
+}
+#else
+size_t heap_count (heap* h);
+#endif // SSCONT_INLINE
+
+/**
+ * Frees memory for the heap.
+ * @param h the heap to free
+ * @param delete_item a function pointer that will be called for each stored pointer.
+ * 	It can be used to free memory. It may be NULL in which case memory must be 
+ * 	reclaimed by the programmer.
+ */
+void heap_delete (heap* h, void (*delete_item)(void*));
+
+/***************************************************************************************
+ * 				bitset
+*/
+
+/**
+ * A dynamically sized set of bits, for membership over dense integer universes.
+ * The bulk operations use AVX2 or SSE2 when the cpu supports them.
+ * @see bitset_create
+ */
+typedef struct {
+	size_t size;    /**< the number of bits in use */
+	size_t words;   /**< the number of allocated 64 bit words */
+	uint64_t* bits; /**< bit storage, bit n is bit n % 64 of word n / 64 */
+} bitset;
+
+/**
+ * Initializes and returns a pointer to a bitset with all bits clear.
+ * @param size the initial number of bits
+ * @return a pointer to a bitset or NULL if an error occurs.
+ */
+bitset* bitset_create (size_t size);
+
+/**
+ * Sets a bit, growing the bitset if the bit is past its end.
+ * @param bs the bitset
+ * @param bit the bit to set
+ * @return 0 or -1 if an error occurs
+ */
+int bitset_set (bitset* bs, size_t bit);
+
+/**
+ * Clears a bit. Bits past the end are already clear.
+ * @param bs the bitset
+ * @param bit the bit to clear
+ */
+void bitset_clear (bitset* bs, size_t bit);
+
+/**
+ * Tests a bit.
+ * @param bs the bitset
+ * @param bit the bit to test
+ * @return 1 if the bit is set, otherwise 0
+ */
+#ifdef SSCONT_INLINE
+static inline int bitset_test (bitset* bs, size_t bit) {
+	return bit < bs->size ? (bs->bits[bit / 64] >> (bit % 64)) & 1 : 0;
+}
+#else
+int bitset_test (bitset* bs, size_t bit);
+#endif // SSCONT_INLINE
+
+/**
+ * Returns the number of set bits (population count).
+ * @param bs the bitset
+ * @return the number of set bits
+ */
+size_t bitset_count (bitset* bs);
+
+/**
+ * Returns the lowest set bit.
+ * @param bs the bitset
+ * @return the index of the bit or -1 if no bit is set
+ */
+ssize_t bitset_first (bitset* bs);
+
+/**
+ * Returns the lowest set bit at or after a position. 
+ * \code{.c}
+ *	for (ssize_t b = bitset_first (bs); b != -1; b = bitset_next (bs, b + 1)) {
+ *		...
+ *	}
+ *	\endcode
+ * @param bs the bitset
+ * @param bit the position to start searching from
+ * @return the index of the bit or -1 if no bit is set
+ */
+ssize_t bitset_next (bitset* bs, size_t bit);
+
+/**
+ * dst = dst & src. Bits of dst past the end of src are cleared.
+ * @param dst the bitset that receives the result
+ * @param src the other operand
+ * @return 0 or -1 if an error occurs
+ */
+int bitset_and (bitset* dst, bitset* src);
+
+/**
+ * dst = dst | src. dst grows to the size of src if it is shorter.
+ * @param dst the bitset that receives the result
+ * @param src the other operand
+ * @return 0 or -1 if an error occurs
+ */
+int bitset_or (bitset* dst, bitset* src);
+
+/**
+ * dst = dst ^ src. dst grows to the size of src if it is shorter.
+ * @param dst the bitset that receives the result
+ * @param src the other operand
+ * @return 0 or -1 if an error occurs
+ */
+int bitset_xor (bitset* dst, bitset* src);
+
+/**
+ * dst = dst & ~src.
+ * @param dst the bitset that receives the result
+ * @param src the other operand
+ * @return 0 or -1 if an error occurs
+ */
+int bitset_andnot (bitset* dst, bitset* src);
+
+/**
+ * Frees memory for the bitset.
+ * @param bs the bitset to free
+ */
+void bitset_delete (bitset* bs);
+
+/***************************************************************************************
+ * 				sorted_set
+*/
+
+/**
+ * A set of 32 bit integers kept in a sorted array. The set algebra merges
+ * the arrays, gallops through the larger one when the sizes are skewed and
+ * intersects with SSE or AVX2 shuffle kernels when the cpu supports them.
+ * @see sorted_set_create
+ */
+typedef struct {
+	size_t size;    /**< the number of allocated values */
+	size_t count;   /**< the number of values in the set */
+	uint32_t* data; /**< the values in ascending order */
+} sorted_set;
+
+/** intersection kernel levels for sorted_set_simd */
+enum {
+	SORTED_SET_SCALAR = 0, /**< merge, no vector instructions */
+	SORTED_SET_SSE = 1,    /**< 4 x 4 compare with an SSSE3 shuffle */
+	SORTED_SET_AVX2 = 2    /**< 8 x 8 compare with an AVX2 permute */
+};
+
+/**
+ * Initializes and returns a pointer to an empty sorted_set.
+ * @param size the initial number of values to allocate
+ * @return a pointer to a sorted_set or NULL if an error occurs.
+ */
+sorted_set* sorted_set_create (size_t size);
+
+/**
+ * Creates a sorted_set holding the distinct values of an array, which need not be sorted.
+ * @param values the values
+ * @param n the number of values
+ * @return a pointer to a sorted_set or NULL if an error occurs.
+ */
+sorted_set* sorted_set_create_from (const uint32_t* values, size_t n);
+
+/**
+ * Adds a value. Adding in ascending order is amortized constant time, 
+ * otherwise the values after it are moved.
+ * @param ss the sorted_set
+ * @param value the value to add
+ * @return the number of values in the set or -1 if an error occurs
+ */
+ssize_t sorted_set_add (sorted_set* ss, uint32_t value);
+
+/**
+ * Removes a value.
+ * @param ss the sorted_set
+ * @param value the value to remove
+ * @return the number of values in the set or -1 if the value is not in the set
+ */
+ssize_t sorted_set_remove (sorted_set* ss, uint32_t value);
+
+/**
+ * Returns the position of a value in the set by binary search.
+ * @param ss the sorted_set
+ * @param value the value to find
+ * @return the position or -1 if the value is not in the set
+ */
+ssize_t sorted_set_index (sorted_set* ss, uint32_t value);
+
+/**
+ * Tests whether a value is in the set.
+ * @param ss the sorted_set
+ * @param value the value to test
+ * @return 1 if the value is in the set, otherwise 0
+ */
+int sorted_set_contains (sorted_set* ss, uint32_t value);
+
+/**
+ * Creates a sorted_set holding the values of both sets.
+ * @param a a sorted_set
+ * @param b a sorted_set
+ * @return a pointer to a new sorted_set or NULL if an error occurs.
+ */
+sorted_set* sorted_set_union (sorted_set* a, sorted_set* b);
+
+/**
+ * Creates a sorted_set holding the values that are in both sets.
+ * @param a a sorted_set
+ * @param b a sorted_set
+ * @return a pointer to a new sorted_set or NULL if an error occurs.
+ */
+sorted_set* sorted_set_intersection (sorted_set* a, sorted_set* b);
+
+/**
+ * Counts the values that are in both sets without creating a set.
+ * @param a a sorted_set
+ * @param b a sorted_set
+ * @return the number of common values
+ */
+size_t sorted_set_intersection_size (sorted_set* a, sorted_set* b);
+
+/**
+ * Creates a sorted_set holding the values of a that are not in b.
+ * @param a a sorted_set
+ * @param b a sorted_set
+ * @return a pointer to a new sorted_set or NULL if an error occurs.
+ */
+sorted_set* sorted_set_difference (sorted_set* a, sorted_set* b);
+
+/**
+ * Creates a sorted_set holding the values that are in exactly one of the sets.
+ * @param a a sorted_set
+ * @param b a sorted_set
+ * @return a pointer to a new sorted_set or NULL if an error occurs.
+ */
+sorted_set* sorted_set_symmetric_difference (sorted_set* a, sorted_set* b);
+
+/**
+ * sorted_set_union on the library's thread pool. The larger set is cut into
+ * value ranges of equal size and the smaller set is cut at the same values,
+ * so each range is merged independently. The pieces are concatenated at 
+ * offsets given by a prefix sum of their sizes.
+ * @param a a sorted_set
+ * @param b a sorted_set
+ * @return a pointer to a new sorted_set or NULL if an error occurs.
+ * @see auto_array_parallel_threads
+ */
+sorted_set* sorted_set_parallel_union (sorted_set* a, sorted_set* b);
+
+/**
+ * sorted_set_intersection on the library's thread pool.
+ * @param a a sorted_set
+ * @param b a sorted_set
+ * @return a pointer to a new sorted_set or NULL if an error occurs.
+ * @see sorted_set_parallel_union
+ */
+sorted_set* sorted_set_parallel_intersection (sorted_set* a, sorted_set* b);
+
+/**
+ * sorted_set_difference on the library's thread pool.
+ * @param a a sorted_set
+ * @param b a sorted_set
+ * @return a pointer to a new sorted_set or NULL if an error occurs.
+ * @see sorted_set_parallel_union
+ */
+sorted_set* sorted_set_parallel_difference (sorted_set* a, sorted_set* b);
+
+/**
+ * Limits the intersection kernel, for testing and benchmarking. The best
+ * kernel the cpu supports is selected when the library loads.
+ * @param level SORTED_SET_SCALAR, SORTED_SET_SSE or SORTED_SET_AVX2
+ * @return the level in effect, which is lower than level if the cpu lacks support
+ */
+int sorted_set_simd (int level);
+
+/**
+ * Frees memory for the sorted_set.
+ * @param ss the sorted_set to free
+ */
+void sorted_set_delete (sorted_set* ss);
+
+/***************************************************************************************
+ * 				roaring
+*/
+
+/** roaring_container types */
+enum {
+	ROARING_ARRAY = 0,  /**< sorted array of up to 4096 values */
+	ROARING_BITMAP = 1, /**< 65536 bit bitmap */
+	ROARING_RUN = 2     /**< sorted (start, length - 1) pairs */
+};
+
+/**
+ * The values of a roaring set that share their high 16 bits.
+ */
+typedef struct {
+	uint16_t key;         /**< the high 16 bits of the values */
+	uint16_t type;        /**< ROARING_ARRAY, ROARING_BITMAP or ROARING_RUN */
+	uint32_t cardinality; /**< the number of values */
+	uint32_t n;           /**< the number of array values, bitmap words or runs */
+	size_t size;          /**< allocated bytes of data */
+	void* data;           /**< the low 16 bits of the values */
+} roaring_container;
+
+/**
+ * A compressed set of 32 bit integers in the style of Roaring bitmaps. The 
+ * values are split into 64K chunks, each stored as a sorted array, a bitmap
+ * or a list of runs, whichever suits its density.
+ * @see roaring_create
+ */
+typedef struct {
+	size_t size;                     /**< allocated containers */
+	size_t count;                    /**< containers in use */
+	roaring_container* containers;   /**< containers in ascending key order */
+	uint64_t* ranks;                 /**< the number of values before each container */
+	size_t ranks_count;              /**< the number of current entries in ranks, 0 after a change */
+} roaring;
+
+/**
+ * Initializes and returns a pointer to an empty roaring set.
+ * @return a pointer to a roaring set or NULL if an error occurs.
+ */
+roaring* roaring_create ();
+
+/**
+ * Adds a value.
+ * @param r the roaring set
+ * @param value the value to add
+ * @return 1 if the value was added, 0 if it was already present or -1 if an error occurs
+ */
+int roaring_add (roaring* r, uint32_t value);
+
+/**
+ * Adds the values [lo, hi), storing long ranges as runs.
+ * @param r the roaring set
+ * @param lo the first value to add
+ * @param hi one past the last value to add
+ * @return 0 or -1 if an error occurs
+ */
+int roaring_add_range (roaring* r, uint32_t lo, uint32_t hi);
+
+/**
+ * Removes a value.
+ * @param r the roaring set
+ * @param value the value to remove
+ * @return 1 if the value was removed, 0 if it was not present or -1 if an error occurs
+ */
+int roaring_remove (roaring* r, uint32_t value);
+
+/**
+ * Tests whether a value is in the set.
+ * @param r the roaring set
+ * @param value the value to test
+ * @return 1 if the value is in the set, otherwise 0
+ */
+int roaring_contains (roaring* r, uint32_t value);
+
+/**
+ * Returns the number of values in the set.
+ * @param r the roaring set
+ * @return the cardinality
+ */
+uint64_t roaring_cardinality (roaring* r);
+
+/**
+ * Returns the number of values in the set that are less than or equal to a value.
+ * The first call to roaring_rank or roaring_select after the set changes builds an
+ * index of the containers, so they must not be called concurrently on a changed set.
+ * @param r the roaring set
+ * @param value the value
+ * @return the rank of the value
+ */
+uint64_t roaring_rank (roaring* r, uint32_t value);
+
+/**
+ * Finds the value with a given rank, counting from 0.
+ * @param r the roaring set
+ * @param rank the number of smaller values in the set
+ * @param value receives the value
+ * @return 0 or -1 if rank is not less than the cardinality
+ */
+int roaring_select (roaring* r, uint64_t rank, uint32_t* value);
+
+/**
+ * Copies the values in ascending order.
+ * @param r the roaring set
+ * @param values an array with room for roaring_cardinality (r) values
+ * @return the number of values copied
+ */
+size_t roaring_to_array (roaring* r, uint32_t* values);
+
+/**
+ * Creates a roaring set holding the values of both sets.
+ * @param a a roaring set
+ * @param b a roaring set
+ * @return a pointer to a new roaring set or NULL if an error occurs.
+ */
+roaring* roaring_union (roaring* a, roaring* b);
+
+/**
+ * Creates a roaring set holding the values that are in both sets.
+ * @param a a roaring set
+ * @param b a roaring set
+ * @return a pointer to a new roaring set or NULL if an error occurs.
+ */
+roaring* roaring_intersection (roaring* a, roaring* b);
+
+/**
+ * Creates a roaring set holding the values of a that are not in b.
+ * @param a a roaring set
+ * @param b a roaring set
+ * @return a pointer to a new roaring set or NULL if an error occurs.
+ */
+roaring* roaring_andnot (roaring* a, roaring* b);
+
+/**
+ * Converts each container to the smallest of array, bitmap or runs and frees 
+ * unused space. Values added one at a time never become runs until this is called.
+ * @param r the roaring set
+ * @return 0 or -1 if an error occurs
+ */
+int roaring_optimize (roaring* r);
+
+/**
+ * Returns the memory used by the set, including the roaring struct.
+ * @param r the roaring set
+ * @return the number of bytes allocated
+ */
+size_t roaring_size_in_bytes (roaring* r);
+
+/**
+ * Returns the size of the serialized form of the set.
+ * @param r the roaring set
+ * @return the number of bytes roaring_serialize will write
+ */
+size_t roaring_serialized_size (roaring* r);
+
+/**
+ * Writes the set in the portable Roaring format, which is little endian
+ * regardless of the host and can be read by other Roaring implementations.
+ * @param r the roaring set
+ * @param buf a buffer of at least roaring_serialized_size (r) bytes
+ * @return the number of bytes written
+ */
+size_t roaring_serialize (roaring* r, void* buf);
+
+/**
+ * Reads a set written in the portable Roaring format.
+ * @param buf the serialized set
+ * @param length the number of bytes available in buf
+ * @return a pointer to a new roaring set or NULL if the data is truncated,
+ * 	malformed or an error occurs.
+ */
+roaring* roaring_deserialize (const void* buf, size_t length);
+
+/**
+ * Frees memory for the roaring set.
+ * @param r the roaring set to free
+ */
+void roaring_delete (roaring* r);
+
+/***************************************************************************************
+ * 				hyperloglog
+*/
+
+/** the range of hyperloglog precisions */
+enum {
+	HYPERLOGLOG_MIN_PRECISION = 4,
+	HYPERLOGLOG_MAX_PRECISION = 18
+};
+
+/**
+ * A HyperLogLog sketch that estimates the number of distinct items added to
+ * it in 2^precision bytes, with a relative standard error of about 
+ * 1.04 / sqrt (2^precision). Items are hashed with MurmurHash64A and a seed of 0.
+ * A new sketch is sparse, holding only the registers that are set, and 
+ * becomes dense when that would be smaller. Sketches of precision 8 or less
+ * are dense from the start. Sketches filled by different threads can be merged.
+ * @see hyperloglog_create
+ */
+typedef struct {
+	unsigned int precision;  /**< the log2 of the number of registers */
+	uint8_t* registers;      /**< one register per byte once dense, otherwise NULL */
+	uint32_t* sparse;        /**< register index << 8 | value, sorted up to sparse_count, NULL once dense */
+	size_t sparse_count;     /**< the number of sorted, distinct entries in sparse */
+	size_t pending_count;    /**< the number of unsorted entries following them */
+	size_t sparse_size;      /**< allocated entries of sparse */
+} hyperloglog;
+
+/**
+ * Initializes and returns a pointer to an empty hyperloglog.
+ * @param precision between HYPERLOGLOG_MIN_PRECISION and HYPERLOGLOG_MAX_PRECISION,
+ * 	14 gives an error of about 0.8% in 16K bytes
+ * @return a pointer to a hyperloglog or NULL if the precision is out of range
+ * 	or an error occurs.
+ */
+hyperloglog* hyperloglog_create (unsigned int precision);
+
+/**
+ * Adds an item, given as bytes.
+ * @param hll the hyperloglog
+ * @param data the bytes of the item
+ * @param len the number of bytes
+ * @return 0 or -1 if an error occurs
+ */
+int hyperloglog_add (hyperloglog* hll, const void* data, size_t len);
+
+/**
+ * Adds an item by its hash, so that a hash computed once can be shared 
+ * with other containers.
+ * @param hll the hyperloglog
+ * @param hash MurmurHash64A of the item with a seed of 0
+ * @return 0 or -1 if an error occurs
+ */
+int hyperloglog_add_hash (hyperloglog* hll, uint64_t hash);
+
+/**
+ * Estimates the number of distinct items added, with Ertl's improved 
+ * estimator, which needs no bias tables and is accurate from 0 up to 
+ * billions of items.
+ * @param hll the hyperloglog, whose pending sparse entries are sorted in
+ * @return the estimate
+ */
+uint64_t hyperloglog_count (hyperloglog* hll);
+
+/**
+ * Merges another sketch of the same precision, after which dest estimates
+ * the distinct items of both. Typically each thread fills its own sketch 
+ * and they are merged at the end.
+ * @param dest the hyperloglog to merge into
+ * @param src the hyperloglog to merge, which is unchanged
+ * @return 0 or -1 if the precisions differ or an error occurs
+ */
+int hyperloglog_merge (hyperloglog* dest, hyperloglog* src);
+
+/**
+ * @param hll the hyperloglog
+ * @return the bytes allocated for the sketch
+ */
+size_t hyperloglog_size_in_bytes (hyperloglog* hll);
+
+/**
+ * Frees memory for the hyperloglog.
+ * @param hll the hyperloglog to free
+ */
+void hyperloglog_delete (hyperloglog* hll);
+
+/***************************************************************************************
+ * 				count_min
+*/
+
+/** the largest count_min depth */
+#define COUNT_MIN_MAX_DEPTH 16
+
+/**
+ * A Count-Min sketch that estimates how many times each item was added in
+ * a fixed depth x width table of counters. Estimates are never low. With 
+ * a width of w and a depth of d an estimate exceeds the true count by more
+ * than 2.72 / w of the total count with probability at most 0.37^d. 
+ * Counts are added conservatively, raising only the counters that are at 
+ * the current estimate, which makes estimates much closer for skewed streams.
+ * Items are hashed with MurmurHash64A and a seed of 0. Counters saturate 
+ * at UINT32_MAX.
+ * @see count_min_create
+ */
+typedef struct {
+	size_t width;        /**< counters per row, a power of 2 */
+	size_t depth;        /**< the number of rows */
+	uint64_t total;      /**< the sum of all counts added */
+	uint32_t* counters;  /**< depth rows of width counters */
+} count_min;
+
+/**
+ * Initializes and returns a pointer to a count_min sketch with all counters at 0.
+ * @param width counters per row, rounded up to a power of 2
+ * @param depth the number of rows, from 1 to COUNT_MIN_MAX_DEPTH
+ * @return a pointer to a count_min or NULL if an argument is out of range 
+ * 	or an error occurs.
+ */
+count_min* count_min_create (size_t width, size_t depth);
+
+/**
+ * Adds count occurrences of an item, given as bytes.
+ * @param cm the count_min
+ * @param data the bytes of the item
+ * @param len the number of bytes
+ * @param count the number of occurrences
+ * @return the new estimate for the item
+ */
+uint32_t count_min_add (count_min* cm, const void* data, size_t len, uint32_t count);
+
+/**
+ * Adds count occurrences of an item by its hash.
+ * @param cm the count_min
+ * @param hash MurmurHash64A of the item with a seed of 0
+ * @param count the number of occurrences
+ * @return the new estimate for the item
+ */
+uint32_t count_min_add_hash (count_min* cm, uint64_t hash, uint32_t count);
+
+/**
+ * Estimates how many times an item was added.
+ * @param cm the count_min
+ * @param data the bytes of the item
+ * @param len the number of bytes
+ * @return the estimate, which is at least the true count
+ */
+uint32_t count_min_estimate (count_min* cm, const void* data, size_t len);
+
+/**
+ * Estimates how many times an item was added by its hash.
+ * @param cm the count_min
+ * @param hash MurmurHash64A of the item with a seed of 0
+ * @return the estimate, which is at least the true count
+ */
+uint32_t count_min_estimate_hash (count_min* cm, uint64_t hash);
+
+/**
+ * Merges another sketch of the same dimensions by adding its counters. The
+ * estimates of the merged sketch are still never low.
+ * @param dest the count_min to merge into
+ * @param src the count_min to merge, which is unchanged
+ * @return 0 or -1 if the dimensions differ
+ */
+int count_min_merge (count_min* dest, count_min* src);
+
+/**
+ * @param cm the count_min
+ * @return the bytes allocated for the sketch
+ */
+size_t count_min_size_in_bytes (count_min* cm);
+
+/**
+ * Frees memory for the count_min.
+ * @param cm the count_min to free
+ */
+void count_min_delete (count_min* cm);
+
+/***************************************************************************************
+ * 				string_builder
+*/
+
+/**
+ * A run of bytes in a string_builder, either in one of its chunks or in an
+ * attached buffer.
+ */
+typedef struct {
+	const char* data;              /**< the bytes */
+	size_t length;                 /**< the number of bytes */
+	void (*release) (void* data);  /**< called with data once an attached buffer is done with, or NULL */
+} string_segment;
+
+/**
+ * A block of memory owned by a string_builder.
+ */
+typedef struct {
+	char* data;   /**< the block */
+	size_t size;  /**< the size of the block */
+} string_chunk;
+
+/**
+ * A string built as a list of segments, for output of many megabytes. 
+ * Appended bytes are copied into chunks that are never reallocated, so 
+ * existing bytes never move, and large buffers can be attached by reference.
+ * The segments are written out with writev without being joined first.
+ * @see string_builder_create
+ */
+typedef struct {
+	size_t count;                /**< the number of bytes not yet written */
+	string_segment* segments;    /**< the segments in order */
+	size_t segments_count;       /**< the number of segments */
+	size_t segments_size;        /**< allocated segments */
+	size_t head;                 /**< the first segment not completely written */
+	size_t head_offset;          /**< the bytes of the head segment already written */
+	string_chunk* chunks;        /**< the chunks appended bytes are copied to */
+	size_t chunks_count;         /**< the number of chunks */
+	size_t chunks_size;          /**< allocated chunks */
+	char* tail;                  /**< the next free byte of the last chunk */
+	size_t room;                 /**< the free bytes after tail */
+	size_t chunk_size;           /**< the size of the next chunk */
+} string_builder;
+
+/** buffers smaller than this are copied by string_builder_attach */
+#define STRING_BUILDER_ATTACH_MIN 512
+
+/**
+ * Initializes and returns a pointer to an empty string_builder.
+ * @return a pointer to a string_builder or NULL if an error occurs.
+ */
+string_builder* string_builder_create ();
+
+/**
+ * Appends a copy of n bytes. Bytes that don't fit in the last chunk go to
+ * a new one, which is at least as large as the rest of the bytes.
+ * @param sb the string_builder
+ * @param data the bytes to append
+ * @param n the number of bytes
+ * @return the string_builder or NULL if an error occurs
+ */
+string_builder* string_builder_append (string_builder* sb, const void* data, size_t n);
+
+/**
+ * Appends a nul terminated string, without its nul.
+ * @param sb the string_builder
+ * @param cstr the string to append
+ * @return the string_builder or NULL if an error occurs
+ */
+string_builder* string_builder_append_str (string_builder* sb, const char* cstr);
+
+/**
+ * Appends a caller owned buffer by reference, without copying it. The 
+ * buffer must not change until it has been written, or the builder is 
+ * cleared or deleted, at which point release, if not NULL, is called with 
+ * data. Buffers shorter than STRING_BUILDER_ATTACH_MIN are copied instead
+ * and released at once.
+ * @param sb the string_builder
+ * @param data the buffer
+ * @param n the number of bytes
+ * @param release frees the buffer, or NULL if the caller does
+ * @return the string_builder or NULL if an error occurs, in which case 
+ * 	the buffer has not been released
+ */
+string_builder* string_builder_attach (string_builder* sb, const void* data, size_t n, void (*release) (void* data));
+
+/**
+ * @param sb the string_builder
+ * @return the number of bytes not yet written
+ */
+size_t string_builder_length (string_builder* sb);
+
+/**
+ * Writes the bytes not yet written to a file descriptor with writev, 
+ * resuming after partial writes. Written bytes are consumed and the 
+ * builder is emptied, keeping its last chunk, when all are written. A 
+ * non blocking descriptor that fills up ends the call early; call it again
+ * when the descriptor is writable while string_builder_length is not 0.
+ * @param sb the string_builder
+ * @param fd the file descriptor
+ * @return the number of bytes written or -1 if nothing could be written,
+ * 	with errno set by writev, e.g. to EAGAIN
+ */
+ssize_t string_builder_write (string_builder* sb, int fd);
+
+/**
+ * Appends the bytes not yet written to an auto_string, growing it once.
+ * The builder is unchanged.
+ * @param sb the string_builder
+ * @param out the auto_string to append to
+ * @return out or NULL if an error occurs
+ */
+auto_string* string_builder_flatten (string_builder* sb, auto_string* out);
+
+/**
+ * Empties the builder, releasing the attached buffers not yet written and
+ * keeping the last chunk for reuse.
+ * @param sb the string_builder
+ */
+void string_builder_clear (string_builder* sb);
+
+/**
+ * Frees memory for the string_builder, releasing the attached buffers not yet written.
+ * @param sb the string_builder to free
+ */
+void string_builder_delete (string_builder* sb);
+
+/***************************************************************************************
+ * 				string_view
+*/
+
+/**
+ * A non owning view of bytes, usually part of an auto_string. Views are 
+ * passed by value and are valid while the bytes they refer to are.
+ */
+typedef struct {
+	const char* data; /**< the first byte, not nul terminated */
+	size_t length;    /**< the number of bytes */
+} string_view;
+
+/**
+ * @param data the first byte
+ * @param length the number of bytes
+ * @return a view of the bytes
+ */
+#ifdef SSCONT_INLINE
+static inline string_view string_view_of (const char* data, size_t length) {
+	return (string_view) { data, length };
+}
+#else
+string_view string_view_of (const char* data, size_t length);
+#endif // SSCONT_INLINE
+
+/**
+ * @param cstr a nul terminated string
+ * @return a view of the string without its nul
+ */
+string_view string_view_from_cstr (const char* cstr);
+
+/**
+ * @param s the auto_string
+ * @return a view of the contents of the auto_string, valid until it is changed
+ */
+string_view auto_string_view (auto_string* s);
+
+/**
+ * @param a a string_view
+ * @param b a string_view
+ * @return 1 if the views hold the same bytes, 0 otherwise
+ */
+int string_view_equals (string_view a, string_view b);
+
+/**
+ * Finds the first occurence of a byte.
+ * @param v the string_view to search
+ * @param c the byte to find
+ * @return the position of the byte or -1 if it isn't found
+ */
+ssize_t string_view_find_byte (string_view v, char c);
+
+/**
+ * Finds the first occurence of any of a set of bytes, comparing 16 or 32
+ * bytes at a time with SSE2 or AVX2 for sets of up to 16 bytes.
+ * @param v the string_view to search
+ * @param delims a nul terminated string of the bytes to find
+ * @return the position of the first byte found or -1 if none is found
+ */
+ssize_t string_view_find_any (string_view v, const char* delims);
+
+/**
+ * Finds the first occurence of a substring, using SSE2 or AVX2 to find the
+ * positions where its first and last bytes match.
+ * @param v the string_view to search
+ * @param needle the bytes to find
+ * @return the position of the substring, 0 for an empty needle, or -1 if it isn't found
+ */
+ssize_t string_view_find (string_view v, string_view needle);
+
+/**
+ * @param v a string_view
+ * @return the view without leading and trailing ASCII white space
+ */
+string_view string_view_trim (string_view v);
+
+/**
+ * Splits off the next field ending at any of a set of delimiters. Adjacent
+ * delimiters give empty fields, and the bytes after the last delimiter are
+ * the last field. Once it has been returned rest has a NULL data.
+ * @param rest the bytes still to split, advanced past the field and its delimiter
+ * @param delims a nul terminated string of delimiters
+ * @param field the field found
+ * @return 1 if a field was found, 0 when rest is exhausted
+ */
+int string_view_split (string_view* rest, const char* delims, string_view* field);
+
+/**
+ * Finds the next token, as strtok does, skipping runs of delimiters, without
+ * changing or copying the bytes.
+ * @param rest the bytes still to tokenize, advanced past the token
+ * @param delims a nul terminated string of delimiters
+ * @param token the token found
+ * @return 1 if a token was found, 0 if only delimiters remained
+ */
+int string_view_next_token (string_view* rest, const char* delims, string_view* token);
+
+/**
+ * Finds the next line, without its terminating newline or a carriage return
+ * before it. A last line without a newline is returned as well.
+ * @param rest the bytes still to read, advanced past the line
+ * @param line the line found
+ * @return 1 if a line was found, 0 when rest is empty
+ */
+int string_view_next_line (string_view* rest, string_view* line);
+
+/***************************************************************************************
+ * 				byte_buffer
+*/
+
+/**
+ * A binary safe buffer for serialization, the byte oriented sibling of 
+ * auto_string. Values are appended at count and read from pos, the read 
+ * cursor, which can be set directly to seek. Fixed width integers are little
+ * endian, varints are LEB128 and byte strings are prefixed by a varint length.
+ * @see byte_buffer_create
+ */
+typedef struct {
+	uint8_t* buf;  /**< the bytes */
+	size_t count;  /**< the number of bytes written */
+	size_t size;   /**< the allocated size of buf */
+	size_t pos;    /**< the read cursor */
+} byte_buffer;
+
+/**
+ * Initializer for a byte_buffer that isn't allocated with byte_buffer_create.
+ * Release it with byte_buffer_release rather than byte_buffer_delete.
+ */
+#define BYTE_BUFFER_INITIALIZER { NULL, 0, 0, 0 }
+
+/**
+ * Initializes and returns a pointer to an empty byte_buffer.
+ * @param initial_size the bytes to allocate, or 0 to allocate on the first write
+ * @return a pointer to a byte_buffer or NULL if an error occurs
+ */
+byte_buffer* byte_buffer_create (size_t initial_size);
+
+/**
+ * Makes room for n more bytes, so the next n bytes of writes don't allocate.
+ * @param bb the byte_buffer
+ * @param n the number of bytes
+ * @return the byte_buffer or NULL if an error occurs
+ */
+byte_buffer* byte_buffer_reserve (byte_buffer* bb, size_t n);
+
+/**
+ * Appends n bytes, which may include nuls.
+ * @param bb the byte_buffer
+ * @param data the bytes
+ * @param n the number of bytes
+ * @return the byte_buffer or NULL if an error occurs
+ */
+byte_buffer* byte_buffer_append (byte_buffer* bb, const void* data, size_t n);
+
+/**
+ * Append little endian integers of 1, 2, 4 and 8 bytes.
+ * @param bb the byte_buffer
+ * @param v the value
+ * @return the byte_buffer or NULL if an error occurs
+ */
+byte_buffer* byte_buffer_put_u8 (byte_buffer* bb, uint8_t v);
+byte_buffer* byte_buffer_put_u16 (byte_buffer* bb, uint16_t v);
+byte_buffer* byte_buffer_put_u32 (byte_buffer* bb, uint32_t v);
+byte_buffer* byte_buffer_put_u64 (byte_buffer* bb, uint64_t v);
+
+/**
+ * Appends an unsigned LEB128 varint, 7 bits per byte with the high bit set
+ * on all but the last, 1 to 10 bytes.
+ * @param bb the byte_buffer
+ * @param v the value
+ * @return the byte_buffer or NULL if an error occurs
+ */
+byte_buffer* byte_buffer_put_varint (byte_buffer* bb, uint64_t v);
+
+/**
+ * Appends a signed value as a zigzag encoded varint, so small negative 
+ * values are short too.
+ * @param bb the byte_buffer
+ * @param v the value
+ * @return the byte_buffer or NULL if an error occurs
+ */
+byte_buffer* byte_buffer_put_svarint (byte_buffer* bb, int64_t v);
+
+/**
+ * Appends n values as varints, growing the buffer once.
+ * @param bb the byte_buffer
+ * @param values the values
+ * @param n the number of values
+ * @return the byte_buffer or NULL if an error occurs
+ */
+byte_buffer* byte_buffer_put_varints (byte_buffer* bb, const uint64_t* values, size_t n);
+
+/**
+ * Appends n bytes prefixed by n as a varint.
+ * @param bb the byte_buffer
+ * @param data the bytes
+ * @param n the number of bytes
+ * @return the byte_buffer or NULL if an error occurs
+ */
+byte_buffer* byte_buffer_put_bytes (byte_buffer* bb, const void* data, size_t n);
+
+/**
+ * @param bb the byte_buffer
+ * @return the number of bytes after the read cursor
+ */
+size_t byte_buffer_remaining (byte_buffer* bb);
+
+/**
+ * Read little endian integers of 1, 2, 4 and 8 bytes at the read cursor and
+ * advance it.
+ * @param bb the byte_buffer
+ * @param v set to the value
+ * @return 0 or -1 if too few bytes remain, leaving the cursor unchanged
+ */
+int byte_buffer_get_u8 (byte_buffer* bb, uint8_t* v);
+int byte_buffer_get_u16 (byte_buffer* bb, uint16_t* v);
+int byte_buffer_get_u32 (byte_buffer* bb, uint32_t* v);
+int byte_buffer_get_u64 (byte_buffer* bb, uint64_t* v);
+
+/**
+ * Reads a varint at the read cursor and advances it.
+ * @param bb the byte_buffer
+ * @param v set to the value
+ * @return 0 or -1 if the varint is cut short or longer than 10 bytes, 
+ * 	leaving the cursor unchanged
+ */
+int byte_buffer_get_varint (byte_buffer* bb, uint64_t* v);
+
+/**
+ * Reads a zigzag encoded varint at the read cursor and advances it.
+ * @param bb the byte_buffer
+ * @param v set to the value
+ * @return 0 or -1 as byte_buffer_get_varint
+ */
+int byte_buffer_get_svarint (byte_buffer* bb, int64_t* v);
+
+/**
+ * Reads up to n varints at the read cursor and advances it past them. 
+ * On x86_64 cpus with AVX2 and BMI2 the continuation bits of 16 bytes are
+ * examined at once, runs of single byte values are widened with AVX2 and 
+ * longer values gathered with pext.
+ * @param bb the byte_buffer
+ * @param values set to the values
+ * @param n the most values to read
+ * @return the number of values read, fewer than n at the end of the 
+ * 	buffer or a corrupt varint
+ */
+size_t byte_buffer_get_varints (byte_buffer* bb, uint64_t* values, size_t n);
+
+/**
+ * Reads a length prefixed byte string at the read cursor and advances it,
+ * without copying it.
+ * @param bb the byte_buffer
+ * @param out set to a view of the bytes, valid until the buffer is written
+ * @return 0 or -1 if the length or the bytes are cut short, leaving the cursor unchanged
+ */
+int byte_buffer_get_bytes (byte_buffer* bb, string_view* out);
+
+/**
+ * Empties the buffer and resets the read cursor, keeping its memory.
+ * @param bb the byte_buffer
+ */
+void byte_buffer_clear (byte_buffer* bb);
+
+/**
+ * Frees the bytes of a byte_buffer but not the byte_buffer itself.
+ * Used with BYTE_BUFFER_INITIALIZER. The buffer is left empty and usable.
+ * @param bb the byte_buffer to release
+ */
+void byte_buffer_release (byte_buffer* bb);
+
+/**
+ * Frees memory for the byte_buffer.
+ * @param bb the byte_buffer to free
+ */
+void byte_buffer_delete (byte_buffer* bb);
 
 #endif // CONTAINER_H_
 
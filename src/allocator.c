@@ -0,0 +1,50 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#include "container.h"
+
+#include <stdlib.h>
+#include <stdatomic.h>
+
+static void* malloc_alloc (void* ctx, size_t size) {
+	return malloc (size);
+}
+
+static void* malloc_realloc (void* ctx, void* ptr, size_t size) {
+	return realloc (ptr, size);
+}
+
+static void malloc_free (void* ctx, void* ptr) {
+	free (ptr);
+}
+
+const sscont_allocator sscont_malloc_allocator = { malloc_alloc, malloc_realloc, malloc_free, NULL };
+
+static const sscont_allocator* _Atomic default_allocator = &sscont_malloc_allocator;
+
+void sscont_allocator_set_default (const sscont_allocator* allocator) {
+	atomic_store (&default_allocator, allocator != NULL ? allocator : &sscont_malloc_allocator);
+}
+
+const sscont_allocator* sscont_allocator_get_default () {
+	return atomic_load_explicit (&default_allocator, memory_order_acquire);
+}
@@ -0,0 +1,169 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#include "container.h"
+#include "debug_utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN 16
+
+/* the size of an allocation made through the allocator is kept in the word before it */
+#define SIZE_HEADER sizeof (size_t)
+
+struct sscont_arena_block {
+	sscont_arena_block* next;
+	size_t size;
+	_Alignas (ARENA_ALIGN) char data[];
+};
+
+static uintptr_t align_up (uintptr_t v) {
+	return (v + ARENA_ALIGN - 1) & ~(uintptr_t) (ARENA_ALIGN - 1);
+}
+
+/* 
+ * Finds room for size bytes, with header bytes in front of them, moving 
+ * on to the following block if the current one is full. A block too small 
+ * for the request is skipped by putting a new block in front of it, so 
+ * blocks kept by a reset are reused in order.
+ */
+static void* bump (sscont_arena* a, size_t size, size_t header) {
+	sscont_arena_block* b = a->current;
+
+	if (b != NULL) {
+		uintptr_t p = align_up ((uintptr_t) (b->data + a->offset + header));
+		if (p + size <= (uintptr_t) (b->data + b->size)) {
+			a->offset = (p + size) - (uintptr_t) b->data;
+			return (void*) p;
+		}
+	}
+
+	size_t need = size + header + ARENA_ALIGN;
+	sscont_arena_block* next = b != NULL ? b->next : a->first;
+	if (next == NULL || next->size < need) {
+		size_t bytes = need > a->block_size ? need : a->block_size;
+		sscont_arena_block* nb = malloc (sizeof (sscont_arena_block) + bytes);
+		if (nb == NULL) {
+			PERR ("malloc");
+			return NULL;
+		}
+
+		nb->size = bytes;
+		nb->next = next;
+		if (b != NULL) {
+			b->next = nb;
+		} else {
+			a->first = nb;
+		}
+		next = nb;
+	}
+
+	a->current = next;
+	a->offset = 0;
+
+	uintptr_t p = align_up ((uintptr_t) (next->data + header));
+	a->offset = (p + size) - (uintptr_t) next->data;
+
+	return (void*) p;
+}
+
+static void* arena_allocator_alloc (void* ctx, size_t size) {
+	size_t* p = bump (ctx, size, SIZE_HEADER);
+	if (p == NULL) {
+		return NULL;
+	}
+
+	p[-1] = size;
+
+	return p;
+}
+
+static void* arena_allocator_realloc (void* ctx, void* ptr, size_t size) {
+	sscont_arena* a = ctx;
+	size_t* p = ptr;
+	size_t old = p[-1];
+
+	// the latest allocation grows in place while its block has room
+	char* end = (char*) ptr + old;
+	if (size <= old || (end == a->current->data + a->offset && (char*) ptr + size <= a->current->data + a->current->size)) {
+		if (end == a->current->data + a->offset) {
+			a->offset = ((char*) ptr + size) - a->current->data;
+		}
+		p[-1] = size;
+		return ptr;
+	}
+
+	void* moved = arena_allocator_alloc (ctx, size);
+	if (moved != NULL) {
+		memcpy (moved, ptr, old);
+	}
+
+	return moved;
+}
+
+sscont_arena* sscont_arena_create (size_t block_size) {
+	sscont_arena* a = malloc (sizeof (sscont_arena));
+	if (a == NULL) {
+		PERR ("malloc");
+		return NULL;
+	}
+
+	a->first = NULL;
+	a->current = NULL;
+	a->offset = 0;
+	a->block_size = block_size > ARENA_ALIGN ? block_size : ARENA_ALIGN;
+	a->allocator = (sscont_allocator) { arena_allocator_alloc, arena_allocator_realloc, NULL, a };
+
+	return a;
+}
+
+void* sscont_arena_alloc (sscont_arena* a, size_t size) {
+	return bump (a, size, 0);
+}
+
+sscont_arena_mark sscont_arena_get_mark (sscont_arena* a) {
+	return (sscont_arena_mark) { a->current, a->offset };
+}
+
+void sscont_arena_rewind (sscont_arena* a, sscont_arena_mark mark) {
+	a->current = mark.block;
+	a->offset = mark.offset;
+}
+
+void sscont_arena_reset (sscont_arena* a) {
+	a->current = NULL;
+	a->offset = 0;
+}
+
+void sscont_arena_delete (sscont_arena* a) {
+	sscont_arena_block* b = a->first;
+	while (b != NULL) {
+		sscont_arena_block* next = b->next;
+		free (b);
+		b = next;
+	}
+
+	free (a);
+	a = NULL;
+}
@@ -21,34 +21,286 @@
 *    USA
 */
 
+#define _GNU_SOURCE
 
 #include "container.h"
 #include "debug_utils.h"
+#include "trace.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * Mapped arrays keep a small header in front of the data table so that
+ * a file backed array can be reopened with its count.
+ */
+#define MAPPED_MAGIC 0x73736361612e3031ULL
+
+typedef struct {
+	uint64_t magic;
+	uint64_t count;
+} mapped_header;
+
+static mapped_header* mapped_base (auto_array* aa) {
+	return (mapped_header*) ((char*) aa->data - sizeof (mapped_header));
+}
+
+static size_t mapped_length (size_t size) {
+	size_t page = sysconf (_SC_PAGESIZE);
+	size_t len = sizeof (mapped_header) + (size * sizeof (void*));
+
+	return ((len + page - 1) / page) * page;
+}
+
+static size_t mapped_size (size_t length) {
+	return (length - sizeof (mapped_header)) / sizeof (void*);
+}
+
+/* arrays from AUTO_ARRAY_INITIALIZER take the default allocator when they first allocate */
+static const sscont_allocator* allocator_of (auto_array* aa) {
+	if (aa->allocator == NULL) {
+		aa->allocator = sscont_allocator_get_default ();
+	}
+
+	return aa->allocator;
+}
+
+static int resize_storage (auto_array* aa, size_t s) {
+	if (aa->backing == AUTO_ARRAY_MAPPED) {
+		size_t old_len = mapped_length (aa->size);
+		size_t new_len = mapped_length (s);
+
+		if (aa->fd != -1 && ftruncate (aa->fd, new_len) == -1) {
+			PERR ("ftruncate");
+			return -1;
+		}
+
+		void* base = mremap (mapped_base (aa), old_len, new_len, MREMAP_MAYMOVE);
+		if (base == MAP_FAILED) {
+			PERR ("mremap");
+			return -1;
+		}
+
+		aa->data = (void**) ((char*) base + sizeof (mapped_header));
+		aa->size = mapped_size (new_len);
+
+		return 0;
+	}
+
+	if (aa->backing == AUTO_ARRAY_INLINE && aa->size < AUTO_ARRAY_SMALL_SIZE) {
+		aa->size = s < AUTO_ARRAY_SMALL_SIZE ? s : AUTO_ARRAY_SMALL_SIZE;
+		return 0;
+	}
+
+	if (aa->backing == AUTO_ARRAY_INLINE) {
+		void** tmp = sscont_alloc (allocator_of (aa), s * sizeof (void*));
+		if (tmp == NULL) {
+			PERR ("malloc");
+			return -1;
+		}
+
+		memcpy (tmp, aa->data, aa->count * sizeof (void*));
+		aa->data = tmp;
+		aa->size = s;
+		aa->backing = AUTO_ARRAY_HEAP;
+
+		return 0;
+	}
+
+	void* tmp;
+	if ((tmp = sscont_realloc (aa->allocator, aa->data, s * sizeof (void*))) == NULL) {
+		PERR ("realloc");
+		return -1;
+	}
+	aa->data = tmp;
+	aa->size = s;
+
+	return 0;
+}
+
+static int auto_array_resize (auto_array* aa, size_t s) {
+	size_t old_size = aa->size;
+	uint64_t start = sscont_trace_start ();
+
+	if (resize_storage (aa, s) == -1) {
+		return -1;
+	}
+
+	sscont_trace_resize ("auto_array", aa, old_size, aa->size, start);
+
+	return 0;
+}
  
 auto_array* auto_array_create (size_t initial_size) {
-	auto_array* aa = malloc (sizeof (auto_array));
+	return auto_array_create_with (initial_size, NULL);
+}
+
+auto_array* auto_array_create_with (size_t initial_size, const sscont_allocator* allocator) {
+	if (allocator == NULL) {
+		allocator = sscont_allocator_get_default ();
+	}
+
+	auto_array* aa = sscont_alloc (allocator, sizeof (auto_array));
 
 	if (aa == NULL) {
 		PERR ("malloc");
 		return NULL;
 	}
 
-	aa->data = malloc (sizeof (void*) * initial_size);
+	aa->allocator = allocator;
+
+	if (initial_size <= AUTO_ARRAY_SMALL_SIZE) {
+		aa->data = aa->small;
+		aa->size = initial_size > 0 ? initial_size : 1;
+		aa->backing = AUTO_ARRAY_INLINE;
+	} else {
+		aa->data = sscont_alloc (allocator, sizeof (void*) * initial_size);
+
+		if (aa->data == NULL) {
+			PERR ("malloc");
+			sscont_free (allocator, aa);
+			return NULL;
+		}
+
+		aa->size = initial_size;
+		aa->backing = AUTO_ARRAY_HEAP;
+	}
+
+	aa->count = 0;
+	aa->fd = -1;
+
+	return aa;
+}
 
-	if (aa->data == NULL) {
+auto_array* auto_array_create_mapped (size_t initial_size, const char* path) {
+	const sscont_allocator* allocator = sscont_allocator_get_default ();
+	auto_array* aa = sscont_alloc (allocator, sizeof (auto_array));
+
+	if (aa == NULL) {
 		PERR ("malloc");
-		free (aa);
 		return NULL;
 	}
 
-	aa->size = initial_size;
-	aa->count = 0;
+	aa->allocator = allocator;
+
+	size_t len = mapped_length (initial_size);
+	size_t count = 0;
+	int fd = -1;
+
+	if (path != NULL) {
+		fd = open (path, O_RDWR | O_CREAT, 0644);
+		if (fd == -1) {
+			PERR ("open");
+			sscont_free (allocator, aa);
+			return NULL;
+		}
+
+		struct stat st;
+		if (fstat (fd, &st) == -1) {
+			PERR ("fstat");
+			close (fd);
+			sscont_free (allocator, aa);
+			return NULL;
+		}
+
+		if (st.st_size != 0) {
+			mapped_header hdr;
+			if (st.st_size < (off_t) sizeof (mapped_header) 
+					|| pread (fd, &hdr, sizeof (hdr), 0) != sizeof (hdr) 
+					|| hdr.magic != MAPPED_MAGIC
+					|| hdr.count > mapped_size (st.st_size)) {
+				PMSG ("not an auto_array file");
+				close (fd);
+				sscont_free (allocator, aa);
+				return NULL;
+			}
+
+			count = hdr.count;
+			if ((size_t) st.st_size > len) {
+				len = mapped_length (mapped_size (st.st_size));
+			}
+		}
+
+		if (ftruncate (fd, len) == -1) {
+			PERR ("ftruncate");
+			close (fd);
+			sscont_free (allocator, aa);
+			return NULL;
+		}
+	}
+
+	void* base;
+	if (fd == -1) {
+		base = mmap (NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	} else {
+		base = mmap (NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+
+	if (base == MAP_FAILED) {
+		PERR ("mmap");
+		if (fd != -1) {
+			close (fd);
+		}
+		sscont_free (allocator, aa);
+		return NULL;
+	}
+
+	mapped_header* hdr = base;
+	hdr->magic = MAPPED_MAGIC;
+	hdr->count = count;
+
+	aa->data = (void**) ((char*) base + sizeof (mapped_header));
+	aa->size = mapped_size (len);
+	aa->count = count;
+	aa->backing = AUTO_ARRAY_MAPPED;
+	aa->fd = fd;
 
 	return aa;
 }
 
+int auto_array_advise (auto_array* aa, int advice) {
+	if (aa->backing != AUTO_ARRAY_MAPPED) {
+		return -1;
+	}
+
+	int madv;
+	switch (advice) {
+		case AUTO_ARRAY_ADVICE_NORMAL: madv = MADV_NORMAL; break;
+		case AUTO_ARRAY_ADVICE_SEQUENTIAL: madv = MADV_SEQUENTIAL; break;
+		case AUTO_ARRAY_ADVICE_RANDOM: madv = MADV_RANDOM; break;
+		default:
+			PMSG ("unknown advice");
+			return -1;
+	}
+
+	if (madvise (mapped_base (aa), mapped_length (aa->size), madv) == -1) {
+		PERR ("madvise");
+		return -1;
+	}
+
+	return 0;
+}
+
+int auto_array_sync (auto_array* aa) {
+	if (aa->backing != AUTO_ARRAY_MAPPED || aa->fd == -1) {
+		return 0;
+	}
+
+	mapped_header* hdr = mapped_base (aa);
+	hdr->count = aa->count;
+
+	if (msync (hdr, mapped_length (aa->size), MS_SYNC) == -1) {
+		PERR ("msync");
+		return -1;
+	}
+
+	return 0;
+}
+
 ssize_t auto_array_add (auto_array* aa, void* data) {
 	return auto_array_put (aa, aa->count, data);
 }
@@ -59,14 +311,9 @@ ssize_t auto_array_put (auto_array* aa, size_t pos, void* data) {
 	}
 
 	if (pos == (aa->size)) {
-		size_t s = aa->size * 2;
-		void* tmp;
-		if ((tmp = realloc (aa->data, s * sizeof (void*))) == NULL) {
-			PERR ("realloc");
+		if (auto_array_resize (aa, aa->size * 2) == -1) {
 			return 0;
 		}
-		aa->data = tmp;
-		aa->size = s;
 	}
 
 	aa->data[pos] = data;
@@ -111,25 +358,17 @@ void* auto_array_remove (auto_array* aa, size_t pos) {
 }
 
 ssize_t auto_array_insert (auto_array* aa, size_t pos, void* data) {
-	if (pos >= aa->count) {
+	if (pos > aa->count) {
 		return -1;
 	}
 
-	if ((aa->count + 1) == aa->size) {
-		void* tmp;
-		size_t s = aa->size * 2;
-		if ((tmp = realloc (aa->data, s * sizeof (void*))) == NULL) {
-			PERR ("realloc");
+	if (aa->count == aa->size) {
+		if (auto_array_resize (aa, aa->size * 2) == -1) {
 			return -1;
 		}
-		aa->data = tmp;
-		aa->size = s;
 	}
 
-	
-	for (size_t i = aa->count; i >= pos; --i) {
-		aa->data[i + 1] = aa->data[i];
-	}
+	memmove (aa->data + pos + 1, aa->data + pos, (aa->count - pos) * sizeof (void*));
 	
 	aa->data[pos] = data;
 
@@ -138,15 +377,34 @@ ssize_t auto_array_insert (auto_array* aa, size_t pos, void* data) {
 	return aa->count;
 }
 
-void auto_array_delete (auto_array* aa, void (*delete_entry)(void* entry)) {
+void auto_array_release (auto_array* aa, void (*delete_entry)(void* entry)) {
 	if (delete_entry != NULL)  {
 		for (size_t i = aa->count; i > 0; --i) {
 			delete_entry (aa->data[i - 1]);
 		}
 	}
 
-	free (aa->data);
-	free (aa);
+	if (aa->backing == AUTO_ARRAY_MAPPED) {
+		auto_array_sync (aa);
+		munmap (mapped_base (aa), mapped_length (aa->size));
+		if (aa->fd != -1) {
+			close (aa->fd);
+		}
+	} else if (aa->backing == AUTO_ARRAY_HEAP) {
+		sscont_free (aa->allocator, aa->data);
+	}
+
+	aa->data = aa->small;
+	aa->size = AUTO_ARRAY_SMALL_SIZE;
+	aa->count = 0;
+	aa->backing = AUTO_ARRAY_INLINE;
+	aa->fd = -1;
+}
+
+void auto_array_delete (auto_array* aa, void (*delete_entry)(void* entry)) {
+	auto_array_release (aa, delete_entry);
+
+	sscont_free (aa->allocator, aa);
 	aa = NULL;
 }
 
@@ -0,0 +1,331 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#include "container.h"
+#include "debug_utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined (__x86_64__)
+#include <immintrin.h>
+#define BITSET_X86 1
+#endif
+
+#define WORD_BITS 64
+#define WORDS(bits) (((bits) + WORD_BITS - 1) / WORD_BITS)
+
+/*
+ * The bulk operations have scalar, SSE2 and AVX2 kernels. SSE2 is part of
+ * the x86_64 baseline, AVX2 is selected at load time if the cpu has it.
+ */
+
+typedef void (*bulk_kernel) (uint64_t* dst, const uint64_t* src, size_t words);
+
+static void and_scalar (uint64_t* dst, const uint64_t* src, size_t words) {
+	for (size_t i = 0; i < words; ++i) {
+		dst[i] &= src[i];
+	}
+}
+
+static void or_scalar (uint64_t* dst, const uint64_t* src, size_t words) {
+	for (size_t i = 0; i < words; ++i) {
+		dst[i] |= src[i];
+	}
+}
+
+static void xor_scalar (uint64_t* dst, const uint64_t* src, size_t words) {
+	for (size_t i = 0; i < words; ++i) {
+		dst[i] ^= src[i];
+	}
+}
+
+static void andnot_scalar (uint64_t* dst, const uint64_t* src, size_t words) {
+	for (size_t i = 0; i < words; ++i) {
+		dst[i] &= ~src[i];
+	}
+}
+
+static size_t count_scalar (const uint64_t* bits, size_t words) {
+	size_t n = 0;
+
+	for (size_t i = 0; i < words; ++i) {
+		n += __builtin_popcountll (bits[i]);
+	}
+
+	return n;
+}
+
+#ifdef BITSET_X86
+
+/*
+ * dst = op (dst, src) for 2 words per step, with the scalar kernel
+ * finishing the tail. _mm_andnot_si128 computes ~a & b, hence the swap.
+ */
+#define SSE2_KERNEL(name, op, tail) \
+static void name (uint64_t* dst, const uint64_t* src, size_t words) { \
+	size_t i = 0; \
+	for (; i + 2 <= words; i += 2) { \
+		__m128i d = _mm_loadu_si128 ((const __m128i*) (dst + i)); \
+		__m128i s = _mm_loadu_si128 ((const __m128i*) (src + i)); \
+		_mm_storeu_si128 ((__m128i*) (dst + i), op); \
+	} \
+	tail (dst + i, src + i, words - i); \
+}
+
+SSE2_KERNEL (and_sse2, _mm_and_si128 (d, s), and_scalar)
+SSE2_KERNEL (or_sse2, _mm_or_si128 (d, s), or_scalar)
+SSE2_KERNEL (xor_sse2, _mm_xor_si128 (d, s), xor_scalar)
+SSE2_KERNEL (andnot_sse2, _mm_andnot_si128 (s, d), andnot_scalar)
+
+/* as above with 4 words per step, unrolled twice */
+#define AVX2_KERNEL(name, op, tail) \
+__attribute__ ((target ("avx2"))) \
+static void name (uint64_t* dst, const uint64_t* src, size_t words) { \
+	size_t i = 0; \
+	for (; i + 8 <= words; i += 8) { \
+		__m256i d = _mm256_loadu_si256 ((const __m256i*) (dst + i)); \
+		__m256i s = _mm256_loadu_si256 ((const __m256i*) (src + i)); \
+		_mm256_storeu_si256 ((__m256i*) (dst + i), op); \
+		d = _mm256_loadu_si256 ((const __m256i*) (dst + i + 4)); \
+		s = _mm256_loadu_si256 ((const __m256i*) (src + i + 4)); \
+		_mm256_storeu_si256 ((__m256i*) (dst + i + 4), op); \
+	} \
+	tail (dst + i, src + i, words - i); \
+}
+
+AVX2_KERNEL (and_avx2, _mm256_and_si256 (d, s), and_sse2)
+AVX2_KERNEL (or_avx2, _mm256_or_si256 (d, s), or_sse2)
+AVX2_KERNEL (xor_avx2, _mm256_xor_si256 (d, s), xor_sse2)
+AVX2_KERNEL (andnot_avx2, _mm256_andnot_si256 (s, d), andnot_sse2)
+
+__attribute__ ((target ("popcnt")))
+static size_t count_popcnt (const uint64_t* bits, size_t words) {
+	size_t n = 0;
+
+	for (size_t i = 0; i < words; ++i) {
+		n += __builtin_popcountll (bits[i]);
+	}
+
+	return n;
+}
+
+/* counts the bits of each nibble with a shuffle lookup and sums the bytes with sad */
+__attribute__ ((target ("avx2,popcnt")))
+static size_t count_avx2 (const uint64_t* bits, size_t words) {
+	const __m256i lookup = _mm256_setr_epi8 (
+			0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+			0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i low_mask = _mm256_set1_epi8 (0x0f);
+	__m256i acc = _mm256_setzero_si256 ();
+	size_t i = 0;
+
+	for (; i + 4 <= words; i += 4) {
+		__m256i v = _mm256_loadu_si256 ((const __m256i*) (bits + i));
+		__m256i lo = _mm256_and_si256 (v, low_mask);
+		__m256i hi = _mm256_and_si256 (_mm256_srli_epi16 (v, 4), low_mask);
+		__m256i cnt = _mm256_add_epi8 (_mm256_shuffle_epi8 (lookup, lo), _mm256_shuffle_epi8 (lookup, hi));
+		acc = _mm256_add_epi64 (acc, _mm256_sad_epu8 (cnt, _mm256_setzero_si256 ()));
+	}
+
+	size_t n = _mm256_extract_epi64 (acc, 0) + _mm256_extract_epi64 (acc, 1)
+		+ _mm256_extract_epi64 (acc, 2) + _mm256_extract_epi64 (acc, 3);
+
+	return n + count_popcnt (bits + i, words - i);
+}
+
+#endif // BITSET_X86
+
+static struct {
+	bulk_kernel and_op;
+	bulk_kernel or_op;
+	bulk_kernel xor_op;
+	bulk_kernel andnot_op;
+	size_t (*count) (const uint64_t*, size_t);
+} kernels = { and_scalar, or_scalar, xor_scalar, andnot_scalar, count_scalar };
+
+__attribute__ ((constructor))
+static void select_kernels () {
+#ifdef BITSET_X86
+	__builtin_cpu_init ();
+
+	kernels.and_op = and_sse2;
+	kernels.or_op = or_sse2;
+	kernels.xor_op = xor_sse2;
+	kernels.andnot_op = andnot_sse2;
+
+	if (__builtin_cpu_supports ("popcnt")) {
+		kernels.count = count_popcnt;
+	}
+
+	if (__builtin_cpu_supports ("avx2")) {
+		kernels.and_op = and_avx2;
+		kernels.or_op = or_avx2;
+		kernels.xor_op = xor_avx2;
+		kernels.andnot_op = andnot_avx2;
+		kernels.count = count_avx2;
+	}
+#endif
+}
+
+static int bitset_resize (bitset* bs, size_t size) {
+	size_t words = WORDS (size);
+
+	if (words > bs->words) {
+		size_t s = bs->words * 2 > words ? bs->words * 2 : words;
+		uint64_t* tmp = realloc (bs->bits, s * sizeof (uint64_t));
+		if (tmp == NULL) {
+			PERR ("realloc");
+			return -1;
+		}
+
+		memset (tmp + bs->words, 0, (s - bs->words) * sizeof (uint64_t));
+		bs->bits = tmp;
+		bs->words = s;
+	}
+
+	if (size > bs->size) {
+		bs->size = size;
+	}
+
+	return 0;
+}
+
+bitset* bitset_create (size_t size) {
+	bitset* bs = malloc (sizeof (bitset));
+	if (bs == NULL) {
+		PERR ("malloc");
+		return NULL;
+	}
+
+	bs->words = WORDS (size) > 0 ? WORDS (size) : 1;
+	bs->bits = calloc (bs->words, sizeof (uint64_t));
+	if (bs->bits == NULL) {
+		PERR ("calloc");
+		free (bs);
+		return NULL;
+	}
+
+	bs->size = size;
+
+	return bs;
+}
+
+int bitset_set (bitset* bs, size_t bit) {
+	if (bit >= bs->size && bitset_resize (bs, bit + 1) == -1) {
+		return -1;
+	}
+
+	bs->bits[bit / WORD_BITS] |= 1ULL << (bit % WORD_BITS);
+
+	return 0;
+}
+
+void bitset_clear (bitset* bs, size_t bit) {
+	if (bit < bs->size) {
+		bs->bits[bit / WORD_BITS] &= ~(1ULL << (bit % WORD_BITS));
+	}
+}
+
+int bitset_test (bitset* bs, size_t bit) {
+	if (bit >= bs->size) {
+		return 0;
+	}
+
+	return (bs->bits[bit / WORD_BITS] >> (bit % WORD_BITS)) & 1;
+}
+
+size_t bitset_count (bitset* bs) {
+	return kernels.count (bs->bits, WORDS (bs->size));
+}
+
+ssize_t bitset_next (bitset* bs, size_t bit) {
+	if (bit >= bs->size) {
+		return -1;
+	}
+
+	size_t w = bit / WORD_BITS;
+	size_t words = WORDS (bs->size);
+	uint64_t word = bs->bits[w] & (~0ULL << (bit % WORD_BITS));
+
+	while (word == 0) {
+		if (++w == words) {
+			return -1;
+		}
+		word = bs->bits[w];
+	}
+
+	return (w * WORD_BITS) + __builtin_ctzll (word);
+}
+
+ssize_t bitset_first (bitset* bs) {
+	return bitset_next (bs, 0);
+}
+
+/*
+ * Bits past the end of the shorter bitset are treated as clear, so
+ * and clears the tail of dst while or and xor copy the tail of src.
+ */
+static int bulk (bitset* dst, bitset* src, bulk_kernel kernel, int grow) {
+	size_t dst_words = WORDS (dst->size);
+	size_t src_words = WORDS (src->size);
+
+	if (grow && src->size > dst->size) {
+		if (bitset_resize (dst, src->size) == -1) {
+			return -1;
+		}
+		dst_words = WORDS (dst->size);
+	}
+
+	size_t common = dst_words < src_words ? dst_words : src_words;
+
+	kernel (dst->bits, src->bits, common);
+
+	if (kernel == kernels.and_op && dst_words > common) {
+		memset (dst->bits + common, 0, (dst_words - common) * sizeof (uint64_t));
+	}
+
+	return 0;
+}
+
+int bitset_and (bitset* dst, bitset* src) {
+	return bulk (dst, src, kernels.and_op, 0);
+}
+
+int bitset_or (bitset* dst, bitset* src) {
+	return bulk (dst, src, kernels.or_op, 1);
+}
+
+int bitset_xor (bitset* dst, bitset* src) {
+	return bulk (dst, src, kernels.xor_op, 1);
+}
+
+int bitset_andnot (bitset* dst, bitset* src) {
+	return bulk (dst, src, kernels.andnot_op, 0);
+}
+
+void bitset_delete (bitset* bs) {
+	free (bs->bits);
+	free (bs);
+	bs = NULL;
+}
@@ -0,0 +1,430 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#include "container.h"
+#include "debug_utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined (__x86_64__)
+#include <immintrin.h>
+#define BYTE_BUFFER_X86 1
+#endif
+
+#define VARINT_MAX_BYTES 10
+
+byte_buffer* byte_buffer_create (size_t initial_size) {
+	byte_buffer* bb = malloc (sizeof (byte_buffer));
+	if (bb == NULL) {
+		PERR ("malloc");
+		return NULL;
+	}
+
+	*bb = (byte_buffer) BYTE_BUFFER_INITIALIZER;
+
+	if (initial_size > 0 && byte_buffer_reserve (bb, initial_size) == NULL) {
+		free (bb);
+		return NULL;
+	}
+
+	return bb;
+}
+
+/* makes room for n more bytes */
+static int byte_buffer_grow (byte_buffer* bb, size_t n) {
+	if (bb->size - bb->count >= n) {
+		return 0;
+	}
+
+	size_t sz = bb->size == 0 ? 64 : 2 * bb->size;
+	if (sz - bb->count < n) {
+		sz = bb->count + (2 * n);
+	}
+
+	uint8_t* tmp = realloc (bb->buf, sz);
+	if (tmp == NULL) {
+		PERR ("realloc");
+		return -1;
+	}
+
+	bb->buf = tmp;
+	bb->size = sz;
+
+	return 0;
+}
+
+byte_buffer* byte_buffer_reserve (byte_buffer* bb, size_t n) {
+	return byte_buffer_grow (bb, n) == -1 ? NULL : bb;
+}
+
+byte_buffer* byte_buffer_append (byte_buffer* bb, const void* data, size_t n) {
+	if (byte_buffer_grow (bb, n) == -1) {
+		return NULL;
+	}
+
+	if (n > 0) {
+		memcpy (bb->buf + bb->count, data, n);
+		bb->count += n;
+	}
+
+	return bb;
+}
+
+/* fixed width values are little endian, so big endian hosts swap them */
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define LE16(v) __builtin_bswap16 (v)
+#define LE32(v) __builtin_bswap32 (v)
+#define LE64(v) __builtin_bswap64 (v)
+#else
+#define LE16(v) (v)
+#define LE32(v) (v)
+#define LE64(v) (v)
+#endif
+
+static inline byte_buffer* put_fixed (byte_buffer* bb, const void* v, size_t bytes) {
+	if (byte_buffer_grow (bb, bytes) == -1) {
+		return NULL;
+	}
+
+	memcpy (bb->buf + bb->count, v, bytes);
+	bb->count += bytes;
+
+	return bb;
+}
+
+byte_buffer* byte_buffer_put_u8 (byte_buffer* bb, uint8_t v) {
+	return put_fixed (bb, &v, 1);
+}
+
+byte_buffer* byte_buffer_put_u16 (byte_buffer* bb, uint16_t v) {
+	uint16_t le = LE16 (v);
+	return put_fixed (bb, &le, 2);
+}
+
+byte_buffer* byte_buffer_put_u32 (byte_buffer* bb, uint32_t v) {
+	uint32_t le = LE32 (v);
+	return put_fixed (bb, &le, 4);
+}
+
+byte_buffer* byte_buffer_put_u64 (byte_buffer* bb, uint64_t v) {
+	uint64_t le = LE64 (v);
+	return put_fixed (bb, &le, 8);
+}
+
+static size_t encode_varint (uint8_t* p, uint64_t v) {
+	size_t n = 0;
+
+	while (v >= 0x80) {
+		p[n++] = (uint8_t) v | 0x80;
+		v >>= 7;
+	}
+	p[n++] = (uint8_t) v;
+
+	return n;
+}
+
+byte_buffer* byte_buffer_put_varint (byte_buffer* bb, uint64_t v) {
+	if (byte_buffer_grow (bb, VARINT_MAX_BYTES) == -1) {
+		return NULL;
+	}
+
+	bb->count += encode_varint (bb->buf + bb->count, v);
+
+	return bb;
+}
+
+byte_buffer* byte_buffer_put_svarint (byte_buffer* bb, int64_t v) {
+	return byte_buffer_put_varint (bb, ((uint64_t) v << 1) ^ (uint64_t) (v >> 63));
+}
+
+byte_buffer* byte_buffer_put_varints (byte_buffer* bb, const uint64_t* values, size_t n) {
+	if (byte_buffer_grow (bb, n * VARINT_MAX_BYTES) == -1) {
+		return NULL;
+	}
+
+	uint8_t* p = bb->buf + bb->count;
+	for (size_t i = 0; i < n; ++i) {
+		p += encode_varint (p, values[i]);
+	}
+	bb->count = p - bb->buf;
+
+	return bb;
+}
+
+byte_buffer* byte_buffer_put_bytes (byte_buffer* bb, const void* data, size_t n) {
+	if (byte_buffer_grow (bb, VARINT_MAX_BYTES + n) == -1) {
+		return NULL;
+	}
+
+	bb->count += encode_varint (bb->buf + bb->count, n);
+	if (n > 0) {
+		memcpy (bb->buf + bb->count, data, n);
+		bb->count += n;
+	}
+
+	return bb;
+}
+
+size_t byte_buffer_remaining (byte_buffer* bb) {
+	return bb->count - bb->pos;
+}
+
+static inline int get_fixed (byte_buffer* bb, void* v, size_t bytes) {
+	if (bb->count - bb->pos < bytes) {
+		return -1;
+	}
+
+	memcpy (v, bb->buf + bb->pos, bytes);
+	bb->pos += bytes;
+
+	return 0;
+}
+
+int byte_buffer_get_u8 (byte_buffer* bb, uint8_t* v) {
+	return get_fixed (bb, v, 1);
+}
+
+int byte_buffer_get_u16 (byte_buffer* bb, uint16_t* v) {
+	if (get_fixed (bb, v, 2) == -1) {
+		return -1;
+	}
+	*v = LE16 (*v);
+
+	return 0;
+}
+
+int byte_buffer_get_u32 (byte_buffer* bb, uint32_t* v) {
+	if (get_fixed (bb, v, 4) == -1) {
+		return -1;
+	}
+	*v = LE32 (*v);
+
+	return 0;
+}
+
+int byte_buffer_get_u64 (byte_buffer* bb, uint64_t* v) {
+	if (get_fixed (bb, v, 8) == -1) {
+		return -1;
+	}
+	*v = LE64 (*v);
+
+	return 0;
+}
+
+/*
+ * Decodes a varint of at most VARINT_MAX_BYTES from p, which has n bytes.
+ * Returns the bytes used, 0 if the varint is cut short by the end and -1
+ * if it is too long.
+ */
+static int decode_varint (const uint8_t* p, size_t n, uint64_t* v) {
+	uint64_t result = 0;
+	size_t max = n < VARINT_MAX_BYTES ? n : VARINT_MAX_BYTES;
+
+	for (size_t i = 0; i < max; ++i) {
+		result |= (uint64_t) (p[i] & 0x7f) << (7 * i);
+		if ((p[i] & 0x80) == 0) {
+			// the 10th byte only has room for the 64th bit
+			if (i == VARINT_MAX_BYTES - 1 && p[i] > 1) {
+				return -1;
+			}
+			*v = result;
+			return i + 1;
+		}
+	}
+
+	return max == VARINT_MAX_BYTES ? -1 : 0;
+}
+
+int byte_buffer_get_varint (byte_buffer* bb, uint64_t* v) {
+	if (bb->pos == bb->count) {
+		return -1;
+	}
+
+	// most values are a single byte
+	const uint8_t* p = bb->buf + bb->pos;
+	if (p[0] < 0x80) {
+		*v = p[0];
+		bb->pos++;
+		return 0;
+	}
+
+	int len = decode_varint (p, bb->count - bb->pos, v);
+	if (len <= 0) {
+		if (len == -1) {
+			PMSG ("Corrupt varint");
+		}
+		return -1;
+	}
+	bb->pos += len;
+
+	return 0;
+}
+
+int byte_buffer_get_svarint (byte_buffer* bb, int64_t* v) {
+	uint64_t u;
+	if (byte_buffer_get_varint (bb, &u) == -1) {
+		return -1;
+	}
+	*v = (int64_t) (u >> 1) ^ -(int64_t) (u & 1);
+
+	return 0;
+}
+
+int byte_buffer_get_bytes (byte_buffer* bb, string_view* out) {
+	size_t start = bb->pos;
+	uint64_t n;
+
+	if (byte_buffer_get_varint (bb, &n) == -1) {
+		return -1;
+	}
+
+	if (n > bb->count - bb->pos) {
+		bb->pos = start;
+		return -1;
+	}
+
+	*out = string_view_of ((const char*) bb->buf + bb->pos, n);
+	bb->pos += n;
+
+	return 0;
+}
+
+static size_t get_varints_scalar (const uint8_t* p, size_t size, uint64_t* values, size_t n, size_t* used) {
+	size_t pos = 0;
+	size_t i = 0;
+
+	for (; i < n; ++i) {
+		int len = decode_varint (p + pos, size - pos, &values[i]);
+		if (len <= 0) {
+			break;
+		}
+		pos += len;
+	}
+
+	*used = pos;
+
+	return i;
+}
+
+#ifdef BYTE_BUFFER_X86
+
+/*
+ * The continuation bits of 16 bytes are gathered with movemask. With none
+ * set the bytes are 16 values, widened 4 at a time, otherwise each varint 
+ * that ends in the next 8 bytes has its 7 bit groups packed with pext.
+ */
+__attribute__ ((target ("avx2,bmi,bmi2")))
+static size_t get_varints_avx2 (const uint8_t* p, size_t size, uint64_t* values, size_t n, size_t* used) {
+	const uint64_t low7 = 0x7f7f7f7f7f7f7f7fULL;
+	size_t pos = 0;
+	size_t i = 0;
+
+	while (i < n && size - pos >= 16) {
+		unsigned mask = _mm_movemask_epi8 (_mm_loadu_si128 ((const __m128i*) (p + pos)));
+
+		if (mask == 0 && n - i >= 16) {
+			for (int q = 0; q < 16; q += 4) {
+				uint32_t four;
+				memcpy (&four, p + pos + q, 4);
+				_mm256_storeu_si256 ((__m256i*) (values + i + q), _mm256_cvtepu8_epi64 (_mm_cvtsi32_si128 (four)));
+			}
+			pos += 16;
+			i += 16;
+			continue;
+		}
+
+		uint64_t word;
+		memcpy (&word, p + pos, 8);
+		unsigned len = _tzcnt_u32 (~mask) + 1;
+		if (len > 8) {
+			// 9 and 10 byte varints, with the 10th byte only holding the 64th bit
+			if (len > VARINT_MAX_BYTES || (len == VARINT_MAX_BYTES && p[pos + 9] > 1)) {
+				break;
+			}
+			uint64_t v = _pext_u64 (word, low7) | (uint64_t) (p[pos + 8] & 0x7f) << 56;
+			if (len == VARINT_MAX_BYTES) {
+				v |= (uint64_t) p[pos + 9] << 63;
+			}
+			values[i++] = v;
+			pos += len;
+			continue;
+		}
+
+		unsigned consumed = 0;
+		while (len <= 8 - consumed && i < n) {
+			uint64_t bytes = len == 8 ? ~0ULL : (1ULL << (8 * len)) - 1;
+			values[i++] = _pext_u64 (word >> (8 * consumed), low7 & bytes);
+			consumed += len;
+			len = _tzcnt_u32 (~(mask >> consumed)) + 1;
+		}
+		pos += consumed;
+	}
+
+	size_t tail_used;
+	i += get_varints_scalar (p + pos, size - pos, values + i, n - i, &tail_used);
+	*used = pos + tail_used;
+
+	return i;
+}
+
+#endif // BYTE_BUFFER_X86
+
+static size_t (*get_varints_kernel) (const uint8_t*, size_t, uint64_t*, size_t, size_t*) = get_varints_scalar;
+
+__attribute__ ((constructor))
+static void select_kernels () {
+#ifdef BYTE_BUFFER_X86
+	__builtin_cpu_init ();
+
+	if (__builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("bmi2")) {
+		get_varints_kernel = get_varints_avx2;
+	}
+#endif
+}
+
+size_t byte_buffer_get_varints (byte_buffer* bb, uint64_t* values, size_t n) {
+	if (bb->pos == bb->count) {
+		return 0;
+	}
+
+	size_t used;
+	size_t decoded = get_varints_kernel (bb->buf + bb->pos, bb->count - bb->pos, values, n, &used);
+	bb->pos += used;
+
+	return decoded;
+}
+
+void byte_buffer_clear (byte_buffer* bb) {
+	bb->count = 0;
+	bb->pos = 0;
+}
+
+void byte_buffer_release (byte_buffer* bb) {
+	free (bb->buf);
+	*bb = (byte_buffer) BYTE_BUFFER_INITIALIZER;
+}
+
+void byte_buffer_delete (byte_buffer* bb) {
+	free (bb->buf);
+	free (bb);
+}
@@ -0,0 +1,271 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+
+/*
+ * Position pos lives in segment k at offset o where pos + first_size is
+ * (first_size << k) + o, so the segment is found from the position's
+ * highest set bit and no segment is ever copied. Behind the items of each
+ * segment is a bitmap of the slots that have been written. After writing
+ * its slots a producer sets their bits and moves count past the run of set
+ * bits that follows it, so no producer waits for another; a slow producer
+ * only holds back the count, and whoever sets the last missing bit moves it.
+ */
+
+#define MIN_SHIFT 4
+#define MAX_SHIFT 32
+
+static size_t segment_size (concurrent_array* ca, size_t k) {
+	return (size_t) 1 << (ca->shift + k);
+}
+
+static size_t segment_of (concurrent_array* ca, size_t pos, size_t* offset) {
+	size_t j = pos + ((size_t) 1 << ca->shift);
+	unsigned top = 63 - __builtin_clzll (j);
+
+	*offset = j - ((size_t) 1 << top);
+
+	return top - ca->shift;
+}
+
+static _Atomic uint64_t* ready_bits (concurrent_array* ca, size_t k, void** seg) {
+	return (_Atomic uint64_t*) (seg + segment_size (ca, k));
+}
+
+/* the producers that need a missing segment race to install one, the losers free theirs */
+static void** segment (concurrent_array* ca, size_t k) {
+	void** seg = atomic_load_explicit (&ca->segments[k], memory_order_acquire);
+	if (seg != NULL) {
+		return seg;
+	}
+
+	size_t words = (segment_size (ca, k) + 63) / 64;
+	void** fresh = sscont_alloc (ca->allocator, (segment_size (ca, k) * sizeof (void*)) + (words * sizeof (uint64_t)));
+	if (fresh == NULL) {
+		PERR ("malloc");
+		return NULL;
+	}
+
+	_Atomic uint64_t* ready = ready_bits (ca, k, fresh);
+	for (size_t w = 0; w < words; ++w) {
+		atomic_init (&ready[w], 0);
+	}
+
+	if (!atomic_compare_exchange_strong_explicit (&ca->segments[k], &seg, fresh, memory_order_acq_rel, memory_order_acquire)) {
+		sscont_free (ca->allocator, fresh);
+		return seg;
+	}
+
+	return fresh;
+}
+
+/* marks [offset, offset + n) of segment k written, n doesn't cross the segment */
+static void mark_ready (concurrent_array* ca, size_t k, void** seg, size_t offset, size_t n) {
+	_Atomic uint64_t* ready = ready_bits (ca, k, seg);
+
+	while (n > 0) {
+		size_t bit = offset % 64;
+		size_t run = 64 - bit < n ? 64 - bit : n;
+		uint64_t mask = (run == 64 ? UINT64_MAX : ((((uint64_t) 1) << run) - 1)) << bit;
+
+		atomic_fetch_or (&ready[offset / 64], mask);
+		offset += run;
+		n -= run;
+	}
+}
+
+/* moves count to the end of the run of written slots that starts at it */
+static void advance (concurrent_array* ca) {
+	size_t count = atomic_load (&ca->count);
+	size_t pos = count;
+
+	for (;;) {
+		size_t offset;
+		size_t k = segment_of (ca, pos, &offset);
+		void** seg = k < CONCURRENT_ARRAY_SEGMENTS ? atomic_load (&ca->segments[k]) : NULL;
+		if (seg == NULL) {
+			break;
+		}
+
+		size_t bit = offset % 64;
+		size_t limit = segment_size (ca, k) - offset;
+		if (limit > 64 - bit) {
+			limit = 64 - bit;
+		}
+
+		uint64_t unwritten = ~(atomic_load (&ready_bits (ca, k, seg)[offset / 64]) >> bit);
+		size_t run = unwritten == 0 ? 64 : __builtin_ctzll (unwritten);
+		if (run > limit) {
+			run = limit;
+		}
+
+		pos += run;
+		if (run < limit) {
+			break;
+		}
+	}
+
+	while (pos > count && !atomic_compare_exchange_weak (&ca->count, &count, pos)) {
+	}
+}
+
+concurrent_array* concurrent_array_create (size_t first_size) {
+	return concurrent_array_create_with (first_size, NULL);
+}
+
+concurrent_array* concurrent_array_create_with (size_t first_size, const sscont_allocator* allocator) {
+	if (allocator == NULL) {
+		allocator = sscont_allocator_get_default ();
+	}
+
+	concurrent_array* ca = sscont_alloc (allocator, sizeof (concurrent_array));
+	if (ca == NULL) {
+		PERR ("malloc");
+		return NULL;
+	}
+
+	for (size_t k = 0; k < CONCURRENT_ARRAY_SEGMENTS; ++k) {
+		atomic_init (&ca->segments[k], NULL);
+	}
+	atomic_init (&ca->reserved, 0);
+	atomic_init (&ca->count, 0);
+	atomic_init (&ca->failed, 0);
+	ca->allocator = allocator;
+
+	ca->shift = MIN_SHIFT;
+	while (ca->shift < MAX_SHIFT && ((size_t) 1 << ca->shift) < first_size) {
+		ca->shift++;
+	}
+
+	return ca;
+}
+
+ssize_t concurrent_array_add (concurrent_array* ca, void* item) {
+	return concurrent_array_add_items (ca, &item, 1);
+}
+
+ssize_t concurrent_array_add_items (concurrent_array* ca, void** items, size_t n) {
+	if (atomic_load_explicit (&ca->failed, memory_order_relaxed)) {
+		return -1;
+	}
+
+	size_t pos = atomic_fetch_add_explicit (&ca->reserved, n, memory_order_relaxed);
+
+	for (size_t done = 0; done < n;) {
+		size_t offset;
+		size_t k = segment_of (ca, pos + done, &offset);
+		void** seg = NULL;
+
+		if (k >= CONCURRENT_ARRAY_SEGMENTS) {
+			PMSG ("concurrent_array is full");
+		} else {
+			seg = segment (ca, k);
+		}
+
+		if (seg == NULL) {
+			atomic_store (&ca->failed, 1);
+			return -1;
+		}
+
+		size_t chunk = segment_size (ca, k) - offset;
+		if (chunk > n - done) {
+			chunk = n - done;
+		}
+
+		memcpy (seg + offset, items + done, chunk * sizeof (void*));
+		mark_ready (ca, k, seg, offset, chunk);
+		done += chunk;
+	}
+
+	advance (ca);
+
+	return pos;
+}
+
+size_t concurrent_array_count (concurrent_array* ca) {
+	return atomic_load_explicit (&ca->count, memory_order_acquire);
+}
+
+void* concurrent_array_get (concurrent_array* ca, size_t pos) {
+	if (pos >= concurrent_array_count (ca)) {
+		return NULL;
+	}
+
+	size_t offset;
+	size_t k = segment_of (ca, pos, &offset);
+
+	return atomic_load_explicit (&ca->segments[k], memory_order_relaxed)[offset];
+}
+
+auto_array* concurrent_array_seal (concurrent_array* ca) {
+	size_t count = concurrent_array_count (ca);
+
+	auto_array* aa = auto_array_create_with (count, ca->allocator);
+	if (aa == NULL) {
+		PMSG ("auto_array_create failed");
+		return NULL;
+	}
+
+	for (size_t k = 0, pos = 0; pos < count; ++k) {
+		size_t chunk = segment_size (ca, k);
+		if (chunk > count - pos) {
+			chunk = count - pos;
+		}
+
+		memcpy (aa->data + pos, atomic_load (&ca->segments[k]), chunk * sizeof (void*));
+		pos += chunk;
+	}
+	aa->count = count;
+
+	concurrent_array_delete (ca, NULL);
+
+	return aa;
+}
+
+void concurrent_array_delete (concurrent_array* ca, void (*delete_entry)(void* entry)) {
+	size_t count = concurrent_array_count (ca);
+
+	// segments may be installed out of order, so each one's first position comes from k
+	for (size_t k = 0; k < CONCURRENT_ARRAY_SEGMENTS; ++k) {
+		void** seg = atomic_load (&ca->segments[k]);
+		if (seg == NULL) {
+			continue;
+		}
+
+		size_t first = segment_size (ca, k) - ((size_t) 1 << ca->shift);
+		for (size_t i = 0; delete_entry != NULL && i < segment_size (ca, k) && first + i < count; ++i) {
+			delete_entry (seg[i]);
+		}
+
+		sscont_free (ca->allocator, seg);
+	}
+
+	sscont_free (ca->allocator, ca);
+}
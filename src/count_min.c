@@ -0,0 +1,154 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#include "container.h"
+#include "debug_utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Each row is indexed by a different combination of the two halves of the
+ * item's 64 bit hash, h1 + row * h2, so an item is hashed once however 
+ * deep the sketch is. h2 is odd, so an item's counters move from row to
+ * row relative to h1 in a power of 2 width.
+ */
+
+count_min* count_min_create (size_t width, size_t depth) {
+	if (width == 0 || depth == 0 || depth > COUNT_MIN_MAX_DEPTH) {
+		PMSG ("count_min dimensions out of range");
+		return NULL;
+	}
+
+	size_t w = 1;
+	while (w < width) {
+		w *= 2;
+	}
+
+	count_min* cm = malloc (sizeof (count_min));
+	if (cm == NULL) {
+		PERR ("malloc");
+		return NULL;
+	}
+
+	cm->counters = calloc (w * depth, sizeof (uint32_t));
+	if (cm->counters == NULL) {
+		PERR ("calloc");
+		free (cm);
+		return NULL;
+	}
+
+	cm->width = w;
+	cm->depth = depth;
+	cm->total = 0;
+
+	return cm;
+}
+
+/* fills slots with the position of the item's counter in each row */
+static void counter_slots (count_min* cm, uint64_t hash, size_t* slots) {
+	size_t mask = cm->width - 1;
+	uint32_t h2 = (uint32_t) (hash >> 32) | 1;
+	uint32_t h = (uint32_t) hash;
+
+	for (size_t row = 0; row < cm->depth; ++row) {
+		slots[row] = (row * cm->width) + (h & mask);
+		h += h2;
+	}
+}
+
+uint32_t count_min_add_hash (count_min* cm, uint64_t hash, uint32_t count) {
+	size_t slots[COUNT_MIN_MAX_DEPTH];
+	uint32_t min = UINT32_MAX;
+
+	counter_slots (cm, hash, slots);
+
+	for (size_t row = 0; row < cm->depth; ++row) {
+		if (cm->counters[slots[row]] < min) {
+			min = cm->counters[slots[row]];
+		}
+	}
+
+	uint32_t target = min > UINT32_MAX - count ? UINT32_MAX : min + count;
+
+	// the conservative update: no counter is raised past the new estimate
+	for (size_t row = 0; row < cm->depth; ++row) {
+		if (cm->counters[slots[row]] < target) {
+			cm->counters[slots[row]] = target;
+		}
+	}
+
+	cm->total += count;
+
+	return target;
+}
+
+uint32_t count_min_add (count_min* cm, const void* data, size_t len, uint32_t count) {
+	return count_min_add_hash (cm, MurmurHash64A (data, len, 0), count);
+}
+
+uint32_t count_min_estimate_hash (count_min* cm, uint64_t hash) {
+	size_t slots[COUNT_MIN_MAX_DEPTH];
+	uint32_t min = UINT32_MAX;
+
+	counter_slots (cm, hash, slots);
+
+	for (size_t row = 0; row < cm->depth; ++row) {
+		if (cm->counters[slots[row]] < min) {
+			min = cm->counters[slots[row]];
+		}
+	}
+
+	return min;
+}
+
+uint32_t count_min_estimate (count_min* cm, const void* data, size_t len) {
+	return count_min_estimate_hash (cm, MurmurHash64A (data, len, 0));
+}
+
+int count_min_merge (count_min* dest, count_min* src) {
+	if (dest->width != src->width || dest->depth != src->depth) {
+		PMSG ("count_min dimensions differ");
+		return -1;
+	}
+
+	size_t n = dest->width * dest->depth;
+	for (size_t i = 0; i < n; ++i) {
+		uint32_t sum = dest->counters[i] + src->counters[i];
+		dest->counters[i] = sum < dest->counters[i] ? UINT32_MAX : sum;
+	}
+
+	dest->total += src->total;
+
+	return 0;
+}
+
+size_t count_min_size_in_bytes (count_min* cm) {
+	return sizeof (count_min) + (cm->width * cm->depth * sizeof (uint32_t));
+}
+
+void count_min_delete (count_min* cm) {
+	free (cm->counters);
+	free (cm);
+	cm = NULL;
+}
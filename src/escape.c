@@ -0,0 +1,495 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#include "container.h"
+#include "debug_utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined (__x86_64__)
+#include <immintrin.h>
+#define ESCAPE_X86 1
+#endif
+
+/*
+ * Escaping scans for the next byte that needs it, a block at a time, and
+ * appends the run before it with one copy. The scans and utf8_validate 
+ * have scalar, SSE2 and AVX2 kernels selected at load time.
+ */
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+/* the short escape for a byte, 'u' for \u00XX or 0 if it's copied as is */
+static char json_escapes[256];
+
+/* 1 for the bytes RFC 3986 leaves unreserved */
+static char url_unreserved[256];
+
+static size_t json_scan_scalar (const char* p, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		if (json_escapes[(unsigned char) p[i]]) {
+			return i;
+		}
+	}
+
+	return n;
+}
+
+static size_t url_scan_scalar (const char* p, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		if (!url_unreserved[(unsigned char) p[i]]) {
+			return i;
+		}
+	}
+
+	return n;
+}
+
+/* the number of bytes of the valid sequence at p or 0 if it is invalid */
+static size_t utf8_sequence (const unsigned char* p, size_t n) {
+	unsigned char c = p[0];
+
+	if (c < 0x80) {
+		return 1;
+	}
+
+	size_t len;
+	unsigned char lo = 0x80, hi = 0xbf;
+	if (c >= 0xc2 && c <= 0xdf) {
+		len = 2;
+	} else if (c >= 0xe0 && c <= 0xef) {
+		len = 3;
+		// no overlongs or surrogates
+		if (c == 0xe0) {
+			lo = 0xa0;
+		} else if (c == 0xed) {
+			hi = 0x9f;
+		}
+	} else if (c >= 0xf0 && c <= 0xf4) {
+		len = 4;
+		// no overlongs or code points past U+10FFFF
+		if (c == 0xf0) {
+			lo = 0x90;
+		} else if (c == 0xf4) {
+			hi = 0x8f;
+		}
+	} else {
+		return 0;
+	}
+
+	if (len > n || p[1] < lo || p[1] > hi) {
+		return 0;
+	}
+
+	for (size_t i = 2; i < len; ++i) {
+		if ((p[i] & 0xc0) != 0x80) {
+			return 0;
+		}
+	}
+
+	return len;
+}
+
+static int utf8_validate_scalar (const unsigned char* p, size_t n) {
+	size_t i = 0;
+
+	while (i < n) {
+		size_t len = utf8_sequence (p + i, n - i);
+		if (len == 0) {
+			return 0;
+		}
+		i += len;
+	}
+
+	return 1;
+}
+
+#ifdef ESCAPE_X86
+
+/* (v - lo) <= (hi - lo) for unsigned bytes */
+#define IN_RANGE_SSE2(v, lo, hi) \
+	_mm_cmpeq_epi8 (_mm_min_epu8 (_mm_sub_epi8 (v, _mm_set1_epi8 (lo)), _mm_set1_epi8 ((hi) - (lo))), \
+			_mm_sub_epi8 (v, _mm_set1_epi8 (lo)))
+
+#define IN_RANGE_AVX2(v, lo, hi) \
+	_mm256_cmpeq_epi8 (_mm256_min_epu8 (_mm256_sub_epi8 (v, _mm256_set1_epi8 (lo)), _mm256_set1_epi8 ((hi) - (lo))), \
+			_mm256_sub_epi8 (v, _mm256_set1_epi8 (lo)))
+
+/* control characters, quotes and backslashes */
+static size_t json_scan_sse2 (const char* p, size_t n) {
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128 ((const __m128i*) (p + i));
+		__m128i escape = _mm_or_si128 (IN_RANGE_SSE2 (v, 0, 0x1f), 
+				_mm_or_si128 (_mm_cmpeq_epi8 (v, _mm_set1_epi8 ('"')), _mm_cmpeq_epi8 (v, _mm_set1_epi8 ('\\'))));
+
+		unsigned mask = _mm_movemask_epi8 (escape);
+		if (mask != 0) {
+			return i + __builtin_ctz (mask);
+		}
+	}
+
+	return i + json_scan_scalar (p + i, n - i);
+}
+
+__attribute__ ((target ("avx2")))
+static size_t json_scan_avx2 (const char* p, size_t n) {
+	size_t i = 0;
+
+	for (; i + 32 <= n; i += 32) {
+		__m256i v = _mm256_loadu_si256 ((const __m256i*) (p + i));
+		__m256i escape = _mm256_or_si256 (IN_RANGE_AVX2 (v, 0, 0x1f), 
+				_mm256_or_si256 (_mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('"')), _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('\\'))));
+
+		unsigned mask = _mm256_movemask_epi8 (escape);
+		if (mask != 0) {
+			return i + __builtin_ctz (mask);
+		}
+	}
+
+	return i + json_scan_sse2 (p + i, n - i);
+}
+
+/* letters are folded to lower case before the range check */
+static size_t url_scan_sse2 (const char* p, size_t n) {
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128 ((const __m128i*) (p + i));
+		__m128i lower = _mm_or_si128 (v, _mm_set1_epi8 (0x20));
+		__m128i keep = _mm_or_si128 (_mm_or_si128 (IN_RANGE_SSE2 (lower, 'a', 'z'), IN_RANGE_SSE2 (v, '0', '9')),
+				_mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (v, _mm_set1_epi8 ('-')), _mm_cmpeq_epi8 (v, _mm_set1_epi8 ('_'))),
+					_mm_or_si128 (_mm_cmpeq_epi8 (v, _mm_set1_epi8 ('.')), _mm_cmpeq_epi8 (v, _mm_set1_epi8 ('~')))));
+
+		unsigned mask = ~_mm_movemask_epi8 (keep) & 0xffff;
+		if (mask != 0) {
+			return i + __builtin_ctz (mask);
+		}
+	}
+
+	return i + url_scan_scalar (p + i, n - i);
+}
+
+__attribute__ ((target ("avx2")))
+static size_t url_scan_avx2 (const char* p, size_t n) {
+	size_t i = 0;
+
+	for (; i + 32 <= n; i += 32) {
+		__m256i v = _mm256_loadu_si256 ((const __m256i*) (p + i));
+		__m256i lower = _mm256_or_si256 (v, _mm256_set1_epi8 (0x20));
+		__m256i keep = _mm256_or_si256 (_mm256_or_si256 (IN_RANGE_AVX2 (lower, 'a', 'z'), IN_RANGE_AVX2 (v, '0', '9')),
+				_mm256_or_si256 (_mm256_or_si256 (_mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('-')), _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('_'))),
+					_mm256_or_si256 (_mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('.')), _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('~')))));
+
+		unsigned mask = ~(unsigned) _mm256_movemask_epi8 (keep);
+		if (mask != 0) {
+			return i + __builtin_ctz (mask);
+		}
+	}
+
+	return i + url_scan_sse2 (p + i, n - i);
+}
+
+/* skips ASCII 16 bytes at a time, validating the rest a sequence at a time */
+static int utf8_validate_sse2 (const unsigned char* p, size_t n) {
+	size_t i = 0;
+
+	while (i < n) {
+		if (i + 16 <= n && _mm_movemask_epi8 (_mm_loadu_si128 ((const __m128i*) (p + i))) == 0) {
+			i += 16;
+			continue;
+		}
+
+		size_t len = utf8_sequence (p + i, n - i);
+		if (len == 0) {
+			return 0;
+		}
+		i += len;
+	}
+
+	return 1;
+}
+
+/*
+ * The lookup algorithm of Keiser and Lemire, "Validating UTF-8 In Less Than
+ * One Instruction Per Byte". Each error is a bit, and three table lookups, 
+ * on the high and low nibbles of the previous byte and the high nibble of
+ * the current one, give the errors each pair of bytes could have; a pair 
+ * is in error where all three agree. The 3rd and 4th bytes of sequences 
+ * are checked by looking back 2 and 3 bytes for their leads.
+ */
+#define TOO_SHORT (1 << 0)
+#define TOO_LONG (1 << 1)
+#define OVERLONG_3 (1 << 2)
+#define TOO_LARGE (1 << 3)
+#define SURROGATE (1 << 4)
+#define OVERLONG_2 (1 << 5)
+#define TOO_LARGE_1000 (1 << 6)
+#define OVERLONG_4 (1 << 6)
+#define TWO_CONTS (1 << 7)
+#define CARRY (TOO_SHORT | TOO_LONG | TWO_CONTS)
+
+#define TABLE(...) _mm256_setr_epi8 (__VA_ARGS__, __VA_ARGS__)
+
+/* the last n bytes of prev followed by the first 32 - n of input */
+#define PREV(input, prev, n) _mm256_alignr_epi8 (input, _mm256_permute2x128_si256 (prev, input, 0x21), 16 - (n))
+
+__attribute__ ((target ("avx2")))
+static __m256i utf8_block_errors (__m256i input, __m256i prev_input) {
+	const __m256i nibble = _mm256_set1_epi8 (0x0f);
+	__m256i prev1 = PREV (input, prev_input, 1);
+
+	__m256i byte_1_high = _mm256_shuffle_epi8 (TABLE (
+			TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+			TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+			TOO_SHORT | OVERLONG_2,
+			TOO_SHORT,
+			TOO_SHORT | OVERLONG_3 | SURROGATE,
+			TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4),
+			_mm256_and_si256 (_mm256_srli_epi16 (prev1, 4), nibble));
+
+	__m256i byte_1_low = _mm256_shuffle_epi8 (TABLE (
+			CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+			CARRY | OVERLONG_2,
+			CARRY,
+			CARRY,
+			CARRY | TOO_LARGE,
+			CARRY | TOO_LARGE | TOO_LARGE_1000,
+			CARRY | TOO_LARGE | TOO_LARGE_1000,
+			CARRY | TOO_LARGE | TOO_LARGE_1000,
+			CARRY | TOO_LARGE | TOO_LARGE_1000,
+			CARRY | TOO_LARGE | TOO_LARGE_1000,
+			CARRY | TOO_LARGE | TOO_LARGE_1000,
+			CARRY | TOO_LARGE | TOO_LARGE_1000,
+			CARRY | TOO_LARGE | TOO_LARGE_1000,
+			CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+			CARRY | TOO_LARGE | TOO_LARGE_1000,
+			CARRY | TOO_LARGE | TOO_LARGE_1000),
+			_mm256_and_si256 (prev1, nibble));
+
+	__m256i byte_2_high = _mm256_shuffle_epi8 (TABLE (
+			TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+			TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+			TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+			TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+			TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+			TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT),
+			_mm256_and_si256 (_mm256_srli_epi16 (input, 4), nibble));
+
+	__m256i special = _mm256_and_si256 (_mm256_and_si256 (byte_1_high, byte_1_low), byte_2_high);
+
+	// bytes 2 and 3 after a 3 or 4 byte lead must be continuations, which the pair check passes as TWO_CONTS
+	__m256i third = _mm256_subs_epu8 (PREV (input, prev_input, 2), _mm256_set1_epi8 ((char) (0xe0 - 0x80)));
+	__m256i fourth = _mm256_subs_epu8 (PREV (input, prev_input, 3), _mm256_set1_epi8 ((char) (0xf0 - 0x80)));
+	__m256i must23 = _mm256_and_si256 (_mm256_or_si256 (third, fourth), _mm256_set1_epi8 ((char) 0x80));
+
+	return _mm256_xor_si256 (must23, special);
+}
+
+/* nonzero if the block ends part way through a sequence */
+__attribute__ ((target ("avx2")))
+static __m256i utf8_incomplete (__m256i input) {
+	const __m256i max = _mm256_setr_epi8 (
+			-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+			-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+			(char) (0xf0 - 1), (char) (0xe0 - 1), (char) (0xc0 - 1));
+
+	return _mm256_subs_epu8 (input, max);
+}
+
+__attribute__ ((target ("avx2")))
+static int utf8_validate_avx2 (const unsigned char* p, size_t n) {
+	__m256i error = _mm256_setzero_si256 ();
+	__m256i prev_input = _mm256_setzero_si256 ();
+	__m256i prev_incomplete = _mm256_setzero_si256 ();
+	size_t i = 0;
+
+	for (; i + 32 <= n; i += 32) {
+		__m256i input = _mm256_loadu_si256 ((const __m256i*) (p + i));
+
+		if (_mm256_movemask_epi8 (input) == 0) {
+			error = _mm256_or_si256 (error, prev_incomplete);
+			prev_incomplete = _mm256_setzero_si256 ();
+		} else {
+			error = _mm256_or_si256 (error, utf8_block_errors (input, prev_input));
+			prev_incomplete = utf8_incomplete (input);
+		}
+		prev_input = input;
+	}
+
+	// the tail is padded with nuls, which end any sequence cut short
+	if (i < n) {
+		unsigned char tail[32] = { 0 };
+		memcpy (tail, p + i, n - i);
+		__m256i input = _mm256_loadu_si256 ((const __m256i*) tail);
+		error = _mm256_or_si256 (error, utf8_block_errors (input, prev_input));
+		prev_incomplete = _mm256_setzero_si256 ();
+	}
+
+	error = _mm256_or_si256 (error, prev_incomplete);
+
+	return _mm256_testz_si256 (error, error);
+}
+
+#endif // ESCAPE_X86
+
+static struct {
+	size_t (*json_scan) (const char*, size_t);
+	size_t (*url_scan) (const char*, size_t);
+	int (*utf8_validate) (const unsigned char*, size_t);
+} kernels = { json_scan_scalar, url_scan_scalar, utf8_validate_scalar };
+
+__attribute__ ((constructor))
+static void select_kernels () {
+	for (int c = 0; c < 0x20; ++c) {
+		json_escapes[c] = 'u';
+	}
+	json_escapes['\b'] = 'b';
+	json_escapes['\f'] = 'f';
+	json_escapes['\n'] = 'n';
+	json_escapes['\r'] = 'r';
+	json_escapes['\t'] = 't';
+	json_escapes['"'] = '"';
+	json_escapes['\\'] = '\\';
+
+	for (int c = 0; c < 256; ++c) {
+		url_unreserved[c] = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') 
+			|| c == '-' || c == '_' || c == '.' || c == '~';
+	}
+
+#ifdef ESCAPE_X86
+	__builtin_cpu_init ();
+
+	kernels.json_scan = json_scan_sse2;
+	kernels.url_scan = url_scan_sse2;
+	kernels.utf8_validate = utf8_validate_sse2;
+
+	if (__builtin_cpu_supports ("avx2")) {
+		kernels.json_scan = json_scan_avx2;
+		kernels.url_scan = url_scan_avx2;
+		kernels.utf8_validate = utf8_validate_avx2;
+	}
+#endif
+}
+
+/*
+ * The input is escaped a block at a time into room reserved for the worst
+ * case, 6 bytes out for each in for JSON and 3 for URLs, so runs are copied
+ * and escapes written without a call per piece.
+ */
+#define ESCAPE_BLOCK 4096
+
+auto_string* auto_string_append_json_escaped (auto_string* s, const char* data, size_t n) {
+	while (n > 0) {
+		size_t block = n < ESCAPE_BLOCK ? n : ESCAPE_BLOCK;
+
+		// data may be part of the buffer, which can move as it grows
+		ssize_t offset = data >= s->buf && data < s->buf + s->size ? data - s->buf : -1;
+		if (auto_string_reserve (s, 6 * block) == NULL) {
+			s->buf[s->count] = '\0';
+			return NULL;
+		}
+		if (offset != -1) {
+			data = s->buf + offset;
+		}
+
+		char* out = s->buf + s->count;
+		const char* end = data + block;
+		while (data < end) {
+			size_t run = kernels.json_scan (data, end - data);
+			memcpy (out, data, run);
+			out += run;
+			data += run;
+
+			while (data < end && json_escapes[(unsigned char) *data]) {
+				unsigned char c = *data++;
+				*out++ = '\\';
+				*out++ = json_escapes[c];
+				if (json_escapes[c] == 'u') {
+					*out++ = '0';
+					*out++ = '0';
+					*out++ = hex_digits[c >> 4];
+					*out++ = hex_digits[c & 0xf];
+				}
+			}
+		}
+
+		s->count = out - s->buf;
+		n -= block;
+	}
+
+	s->buf[s->count] = '\0';
+
+	return s;
+}
+
+auto_string* auto_string_append_url_encoded (auto_string* s, const char* data, size_t n) {
+	while (n > 0) {
+		size_t block = n < ESCAPE_BLOCK ? n : ESCAPE_BLOCK;
+
+		// data may be part of the buffer, which can move as it grows
+		ssize_t offset = data >= s->buf && data < s->buf + s->size ? data - s->buf : -1;
+		if (auto_string_reserve (s, 3 * block) == NULL) {
+			s->buf[s->count] = '\0';
+			return NULL;
+		}
+		if (offset != -1) {
+			data = s->buf + offset;
+		}
+
+		char* out = s->buf + s->count;
+		const char* end = data + block;
+		while (data < end) {
+			// words are short, so a few bytes are checked before the vector scan
+			size_t run = 0;
+			while (run < 8 && data + run < end && url_unreserved[(unsigned char) data[run]]) {
+				++run;
+			}
+			if (run == 8) {
+				run += kernels.url_scan (data + run, end - data - run);
+			}
+			memcpy (out, data, run);
+			out += run;
+			data += run;
+
+			while (data < end && !url_unreserved[(unsigned char) *data]) {
+				unsigned char c = *data++;
+				*out++ = '%';
+				*out++ = hex_digits[c >> 4];
+				*out++ = hex_digits[c & 0xf];
+			}
+		}
+
+		s->count = out - s->buf;
+		n -= block;
+	}
+
+	s->buf[s->count] = '\0';
+
+	return s;
+}
+
+int utf8_validate (const char* data, size_t n) {
+	return kernels.utf8_validate ((const unsigned char*) data, n);
+}
@@ -23,6 +23,7 @@
 
 #include "container.h"
 #include "debug_utils.h"
+#include "trace.h"
 
 #include <stdint.h>
 #include <stdio.h>
@@ -82,48 +83,114 @@ uint32_t SuperFastHash (const char * data, int len) {
 }
 
 
+// see https://github.com/aappleby/smhasher
+// Austin Appleby, public domain
+uint64_t MurmurHash64A (const void* key, size_t len, uint64_t seed) {
+	const uint64_t m = 0xc6a4a7935bd1e995ULL;
+	const int r = 47;
+	const unsigned char* data = key;
+	const unsigned char* end = data + (len & ~(size_t) 7);
+
+	uint64_t h = seed ^ (len * m);
+
+	while (data != end) {
+		uint64_t k;
+		memcpy (&k, data, sizeof (k));
+		data += sizeof (k);
+
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+
+		h ^= k;
+		h *= m;
+	}
+
+	switch (len & 7) {
+		case 7: h ^= (uint64_t) data[6] << 48; /* fall through */
+		case 6: h ^= (uint64_t) data[5] << 40; /* fall through */
+		case 5: h ^= (uint64_t) data[4] << 32; /* fall through */
+		case 4: h ^= (uint64_t) data[3] << 24; /* fall through */
+		case 3: h ^= (uint64_t) data[2] << 16; /* fall through */
+		case 2: h ^= (uint64_t) data[1] << 8; /* fall through */
+		case 1: h ^= (uint64_t) data[0];
+			h *= m;
+	}
+
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+
+	return h;
+}
+
+/* keys shorter than this are stored in the entry's pool object, after the entry */
+#define HASH_KEY_INLINE 16
+
+static char* inline_key (hash_entry* entry) {
+	return (char*) (entry + 1);
+}
+
 hash_table* hash_table_create (size_t size_table) {
+	return hash_table_create_with (size_table, NULL);
+}
+
+hash_table* hash_table_create_with (size_t size_table, const sscont_allocator* allocator) {
 	size_t bucket_size = 10;
 
-	hash_table* ht = malloc (sizeof (hash_table));
+	if (allocator == NULL) {
+		allocator = sscont_allocator_get_default ();
+	}
+
+	hash_table* ht = sscont_alloc (allocator, sizeof (hash_table));
 	if (ht == NULL) {
 		PERR ("malloc");
 		return NULL;
 	}
 
-	ht->buckets = malloc (sizeof (hash_bucket*) * size_table);
+	ht->allocator = allocator;
+	ht->entries = sscont_pool_create_with (sizeof (hash_entry) + HASH_KEY_INLINE, 0, allocator);
+	if (ht->entries == NULL) {
+		sscont_free (allocator, ht);
+		return NULL;
+	}
+
+	ht->buckets = sscont_alloc (allocator, sizeof (hash_bucket*) * size_table);
 	if (ht->buckets == NULL) {
 		PERR ("malloc");
-		free (ht);
+		sscont_pool_delete (ht->entries);
+		sscont_free (allocator, ht);
 		return NULL;
 	}
 
 	ht->size = size_table;
 
 	for (size_t i = 0; i < size_table; ++i) {
-		ht->buckets[i] = malloc (sizeof (hash_bucket));
+		ht->buckets[i] = sscont_alloc (allocator, sizeof (hash_bucket));
 		if (ht->buckets[i] == NULL) {
 			PERR ("malloc");
 			for (size_t j = 0; j < i; ++j) {
-				free (ht->buckets[j]->entries);
-				free (ht->buckets[j]);
+				sscont_free (allocator, ht->buckets[j]->entries);
+				sscont_free (allocator, ht->buckets[j]);
 			}
-			free (ht->buckets);
-			free (ht);
+			sscont_free (allocator, ht->buckets);
+			sscont_pool_delete (ht->entries);
+			sscont_free (allocator, ht);
 
 			return NULL;
 		}
 
-		ht->buckets[i]->entries = malloc (sizeof (hash_entry*) * bucket_size);
+		ht->buckets[i]->entries = sscont_alloc (allocator, sizeof (hash_entry*) * bucket_size);
 		if (ht->buckets[i]->entries == NULL) {
 			PERR ("malloc");
 			for (size_t j = 0; j < i; ++j) {
-				free (ht->buckets[j]->entries);
-				free (ht->buckets[j]);
+				sscont_free (allocator, ht->buckets[j]->entries);
+				sscont_free (allocator, ht->buckets[j]);
 			}
-			free (ht->buckets[i]);
-			free (ht->buckets);
-			free (ht);
+			sscont_free (allocator, ht->buckets[i]);
+			sscont_free (allocator, ht->buckets);
+			sscont_pool_delete (ht->entries);
+			sscont_free (allocator, ht);
 
 			return NULL;
 		}
@@ -137,7 +204,11 @@ hash_table* hash_table_create (size_t size_table) {
 }
 
 hash_entry* hash_table_put (hash_table* ht, char* key, void* value) {
-	uint32_t hash = SuperFastHash (key, strlen (key));
+	return hash_table_put_n (ht, key, strlen (key), value);
+}
+
+hash_entry* hash_table_put_n (hash_table* ht, const char* key, size_t n, void* value) {
+	uint32_t hash = SuperFastHash (key, n);
 
 	size_t pos = hash % ht->size;
 
@@ -145,13 +216,15 @@ hash_entry* hash_table_put (hash_table* ht, char* key, void* value) {
 
 	if (bpos == (ht->buckets[pos]->size - 1)) {
 		int new_size = ht->buckets[pos]->size * 2;
+		uint64_t start = sscont_trace_start ();
 		void* tmp;
-		if ((tmp = realloc (ht->buckets[pos], new_size * sizeof (hash_entry*))) == NULL) {
+		if ((tmp = sscont_realloc (ht->allocator, ht->buckets[pos]->entries, new_size * sizeof (hash_entry*))) == NULL) {
 			PERR ("realloc");
 			return NULL;
 		}
-		ht->buckets[pos] = tmp;
+		ht->buckets[pos]->entries = tmp;
 		ht->buckets[pos]->size = new_size;	
+		sscont_trace_resize ("hash_table", ht, new_size / 2, new_size, start);
 	}
 
 	for (int i = 0; i < bpos; ++i) {
@@ -161,43 +234,54 @@ hash_entry* hash_table_put (hash_table* ht, char* key, void* value) {
 		}	
 	}
 
-	ht->buckets[pos]->entries[bpos] = malloc (sizeof (hash_entry));
-	if (ht->buckets[pos]->entries[bpos] == NULL) {
-		PERR ("malloc");
+	hash_entry* entry = sscont_pool_alloc (ht->entries);
+	if (entry == NULL) {
 		return NULL;
 	}
 
-	ht->buckets[pos]->count++;
-
-	ht->buckets[pos]->entries[bpos]->hash = hash;
-	ht->buckets[pos]->entries[bpos]->key = malloc (strlen (key) + 1);
-	if (ht->buckets[pos]->entries[bpos]->key == NULL) {
+	entry->key = n < HASH_KEY_INLINE ? inline_key (entry) : sscont_alloc (ht->allocator, n + 1);
+	if (entry->key == NULL) {
 		PERR ("malloc");
-		free (ht->buckets[pos]->entries[bpos]);
+		sscont_pool_free (ht->entries, entry);
 		return NULL;
 	}
 
-	strcpy (ht->buckets[pos]->entries[bpos]->key, key);
-	ht->buckets[pos]->entries[bpos]->value = value;
+	entry->hash = hash;
+	memcpy (entry->key, key, n);
+	entry->key[n] = '\0';
+	entry->value = value;
 
-	return ht->buckets[pos]->entries[bpos];
+	ht->buckets[pos]->entries[bpos] = entry;
+	ht->buckets[pos]->count++;
+
+	return entry;
 }
 
 void* hash_table_get (hash_table* ht, char* key) {
-	uint32_t hash = SuperFastHash (key, strlen (key));
+	return hash_table_get_n (ht, key, strlen (key));
+}
+
+void* hash_table_get_n (hash_table* ht, const char* key, size_t n) {
+	uint32_t hash = SuperFastHash (key, n);
 
 	size_t pos = hash % ht->size;
 	
 	int bpos = ht->buckets[pos]->count;
 
 	for (int i = 0; i < bpos; ++i) {
-		if (ht->buckets[pos]->entries[i] != NULL) {
-			if (strcmp (ht->buckets[pos]->entries[i]->key, key) == 0) {
+		hash_entry* entry = ht->buckets[pos]->entries[i];
+		if (entry != NULL && entry->hash == hash) {
+			if (strncmp (entry->key, key, n) == 0 && entry->key[n] == '\0') {
 				bpos = i;
 				break;
 			}
 		}
 	}
+
+	size_t compared = bpos == ht->buckets[pos]->count ? bpos : bpos + 1;
+	if (compared > atomic_load_explicit (&sscont_trace_chain_limit, memory_order_relaxed)) {
+		sscont_trace_chain_walk (ht, compared, pos);
+	}
 	
 	return bpos == ht->buckets[pos]->count ? NULL : ht->buckets[pos]->entries[bpos]->value;
 }
@@ -209,7 +293,7 @@ auto_array* hash_table_get_all (hash_table* ht, char* key) {
 	
 	int bpos = ht->buckets[pos]->count;
 
-	auto_array* aa = auto_array_create (bpos);
+	auto_array* aa = auto_array_create_with (bpos, ht->allocator);
 	if (aa == NULL) {
 		PMSG ("auto_array_create failed");
 		return NULL;
@@ -239,10 +323,15 @@ void* hash_table_remove (hash_table* ht, char* key) {
 	for (int i = 0; i < bpos; ++i) {
 		if (ht->buckets[pos]->entries[i] != NULL) {
 			if (strcmp (ht->buckets[pos]->entries[i]->key, key) == 0) {
-				entry_value = ht->buckets[pos]->entries[i]->value; 
-				free (ht->buckets[pos]->entries[i]->key);
-				free (ht->buckets[pos]->entries[i]);
-				ht->buckets[pos]->entries[i] = NULL;
+				hash_entry* entry = ht->buckets[pos]->entries[i];
+				entry_value = entry->value; 
+				if (entry->key != inline_key (entry)) {
+					sscont_free (ht->allocator, entry->key);
+				}
+				sscont_pool_free (ht->entries, entry);
+				// keep the entries packed below count so lookups see them all
+				memmove (&ht->buckets[pos]->entries[i], &ht->buckets[pos]->entries[i + 1], (bpos - i - 1) * sizeof (hash_entry*));
+				ht->buckets[pos]->entries[bpos - 1] = NULL;
 				ht->buckets[pos]->count--;
 				break;
 			}
@@ -254,6 +343,12 @@ void* hash_table_remove (hash_table* ht, char* key) {
 }
 
 void hash_table_delete (hash_table* ht, void (*delete_value)(void*)) {
+	const sscont_allocator* allocator = ht->allocator;
+
+	// an allocator without free, e.g. an arena, reclaims everything at once
+	if (allocator->free == NULL && delete_value == NULL) {
+		return;
+	}
 
 	for (size_t i = 0; i < ht->size; ++i) {
 		size_t count = ht->buckets[i]->count;
@@ -261,33 +356,37 @@ void hash_table_delete (hash_table* ht, void (*delete_value)(void*)) {
 
 		while (count) {
 			
-			if (ht->buckets[i]->entries[pos] != NULL) {
-				free (ht->buckets[i]->entries[pos]->key);
+			hash_entry* entry = ht->buckets[i]->entries[pos];
+			if (entry != NULL) {
+				if (entry->key != inline_key (entry)) {
+					sscont_free (allocator, entry->key);
+				}
 				if (delete_value != NULL) {
-					delete_value (ht->buckets[i]->entries[pos]->value);
+					delete_value (entry->value);
 				}
 				
-				free (ht->buckets[i]->entries[pos]);
 				--count;
 			}
 
 			++pos;
 		}
 
-		free (ht->buckets[i]->entries);
-		free (ht->buckets[i]);
+		sscont_free (allocator, ht->buckets[i]->entries);
+		sscont_free (allocator, ht->buckets[i]);
 	}
 
 		
-	free (ht->buckets);
-	free (ht);
+	// the entries are freed with their pool's slabs
+	sscont_pool_delete (ht->entries);
+	sscont_free (allocator, ht->buckets);
+	sscont_free (allocator, ht);
 	ht = NULL;
 }
 
 auto_array* hash_table_keys (hash_table* ht) {
 	size_t num_keys_estimate = 1000;
 
-	auto_array* aa = auto_array_create (num_keys_estimate);
+	auto_array* aa = auto_array_create_with (num_keys_estimate, ht->allocator);
 	if (aa == NULL) {
 		PERR ("auto_array");
 		return NULL;
@@ -0,0 +1,262 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#include "container.h"
+#include "debug_utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_ARITY 4
+
+static void place (heap* h, heap_node* node, size_t pos) {
+	h->nodes->data[pos] = node;
+	node->pos = pos;
+}
+
+/* moves the node at pos towards the root until its parent comes first */
+static size_t sift_up (heap* h, size_t pos) {
+	heap_node** nodes = (heap_node**) h->nodes->data;
+	heap_node* node = nodes[pos];
+
+	while (pos > 0) {
+		size_t parent = (pos - 1) / h->arity;
+		if (h->compare (node->item, nodes[parent]->item) >= 0) {
+			break;
+		}
+
+		place (h, nodes[parent], pos);
+		pos = parent;
+	}
+
+	place (h, node, pos);
+
+	return pos;
+}
+
+/* moves the node at pos towards the leaves until it comes before its children */
+static size_t sift_down (heap* h, size_t pos) {
+	heap_node** nodes = (heap_node**) h->nodes->data;
+	size_t count = h->nodes->count;
+	heap_node* node = nodes[pos];
+
+	for (;;) {
+		size_t first = (pos * h->arity) + 1;
+		if (first >= count) {
+			break;
+		}
+
+		size_t last = first + h->arity < count ? first + h->arity : count;
+		size_t best = first;
+		for (size_t c = first + 1; c < last; ++c) {
+			if (h->compare (nodes[c]->item, nodes[best]->item) < 0) {
+				best = c;
+			}
+		}
+
+		if (h->compare (nodes[best]->item, node->item) >= 0) {
+			break;
+		}
+
+		place (h, nodes[best], pos);
+		pos = best;
+	}
+
+	place (h, node, pos);
+
+	return pos;
+}
+
+static heap_node* node_create (heap* h, void* item) {
+	heap_node* node = auto_array_remove (h->spare, h->spare->count - 1);
+
+	if (node == NULL) {
+		node = malloc (sizeof (heap_node));
+		if (node == NULL) {
+			PERR ("malloc");
+			return NULL;
+		}
+	}
+
+	node->item = item;
+
+	return node;
+}
+
+static void node_release (heap* h, heap_node* node) {
+	node->pos = SIZE_MAX;
+
+	if (auto_array_add (h->spare, node) <= 0) {
+		free (node);
+	}
+}
+
+heap* heap_create (size_t initial_size, size_t arity, int (*compare) (void*, void*)) {
+	if (arity == 1) {
+		PMSG ("heap arity must be at least 2");
+		return NULL;
+	}
+
+	heap* h = malloc (sizeof (heap));
+	if (h == NULL) {
+		PERR ("malloc");
+		return NULL;
+	}
+
+	h->nodes = auto_array_create (initial_size);
+	if (h->nodes == NULL) {
+		PMSG ("auto_array_create failed");
+		free (h);
+		return NULL;
+	}
+
+	h->spare = auto_array_create (AUTO_ARRAY_SMALL_SIZE);
+	if (h->spare == NULL) {
+		PMSG ("auto_array_create failed");
+		auto_array_delete (h->nodes, NULL);
+		free (h);
+		return NULL;
+	}
+
+	h->arity = arity == 0 ? DEFAULT_ARITY : arity;
+	h->compare = compare;
+
+	return h;
+}
+
+heap* heap_create_from (auto_array* aa, size_t arity, int (*compare) (void*, void*)) {
+	heap* h = heap_create (aa->count, arity, compare);
+	if (h == NULL) {
+		return NULL;
+	}
+
+	for (size_t i = 0; i < aa->count; ++i) {
+		heap_node* node = node_create (h, aa->data[i]);
+		if (node == NULL) {
+			heap_delete (h, NULL);
+			return NULL;
+		}
+
+		if (auto_array_add (h->nodes, node) <= 0) {
+			PMSG ("auto_array_add failed");
+			free (node);
+			heap_delete (h, NULL);
+			return NULL;
+		}
+		node->pos = i;
+	}
+
+	size_t count = h->nodes->count;
+	if (count > 1) {
+		for (size_t i = ((count - 2) / h->arity) + 1; i > 0; --i) {
+			sift_down (h, i - 1);
+		}
+	}
+
+	return h;
+}
+
+heap_node* heap_push (heap* h, void* item) {
+	heap_node* node = node_create (h, item);
+	if (node == NULL) {
+		return NULL;
+	}
+
+	if (auto_array_add (h->nodes, node) <= 0) {
+		PMSG ("auto_array_add failed");
+		free (node);
+		return NULL;
+	}
+
+	sift_up (h, h->nodes->count - 1);
+
+	return node;
+}
+
+void* heap_peek (heap* h) {
+	if (h->nodes->count == 0) {
+		return NULL;
+	}
+
+	return ((heap_node*) h->nodes->data[0])->item;
+}
+
+void* heap_pop (heap* h) {
+	if (h->nodes->count == 0) {
+		return NULL;
+	}
+
+	return heap_remove (h, h->nodes->data[0]);
+}
+
+int heap_update (heap* h, heap_node* node) {
+	if (node->pos >= h->nodes->count || h->nodes->data[node->pos] != node) {
+		return -1;
+	}
+
+	size_t pos = node->pos;
+
+	if (sift_up (h, pos) == pos) {
+		sift_down (h, pos);
+	}
+
+	return 0;
+}
+
+void* heap_remove (heap* h, heap_node* node) {
+	size_t pos = node->pos;
+
+	if (pos >= h->nodes->count || h->nodes->data[pos] != node) {
+		return NULL;
+	}
+
+	void* item = node->item;
+	heap_node* last = h->nodes->data[--h->nodes->count];
+
+	if (last != node) {
+		place (h, last, pos);
+		heap_update (h, last);
+	}
+
+	node_release (h, node);
+
+	return item;
+}
+
+size_t heap_count (heap* h) {
+	return h->nodes->count;
+}
+
+void heap_delete (heap* h, void (*delete_item)(void*)) {
+	for (size_t i = 0; i < h->nodes->count; ++i) {
+		heap_node* node = h->nodes->data[i];
+		if (delete_item != NULL) {
+			delete_item (node->item);
+		}
+		free (node);
+	}
+
+	auto_array_delete (h->nodes, NULL);
+	auto_array_delete (h->spare, free);
+	free (h);
+	h = NULL;
+}
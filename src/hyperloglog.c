@@ -0,0 +1,324 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#include "container.h"
+#include "debug_utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * The top precision bits of an item's 64 bit hash select a register, which
+ * keeps the largest rank seen: the position of the first set bit in the rest
+ * of the hash, at most 65 - precision.
+ *
+ * A sparse sketch keeps (index << 8 | rank) entries. New entries are
+ * appended unsorted after the sorted ones and merged in when the buffer
+ * fills, keeping the largest rank per index. The sketch becomes dense once
+ * the entries would take more room than one byte per register.
+ */
+
+#define SPARSE_MIN 64
+
+/* the limit of the HyperLogLog bias constant alpha, 1 / (2 ln 2) */
+#define ALPHA_INF 0.72134752044448170368
+
+static int u32_compare (const void* l, const void* r) {
+	uint32_t a = *(const uint32_t*) l;
+	uint32_t b = *(const uint32_t*) r;
+
+	return a < b ? -1 : a > b;
+}
+
+hyperloglog* hyperloglog_create (unsigned int precision) {
+	if (precision < HYPERLOGLOG_MIN_PRECISION || precision > HYPERLOGLOG_MAX_PRECISION) {
+		PMSG ("hyperloglog precision out of range");
+		return NULL;
+	}
+
+	hyperloglog* hll = malloc (sizeof (hyperloglog));
+	if (hll == NULL) {
+		PERR ("malloc");
+		return NULL;
+	}
+
+	hll->precision = precision;
+	hll->registers = NULL;
+	hll->sparse = NULL;
+	hll->sparse_count = 0;
+	hll->pending_count = 0;
+	hll->sparse_size = 0;
+
+	// small sketches are dense from the start
+	if ((SPARSE_MIN * sizeof (uint32_t)) >= ((size_t) 1 << precision)) {
+		hll->registers = calloc ((size_t) 1 << precision, 1);
+	} else {
+		hll->sparse = malloc (SPARSE_MIN * sizeof (uint32_t));
+		hll->sparse_size = SPARSE_MIN;
+	}
+
+	if (hll->registers == NULL && hll->sparse == NULL) {
+		PERR ("malloc");
+		free (hll);
+		return NULL;
+	}
+
+	return hll;
+}
+
+/* moves the sparse entries, sorted or not, into registers */
+static int to_dense (hyperloglog* hll) {
+	hll->registers = calloc ((size_t) 1 << hll->precision, 1);
+	if (hll->registers == NULL) {
+		PERR ("calloc");
+		return -1;
+	}
+
+	size_t n = hll->sparse_count + hll->pending_count;
+	for (size_t i = 0; i < n; ++i) {
+		uint32_t index = hll->sparse[i] >> 8;
+		uint8_t rank = hll->sparse[i] & 0xff;
+
+		if (hll->registers[index] < rank) {
+			hll->registers[index] = rank;
+		}
+	}
+
+	free (hll->sparse);
+	hll->sparse = NULL;
+	hll->sparse_count = 0;
+	hll->pending_count = 0;
+	hll->sparse_size = 0;
+
+	return 0;
+}
+
+/* 
+ * Sorts the pending entries into the sorted ones, then either goes dense or
+ * makes sure there is room for at least as many pending entries as sorted ones.
+ */
+static int sparse_compact (hyperloglog* hll) {
+	size_t sorted = hll->sparse_count;
+	size_t n = sorted + hll->pending_count;
+	uint32_t* pending = hll->sparse + sorted;
+
+	qsort (pending, hll->pending_count, sizeof (uint32_t), u32_compare);
+
+	uint32_t* merged = malloc ((n > 0 ? n : 1) * sizeof (uint32_t));
+	if (merged == NULL) {
+		PERR ("malloc");
+		return -1;
+	}
+
+	// entries for an index sort by rank, so the last of each index is kept
+	size_t i = 0;
+	size_t j = 0;
+	size_t k = 0;
+	while (i < sorted || j < hll->pending_count) {
+		uint32_t next;
+		if (j == hll->pending_count || (i < sorted && hll->sparse[i] < pending[j])) {
+			next = hll->sparse[i++];
+		} else {
+			next = pending[j++];
+		}
+
+		if (k > 0 && (merged[k - 1] >> 8) == (next >> 8)) {
+			merged[k - 1] = next;
+		} else {
+			merged[k++] = next;
+		}
+	}
+
+	free (hll->sparse);
+	hll->sparse = merged;
+	hll->sparse_count = k;
+	hll->pending_count = 0;
+	hll->sparse_size = n > 0 ? n : 1;
+
+	// at twice the sorted entries the buffer would be as large as the registers
+	if ((2 * k * sizeof (uint32_t)) > ((size_t) 1 << hll->precision)) {
+		return to_dense (hll);
+	}
+
+	size_t size = (2 * k) > SPARSE_MIN ? 2 * k : SPARSE_MIN;
+	uint32_t* tmp = realloc (merged, size * sizeof (uint32_t));
+	if (tmp == NULL) {
+		PERR ("realloc");
+		return -1;
+	}
+
+	hll->sparse = tmp;
+	hll->sparse_size = size;
+
+	return 0;
+}
+
+/* adds a register index and rank, returning -1 if an error occurs */
+static int hll_set (hyperloglog* hll, uint32_t index, uint8_t rank) {
+	if (hll->registers == NULL && hll->sparse_count + hll->pending_count == hll->sparse_size) {
+		if (sparse_compact (hll) == -1) {
+			return -1;
+		}
+	}
+
+	if (hll->registers == NULL) {
+		hll->sparse[hll->sparse_count + hll->pending_count++] = (index << 8) | rank;
+	} else if (hll->registers[index] < rank) {
+		hll->registers[index] = rank;
+	}
+
+	return 0;
+}
+
+int hyperloglog_add_hash (hyperloglog* hll, uint64_t hash) {
+	unsigned int p = hll->precision;
+	uint64_t rest = hash << p;
+
+	return hll_set (hll, hash >> (64 - p), rest == 0 ? (65 - p) : __builtin_clzll (rest) + 1);
+}
+
+int hyperloglog_add (hyperloglog* hll, const void* data, size_t len) {
+	return hyperloglog_add_hash (hll, MurmurHash64A (data, len, 0));
+}
+
+/* sigma and tau of Ertl, "New cardinality estimation algorithms for HyperLogLog sketches" */
+static double hll_sigma (double x) {
+	if (x == 1.0) {
+		return INFINITY;
+	}
+
+	double y = 1.0;
+	double z = x;
+	double prev;
+	do {
+		x *= x;
+		prev = z;
+		z += x * y;
+		y += y;
+	} while (z != prev);
+
+	return z;
+}
+
+static double hll_tau (double x) {
+	if (x == 0.0 || x == 1.0) {
+		return 0.0;
+	}
+
+	double y = 1.0;
+	double z = 1.0 - x;
+	double prev;
+	do {
+		x = sqrt (x);
+		prev = z;
+		y *= 0.5;
+		z -= (1.0 - x) * (1.0 - x) * y;
+	} while (z != prev);
+
+	return z / 3.0;
+}
+
+uint64_t hyperloglog_count (hyperloglog* hll) {
+	unsigned int p = hll->precision;
+	unsigned int q = 64 - p;
+	double m = (double) ((size_t) 1 << p);
+	uint64_t histogram[66] = { 0 };
+
+	if (hll->registers == NULL && hll->pending_count > 0 && sparse_compact (hll) == -1) {
+		return 0;
+	}
+
+	if (hll->registers != NULL) {
+		for (size_t i = 0; i < ((size_t) 1 << p); ++i) {
+			histogram[hll->registers[i]]++;
+		}
+	} else {
+		for (size_t i = 0; i < hll->sparse_count; ++i) {
+			histogram[hll->sparse[i] & 0xff]++;
+		}
+		histogram[0] = ((size_t) 1 << p) - hll->sparse_count;
+	}
+
+	double z = m * hll_tau (1.0 - (histogram[q + 1] / m));
+	for (unsigned int k = q; k >= 1; --k) {
+		z += histogram[k];
+		z *= 0.5;
+	}
+	z += m * hll_sigma (histogram[0] / m);
+
+	// every register saturated
+	if (z == 0.0) {
+		return UINT64_MAX;
+	}
+
+	return (uint64_t) llround (ALPHA_INF * m * m / z);
+}
+
+int hyperloglog_merge (hyperloglog* dest, hyperloglog* src) {
+	if (dest->precision != src->precision) {
+		PMSG ("hyperloglog precisions differ");
+		return -1;
+	}
+
+	if (src->registers == NULL) {
+		size_t n = src->sparse_count + src->pending_count;
+		for (size_t i = 0; i < n; ++i) {
+			if (hll_set (dest, src->sparse[i] >> 8, src->sparse[i] & 0xff) == -1) {
+				return -1;
+			}
+		}
+
+		return 0;
+	}
+
+	if (dest->registers == NULL && to_dense (dest) == -1) {
+		return -1;
+	}
+
+	size_t m = (size_t) 1 << dest->precision;
+	for (size_t i = 0; i < m; ++i) {
+		if (dest->registers[i] < src->registers[i]) {
+			dest->registers[i] = src->registers[i];
+		}
+	}
+
+	return 0;
+}
+
+size_t hyperloglog_size_in_bytes (hyperloglog* hll) {
+	size_t bytes = sizeof (hyperloglog);
+
+	if (hll->registers != NULL) {
+		return bytes + ((size_t) 1 << hll->precision);
+	}
+
+	return bytes + (hll->sparse_size * sizeof (uint32_t));
+}
+
+void hyperloglog_delete (hyperloglog* hll) {
+	free (hll->registers);
+	free (hll->sparse);
+	free (hll);
+	hll = NULL;
+}
@@ -0,0 +1,345 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+#include "parallel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+/*
+ * The parallel auto_array and set functions share a task_pool that is
+ * started on first use, or when the thread count is set. Each call holds
+ * a reference to the pool it runs on and the executor holds one more, so
+ * a pool replaced by auto_array_parallel_threads is deleted by whichever
+ * drops the last reference.
+ */
+
+typedef struct {
+	task_pool* pool;
+	size_t refs;
+} executor_ref;
+
+static pthread_mutex_t executor_lock = PTHREAD_MUTEX_INITIALIZER;
+static executor_ref* executor;
+
+static executor_ref* executor_ref_create (size_t threads) {
+	executor_ref* ref = malloc (sizeof (executor_ref));
+	if (ref == NULL) {
+		PERR ("malloc");
+		return NULL;
+	}
+
+	ref->pool = task_pool_create (threads);
+	if (ref->pool == NULL) {
+		free (ref);
+		return NULL;
+	}
+	ref->refs = 1;
+
+	return ref;
+}
+
+static executor_ref* executor_get () {
+	pthread_mutex_lock (&executor_lock);
+	if (executor == NULL) {
+		executor = executor_ref_create (0);
+	}
+	executor_ref* ref = executor;
+	if (ref != NULL) {
+		ref->refs++;
+	}
+	pthread_mutex_unlock (&executor_lock);
+
+	return ref;
+}
+
+static void executor_put (executor_ref* ref) {
+	pthread_mutex_lock (&executor_lock);
+	int last = --ref->refs == 0;
+	pthread_mutex_unlock (&executor_lock);
+
+	if (last) {
+		task_pool_delete (ref->pool);
+		free (ref);
+	}
+}
+
+/*
+ * Runs body over [0, n) in ranges of at least grain items. A grain of 0
+ * picks one that gives each thread about 8 ranges to balance with.
+ */
+static int parallel_run (size_t n, size_t grain, void (*body) (size_t lo, size_t hi, void* arg), void* arg) {
+	if (n == 0) {
+		return 0;
+	}
+
+	executor_ref* ref = executor_get ();
+	if (ref == NULL) {
+		return -1;
+	}
+
+	int rv = task_pool_parallel_for (ref->pool, n, grain, body, arg);
+	executor_put (ref);
+
+	return rv;
+}
+
+int sscont_parallel_for_range (size_t n, size_t grain, void (*body) (size_t lo, size_t hi, void* arg), void* arg) {
+	return parallel_run (n, grain, body, arg);
+}
+
+int auto_array_parallel_threads (size_t threads) {
+	executor_ref* ref = executor_ref_create (threads);
+	if (ref == NULL) {
+		return -1;
+	}
+
+	pthread_mutex_lock (&executor_lock);
+	executor_ref* old = executor;
+	executor = ref;
+	pthread_mutex_unlock (&executor_lock);
+
+	if (old != NULL) {
+		executor_put (old);
+	}
+
+	return 0;
+}
+
+typedef struct {
+	auto_array* aa;
+	auto_array* out;
+	void (*each) (void* item, size_t pos, void* ctx);
+	void* (*map) (void* item, void* ctx);
+	int (*keep) (void* item, void* ctx);
+	void* (*reduce) (void* acc, void* item, void* ctx);
+	void* ctx;
+	void* init;
+	size_t chunk;
+	size_t* offsets;
+	void** results;
+	unsigned char* kept;
+} parallel_args;
+
+static void for_body (size_t lo, size_t hi, void* arg) {
+	parallel_args* pa = arg;
+
+	for (size_t i = lo; i < hi; ++i) {
+		pa->each (pa->aa->data[i], i, pa->ctx);
+	}
+}
+
+int auto_array_parallel_for (auto_array* aa, void (*fn) (void* item, size_t pos, void* ctx), void* ctx) {
+	parallel_args pa = { .aa = aa, .each = fn, .ctx = ctx };
+
+	return parallel_run (aa->count, 0, for_body, &pa);
+}
+
+static void map_body (size_t lo, size_t hi, void* arg) {
+	parallel_args* pa = arg;
+
+	for (size_t i = lo; i < hi; ++i) {
+		pa->out->data[i] = pa->map (pa->aa->data[i], pa->ctx);
+	}
+}
+
+auto_array* auto_array_map (auto_array* aa, void* (*fn) (void* item, void* ctx), void* ctx) {
+	auto_array* out = auto_array_create_with (aa->count, aa->allocator);
+	if (out == NULL) {
+		PMSG ("auto_array_create_with failed");
+		return NULL;
+	}
+
+	parallel_args pa = { .aa = aa, .out = out, .map = fn, .ctx = ctx };
+
+	if (parallel_run (aa->count, 0, map_body, &pa) == -1) {
+		auto_array_delete (out, NULL);
+		return NULL;
+	}
+
+	out->count = aa->count;
+
+	return out;
+}
+
+/*
+ * filter and reduce work on fixed chunks so that the per chunk results
+ * can be combined in order. The chunks are still scheduled by the pool.
+ */
+static size_t chunk_count (size_t threads, size_t n, size_t* chunk) {
+	size_t chunks = threads * 8;
+
+	if (chunks == 0 || chunks > n) {
+		chunks = n;
+	}
+
+	*chunk = (n + chunks - 1) / chunks;
+
+	return (n + *chunk - 1) / *chunk;
+}
+
+static void filter_count_body (size_t lo, size_t hi, void* arg) {
+	parallel_args* pa = arg;
+
+	for (size_t c = lo; c < hi; ++c) {
+		size_t first = c * pa->chunk;
+		size_t last = first + pa->chunk < pa->aa->count ? first + pa->chunk : pa->aa->count;
+		size_t kept = 0;
+
+		for (size_t i = first; i < last; ++i) {
+			pa->kept[i] = pa->keep (pa->aa->data[i], pa->ctx) != 0;
+			kept += pa->kept[i];
+		}
+
+		pa->offsets[c + 1] = kept;
+	}
+}
+
+static void filter_copy_body (size_t lo, size_t hi, void* arg) {
+	parallel_args* pa = arg;
+
+	for (size_t c = lo; c < hi; ++c) {
+		size_t first = c * pa->chunk;
+		size_t last = first + pa->chunk < pa->aa->count ? first + pa->chunk : pa->aa->count;
+		void** dest = pa->out->data + pa->offsets[c];
+
+		for (size_t i = first; i < last; ++i) {
+			if (pa->kept[i]) {
+				*dest++ = pa->aa->data[i];
+			}
+		}
+	}
+}
+
+auto_array* auto_array_filter (auto_array* aa, int (*keep) (void* item, void* ctx), void* ctx) {
+	size_t n = aa->count;
+
+	if (n == 0) {
+		return auto_array_create_with (1, aa->allocator);
+	}
+
+	parallel_args pa = { .aa = aa, .keep = keep, .ctx = ctx };
+
+	// one pool for both passes, so the chunks match its thread count
+	executor_ref* ref = executor_get ();
+	if (ref == NULL) {
+		return NULL;
+	}
+	size_t chunks = chunk_count (ref->pool->threads, n, &pa.chunk);
+
+	auto_array* out = NULL;
+
+	pa.kept = malloc (n);
+	pa.offsets = calloc (chunks + 1, sizeof (size_t));
+	if (pa.kept == NULL || pa.offsets == NULL) {
+		PERR ("malloc");
+		goto done;
+	}
+
+	if (task_pool_parallel_for (ref->pool, chunks, 1, filter_count_body, &pa) == -1) {
+		goto done;
+	}
+
+	for (size_t c = 0; c < chunks; ++c) {
+		pa.offsets[c + 1] += pa.offsets[c];
+	}
+
+	out = auto_array_create_with (pa.offsets[chunks] > 0 ? pa.offsets[chunks] : 1, aa->allocator);
+	if (out == NULL) {
+		PMSG ("auto_array_create_with failed");
+		goto done;
+	}
+
+	pa.out = out;
+	if (task_pool_parallel_for (ref->pool, chunks, 1, filter_copy_body, &pa) == -1) {
+		auto_array_delete (out, NULL);
+		out = NULL;
+		goto done;
+	}
+
+	out->count = pa.offsets[chunks];
+
+done:
+	free (pa.kept);
+	free (pa.offsets);
+	executor_put (ref);
+
+	return out;
+}
+
+static void reduce_body (size_t lo, size_t hi, void* arg) {
+	parallel_args* pa = arg;
+
+	for (size_t c = lo; c < hi; ++c) {
+		size_t first = c * pa->chunk;
+		size_t last = first + pa->chunk < pa->aa->count ? first + pa->chunk : pa->aa->count;
+		void* acc = pa->init;
+
+		for (size_t i = first; i < last; ++i) {
+			acc = pa->reduce (acc, pa->aa->data[i], pa->ctx);
+		}
+
+		pa->results[c] = acc;
+	}
+}
+
+void* auto_array_reduce (auto_array* aa, void* init, void* (*fn) (void* acc, void* item, void* ctx),
+		void* (*combine) (void* left, void* right, void* ctx), void* ctx) {
+	size_t n = aa->count;
+
+	if (n == 0) {
+		return init;
+	}
+
+	parallel_args pa = { .aa = aa, .reduce = fn, .init = init, .ctx = ctx };
+
+	executor_ref* ref = executor_get ();
+	if (ref == NULL) {
+		return NULL;
+	}
+	size_t chunks = chunk_count (ref->pool->threads, n, &pa.chunk);
+
+	pa.results = malloc (chunks * sizeof (void*));
+	if (pa.results == NULL) {
+		PERR ("malloc");
+		executor_put (ref);
+		return NULL;
+	}
+
+	void* acc = NULL;
+	if (task_pool_parallel_for (ref->pool, chunks, 1, reduce_body, &pa) == 0) {
+		acc = pa.results[0];
+		for (size_t c = 1; c < chunks; ++c) {
+			acc = combine (acc, pa.results[c], ctx);
+		}
+	}
+
+	free (pa.results);
+	executor_put (ref);
+
+	return acc;
+}
@@ -0,0 +1,36 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+#include "container.h"
+
+/*
+ * The library side of the parallel container functions, which share the
+ * pool that auto_array_parallel_threads sizes. Calls body with ranges that
+ * together cover [0, n), splitting those larger than grain, or one picked
+ * from the thread count when grain is 0. Returns 0 or -1 on error.
+ */
+int sscont_parallel_for_range (size_t n, size_t grain, void (*body) (size_t lo, size_t hi, void* arg), void* arg);
+
+#endif // PARALLEL_H_
@@ -0,0 +1,289 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#include "container.h"
+#include "debug_utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* slabs start small so pools of a few objects stay small, and double up to this */
+#define POOL_FIRST_SLAB_OBJECTS 16
+#define POOL_MAX_SLAB_BYTES (64 * 1024)
+
+/* slabs start with their link, padded so that objects keep the slab's alignment */
+#define SLAB_HEADER 16
+
+/* a magazine holds up to POOL_MAGAZINE_SIZE objects and moves half of that at a time */
+#define POOL_MAGAZINE_SIZE 64
+
+typedef struct pool_magazine {
+	struct pool_magazine* next;
+	sscont_pool* pool;
+	size_t count;
+	void* objects[POOL_MAGAZINE_SIZE];
+} pool_magazine;
+
+struct sscont_pool_shared {
+	pthread_mutex_t lock;
+	pthread_key_t key;
+	pool_magazine* magazines;
+};
+
+/* takes an object from the free list or the newest slab, adding a slab if both are empty */
+static void* pool_take (sscont_pool* p) {
+	void* object = p->free_list;
+	if (object != NULL) {
+		p->free_list = *(void**) object;
+		return object;
+	}
+
+	if (p->bump == p->bump_end) {
+		size_t bytes = SLAB_HEADER + (p->slab_objects * p->object_size);
+		char* slab = sscont_alloc (p->parent, bytes);
+		if (slab == NULL) {
+			PERR ("malloc");
+			return NULL;
+		}
+
+		*(void**) slab = p->slabs;
+		p->slabs = slab;
+		p->bump = slab + SLAB_HEADER;
+		p->bump_end = slab + bytes;
+
+		if (p->slab_objects * p->object_size * 2 <= POOL_MAX_SLAB_BYTES) {
+			p->slab_objects *= 2;
+		}
+	}
+
+	object = p->bump;
+	p->bump += p->object_size;
+
+	return object;
+}
+
+static void pool_give (sscont_pool* p, void* object) {
+	*(void**) object = p->free_list;
+	p->free_list = object;
+}
+
+/* returns the objects of a magazine whose thread has exited */
+static void magazine_release (void* arg) {
+	pool_magazine* m = arg;
+	sscont_pool* p = m->pool;
+
+	pthread_mutex_lock (&p->shared->lock);
+	for (size_t i = 0; i < m->count; ++i) {
+		pool_give (p, m->objects[i]);
+	}
+
+	pool_magazine** link = &p->shared->magazines;
+	while (*link != m) {
+		link = &(*link)->next;
+	}
+	*link = m->next;
+	pthread_mutex_unlock (&p->shared->lock);
+
+	free (m);
+}
+
+static pool_magazine* magazine_of (sscont_pool* p) {
+	pool_magazine* m = pthread_getspecific (p->shared->key);
+	if (m != NULL) {
+		return m;
+	}
+
+	m = malloc (sizeof (pool_magazine));
+	if (m == NULL) {
+		PERR ("malloc");
+		return NULL;
+	}
+
+	m->pool = p;
+	m->count = 0;
+
+	pthread_mutex_lock (&p->shared->lock);
+	m->next = p->shared->magazines;
+	p->shared->magazines = m;
+	pthread_mutex_unlock (&p->shared->lock);
+
+	pthread_setspecific (p->shared->key, m);
+
+	return m;
+}
+
+void* sscont_pool_alloc (sscont_pool* p) {
+	if (p->shared == NULL) {
+		return pool_take (p);
+	}
+
+	pool_magazine* m = magazine_of (p);
+	if (m == NULL) {
+		return NULL;
+	}
+
+	if (m->count == 0) {
+		pthread_mutex_lock (&p->shared->lock);
+		while (m->count < POOL_MAGAZINE_SIZE / 2) {
+			void* object = pool_take (p);
+			if (object == NULL) {
+				break;
+			}
+			m->objects[m->count++] = object;
+		}
+		pthread_mutex_unlock (&p->shared->lock);
+
+		if (m->count == 0) {
+			return NULL;
+		}
+	}
+
+	return m->objects[--m->count];
+}
+
+void sscont_pool_free (sscont_pool* p, void* object) {
+	if (object == NULL) {
+		return;
+	}
+
+	if (p->shared == NULL) {
+		pool_give (p, object);
+		return;
+	}
+
+	pool_magazine* m = magazine_of (p);
+	if (m == NULL) {
+		pthread_mutex_lock (&p->shared->lock);
+		pool_give (p, object);
+		pthread_mutex_unlock (&p->shared->lock);
+		return;
+	}
+
+	if (m->count == POOL_MAGAZINE_SIZE) {
+		pthread_mutex_lock (&p->shared->lock);
+		while (m->count > POOL_MAGAZINE_SIZE / 2) {
+			pool_give (p, m->objects[--m->count]);
+		}
+		pthread_mutex_unlock (&p->shared->lock);
+	}
+
+	m->objects[m->count++] = object;
+}
+
+static void* pool_allocator_alloc (void* ctx, size_t size) {
+	sscont_pool* p = ctx;
+	if (size > p->object_size) {
+		PMSG ("allocation larger than the pool's objects");
+		return NULL;
+	}
+
+	return sscont_pool_alloc (p);
+}
+
+/* objects don't move, so a realloc only succeeds if the object is already large enough */
+static void* pool_allocator_realloc (void* ctx, void* ptr, size_t size) {
+	if (size > ((sscont_pool*) ctx)->object_size) {
+		PMSG ("allocation larger than the pool's objects");
+		return NULL;
+	}
+
+	return ptr;
+}
+
+static void pool_allocator_free (void* ctx, void* ptr) {
+	sscont_pool_free (ctx, ptr);
+}
+
+sscont_pool* sscont_pool_create (size_t object_size, int flags) {
+	return sscont_pool_create_with (object_size, flags, NULL);
+}
+
+sscont_pool* sscont_pool_create_with (size_t object_size, int flags, const sscont_allocator* parent) {
+	if (parent == NULL) {
+		parent = &sscont_malloc_allocator;
+	}
+
+	sscont_pool* p = sscont_alloc (parent, sizeof (sscont_pool));
+	if (p == NULL) {
+		PERR ("malloc");
+		return NULL;
+	}
+
+	object_size = object_size > sizeof (void*) ? object_size : sizeof (void*);
+	p->object_size = (object_size + 7) & ~(size_t) 7;
+	p->slab_objects = POOL_FIRST_SLAB_OBJECTS;
+	p->free_list = NULL;
+	p->slabs = NULL;
+	p->bump = NULL;
+	p->bump_end = NULL;
+	p->parent = parent;
+	p->shared = NULL;
+	p->allocator = (sscont_allocator) { pool_allocator_alloc, pool_allocator_realloc, pool_allocator_free, p };
+
+	if (flags & SSCONT_POOL_THREADED) {
+		p->shared = malloc (sizeof (sscont_pool_shared));
+		if (p->shared == NULL) {
+			PERR ("malloc");
+			sscont_free (parent, p);
+			return NULL;
+		}
+
+		int rv;
+		if ((rv = pthread_key_create (&p->shared->key, magazine_release)) != 0) {
+			fprintf (stderr, "pthread_key_create: %s\n", strerror (rv));
+			free (p->shared);
+			sscont_free (parent, p);
+			return NULL;
+		}
+
+		pthread_mutex_init (&p->shared->lock, NULL);
+		p->shared->magazines = NULL;
+	}
+
+	return p;
+}
+
+void sscont_pool_delete (sscont_pool* p) {
+	if (p->shared != NULL) {
+		pthread_key_delete (p->shared->key);
+		pool_magazine* m = p->shared->magazines;
+		while (m != NULL) {
+			pool_magazine* next = m->next;
+			free (m);
+			m = next;
+		}
+		pthread_mutex_destroy (&p->shared->lock);
+		free (p->shared);
+	}
+
+	void* slab = p->slabs;
+	while (slab != NULL) {
+		void* next = *(void**) slab;
+		sscont_free (p->parent, slab);
+		slab = next;
+	}
+
+	sscont_free (p->parent, p);
+	p = NULL;
+}
@@ -0,0 +1,1364 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#include "container.h"
+#include "debug_utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Each 64K chunk of the value space is a container holding the low 16
+ * bits of its values: a sorted array while it has at most ARRAY_MAX
+ * values, otherwise a bitmap, or a list of runs when that is smaller.
+ * Runs are pairs of (start, length - 1).
+ */
+
+#define ARRAY_MAX 4096
+#define BITMAP_WORDS 1024
+#define BITMAP_BYTES (BITMAP_WORDS * sizeof (uint64_t))
+
+/* cookies of the Roaring serialization format */
+#define SERIAL_COOKIE_NO_RUN 12346
+#define SERIAL_COOKIE 12347
+#define NO_OFFSET_THRESHOLD 4
+
+/***************************************************************************************
+ * 				containers
+*/
+
+static size_t count_scalar (const uint64_t* words, size_t n) {
+	size_t bits = 0;
+
+	for (size_t i = 0; i < n; ++i) {
+		bits += __builtin_popcountll (words[i]);
+	}
+
+	return bits;
+}
+
+#if defined (__x86_64__)
+
+__attribute__ ((target ("popcnt")))
+static size_t count_popcnt (const uint64_t* words, size_t n) {
+	size_t bits = 0;
+
+	for (size_t i = 0; i < n; ++i) {
+		bits += __builtin_popcountll (words[i]);
+	}
+
+	return bits;
+}
+
+#endif
+
+/* counts the bits of bitmap words, using the popcnt instruction if the cpu has it */
+static size_t (*count_bits) (const uint64_t* words, size_t n) = count_scalar;
+
+__attribute__ ((constructor))
+static void select_kernels () {
+#if defined (__x86_64__)
+	__builtin_cpu_init ();
+
+	if (__builtin_cpu_supports ("popcnt")) {
+		count_bits = count_popcnt;
+	}
+#endif
+}
+
+static int container_reserve (roaring_container* c, size_t bytes) {
+	if (bytes <= c->size) {
+		return 0;
+	}
+
+	size_t s = c->size * 2 > bytes ? c->size * 2 : bytes;
+	void* tmp = realloc (c->data, s);
+	if (tmp == NULL) {
+		PERR ("realloc");
+		return -1;
+	}
+
+	c->data = tmp;
+	c->size = s;
+
+	return 0;
+}
+
+/* the bytes of data in use */
+static size_t container_bytes (const roaring_container* c) {
+	switch (c->type) {
+		case ROARING_ARRAY:
+			return c->n * sizeof (uint16_t);
+		case ROARING_BITMAP:
+			return BITMAP_BYTES;
+		default:
+			return c->n * 4;
+	}
+}
+
+/* gives back the unused part of the allocation, which only matters for memory use */
+static void container_shrink (roaring_container* c) {
+	size_t bytes = container_bytes (c);
+
+	if (bytes > 0 && bytes < c->size) {
+		void* tmp = realloc (c->data, bytes);
+		if (tmp != NULL) {
+			c->data = tmp;
+			c->size = bytes;
+		}
+	}
+}
+
+/* the first position in values [0, n) that is >= v */
+static size_t lower_bound16 (const uint16_t* values, size_t n, uint16_t v) {
+	size_t lo = 0;
+
+	while (lo < n) {
+		size_t mid = lo + ((n - lo) / 2);
+		if (values[mid] < v) {
+			lo = mid + 1;
+		} else {
+			n = mid;
+		}
+	}
+
+	return lo;
+}
+
+/* the index of the last run starting at or before v, or -1 */
+static ssize_t run_find (const uint16_t* runs, size_t n, uint16_t v) {
+	size_t lo = 0;
+
+	while (lo < n) {
+		size_t mid = lo + ((n - lo) / 2);
+		if (runs[mid * 2] <= v) {
+			lo = mid + 1;
+		} else {
+			n = mid;
+		}
+	}
+
+	return (ssize_t) lo - 1;
+}
+
+static int container_contains (const roaring_container* c, uint16_t v) {
+	const uint16_t* values = c->data;
+
+	switch (c->type) {
+		case ROARING_ARRAY: {
+			size_t pos = lower_bound16 (values, c->n, v);
+			return pos < c->n && values[pos] == v;
+		}
+		case ROARING_BITMAP:
+			return (((const uint64_t*) c->data)[v / 64] >> (v % 64)) & 1;
+		default: {
+			ssize_t i = run_find (values, c->n, v);
+			return i != -1 && v <= values[i * 2] + values[(i * 2) + 1];
+		}
+	}
+}
+
+/* sets bits [lo, hi) */
+static void words_set_range (uint64_t* words, uint32_t lo, uint32_t hi) {
+	while (lo < hi) {
+		uint32_t w = lo / 64;
+		uint32_t end = (w + 1) * 64 < hi ? (w + 1) * 64 : hi;
+		uint32_t bits = end - lo;
+		uint64_t mask = bits == 64 ? ~0ULL : ((1ULL << bits) - 1) << (lo % 64);
+
+		words[w] |= mask;
+		lo = end;
+	}
+}
+
+/* the container as a bitmap, which is the container's own storage if it is one */
+static const uint64_t* container_words (const roaring_container* c, uint64_t* scratch) {
+	const uint16_t* values = c->data;
+
+	if (c->type == ROARING_BITMAP) {
+		return c->data;
+	}
+
+	memset (scratch, 0, BITMAP_BYTES);
+
+	if (c->type == ROARING_ARRAY) {
+		for (uint32_t i = 0; i < c->n; ++i) {
+			scratch[values[i] / 64] |= 1ULL << (values[i] % 64);
+		}
+	} else {
+		for (uint32_t i = 0; i < c->n; ++i) {
+			uint32_t start = values[i * 2];
+			words_set_range (scratch, start, start + values[(i * 2) + 1] + 1);
+		}
+	}
+
+	return scratch;
+}
+
+/*
+ * Stores a bitmap in c as whichever of array, bitmap or runs is smallest.
+ * An empty bitmap leaves c empty with cardinality 0.
+ */
+static int container_from_words (roaring_container* c, const uint64_t* words) {
+	uint32_t card = count_bits (words, BITMAP_WORDS);
+	uint32_t runs = 0;
+	uint64_t prev = 0;
+
+	for (size_t i = 0; i < BITMAP_WORDS; ++i) {
+		runs += __builtin_popcountll (words[i] & ~((words[i] << 1) | (prev >> 63)));
+		prev = words[i];
+	}
+
+	c->cardinality = card;
+	if (card == 0) {
+		c->n = 0;
+		return 0;
+	}
+
+	size_t run_bytes = 2 + (runs * 4);
+	size_t array_bytes = card <= ARRAY_MAX ? card * 2 : BITMAP_BYTES + 1;
+
+	if (run_bytes < array_bytes && run_bytes < BITMAP_BYTES) {
+		if (container_reserve (c, runs * 4) == -1) {
+			return -1;
+		}
+
+		uint16_t* out = c->data;
+		uint32_t n = 0;
+		uint32_t v = 0;
+
+		while (v < 65536) {
+			uint64_t w = words[v / 64] >> (v % 64);
+			if (w == 0) {
+				v = ((v / 64) + 1) * 64;
+				continue;
+			}
+
+			v += __builtin_ctzll (w);
+			uint32_t start = v;
+			while (v < 65536 && ((words[v / 64] >> (v % 64)) & 1)) {
+				uint64_t ones = ~(words[v / 64] >> (v % 64));
+				v += ones == 0 ? 64 - (v % 64) : (uint32_t) __builtin_ctzll (ones);
+			}
+
+			out[n * 2] = start;
+			out[(n * 2) + 1] = v - start - 1;
+			n++;
+		}
+
+		c->type = ROARING_RUN;
+		c->n = n;
+	} else if (card <= ARRAY_MAX) {
+		if (container_reserve (c, card * 2) == -1) {
+			return -1;
+		}
+
+		uint16_t* out = c->data;
+		uint32_t n = 0;
+		for (size_t i = 0; i < BITMAP_WORDS; ++i) {
+			for (uint64_t w = words[i]; w != 0; w &= w - 1) {
+				out[n++] = (i * 64) + __builtin_ctzll (w);
+			}
+		}
+
+		c->type = ROARING_ARRAY;
+		c->n = n;
+	} else {
+		if (c->data != words) {
+			if (container_reserve (c, BITMAP_BYTES) == -1) {
+				return -1;
+			}
+			memcpy (c->data, words, BITMAP_BYTES);
+		}
+
+		c->type = ROARING_BITMAP;
+		c->n = BITMAP_WORDS;
+	}
+
+	return 0;
+}
+
+static int array_to_bitmap (roaring_container* c) {
+	uint64_t* words = calloc (BITMAP_WORDS, sizeof (uint64_t));
+	if (words == NULL) {
+		PERR ("calloc");
+		return -1;
+	}
+
+	const uint16_t* values = c->data;
+	for (uint32_t i = 0; i < c->n; ++i) {
+		words[values[i] / 64] |= 1ULL << (values[i] % 64);
+	}
+
+	free (c->data);
+	c->data = words;
+	c->size = BITMAP_BYTES;
+	c->type = ROARING_BITMAP;
+	c->n = BITMAP_WORDS;
+
+	return 0;
+}
+
+static int bitmap_to_array (roaring_container* c) {
+	uint16_t* values = malloc ((c->cardinality > 0 ? c->cardinality : 1) * sizeof (uint16_t));
+	if (values == NULL) {
+		PERR ("malloc");
+		return -1;
+	}
+
+	const uint64_t* words = c->data;
+	uint32_t n = 0;
+	for (size_t i = 0; i < BITMAP_WORDS; ++i) {
+		for (uint64_t w = words[i]; w != 0; w &= w - 1) {
+			values[n++] = (i * 64) + __builtin_ctzll (w);
+		}
+	}
+
+	free (c->data);
+	c->data = values;
+	c->size = n * sizeof (uint16_t);
+	c->type = ROARING_ARRAY;
+	c->n = n;
+
+	return 0;
+}
+
+/* returns 1 if v was added, 0 if it was present or -1 if an error occurs */
+static int run_add (roaring_container* c, uint16_t v) {
+	uint16_t* runs = c->data;
+	ssize_t i = run_find (runs, c->n, v);
+
+	if (i != -1 && v <= runs[i * 2] + runs[(i * 2) + 1]) {
+		return 0;
+	}
+
+	size_t next = i + 1;
+	int joins_prev = i != -1 && v == runs[i * 2] + runs[(i * 2) + 1] + 1;
+	int joins_next = next < c->n && v + 1 == runs[next * 2];
+
+	if (joins_prev && joins_next) {
+		runs[(i * 2) + 1] += runs[(next * 2) + 1] + 2;
+		memmove (runs + (next * 2), runs + ((next + 1) * 2), (c->n - next - 1) * 4);
+		c->n--;
+	} else if (joins_prev) {
+		runs[(i * 2) + 1]++;
+	} else if (joins_next) {
+		runs[next * 2]--;
+		runs[(next * 2) + 1]++;
+	} else {
+		if (container_reserve (c, (c->n + 1) * 4) == -1) {
+			return -1;
+		}
+		runs = c->data;
+		memmove (runs + ((next + 1) * 2), runs + (next * 2), (c->n - next) * 4);
+		runs[next * 2] = v;
+		runs[(next * 2) + 1] = 0;
+		c->n++;
+	}
+
+	c->cardinality++;
+
+	return 1;
+}
+
+/* returns 1 if v was removed, 0 if it was absent or -1 if an error occurs */
+static int run_remove (roaring_container* c, uint16_t v) {
+	uint16_t* runs = c->data;
+	ssize_t i = run_find (runs, c->n, v);
+
+	if (i == -1 || v > runs[i * 2] + runs[(i * 2) + 1]) {
+		return 0;
+	}
+
+	uint32_t start = runs[i * 2];
+	uint32_t end = start + runs[(i * 2) + 1];
+
+	if (start == end) {
+		memmove (runs + (i * 2), runs + ((i + 1) * 2), (c->n - i - 1) * 4);
+		c->n--;
+	} else if (v == start) {
+		runs[i * 2]++;
+		runs[(i * 2) + 1]--;
+	} else if (v == end) {
+		runs[(i * 2) + 1]--;
+	} else {
+		if (container_reserve (c, (c->n + 1) * 4) == -1) {
+			return -1;
+		}
+		runs = c->data;
+		memmove (runs + ((i + 2) * 2), runs + ((i + 1) * 2), (c->n - i - 1) * 4);
+		runs[(i * 2) + 1] = v - start - 1;
+		runs[(i + 1) * 2] = v + 1;
+		runs[((i + 1) * 2) + 1] = end - v - 1;
+		c->n++;
+	}
+
+	c->cardinality--;
+
+	return 1;
+}
+
+static int container_add (roaring_container* c, uint16_t v) {
+	if (c->type == ROARING_RUN) {
+		return run_add (c, v);
+	}
+
+	if (c->type == ROARING_BITMAP) {
+		uint64_t* w = &((uint64_t*) c->data)[v / 64];
+		uint64_t bit = 1ULL << (v % 64);
+		if (*w & bit) {
+			return 0;
+		}
+		*w |= bit;
+		c->cardinality++;
+		return 1;
+	}
+
+	uint16_t* values = c->data;
+	size_t pos = lower_bound16 (values, c->n, v);
+	if (pos < c->n && values[pos] == v) {
+		return 0;
+	}
+
+	if (c->n == ARRAY_MAX) {
+		if (array_to_bitmap (c) == -1) {
+			return -1;
+		}
+		return container_add (c, v);
+	}
+
+	if (container_reserve (c, (c->n + 1) * sizeof (uint16_t)) == -1) {
+		return -1;
+	}
+
+	values = c->data;
+	memmove (values + pos + 1, values + pos, (c->n - pos) * sizeof (uint16_t));
+	values[pos] = v;
+	c->n++;
+	c->cardinality++;
+
+	return 1;
+}
+
+static int container_remove (roaring_container* c, uint16_t v) {
+	if (c->type == ROARING_RUN) {
+		return run_remove (c, v);
+	}
+
+	if (c->type == ROARING_BITMAP) {
+		uint64_t* w = &((uint64_t*) c->data)[v / 64];
+		uint64_t bit = 1ULL << (v % 64);
+		if ((*w & bit) == 0) {
+			return 0;
+		}
+		*w &= ~bit;
+		c->cardinality--;
+		if (c->cardinality <= ARRAY_MAX && bitmap_to_array (c) == -1) {
+			return -1;
+		}
+		return 1;
+	}
+
+	uint16_t* values = c->data;
+	size_t pos = lower_bound16 (values, c->n, v);
+	if (pos == c->n || values[pos] != v) {
+		return 0;
+	}
+
+	memmove (values + pos, values + pos + 1, (c->n - pos - 1) * sizeof (uint16_t));
+	c->n--;
+	c->cardinality--;
+
+	return 1;
+}
+
+/* the number of values <= v */
+static uint32_t container_rank (const roaring_container* c, uint16_t v) {
+	const uint16_t* values = c->data;
+
+	if (c->type == ROARING_ARRAY) {
+		size_t pos = lower_bound16 (values, c->n, v);
+		return pos < c->n && values[pos] == v ? pos + 1 : pos;
+	}
+
+	if (c->type == ROARING_BITMAP) {
+		const uint64_t* words = c->data;
+		uint32_t rank = count_bits (words, v / 64);
+		uint64_t mask = (v % 64) == 63 ? ~0ULL : (2ULL << (v % 64)) - 1;
+		return rank + __builtin_popcountll (words[v / 64] & mask);
+	}
+
+	uint32_t rank = 0;
+	for (uint32_t i = 0; i < c->n && values[i * 2] <= v; ++i) {
+		uint32_t end = values[i * 2] + values[(i * 2) + 1];
+		rank += (v < end ? v : end) - values[i * 2] + 1;
+	}
+
+	return rank;
+}
+
+/* the value at position i, which is less than the cardinality */
+static uint16_t container_select (const roaring_container* c, uint32_t i) {
+	const uint16_t* values = c->data;
+
+	if (c->type == ROARING_ARRAY) {
+		return values[i];
+	}
+
+	if (c->type == ROARING_BITMAP) {
+		const uint64_t* words = c->data;
+		size_t w = 0;
+		for (uint32_t block = count_bits (words, 16); i >= block; block = count_bits (words + w, 16)) {
+			i -= block;
+			w += 16;
+		}
+		while (i >= (uint32_t) __builtin_popcountll (words[w])) {
+			i -= __builtin_popcountll (words[w]);
+			w++;
+		}
+
+		uint64_t bits = words[w];
+		while (i-- > 0) {
+			bits &= bits - 1;
+		}
+		return (w * 64) + __builtin_ctzll (bits);
+	}
+
+	size_t r = 0;
+	while (i > values[(r * 2) + 1]) {
+		i -= values[(r * 2) + 1] + 1;
+		r++;
+	}
+
+	return values[r * 2] + i;
+}
+
+static int container_copy (roaring_container* dst, const roaring_container* src) {
+	size_t bytes = container_bytes (src);
+
+	*dst = *src;
+	dst->size = bytes > 0 ? bytes : 1;
+	dst->data = malloc (dst->size);
+	if (dst->data == NULL) {
+		PERR ("malloc");
+		return -1;
+	}
+
+	memcpy (dst->data, src->data, bytes);
+
+	return 0;
+}
+
+/***************************************************************************************
+ * 				container algebra
+*/
+
+/* values of the array a kept when their membership in b equals keep */
+static int array_filter (roaring_container* out, const roaring_container* a, const roaring_container* b, int keep) {
+	if (container_reserve (out, a->n * sizeof (uint16_t)) == -1) {
+		return -1;
+	}
+
+	const uint16_t* values = a->data;
+	uint16_t* dst = out->data;
+	uint32_t n = 0;
+
+	for (uint32_t i = 0; i < a->n; ++i) {
+		if (container_contains (b, values[i]) == keep) {
+			dst[n++] = values[i];
+		}
+	}
+
+	out->type = ROARING_ARRAY;
+	out->n = n;
+	out->cardinality = n;
+
+	return 0;
+}
+
+/* merges two arrays, keeping common values once for a union or only common values for an intersection */
+static int array_merge (roaring_container* out, const roaring_container* a, const roaring_container* b, int union_op) {
+	if (container_reserve (out, (union_op ? a->n + b->n : (a->n < b->n ? a->n : b->n)) * sizeof (uint16_t)) == -1) {
+		return -1;
+	}
+
+	const uint16_t* x = a->data;
+	const uint16_t* y = b->data;
+	uint16_t* dst = out->data;
+	uint32_t i = 0;
+	uint32_t j = 0;
+	uint32_t n = 0;
+
+	while (i < a->n && j < b->n) {
+		if (x[i] < y[j]) {
+			if (union_op) {
+				dst[n++] = x[i];
+			}
+			i++;
+		} else if (y[j] < x[i]) {
+			if (union_op) {
+				dst[n++] = y[j];
+			}
+			j++;
+		} else {
+			dst[n++] = x[i];
+			i++;
+			j++;
+		}
+	}
+
+	if (union_op) {
+		memcpy (dst + n, x + i, (a->n - i) * sizeof (uint16_t));
+		n += a->n - i;
+		memcpy (dst + n, y + j, (b->n - j) * sizeof (uint16_t));
+		n += b->n - j;
+	}
+
+	out->type = ROARING_ARRAY;
+	out->n = n;
+	out->cardinality = n;
+
+	return 0;
+}
+
+enum { OP_AND, OP_OR, OP_ANDNOT };
+
+/* out = a op b through bitmaps, with scratch space for 2 bitmaps */
+static int words_op (roaring_container* out, const roaring_container* a, const roaring_container* b, int op, uint64_t* scratch) {
+	const uint64_t* wa = container_words (a, scratch);
+	const uint64_t* wb = container_words (b, scratch + BITMAP_WORDS);
+	uint64_t* dst = scratch;
+
+	for (size_t i = 0; i < BITMAP_WORDS; ++i) {
+		dst[i] = op == OP_AND ? wa[i] & wb[i] : op == OP_OR ? wa[i] | wb[i] : wa[i] & ~wb[i];
+	}
+
+	return container_from_words (out, dst);
+}
+
+static int container_op (roaring_container* out, const roaring_container* a, const roaring_container* b, int op, uint64_t* scratch) {
+	int a_array = a->type == ROARING_ARRAY;
+	int b_array = b->type == ROARING_ARRAY;
+
+	switch (op) {
+		case OP_AND:
+			if (a_array && b_array) {
+				return array_merge (out, a, b, 0);
+			}
+			if (a_array || b_array) {
+				return a_array ? array_filter (out, a, b, 1) : array_filter (out, b, a, 1);
+			}
+			break;
+		case OP_OR:
+			if (a_array && b_array && a->cardinality + b->cardinality <= ARRAY_MAX) {
+				return array_merge (out, a, b, 1);
+			}
+			break;
+		case OP_ANDNOT:
+			if (a_array) {
+				return array_filter (out, a, b, 0);
+			}
+			break;
+	}
+
+	return words_op (out, a, b, op, scratch);
+}
+
+/***************************************************************************************
+ * 				roaring
+*/
+
+roaring* roaring_create () {
+	roaring* r = malloc (sizeof (roaring));
+	if (r == NULL) {
+		PERR ("malloc");
+		return NULL;
+	}
+
+	r->size = 4;
+	r->count = 0;
+	r->ranks = NULL;
+	r->ranks_count = 0;
+	r->containers = malloc (r->size * sizeof (roaring_container));
+	if (r->containers == NULL) {
+		PERR ("malloc");
+		free (r);
+		return NULL;
+	}
+
+	return r;
+}
+
+/* the position of the container for key, or where it would be inserted */
+static size_t find_container (roaring* r, uint16_t key) {
+	size_t lo = 0;
+	size_t hi = r->count;
+
+	// values are usually added in ascending order
+	if (hi > 0 && r->containers[hi - 1].key < key) {
+		return hi;
+	}
+
+	while (lo < hi) {
+		size_t mid = lo + ((hi - lo) / 2);
+		if (r->containers[mid].key < key) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+static roaring_container* insert_container (roaring* r, size_t pos, uint16_t key) {
+	if (r->count == r->size) {
+		size_t s = r->size * 2;
+		roaring_container* tmp = realloc (r->containers, s * sizeof (roaring_container));
+		if (tmp == NULL) {
+			PERR ("realloc");
+			return NULL;
+		}
+		r->containers = tmp;
+		r->size = s;
+	}
+
+	memmove (r->containers + pos + 1, r->containers + pos, (r->count - pos) * sizeof (roaring_container));
+	r->count++;
+
+	roaring_container* c = &r->containers[pos];
+	c->key = key;
+	c->type = ROARING_ARRAY;
+	c->cardinality = 0;
+	c->n = 0;
+	c->size = 0;
+	c->data = NULL;
+
+	return c;
+}
+
+static void remove_container (roaring* r, size_t pos) {
+	free (r->containers[pos].data);
+	memmove (r->containers + pos, r->containers + pos + 1, (r->count - pos - 1) * sizeof (roaring_container));
+	r->count--;
+}
+
+int roaring_add (roaring* r, uint32_t value) {
+	uint16_t key = value >> 16;
+	r->ranks_count = 0;
+	size_t pos = find_container (r, key);
+	roaring_container* c;
+
+	if (pos < r->count && r->containers[pos].key == key) {
+		c = &r->containers[pos];
+	} else {
+		c = insert_container (r, pos, key);
+		if (c == NULL) {
+			return -1;
+		}
+	}
+
+	int rv = container_add (c, value & 0xffff);
+	if (c->cardinality == 0) {
+		remove_container (r, pos);
+	}
+
+	return rv;
+}
+
+int roaring_add_range (roaring* r, uint32_t lo, uint32_t hi) {
+	uint64_t scratch[BITMAP_WORDS];
+	r->ranks_count = 0;
+
+	for (uint64_t v = lo; v < hi; ) {
+		uint16_t key = v >> 16;
+		uint64_t chunk_end = ((uint64_t) key + 1) << 16;
+		uint64_t end = chunk_end < hi ? chunk_end : hi;
+		size_t pos = find_container (r, key);
+		roaring_container* c;
+
+		if (pos < r->count && r->containers[pos].key == key) {
+			c = &r->containers[pos];
+			const uint64_t* words = container_words (c, scratch);
+			if (words != scratch) {
+				memcpy (scratch, words, BITMAP_BYTES);
+			}
+		} else {
+			c = insert_container (r, pos, key);
+			if (c == NULL) {
+				return -1;
+			}
+			memset (scratch, 0, BITMAP_BYTES);
+		}
+
+		words_set_range (scratch, v & 0xffff, end - ((uint64_t) key << 16));
+		if (container_from_words (c, scratch) == -1) {
+			return -1;
+		}
+
+		v = end;
+	}
+
+	return 0;
+}
+
+int roaring_remove (roaring* r, uint32_t value) {
+	uint16_t key = value >> 16;
+	r->ranks_count = 0;
+	size_t pos = find_container (r, key);
+
+	if (pos == r->count || r->containers[pos].key != key) {
+		return 0;
+	}
+
+	int rv = container_remove (&r->containers[pos], value & 0xffff);
+	if (r->containers[pos].cardinality == 0) {
+		remove_container (r, pos);
+	}
+
+	return rv;
+}
+
+int roaring_contains (roaring* r, uint32_t value) {
+	uint16_t key = value >> 16;
+	size_t pos = find_container (r, key);
+
+	if (pos == r->count || r->containers[pos].key != key) {
+		return 0;
+	}
+
+	return container_contains (&r->containers[pos], value & 0xffff);
+}
+
+uint64_t roaring_cardinality (roaring* r) {
+	uint64_t n = 0;
+
+	for (size_t i = 0; i < r->count; ++i) {
+		n += r->containers[i].cardinality;
+	}
+
+	return n;
+}
+
+/* brings the ranks of the containers up to date after a change */
+static int ranks_update (roaring* r) {
+	if (r->ranks_count == r->count && r->ranks != NULL) {
+		return 0;
+	}
+
+	uint64_t* ranks = realloc (r->ranks, (r->count + 1) * sizeof (uint64_t));
+	if (ranks == NULL) {
+		PERR ("realloc");
+		return -1;
+	}
+
+	ranks[0] = 0;
+	for (size_t i = 0; i < r->count; ++i) {
+		ranks[i + 1] = ranks[i] + r->containers[i].cardinality;
+	}
+
+	r->ranks = ranks;
+	r->ranks_count = r->count;
+
+	return 0;
+}
+
+uint64_t roaring_rank (roaring* r, uint32_t value) {
+	uint16_t key = value >> 16;
+	size_t pos = find_container (r, key);
+	uint64_t rank = 0;
+
+	if (ranks_update (r) == 0) {
+		rank = r->ranks[pos];
+	} else {
+		for (size_t i = 0; i < pos; ++i) {
+			rank += r->containers[i].cardinality;
+		}
+	}
+
+	if (pos < r->count && r->containers[pos].key == key) {
+		rank += container_rank (&r->containers[pos], value & 0xffff);
+	}
+
+	return rank;
+}
+
+int roaring_select (roaring* r, uint64_t rank, uint32_t* value) {
+	if (ranks_update (r) == -1 || rank >= r->ranks[r->count]) {
+		return -1;
+	}
+
+	// the last container whose first value has a rank <= rank
+	size_t lo = 0;
+	size_t hi = r->count;
+	while (hi - lo > 1) {
+		size_t mid = lo + ((hi - lo) / 2);
+		if (r->ranks[mid] <= rank) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+
+	roaring_container* c = &r->containers[lo];
+	*value = ((uint32_t) c->key << 16) | container_select (c, rank - r->ranks[lo]);
+
+	return 0;
+}
+
+size_t roaring_to_array (roaring* r, uint32_t* values) {
+	uint64_t scratch[BITMAP_WORDS];
+	size_t n = 0;
+
+	for (size_t i = 0; i < r->count; ++i) {
+		roaring_container* c = &r->containers[i];
+		uint32_t high = (uint32_t) c->key << 16;
+
+		if (c->type == ROARING_ARRAY) {
+			const uint16_t* low = c->data;
+			for (uint32_t j = 0; j < c->n; ++j) {
+				values[n++] = high | low[j];
+			}
+			continue;
+		}
+
+		const uint64_t* words = container_words (c, scratch);
+		for (size_t w = 0; w < BITMAP_WORDS; ++w) {
+			for (uint64_t bits = words[w]; bits != 0; bits &= bits - 1) {
+				values[n++] = high | ((w * 64) + __builtin_ctzll (bits));
+			}
+		}
+	}
+
+	return n;
+}
+
+/* the number of runs of consecutive values in an array container */
+static uint32_t array_runs (const roaring_container* c) {
+	const uint16_t* values = c->data;
+	uint32_t runs = c->n > 0;
+
+	for (uint32_t i = 1; i < c->n; ++i) {
+		runs += values[i] != values[i - 1] + 1;
+	}
+
+	return runs;
+}
+
+static int array_to_runs (roaring_container* c, uint32_t runs) {
+	uint16_t* out = malloc (runs * 4);
+	if (out == NULL) {
+		PERR ("malloc");
+		return -1;
+	}
+
+	const uint16_t* values = c->data;
+	uint32_t n = 0;
+	for (uint32_t i = 0; i < c->n; ++i) {
+		if (i > 0 && values[i] == values[i - 1] + 1) {
+			out[(n * 2) - 1]++;
+		} else {
+			out[n * 2] = values[i];
+			out[(n * 2) + 1] = 0;
+			n++;
+		}
+	}
+
+	free (c->data);
+	c->data = out;
+	c->size = runs * 4;
+	c->type = ROARING_RUN;
+	c->n = runs;
+
+	return 0;
+}
+
+int roaring_optimize (roaring* r) {
+	uint64_t scratch[BITMAP_WORDS];
+
+	for (size_t i = 0; i < r->count; ++i) {
+		roaring_container* c = &r->containers[i];
+
+		// arrays, which are most containers of sparse sets, are checked without a bitmap
+		if (c->type == ROARING_ARRAY) {
+			uint32_t runs = array_runs (c);
+			if (2 + (runs * 4) < c->n * 2) {
+				if (array_to_runs (c, runs) == -1) {
+					return -1;
+				}
+			} else {
+				container_shrink (c);
+			}
+			continue;
+		}
+
+		const uint64_t* words = container_words (c, scratch);
+		if (words != scratch) {
+			memcpy (scratch, words, BITMAP_BYTES);
+		}
+
+		if (container_from_words (c, scratch) == -1) {
+			return -1;
+		}
+		container_shrink (c);
+	}
+
+	return 0;
+}
+
+size_t roaring_size_in_bytes (roaring* r) {
+	size_t bytes = sizeof (roaring) + (r->size * sizeof (roaring_container));
+
+	for (size_t i = 0; i < r->count; ++i) {
+		bytes += r->containers[i].size;
+	}
+
+	return bytes;
+}
+
+/*
+ * Walks the keys of a and b in order. Containers whose key is only in a
+ * are copied when copy_a is set, likewise for b; containers in both are
+ * combined with op and kept if the result is not empty.
+ */
+static roaring* roaring_op (roaring* a, roaring* b, int op, int copy_a, int copy_b) {
+	uint64_t scratch[2 * BITMAP_WORDS];
+
+	roaring* rv = roaring_create ();
+	if (rv == NULL) {
+		return NULL;
+	}
+
+	size_t i = 0;
+	size_t j = 0;
+
+	while (i < a->count || j < b->count) {
+		roaring_container* ca = i < a->count ? &a->containers[i] : NULL;
+		roaring_container* cb = j < b->count ? &b->containers[j] : NULL;
+		roaring_container* src = NULL;
+
+		if (cb == NULL || (ca != NULL && ca->key < cb->key)) {
+			src = copy_a ? ca : NULL;
+			i++;
+		} else if (ca == NULL || cb->key < ca->key) {
+			src = copy_b ? cb : NULL;
+			j++;
+		} else {
+			roaring_container* c = insert_container (rv, rv->count, ca->key);
+			if (c == NULL || container_op (c, ca, cb, op, scratch) == -1) {
+				roaring_delete (rv);
+				return NULL;
+			}
+			if (c->cardinality == 0) {
+				remove_container (rv, rv->count - 1);
+			} else {
+				container_shrink (c);
+			}
+			i++;
+			j++;
+			continue;
+		}
+
+		if (src != NULL) {
+			if (insert_container (rv, rv->count, src->key) == NULL
+					|| container_copy (&rv->containers[rv->count - 1], src) == -1) {
+				roaring_delete (rv);
+				return NULL;
+			}
+		}
+
+		// nothing more can be produced once a is exhausted for and and andnot
+		if (!copy_b && i == a->count) {
+			break;
+		}
+	}
+
+	return rv;
+}
+
+roaring* roaring_union (roaring* a, roaring* b) {
+	return roaring_op (a, b, OP_OR, 1, 1);
+}
+
+roaring* roaring_intersection (roaring* a, roaring* b) {
+	return roaring_op (a, b, OP_AND, 0, 0);
+}
+
+roaring* roaring_andnot (roaring* a, roaring* b) {
+	return roaring_op (a, b, OP_ANDNOT, 1, 0);
+}
+
+/***************************************************************************************
+ * 				serialization
+*/
+
+static uint8_t* put16 (uint8_t* p, uint16_t v) {
+	p[0] = v;
+	p[1] = v >> 8;
+
+	return p + 2;
+}
+
+static uint8_t* put32 (uint8_t* p, uint32_t v) {
+	p = put16 (p, v);
+
+	return put16 (p, v >> 16);
+}
+
+static uint16_t get16 (const uint8_t* p) {
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32 (const uint8_t* p) {
+	return get16 (p) | ((uint32_t) get16 (p + 2) << 16);
+}
+
+static int has_runs (roaring* r) {
+	for (size_t i = 0; i < r->count; ++i) {
+		if (r->containers[i].type == ROARING_RUN) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static size_t container_serialized_size (const roaring_container* c) {
+	return container_bytes (c) + (c->type == ROARING_RUN ? 2 : 0);
+}
+
+/* the size of the headers, i.e. the offset of the first container */
+static size_t header_size (roaring* r, int runs) {
+	size_t bytes = runs ? 4 + ((r->count + 7) / 8) : 8;
+
+	bytes += r->count * 4;
+	if (!runs || r->count >= NO_OFFSET_THRESHOLD) {
+		bytes += r->count * 4;
+	}
+
+	return bytes;
+}
+
+size_t roaring_serialized_size (roaring* r) {
+	size_t bytes = header_size (r, has_runs (r));
+
+	for (size_t i = 0; i < r->count; ++i) {
+		bytes += container_serialized_size (&r->containers[i]);
+	}
+
+	return bytes;
+}
+
+size_t roaring_serialize (roaring* r, void* buf) {
+	int runs = has_runs (r);
+	uint8_t* p = buf;
+
+	if (runs) {
+		p = put32 (p, SERIAL_COOKIE | ((uint32_t) (r->count - 1) << 16));
+		memset (p, 0, (r->count + 7) / 8);
+		for (size_t i = 0; i < r->count; ++i) {
+			if (r->containers[i].type == ROARING_RUN) {
+				p[i / 8] |= 1 << (i % 8);
+			}
+		}
+		p += (r->count + 7) / 8;
+	} else {
+		p = put32 (p, SERIAL_COOKIE_NO_RUN);
+		p = put32 (p, r->count);
+	}
+
+	for (size_t i = 0; i < r->count; ++i) {
+		p = put16 (p, r->containers[i].key);
+		p = put16 (p, r->containers[i].cardinality - 1);
+	}
+
+	if (!runs || r->count >= NO_OFFSET_THRESHOLD) {
+		uint32_t offset = header_size (r, runs);
+		for (size_t i = 0; i < r->count; ++i) {
+			p = put32 (p, offset);
+			offset += container_serialized_size (&r->containers[i]);
+		}
+	}
+
+	for (size_t i = 0; i < r->count; ++i) {
+		roaring_container* c = &r->containers[i];
+
+		if (c->type == ROARING_BITMAP) {
+			const uint64_t* words = c->data;
+			for (size_t w = 0; w < BITMAP_WORDS; ++w) {
+				p = put32 (p, words[w]);
+				p = put32 (p, words[w] >> 32);
+			}
+			continue;
+		}
+
+		const uint16_t* values = c->data;
+		if (c->type == ROARING_RUN) {
+			p = put16 (p, c->n);
+		}
+
+		for (size_t v = 0; v < (c->type == ROARING_RUN ? c->n * 2 : c->n); ++v) {
+			p = put16 (p, values[v]);
+		}
+	}
+
+	return p - (uint8_t*) buf;
+}
+
+/* reads one container of the given type, checking it against its header cardinality */
+static const uint8_t* read_container (roaring_container* c, const uint8_t* p, const uint8_t* end) {
+	if (c->type == ROARING_RUN) {
+		if (end - p < 2) {
+			return NULL;
+		}
+		c->n = get16 (p);
+		p += 2;
+	} else {
+		c->n = c->type == ROARING_BITMAP ? BITMAP_WORDS : c->cardinality;
+	}
+
+	size_t bytes = container_bytes (c);
+	if ((size_t) (end - p) < bytes || container_reserve (c, bytes > 0 ? bytes : 1) == -1) {
+		return NULL;
+	}
+
+	uint32_t card = 0;
+
+	if (c->type == ROARING_BITMAP) {
+		uint64_t* words = c->data;
+		for (size_t w = 0; w < BITMAP_WORDS; ++w) {
+			words[w] = get32 (p) | ((uint64_t) get32 (p + 4) << 32);
+			card += __builtin_popcountll (words[w]);
+			p += 8;
+		}
+	} else if (c->type == ROARING_RUN) {
+		uint16_t* runs = c->data;
+		uint32_t next = 0;
+		for (size_t i = 0; i < c->n; ++i) {
+			runs[i * 2] = get16 (p);
+			runs[(i * 2) + 1] = get16 (p + 2);
+			p += 4;
+			if (runs[i * 2] < next || runs[i * 2] + runs[(i * 2) + 1] > 0xffff) {
+				return NULL;
+			}
+			next = runs[i * 2] + runs[(i * 2) + 1] + 2;
+			card += runs[(i * 2) + 1] + 1;
+		}
+	} else {
+		uint16_t* values = c->data;
+		for (size_t i = 0; i < c->n; ++i) {
+			values[i] = get16 (p);
+			p += 2;
+			if (i > 0 && values[i] <= values[i - 1]) {
+				return NULL;
+			}
+		}
+		card = c->n;
+	}
+
+	return card == c->cardinality ? p : NULL;
+}
+
+roaring* roaring_deserialize (const void* buf, size_t length) {
+	const uint8_t* p = buf;
+	const uint8_t* end = p + length;
+
+	if (length < 4) {
+		PMSG ("Truncated roaring data");
+		return NULL;
+	}
+
+	uint32_t cookie = get32 (p);
+	const uint8_t* run_flags = NULL;
+	size_t count;
+	p += 4;
+
+	if ((cookie & 0xffff) == SERIAL_COOKIE) {
+		count = (cookie >> 16) + 1;
+		run_flags = p;
+		p += (count + 7) / 8;
+	} else if (cookie == SERIAL_COOKIE_NO_RUN && length >= 8) {
+		count = get32 (p);
+		p += 4;
+	} else {
+		PMSG ("Not roaring data");
+		return NULL;
+	}
+
+	int offsets = run_flags == NULL || count >= NO_OFFSET_THRESHOLD;
+	if (count > 65536 || p > end || (size_t) (end - p) < count * (offsets ? 8 : 4)) {
+		PMSG ("Truncated roaring data");
+		return NULL;
+	}
+
+	roaring* r = roaring_create ();
+	if (r == NULL) {
+		return NULL;
+	}
+
+	const uint8_t* desc = p;
+	p += count * (offsets ? 8 : 4);
+
+	for (size_t i = 0; i < count; ++i) {
+		uint16_t key = get16 (desc + (i * 4));
+
+		if (i > 0 && key <= r->containers[i - 1].key) {
+			PMSG ("Roaring keys out of order");
+			roaring_delete (r);
+			return NULL;
+		}
+
+		roaring_container* c = insert_container (r, i, key);
+		if (c == NULL) {
+			roaring_delete (r);
+			return NULL;
+		}
+
+		c->cardinality = get16 (desc + (i * 4) + 2) + 1;
+		if (run_flags != NULL && (run_flags[i / 8] >> (i % 8)) & 1) {
+			c->type = ROARING_RUN;
+		} else {
+			c->type = c->cardinality <= ARRAY_MAX ? ROARING_ARRAY : ROARING_BITMAP;
+		}
+
+		p = read_container (c, p, end);
+		if (p == NULL) {
+			PMSG ("Corrupt roaring container");
+			roaring_delete (r);
+			return NULL;
+		}
+	}
+
+	return r;
+}
+
+void roaring_delete (roaring* r) {
+	for (size_t i = 0; i < r->count; ++i) {
+		free (r->containers[i].data);
+	}
+
+	free (r->containers);
+	free (r->ranks);
+	free (r);
+	r = NULL;
+}
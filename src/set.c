@@ -23,6 +23,8 @@
 
 #include "container.h"
 #include "debug_utils.h"
+#include "parallel.h"
+#include "trace.h"
 
 #include <sys/types.h>
 #include <stdio.h>
@@ -30,31 +32,169 @@
 #include <string.h>
 #include <math.h>
 
+#define MIN_INDEX_SIZE 8
+
+/* the smallest power of 2 that keeps the index at most half full */
+static size_t index_size_for (size_t count) {
+	size_t n = MIN_INDEX_SIZE;
+
+	while (n < (count * 2)) {
+		n *= 2;
+	}
+
+	return n;
+}
+
+static void index_insert (set* s, size_t pos, uint32_t hash) {
+	size_t mask = s->index_size - 1;
+	size_t i = hash & mask;
+
+	while (s->index[i].pos != 0) {
+		i = (i + 1) & mask;
+	}
+
+	s->index[i].pos = pos + 1;
+	s->index[i].hash = hash;
+}
+
+static ssize_t index_find (set* s, void* item, uint32_t hash) {
+	size_t mask = s->index_size - 1;
+	size_t i = hash & mask;
+
+	while (s->index[i].pos != 0) {
+		if (s->index[i].hash == hash && s->equals (s->data[s->index[i].pos - 1], item)) {
+			return s->index[i].pos - 1;
+		}
+		i = (i + 1) & mask;
+	}
+
+	return -1;
+}
+
+/* an empty index of n slots from the set's allocator */
+static set_slot* index_alloc (set* s, size_t n) {
+	set_slot* index = sscont_alloc (s->allocator, n * sizeof (set_slot));
+	if (index == NULL) {
+		PERR ("malloc");
+		return NULL;
+	}
+
+	memset (index, 0, n * sizeof (set_slot));
+
+	return index;
+}
+
+/* rebuilds the index with room for count items, hashing the items again only if needed */
+static int index_rebuild (set* s, size_t count) {
+	size_t n = index_size_for (count);
+	set_slot* old = s->index;
+	size_t old_size = s->index_size;
+
+	s->index = index_alloc (s, n);
+	if (s->index == NULL) {
+		s->index = old;
+		return -1;
+	}
+	s->index_size = n;
+
+	if (old != NULL) {
+		for (size_t i = 0; i < old_size; ++i) {
+			if (old[i].pos != 0) {
+				index_insert (s, old[i].pos - 1, old[i].hash);
+			}
+		}
+		sscont_free (s->allocator, old);
+	} else {
+		for (size_t i = 0; i < s->count; ++i) {
+			index_insert (s, i, s->hash (s->data[i]));
+		}
+	}
+
+	return 0;
+}
+
+static int set_grow (set* s, size_t size) {
+	size_t old_size = s->size;
+	uint64_t start = sscont_trace_start ();
+
+	void** tmp = sscont_realloc (s->allocator, s->data, sizeof (void*) * size);
+	if (tmp == NULL) {
+		PERR ("realloc");
+		return -1;
+	}
+
+	s->data = tmp;
+	s->size = size;
+
+	if (s->index_size < (size * 2) && index_rebuild (s, size) == -1) {
+		return -1;
+	}
+
+	sscont_trace_resize ("set", s, old_size, size, start);
+
+	return 0;
+}
+
+set* set_create_hashed (size_t size, int (*equals) (void*, void*), uint32_t (*hash) (void*)) {
+	return set_create_hashed_with (size, equals, hash, NULL);
+}
+
+set* set_create_hashed_with (size_t size, int (*equals) (void*, void*), uint32_t (*hash) (void*), const sscont_allocator* allocator) {
+	set* s = set_create_with (size > 0 ? size : 1, equals, allocator);
+	if (s == NULL) {
+		return NULL;
+	}
+
+	s->hash = hash;
+	if (index_rebuild (s, s->size) == -1) {
+		set_delete (s, NULL);
+		return NULL;
+	}
+
+	return s;
+}
+
 set* set_create (size_t size, int (*equals) (void*, void*)) {
-	set* s = malloc (sizeof (set));
+	return set_create_with (size, equals, NULL);
+}
+
+set* set_create_with (size_t size, int (*equals) (void*, void*), const sscont_allocator* allocator) {
+	if (allocator == NULL) {
+		allocator = sscont_allocator_get_default ();
+	}
+
+	set* s = sscont_alloc (allocator, sizeof (set));
 
 	if (s == NULL) {
 		PERR ("malloc");
 		return NULL;
 	}
 
-	s->data = malloc (sizeof (void*) * size);
+	s->data = sscont_alloc (allocator, sizeof (void*) * size);
 
 	if (s->data == NULL) {
 		PERR ("malloc");
-		free (s);
+		sscont_free (allocator, s);
 
 		return NULL;
 	}
 
+	s->allocator = allocator;
 	s->size = size;
 	s->count = 0;
 	s->equals = equals;
+	s->hash = NULL;
+	s->index_size = 0;
+	s->index = NULL;
 
 	return s;
 }
 
 ssize_t set_get_item_index (set* s, void* item) {
+	if (s->hash != NULL) {
+		return index_find (s, item, s->hash (item));
+	}
+
 	for (int i = 0; i < s->count; ++i) {
 		void* data = s->data[i];
 		if (s->equals (data, item)) {
@@ -67,8 +207,28 @@ ssize_t set_get_item_index (set* s, void* item) {
 
 ssize_t set_add_item (set* s, void* item) {
 
+	if (s->hash != NULL) {
+		uint32_t hash = s->hash (item);
+
+		ssize_t existing = index_find (s, item, hash);
+		if (existing != -1) {
+			return existing;
+		}
+
+		if (s->count >= s->size && set_grow (s, s->size * 2) == -1) {
+			return -1;
+		}
+
+		s->data[s->count] = item;
+		index_insert (s, s->count, hash);
+		s->count++;
+
+		return s->count;
+	}
+
 	if (s->count >= s->size) {
 		PMSG ("Item would cause overflow");
+		sscont_trace_set_overflow (s, s->count, s->count + 1);
 		return -1;
 	}
 
@@ -85,8 +245,13 @@ ssize_t set_add_item (set* s, void* item) {
 
 ssize_t set_add_items (set* s, void** items, size_t size) {
 
-	if (size > (s->size - s->count)) {
+	if (s->hash != NULL) {
+		if ((s->count + size) > s->size && set_grow (s, s->count + size) == -1) {
+			return -1;
+		}
+	} else if (size > (s->size - s->count)) {
 		PMSG ("Size of items would cause overflow");
+		sscont_trace_set_overflow (s, s->count, s->count + size);
 		return -1;
 	}
 
@@ -104,10 +269,12 @@ int all_set_equ (void* l, void* r) {
 set* set_all_subsets (set* s) {
 	size_t num_sets = pow (2, s->count);
 
-	set* all_sets = set_create (num_sets, all_set_equ);
+	set* all_sets = set_create_with (num_sets, all_set_equ, s->allocator);
 
-	set* next_set = set_create (0, s->equals);
-	set_add_item (all_sets, next_set);
+	// the subsets are distinct by construction, so they are appended 
+	// without the quadratic search set_add_item would do
+	set* next_set = set_create_with (0, s->equals, s->allocator);
+	all_sets->data[all_sets->count++] = next_set;
 
 	for (int i = 0; i < s->count; ++i) {
 		void* next_item = set_get_item (s, i);
@@ -119,7 +286,7 @@ set* set_all_subsets (set* s) {
 
 			int new_set_count = to_add_to->count + 1;
 
-			set* new_set = set_create (new_set_count, s->equals);
+			set* new_set = set_create_with (new_set_count, s->equals, s->allocator);
 
 			if (new_set_count > 1) {
 				set_add_items (new_set, to_add_to->data, to_add_to->count);
@@ -127,13 +294,178 @@ set* set_all_subsets (set* s) {
 			
 			set_add_item (new_set, next_item);
 
-			set_add_item (all_sets, new_set);
+			all_sets->data[all_sets->count++] = new_set;
 		}
 	}
 
 	return all_sets;	
 }
 
+#define MAX_SUBSET_ITEMS 63
+
+/* n choose k, 0 when k > n. Every value for n <= 63 fits in 64 bits. */
+static uint64_t binomial (size_t n, size_t k) {
+	if (k > n) {
+		return 0;
+	}
+
+	if (k > n - k) {
+		k = n - k;
+	}
+
+	unsigned __int128 c = 1;
+	for (size_t i = 1; i <= k; ++i) {
+		c = (c * (n - k + i)) / i;
+	}
+
+	return (uint64_t) c;
+}
+
+uint64_t set_subset_count (set* s) {
+	if (s->count > MAX_SUBSET_ITEMS) {
+		return 0;
+	}
+
+	return 1ULL << s->count;
+}
+
+uint64_t set_combination_count (set* s, size_t k) {
+	if (s->count > MAX_SUBSET_ITEMS) {
+		return 0;
+	}
+
+	return binomial (s->count, k);
+}
+
+/* the combination of rank r in colex order, i.e. the r-th k bit mask in ascending order */
+static uint64_t combination_unrank (size_t n, size_t k, uint64_t r) {
+	uint64_t mask = 0;
+	size_t c = n;
+
+	for (size_t i = k; i > 0; --i) {
+		do {
+			c--;
+		} while (binomial (c, i) > r);
+
+		mask |= 1ULL << c;
+		r -= binomial (c, i);
+	}
+
+	return mask;
+}
+
+/* fills the iterator's items from its mask in set order */
+static void subset_fill (set_subset_iter* it) {
+	size_t n = it->s->count;
+	size_t k = 0;
+
+	for (uint64_t m = it->mask; m != 0; m &= m - 1) {
+		k++;
+	}
+
+	it->items = it->buf + (n - k);
+	it->count = k;
+	it->toggled = -1;
+
+	k = 0;
+	for (uint64_t m = it->mask; m != 0; m &= m - 1) {
+		it->items[k++] = it->s->data[__builtin_ctzll (m)];
+	}
+}
+
+static int subset_begin (set_subset_iter* it, set* s, size_t k, void** buf, uint64_t begin, uint64_t end, uint64_t total) {
+	if (s->count > MAX_SUBSET_ITEMS) {
+		PMSG ("Too many items to enumerate subsets");
+		return -1;
+	}
+
+	if (end > total || begin > end) {
+		PMSG ("Subset range out of bounds");
+		return -1;
+	}
+
+	it->s = s;
+	it->buf = buf;
+	it->items = buf + s->count;
+	it->count = 0;
+	it->mask = 0;
+	it->begin = begin;
+	it->rank = begin;
+	it->end = end;
+	it->k = k;
+	it->toggled = -1;
+
+	return 0;
+}
+
+int set_subsets_begin (set_subset_iter* it, set* s, void** buf, uint64_t begin, uint64_t end) {
+	return subset_begin (it, s, SIZE_MAX, buf, begin, end, set_subset_count (s));
+}
+
+int set_combinations_begin (set_subset_iter* it, set* s, size_t k, void** buf, uint64_t begin, uint64_t end) {
+	return subset_begin (it, s, k, buf, begin, end, set_combination_count (s, k));
+}
+
+/*
+ * Subsets are kept at the end of buf. When bit j of the Gray code toggles
+ * the only lower bit set is j - 1, so item j is always first or second
+ * in the buffer and a step moves at most 2 pointers.
+ */
+static void subset_toggle (set_subset_iter* it, size_t j) {
+	void** items = it->items;
+
+	it->mask ^= 1ULL << j;
+	it->toggled = j;
+
+	if (it->mask & (1ULL << j)) {
+		items--;
+		if (j > 0) {
+			items[0] = items[1];
+			items[1] = it->s->data[j];
+		} else {
+			items[0] = it->s->data[0];
+		}
+		it->count++;
+	} else {
+		if (j > 0) {
+			items[1] = items[0];
+		}
+		items++;
+		it->count--;
+	}
+
+	it->items = items;
+}
+
+int set_subset_next (set_subset_iter* it) {
+	if (it->rank >= it->end) {
+		return 0;
+	}
+
+	uint64_t r = it->rank++;
+
+	if (it->k == SIZE_MAX) {
+		if (r == it->begin) {
+			it->mask = r ^ (r >> 1);
+			subset_fill (it);
+		} else {
+			subset_toggle (it, __builtin_ctzll (r));
+		}
+	} else {
+		if (r == it->begin) {
+			it->mask = combination_unrank (it->s->count, it->k, r);
+		} else {
+			// the next larger mask with the same number of bits
+			uint64_t low = it->mask & -it->mask;
+			uint64_t ripple = it->mask + low;
+			it->mask = (((ripple ^ it->mask) >> 2) / low) | ripple;
+		}
+		subset_fill (it);
+	}
+
+	return 1;
+}
+
 void* set_get_item (set* s, size_t pos) {
 	if (pos >= s->count) {
 		return NULL;
@@ -142,68 +474,452 @@ void* set_get_item (set* s, size_t pos) {
 	return s->data[pos];
 }
 
-set* set_intersection (set* s, set* other) {
-	auto_array* rvals = auto_array_create (s->count + other->count);
-	if (rvals == NULL) {
-		PMSG ("auto_array");
-		return NULL;
+/* a set of the same kind as s with room for size items */
+static set* set_create_like (set* s, size_t size) {
+	if (s->hash != NULL) {
+		return set_create_hashed_with (size, s->equals, s->hash, s->allocator);
 	}
 
-	auto_array* other_vals = auto_array_create (other->count);
-	if (other_vals == NULL) {
-		PMSG ("auto_array");
-		return NULL;
-	}
+	return set_create_with (size, s->equals, s->allocator);
+}
 
-	memcpy (other_vals->data, other->data, sizeof (void*) * other->count);
-	other_vals->count = other->count;
+/* copies all of the items of s, which are known to be distinct, into an empty set */
+static void set_copy_items (set* dest, set* s) {
+	memcpy (dest->data, s->data, sizeof (void*) * s->count);
+	dest->count = s->count;
 
-	for (int i = 0; i < s->count; ++i) {
-		void* item = set_get_item (s, i);
-		ssize_t ind = set_get_item_index (other, item);
-		if (ind != -1) {
-			auto_array_add (rvals, item);
-			auto_array_put (other_vals, ind, NULL);
+	if (dest->hash == NULL) {
+		return;
+	}
+
+	if (s->hash == dest->hash) {
+		for (size_t i = 0; i < s->index_size; ++i) {
+			if (s->index[i].pos != 0) {
+				index_insert (dest, s->index[i].pos - 1, s->index[i].hash);
+			}
+		}
+	} else {
+		for (size_t i = 0; i < s->count; ++i) {
+			index_insert (dest, i, dest->hash (dest->data[i]));
 		}
 	}
+}
 
-	for (int i = 0; i < other_vals->count; ++i) {
-		void* item = auto_array_get (other_vals, i);
-		if (item == NULL) {
-			continue;
+/* looks an item up, leaving its hash in hash if s is hashed */
+static ssize_t set_find (set* s, void* item, uint32_t* hash) {
+	if (s->hash != NULL) {
+		*hash = s->hash (item);
+		return index_find (s, item, *hash);
+	}
+
+	return set_get_item_index (s, item);
+}
+
+/* 
+ * Appends an item that is known not to be in s, which has room for it.
+ * hash is the item's hash under hash_fn, and is reused if s hashes the same way.
+ */
+static void set_append (set* s, void* item, uint32_t (*hash_fn) (void*), uint32_t hash) {
+	s->data[s->count] = item;
+
+	if (s->hash != NULL) {
+		index_insert (s, s->count, s->hash == hash_fn ? hash : s->hash (item));
+	}
+
+	s->count++;
+}
+
+/* appends the items of s whose membership in other is keep to an empty set with room for them */
+static void set_filter (set* dest, set* s, set* other, int keep) {
+	for (size_t i = 0; i < s->count; ++i) {
+		uint32_t hash = 0;
+		void* item = s->data[i];
+
+		if ((set_find (other, item, &hash) != -1) == keep) {
+			set_append (dest, item, other->hash, hash);
 		}
+	}
+}
 
-		auto_array_add (rvals, item);
-	}	
+set* set_intersection (set* s, set* other) {
+	size_t n = s->count < other->count ? s->count : other->count;
 
-	if (rvals->count == 0) {
+	set* rset = set_create_like (s, n > 0 ? n : 1);
+	if (rset == NULL) {
 		return NULL;
 	}
 
-	set* rset = set_create (rvals->count, s->equals);
-	memcpy (rset->data, rvals->data, sizeof (void*) * rvals->count);
-        rset->count = rvals->count;
+	set_filter (rset, s, other, 1);
 
-	auto_array_delete (other_vals, NULL);
-	auto_array_delete (rvals, NULL);
+	return rset;
+}
+
+set* set_difference (set* s, set* other) {
+	set* rset = set_create_like (s, s->count > 0 ? s->count : 1);
+	if (rset == NULL) {
+		return NULL;
+	}
+
+	set_filter (rset, s, other, 0);
 
 	return rset;
 }
 
 set* set_union (set* s, set* other) {
-	set* rvals = set_create (s->count + other->count, s->equals);
+	set* rvals = set_create_like (s, s->count + other->count);
 	if (rvals == NULL) {
 		return NULL;
 	}
 
-	memcpy (rvals->data, s->data, sizeof (void*) * s->count);
-	rvals->count = s->count;
+	set_copy_items (rvals, s);
 
 	set_add_items (rvals, other->data, other->count);
 
 	return rvals;
 }
 
+ssize_t set_union_into (set* dest, set* other) {
+	if (dest == other) {
+		return dest->count;
+	}
+
+	if (dest->hash == NULL) {
+		// count the new items first so a full dest is left untouched
+		size_t missing = 0;
+		for (size_t i = 0; i < other->count; ++i) {
+			if (set_get_item_index (dest, other->data[i]) == -1) {
+				missing++;
+			}
+		}
+
+		if (missing > dest->size - dest->count) {
+			PMSG ("Size of items would cause overflow");
+			sscont_trace_set_overflow (dest, dest->count, dest->count + missing);
+			return -1;
+		}
+
+		for (size_t i = 0; i < other->count && missing > 0; ++i) {
+			if (set_get_item_index (dest, other->data[i]) == -1) {
+				dest->data[dest->count++] = other->data[i];
+				missing--;
+			}
+		}
+
+		return dest->count;
+	}
+
+	for (size_t i = 0; i < other->count; ++i) {
+		if (set_add_item (dest, other->data[i]) == -1) {
+			return -1;
+		}
+	}
+
+	return dest->count;
+}
+
+/* the index slot of the item at pos, whose hash is hash */
+static size_t index_slot (set* s, size_t pos, uint32_t hash) {
+	size_t mask = s->index_size - 1;
+	size_t i = hash & mask;
+
+	while (s->index[i].pos != pos + 1) {
+		i = (i + 1) & mask;
+	}
+
+	return i;
+}
+
+/* removes a slot, moving later slots of the same probe run back to keep them reachable */
+static void index_remove (set* s, size_t i) {
+	size_t mask = s->index_size - 1;
+	size_t j = i;
+
+	for (;;) {
+		j = (j + 1) & mask;
+		if (s->index[j].pos == 0) {
+			break;
+		}
+
+		// the slot at j can move to i unless its home lies cyclically in (i, j]
+		size_t home = s->index[j].hash & mask;
+		if (i <= j ? (home <= i || home > j) : (home <= i && home > j)) {
+			s->index[i] = s->index[j];
+			i = j;
+		}
+	}
+
+	s->index[i].pos = 0;
+}
+
+/*
+ * Keeps the items of dest whose membership in other is keep. A plain set is
+ * compacted in order. A hashed set moves its last item into each hole, so 
+ * only the index slots of removed and moved items change.
+ */
+static ssize_t set_filter_into (set* dest, set* other, int keep) {
+	if (dest == other) {
+		if (!keep) {
+			dest->count = 0;
+			if (dest->index != NULL) {
+				memset (dest->index, 0, dest->index_size * sizeof (set_slot));
+			}
+		}
+		return dest->count;
+	}
+
+	if (dest->hash == NULL) {
+		size_t n = 0;
+		for (size_t i = 0; i < dest->count; ++i) {
+			uint32_t hash;
+			if ((set_find (other, dest->data[i], &hash) != -1) == keep) {
+				dest->data[n++] = dest->data[i];
+			}
+		}
+		dest->count = n;
+
+		return n;
+	}
+
+	size_t i = 0;
+	while (i < dest->count) {
+		uint32_t hash = 0;
+		void* item = dest->data[i];
+
+		if ((set_find (other, item, &hash) != -1) == keep) {
+			i++;
+			continue;
+		}
+
+		if (other->hash != dest->hash) {
+			hash = dest->hash (item);
+		}
+		index_remove (dest, index_slot (dest, i, hash));
+
+		size_t last = --dest->count;
+		if (i != last) {
+			void* moved = dest->data[last];
+			dest->data[i] = moved;
+			dest->index[index_slot (dest, last, dest->hash (moved))].pos = i + 1;
+		}
+	}
+
+	return dest->count;
+}
+
+ssize_t set_intersect_into (set* dest, set* other) {
+	return set_filter_into (dest, other, 1);
+}
+
+ssize_t set_difference_into (set* dest, set* other) {
+	return set_filter_into (dest, other, 0);
+}
+
+size_t set_intersection_size (set* s, set* other) {
+	// probe the hashed set, or the larger one if both are hashed
+	if (other->hash != NULL && (s->hash == NULL || s->count < other->count)) {
+		set* t = s;
+		s = other;
+		other = t;
+	}
+
+	size_t n = 0;
+	for (size_t i = 0; i < other->count; ++i) {
+		n += set_get_item_index (s, other->data[i]) != -1;
+	}
+
+	return n;
+}
+
+/*
+ * The parallel operations scan one set in chunks, looking each item up in 
+ * the other, which is only read. A first pass marks the items to keep and
+ * counts them per chunk. After a prefix sum of the counts a second pass 
+ * copies each chunk's items to its own part of the result and claims slots
+ * in the result's index with compare and swap, so no lock is taken.
+ */
+#define PARALLEL_CHUNK 16384
+
+typedef struct {
+	set* head;     // a set whose items come first in the result, or NULL
+	set* src;      // the set scanned
+	set* probe;    // the set the items of src are looked up in
+	set* rset;
+	int keep;
+	uint32_t (*hash) (void*); // the hash function of the result
+	unsigned char* kept;
+	uint32_t* hashes;
+	size_t* offsets;
+} parallel_filter;
+
+/* index_insert for several threads filling the index of a set at once */
+static void index_claim (set* s, size_t pos, uint32_t hash) {
+	size_t mask = s->index_size - 1;
+	size_t i = hash & mask;
+
+	for (;;) {
+		size_t empty = 0;
+		if (__atomic_load_n (&s->index[i].pos, __ATOMIC_RELAXED) == 0 &&
+				__atomic_compare_exchange_n (&s->index[i].pos, &empty, pos + 1, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+			break;
+		}
+		i = (i + 1) & mask;
+	}
+
+	s->index[i].hash = hash;
+}
+
+static void filter_mark_body (size_t lo, size_t hi, void* arg) {
+	parallel_filter* pf = arg;
+
+	for (size_t c = lo; c < hi; ++c) {
+		size_t first = c * PARALLEL_CHUNK;
+		size_t last = first + PARALLEL_CHUNK < pf->src->count ? first + PARALLEL_CHUNK : pf->src->count;
+		size_t n = 0;
+
+		for (size_t i = first; i < last; ++i) {
+			uint32_t hash = 0;
+			void* item = pf->src->data[i];
+			int keep = (set_find (pf->probe, item, &hash) != -1) == pf->keep;
+
+			pf->kept[i] = keep;
+			if (keep && pf->hashes != NULL) {
+				pf->hashes[i] = pf->probe->hash == pf->hash ? hash : pf->hash (item);
+			}
+			n += keep;
+		}
+
+		pf->offsets[c + 1] = n;
+	}
+}
+
+static void filter_copy_body (size_t lo, size_t hi, void* arg) {
+	parallel_filter* pf = arg;
+	size_t base = pf->head != NULL ? pf->head->count : 0;
+
+	for (size_t c = lo; c < hi; ++c) {
+		size_t first = c * PARALLEL_CHUNK;
+		size_t last = first + PARALLEL_CHUNK < pf->src->count ? first + PARALLEL_CHUNK : pf->src->count;
+		size_t dest = base + pf->offsets[c];
+
+		for (size_t i = first; i < last; ++i) {
+			if (pf->kept[i]) {
+				pf->rset->data[dest] = pf->src->data[i];
+				if (pf->hashes != NULL) {
+					index_claim (pf->rset, dest, pf->hashes[i]);
+				}
+				dest++;
+			}
+		}
+	}
+}
+
+/* 
+ * Indexes the items of head, which hashes as the result does, by the slots 
+ * of its own index. An index of the same size is copied as it is.
+ */
+static void head_index_body (size_t lo, size_t hi, void* arg) {
+	parallel_filter* pf = arg;
+
+	if (pf->rset->index_size == pf->head->index_size) {
+		memcpy (pf->rset->index + lo, pf->head->index + lo, (hi - lo) * sizeof (set_slot));
+		return;
+	}
+
+	for (size_t i = lo; i < hi; ++i) {
+		set_slot slot = pf->head->index[i];
+		if (slot.pos != 0) {
+			index_claim (pf->rset, slot.pos - 1, slot.hash);
+		}
+	}
+}
+
+/* a set like s holding the items of head, if any, then the items of src whose membership in probe is keep */
+static set* set_parallel_filter (set* s, set* head, set* src, set* probe, int keep) {
+	size_t n = src->count;
+	size_t chunks = (n + PARALLEL_CHUNK - 1) / PARALLEL_CHUNK;
+	set* rset = NULL;
+
+	parallel_filter pf = { .head = head, .src = src, .probe = probe, .keep = keep, .hash = s->hash };
+
+	pf.kept = malloc (n > 0 ? n : 1);
+	pf.offsets = calloc (chunks + 1, sizeof (size_t));
+	if (s->hash != NULL) {
+		pf.hashes = malloc ((n > 0 ? n : 1) * sizeof (uint32_t));
+	}
+	if (pf.kept == NULL || pf.offsets == NULL || (s->hash != NULL && pf.hashes == NULL)) {
+		PERR ("malloc");
+		goto done;
+	}
+
+	if (sscont_parallel_for_range (chunks, 1, filter_mark_body, &pf) == -1) {
+		goto done;
+	}
+
+	for (size_t c = 0; c < chunks; ++c) {
+		pf.offsets[c + 1] += pf.offsets[c];
+	}
+
+	size_t count = (head != NULL ? head->count : 0) + pf.offsets[chunks];
+
+	rset = set_create_like (s, count > 0 ? count : 1);
+	if (rset == NULL) {
+		goto done;
+	}
+	pf.rset = rset;
+
+	if (head != NULL) {
+		memcpy (rset->data, head->data, sizeof (void*) * head->count);
+
+		if (rset->hash != NULL) {
+			// a larger index than needed lets head's be copied rather than rebuilt
+			if (head->index_size > rset->index_size) {
+				set_slot* index = index_alloc (rset, head->index_size);
+				if (index == NULL) {
+					goto fail;
+				}
+				sscont_free (rset->allocator, rset->index);
+				rset->index = index;
+				rset->index_size = head->index_size;
+			}
+
+			if (sscont_parallel_for_range (head->index_size, 0, head_index_body, &pf) == -1) {
+				goto fail;
+			}
+		}
+	}
+
+	if (sscont_parallel_for_range (chunks, 1, filter_copy_body, &pf) == -1) {
+		goto fail;
+	}
+
+	rset->count = count;
+
+	goto done;
+
+fail:
+	set_delete (rset, NULL);
+	rset = NULL;
+
+done:
+	free (pf.kept);
+	free (pf.hashes);
+	free (pf.offsets);
+
+	return rset;
+}
+
+set* set_parallel_union (set* s, set* other) {
+	return set_parallel_filter (s, s, other, s, 0);
+}
+
+set* set_parallel_intersection (set* s, set* other) {
+	return set_parallel_filter (s, NULL, s, other, 1);
+}
+
+set* set_parallel_difference (set* s, set* other) {
+	return set_parallel_filter (s, NULL, s, other, 0);
+}
+
 void set_delete (set* s, void (*delete_item)(void*)) {
 	if (delete_item != NULL) {
 		for (size_t i = 0; i < s->count; ++i) {
@@ -211,8 +927,9 @@ void set_delete (set* s, void (*delete_item)(void*)) {
 		}
 	}	
 
-	free (s->data);
-	free (s);
+	sscont_free (s->allocator, s->index);
+	sscont_free (s->allocator, s->data);
+	sscont_free (s->allocator, s);
 	s = NULL;
 }
 
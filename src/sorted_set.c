@@ -0,0 +1,716 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#include "container.h"
+#include "debug_utils.h"
+#include "parallel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined (__x86_64__)
+#include <immintrin.h>
+#define SORTED_SET_X86 1
+#endif
+
+/*
+ * When one operand is more than GALLOP_RATIO times larger than the other
+ * the items of the smaller are searched for in the larger by galloping
+ * rather than merging the two.
+ */
+#define GALLOP_RATIO 32
+
+/* the SIMD kernels store whole vectors so results need this much slack */
+#define SLACK 8
+
+static int simd_level = SORTED_SET_SCALAR;
+static int simd_supported = SORTED_SET_SCALAR;
+
+#ifdef SORTED_SET_X86
+
+/* pshufb masks moving the 32 bit lanes selected by a 4 bit mask to the front */
+static uint8_t shuffle4[16][16];
+
+/* vpermd indexes moving the 32 bit lanes selected by an 8 bit mask to the front */
+static uint32_t permute8[256][8];
+
+#endif
+
+__attribute__ ((constructor))
+static void select_kernels () {
+#ifdef SORTED_SET_X86
+	for (int mask = 0; mask < 16; ++mask) {
+		int k = 0;
+		memset (shuffle4[mask], 0x80, 16);
+		for (int lane = 0; lane < 4; ++lane) {
+			if (mask & (1 << lane)) {
+				for (int b = 0; b < 4; ++b) {
+					shuffle4[mask][(k * 4) + b] = (lane * 4) + b;
+				}
+				k++;
+			}
+		}
+	}
+
+	for (int mask = 0; mask < 256; ++mask) {
+		int k = 0;
+		memset (permute8[mask], 0, sizeof (permute8[mask]));
+		for (int lane = 0; lane < 8; ++lane) {
+			if (mask & (1 << lane)) {
+				permute8[mask][k++] = lane;
+			}
+		}
+	}
+
+	__builtin_cpu_init ();
+
+	if (__builtin_cpu_supports ("ssse3")) {
+		simd_supported = SORTED_SET_SSE;
+	}
+
+	if (__builtin_cpu_supports ("avx2")) {
+		simd_supported = SORTED_SET_AVX2;
+	}
+
+	simd_level = simd_supported;
+#endif
+}
+
+int sorted_set_simd (int level) {
+	simd_level = level < simd_supported ? level : simd_supported;
+
+	return simd_level;
+}
+
+static sorted_set* sorted_set_alloc (size_t size) {
+	sorted_set* ss = malloc (sizeof (sorted_set));
+	if (ss == NULL) {
+		PERR ("malloc");
+		return NULL;
+	}
+
+	ss->size = size > 0 ? size : 1;
+	ss->data = malloc (ss->size * sizeof (uint32_t));
+	if (ss->data == NULL) {
+		PERR ("malloc");
+		free (ss);
+		return NULL;
+	}
+
+	ss->count = 0;
+
+	return ss;
+}
+
+sorted_set* sorted_set_create (size_t size) {
+	return sorted_set_alloc (size);
+}
+
+static int u32_compare (const void* l, const void* r) {
+	uint32_t a = *(const uint32_t*) l;
+	uint32_t b = *(const uint32_t*) r;
+
+	return a < b ? -1 : a > b;
+}
+
+sorted_set* sorted_set_create_from (const uint32_t* values, size_t n) {
+	sorted_set* ss = sorted_set_alloc (n);
+	if (ss == NULL) {
+		return NULL;
+	}
+
+	if (n == 0) {
+		return ss;
+	}
+
+	memcpy (ss->data, values, n * sizeof (uint32_t));
+
+	size_t i = 1;
+	while (i < n && ss->data[i - 1] < ss->data[i]) {
+		i++;
+	}
+
+	if (i < n) {
+		qsort (ss->data, n, sizeof (uint32_t), u32_compare);
+	}
+
+	size_t k = 1;
+	for (i = 1; i < n; ++i) {
+		if (ss->data[i] != ss->data[k - 1]) {
+			ss->data[k++] = ss->data[i];
+		}
+	}
+
+	ss->count = k;
+
+	return ss;
+}
+
+/* the first position at or after lo whose value is >= value */
+static size_t lower_bound (const uint32_t* data, size_t lo, size_t hi, uint32_t value) {
+	while (lo < hi) {
+		size_t mid = lo + ((hi - lo) / 2);
+		if (data[mid] < value) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+/* lower_bound that probes 1, 2, 4 ... items ahead of lo before the binary search */
+static size_t gallop (const uint32_t* data, size_t lo, size_t n, uint32_t value) {
+	if (lo >= n || data[lo] >= value) {
+		return lo;
+	}
+
+	size_t step = 1;
+	size_t prev = lo;
+	size_t probe = lo + 1;
+
+	while (probe < n && data[probe] < value) {
+		prev = probe;
+		step *= 2;
+		probe = lo + step;
+	}
+
+	return lower_bound (data, prev + 1, probe < n ? probe + 1 : n, value);
+}
+
+ssize_t sorted_set_index (sorted_set* ss, uint32_t value) {
+	size_t pos = lower_bound (ss->data, 0, ss->count, value);
+
+	if (pos < ss->count && ss->data[pos] == value) {
+		return pos;
+	}
+
+	return -1;
+}
+
+int sorted_set_contains (sorted_set* ss, uint32_t value) {
+	return sorted_set_index (ss, value) != -1;
+}
+
+ssize_t sorted_set_add (sorted_set* ss, uint32_t value) {
+	size_t pos = ss->count;
+
+	if (pos == 0 || ss->data[pos - 1] < value) {
+		// appending in order is the common case when building a set
+	} else {
+		pos = lower_bound (ss->data, 0, ss->count, value);
+		if (ss->data[pos] == value) {
+			return ss->count;
+		}
+	}
+
+	if (ss->count == ss->size) {
+		size_t s = ss->size * 2;
+		uint32_t* tmp = realloc (ss->data, s * sizeof (uint32_t));
+		if (tmp == NULL) {
+			PERR ("realloc");
+			return -1;
+		}
+		ss->data = tmp;
+		ss->size = s;
+	}
+
+	memmove (ss->data + pos + 1, ss->data + pos, (ss->count - pos) * sizeof (uint32_t));
+	ss->data[pos] = value;
+	ss->count++;
+
+	return ss->count;
+}
+
+ssize_t sorted_set_remove (sorted_set* ss, uint32_t value) {
+	ssize_t pos = sorted_set_index (ss, value);
+	if (pos == -1) {
+		return -1;
+	}
+
+	memmove (ss->data + pos, ss->data + pos + 1, (ss->count - pos - 1) * sizeof (uint32_t));
+	ss->count--;
+
+	return ss->count;
+}
+
+/*
+ * Intersection kernels. Each writes the common values of a and b to out,
+ * which has room for the smaller count plus SLACK, and returns the count.
+ */
+
+static size_t intersect_merge (const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out) {
+	size_t i = 0;
+	size_t j = 0;
+	size_t k = 0;
+
+	while (i < na && j < nb) {
+		if (a[i] < b[j]) {
+			i++;
+		} else if (b[j] < a[i]) {
+			j++;
+		} else {
+			out[k++] = a[i];
+			i++;
+			j++;
+		}
+	}
+
+	return k;
+}
+
+/* a is the smaller set */
+static size_t intersect_gallop (const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out) {
+	size_t j = 0;
+	size_t k = 0;
+
+	for (size_t i = 0; i < na && j < nb; ++i) {
+		j = gallop (b, j, nb, a[i]);
+		if (j < nb && b[j] == a[i]) {
+			out[k++] = a[i];
+			j++;
+		}
+	}
+
+	return k;
+}
+
+#ifdef SORTED_SET_X86
+
+/*
+ * Compares 4 values of a with all rotations of 4 values of b, keeps the
+ * matching values of a with a shuffle and advances the block with the
+ * smaller maximum. Both advance when the maxima are equal.
+ */
+__attribute__ ((target ("ssse3,popcnt")))
+static size_t intersect_sse (const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out) {
+	size_t i = 0;
+	size_t j = 0;
+	size_t k = 0;
+
+	while (i + 4 <= na && j + 4 <= nb) {
+		__m128i va = _mm_loadu_si128 ((const __m128i*) (a + i));
+		__m128i vb = _mm_loadu_si128 ((const __m128i*) (b + j));
+
+		__m128i cmp = _mm_or_si128 (
+				_mm_or_si128 (_mm_cmpeq_epi32 (va, vb),
+					_mm_cmpeq_epi32 (va, _mm_shuffle_epi32 (vb, _MM_SHUFFLE (0, 3, 2, 1)))),
+				_mm_or_si128 (_mm_cmpeq_epi32 (va, _mm_shuffle_epi32 (vb, _MM_SHUFFLE (1, 0, 3, 2))),
+					_mm_cmpeq_epi32 (va, _mm_shuffle_epi32 (vb, _MM_SHUFFLE (2, 1, 0, 3)))));
+
+		int mask = _mm_movemask_ps (_mm_castsi128_ps (cmp));
+		__m128i packed = _mm_shuffle_epi8 (va, _mm_loadu_si128 ((const __m128i*) shuffle4[mask]));
+		_mm_storeu_si128 ((__m128i*) (out + k), packed);
+		k += __builtin_popcount (mask);
+
+		uint32_t amax = a[i + 3];
+		uint32_t bmax = b[j + 3];
+		if (amax <= bmax) {
+			i += 4;
+		}
+		if (bmax <= amax) {
+			j += 4;
+		}
+	}
+
+	return k + intersect_merge (a + i, na - i, b + j, nb - j, out + k);
+}
+
+/* as intersect_sse with 8 values per block and a lane permute to compact */
+__attribute__ ((target ("avx2,popcnt")))
+static size_t intersect_avx2 (const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out) {
+	size_t i = 0;
+	size_t j = 0;
+	size_t k = 0;
+	const __m256i rot = _mm256_setr_epi32 (1, 2, 3, 4, 5, 6, 7, 0);
+
+	while (i + 8 <= na && j + 8 <= nb) {
+		__m256i va = _mm256_loadu_si256 ((const __m256i*) (a + i));
+		__m256i vb = _mm256_loadu_si256 ((const __m256i*) (b + j));
+		__m256i cmp = _mm256_cmpeq_epi32 (va, vb);
+
+		for (int r = 1; r < 8; ++r) {
+			vb = _mm256_permutevar8x32_epi32 (vb, rot);
+			cmp = _mm256_or_si256 (cmp, _mm256_cmpeq_epi32 (va, vb));
+		}
+
+		int mask = _mm256_movemask_ps (_mm256_castsi256_ps (cmp));
+		__m256i idx = _mm256_loadu_si256 ((const __m256i*) permute8[mask]);
+		_mm256_storeu_si256 ((__m256i*) (out + k), _mm256_permutevar8x32_epi32 (va, idx));
+		k += __builtin_popcount (mask);
+
+		uint32_t amax = a[i + 7];
+		uint32_t bmax = b[j + 7];
+		if (amax <= bmax) {
+			i += 8;
+		}
+		if (bmax <= amax) {
+			j += 8;
+		}
+	}
+
+	return k + intersect_sse (a + i, na - i, b + j, nb - j, out + k);
+}
+
+#endif // SORTED_SET_X86
+
+static size_t intersect (const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out) {
+	if (na > nb) {
+		const uint32_t* t = a;
+		a = b;
+		b = t;
+		size_t n = na;
+		na = nb;
+		nb = n;
+	}
+
+	if (na == 0) {
+		return 0;
+	}
+
+	if (nb / na > GALLOP_RATIO) {
+		return intersect_gallop (a, na, b, nb, out);
+	}
+
+#ifdef SORTED_SET_X86
+	if (simd_level == SORTED_SET_AVX2) {
+		return intersect_avx2 (a, na, b, nb, out);
+	}
+
+	if (simd_level == SORTED_SET_SSE) {
+		return intersect_sse (a, na, b, nb, out);
+	}
+#endif
+
+	return intersect_merge (a, na, b, nb, out);
+}
+
+sorted_set* sorted_set_intersection (sorted_set* a, sorted_set* b) {
+	size_t n = a->count < b->count ? a->count : b->count;
+
+	sorted_set* rv = sorted_set_alloc (n + SLACK);
+	if (rv == NULL) {
+		return NULL;
+	}
+
+	rv->count = intersect (a->data, a->count, b->data, b->count, rv->data);
+
+	return rv;
+}
+
+size_t sorted_set_intersection_size (sorted_set* a, sorted_set* b) {
+	sorted_set* small = a->count < b->count ? a : b;
+	sorted_set* large = a->count < b->count ? b : a;
+	size_t j = 0;
+	size_t k = 0;
+
+	for (size_t i = 0; i < small->count && j < large->count; ++i) {
+		j = gallop (large->data, j, large->count, small->data[i]);
+		if (j < large->count && large->data[j] == small->data[i]) {
+			k++;
+			j++;
+		}
+	}
+
+	return k;
+}
+
+/* copies the items of a that are not in b to out and returns the count */
+static size_t difference (const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out) {
+	size_t i = 0;
+	size_t j = 0;
+	size_t k = 0;
+
+	if (nb > 0 && na / nb > GALLOP_RATIO) {
+		// copy the runs of a between the items of b
+		for (j = 0; j < nb && i < na; ++j) {
+			size_t next = gallop (a, i, na, b[j]);
+			memcpy (out + k, a + i, (next - i) * sizeof (uint32_t));
+			k += next - i;
+			i = next;
+			if (i < na && a[i] == b[j]) {
+				i++;
+			}
+		}
+	} else if (na > 0 && nb / na > GALLOP_RATIO) {
+		for (i = 0; i < na; ++i) {
+			j = gallop (b, j, nb, a[i]);
+			if (j == nb || b[j] != a[i]) {
+				out[k++] = a[i];
+			}
+		}
+		return k;
+	} else {
+		while (i < na && j < nb) {
+			if (a[i] < b[j]) {
+				out[k++] = a[i++];
+			} else if (b[j] < a[i]) {
+				j++;
+			} else {
+				i++;
+				j++;
+			}
+		}
+	}
+
+	memcpy (out + k, a + i, (na - i) * sizeof (uint32_t));
+
+	return k + (na - i);
+}
+
+sorted_set* sorted_set_difference (sorted_set* a, sorted_set* b) {
+	sorted_set* rv = sorted_set_alloc (a->count);
+	if (rv == NULL) {
+		return NULL;
+	}
+
+	rv->count = difference (a->data, a->count, b->data, b->count, rv->data);
+
+	return rv;
+}
+
+/*
+ * Merges a and b. With keep_common the union is produced, without it the
+ * symmetric difference. Skewed inputs copy the runs of the larger set
+ * between the items of the smaller.
+ */
+static size_t merge (const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out, int keep_common) {
+	size_t i = 0;
+	size_t j = 0;
+	size_t k = 0;
+
+	if (na < nb) {
+		const uint32_t* t = a;
+		a = b;
+		b = t;
+		size_t n = na;
+		na = nb;
+		nb = n;
+	}
+
+	if (nb > 0 && na / nb > GALLOP_RATIO) {
+		for (j = 0; j < nb; ++j) {
+			size_t next = gallop (a, i, na, b[j]);
+			memcpy (out + k, a + i, (next - i) * sizeof (uint32_t));
+			k += next - i;
+			i = next;
+			if (i < na && a[i] == b[j]) {
+				if (keep_common) {
+					out[k++] = a[i];
+				}
+				i++;
+			} else {
+				out[k++] = b[j];
+			}
+		}
+	} else {
+		while (i < na && j < nb) {
+			if (a[i] < b[j]) {
+				out[k++] = a[i++];
+			} else if (b[j] < a[i]) {
+				out[k++] = b[j++];
+			} else {
+				if (keep_common) {
+					out[k++] = a[i];
+				}
+				i++;
+				j++;
+			}
+		}
+
+		memcpy (out + k, b + j, (nb - j) * sizeof (uint32_t));
+		k += nb - j;
+	}
+
+	memcpy (out + k, a + i, (na - i) * sizeof (uint32_t));
+
+	return k + (na - i);
+}
+
+sorted_set* sorted_set_union (sorted_set* a, sorted_set* b) {
+	sorted_set* rv = sorted_set_alloc (a->count + b->count);
+	if (rv == NULL) {
+		return NULL;
+	}
+
+	rv->count = merge (a->data, a->count, b->data, b->count, rv->data, 1);
+
+	return rv;
+}
+
+sorted_set* sorted_set_symmetric_difference (sorted_set* a, sorted_set* b) {
+	sorted_set* rv = sorted_set_alloc (a->count + b->count);
+	if (rv == NULL) {
+		return NULL;
+	}
+
+	rv->count = merge (a->data, a->count, b->data, b->count, rv->data, 0);
+
+	return rv;
+}
+
+/*
+ * The parallel operations cut the larger set every PARALLEL_CHUNK values and
+ * the smaller set at the same values, giving pieces that cover disjoint value
+ * ranges. Each piece is computed into its own part of a scratch buffer, then
+ * the pieces are copied to offsets given by a prefix sum of their sizes.
+ */
+#define PARALLEL_CHUNK 65536
+
+enum { PARALLEL_UNION, PARALLEL_INTERSECTION, PARALLEL_DIFFERENCE };
+
+typedef struct {
+	sorted_set* a;
+	sorted_set* b;
+	int op;
+	size_t* a_split;
+	size_t* b_split;
+	size_t* offsets;
+	uint32_t* scratch;
+	uint32_t* out;
+} parallel_merge;
+
+/* 
+ * Where piece p is computed in the scratch buffer, leaving SLACK for the kernels.
+ * Only a union can have more values than a's part of the piece.
+ */
+static size_t piece_start (parallel_merge* pm, size_t p) {
+	size_t start = pm->a_split[p] + (p * SLACK);
+
+	return pm->op == PARALLEL_UNION ? start + pm->b_split[p] : start;
+}
+
+static void piece_body (size_t lo, size_t hi, void* arg) {
+	parallel_merge* pm = arg;
+
+	for (size_t p = lo; p < hi; ++p) {
+		const uint32_t* a = pm->a->data + pm->a_split[p];
+		const uint32_t* b = pm->b->data + pm->b_split[p];
+		size_t na = pm->a_split[p + 1] - pm->a_split[p];
+		size_t nb = pm->b_split[p + 1] - pm->b_split[p];
+		uint32_t* out = pm->scratch + piece_start (pm, p);
+
+		switch (pm->op) {
+			case PARALLEL_UNION:
+				pm->offsets[p + 1] = merge (a, na, b, nb, out, 1);
+				break;
+			case PARALLEL_INTERSECTION:
+				pm->offsets[p + 1] = intersect (a, na, b, nb, out);
+				break;
+			default:
+				pm->offsets[p + 1] = difference (a, na, b, nb, out);
+				break;
+		}
+	}
+}
+
+static void concat_body (size_t lo, size_t hi, void* arg) {
+	parallel_merge* pm = arg;
+
+	for (size_t p = lo; p < hi; ++p) {
+		memcpy (pm->out + pm->offsets[p], pm->scratch + piece_start (pm, p), 
+				(pm->offsets[p + 1] - pm->offsets[p]) * sizeof (uint32_t));
+	}
+}
+
+static sorted_set* parallel_op (sorted_set* a, sorted_set* b, int op) {
+	sorted_set* large = a->count >= b->count ? a : b;
+	sorted_set* small = large == a ? b : a;
+	size_t pieces = (large->count + PARALLEL_CHUNK - 1) / PARALLEL_CHUNK;
+	sorted_set* rv = NULL;
+
+	if (pieces == 0) {
+		pieces = 1;
+	}
+
+	parallel_merge pm = { .a = a, .b = b, .op = op };
+
+	pm.a_split = malloc ((pieces + 1) * sizeof (size_t));
+	pm.b_split = malloc ((pieces + 1) * sizeof (size_t));
+	pm.offsets = calloc (pieces + 1, sizeof (size_t));
+	pm.scratch = malloc ((a->count + (op == PARALLEL_UNION ? b->count : 0) + ((pieces + 1) * SLACK)) * sizeof (uint32_t));
+	if (pm.a_split == NULL || pm.b_split == NULL || pm.offsets == NULL || pm.scratch == NULL) {
+		PERR ("malloc");
+		goto done;
+	}
+
+	size_t* large_split = large == a ? pm.a_split : pm.b_split;
+	size_t* small_split = large == a ? pm.b_split : pm.a_split;
+
+	large_split[0] = small_split[0] = 0;
+	for (size_t p = 1; p < pieces; ++p) {
+		large_split[p] = (p * large->count) / pieces;
+		small_split[p] = lower_bound (small->data, small_split[p - 1], small->count, large->data[large_split[p]]);
+	}
+	large_split[pieces] = large->count;
+	small_split[pieces] = small->count;
+
+	if (sscont_parallel_for_range (pieces, 1, piece_body, &pm) == -1) {
+		goto done;
+	}
+
+	for (size_t p = 0; p < pieces; ++p) {
+		pm.offsets[p + 1] += pm.offsets[p];
+	}
+
+	rv = sorted_set_alloc (pm.offsets[pieces] + SLACK);
+	if (rv == NULL) {
+		goto done;
+	}
+
+	pm.out = rv->data;
+	if (sscont_parallel_for_range (pieces, 1, concat_body, &pm) == -1) {
+		sorted_set_delete (rv);
+		rv = NULL;
+		goto done;
+	}
+
+	rv->count = pm.offsets[pieces];
+
+done:
+	free (pm.a_split);
+	free (pm.b_split);
+	free (pm.offsets);
+	free (pm.scratch);
+
+	return rv;
+}
+
+sorted_set* sorted_set_parallel_union (sorted_set* a, sorted_set* b) {
+	return parallel_op (a, b, PARALLEL_UNION);
+}
+
+sorted_set* sorted_set_parallel_intersection (sorted_set* a, sorted_set* b) {
+	return parallel_op (a, b, PARALLEL_INTERSECTION);
+}
+
+sorted_set* sorted_set_parallel_difference (sorted_set* a, sorted_set* b) {
+	return parallel_op (a, b, PARALLEL_DIFFERENCE);
+}
+
+void sorted_set_delete (sorted_set* ss) {
+	free (ss->data);
+	free (ss);
+	ss = NULL;
+}
@@ -24,68 +24,305 @@
 #include "container.h"
 #include "debug_utils.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 auto_string* auto_string_create (size_t initial_size) {
-	auto_string* s = malloc (sizeof (auto_string));
+	return auto_string_create_with (initial_size, NULL);
+}
+
+auto_string* auto_string_create_with (size_t initial_size, const sscont_allocator* allocator) {
+	if (allocator == NULL) {
+		allocator = sscont_allocator_get_default ();
+	}
+
+	auto_string* s = sscont_alloc (allocator, sizeof (auto_string));
 
 	if (s == NULL) {
 		PERR ("malloc");
 		return NULL;
 	}
 
-	s->buf = malloc (initial_size);
-	if (s->buf == NULL) {
-		PERR ("malloc");
-		free (s);
-		return NULL;
+	s->allocator = allocator;
+
+	if (initial_size <= AUTO_STRING_SMALL_SIZE) {
+		s->buf = s->small;
+		s->size = initial_size > 0 ? initial_size : 1;
+	} else {
+		s->buf = sscont_alloc (allocator, initial_size);
+		if (s->buf == NULL) {
+			PERR ("malloc");
+			sscont_free (allocator, s);
+			return NULL;
+		}
+
+		s->size = initial_size;
 	}
 
-	s->size = initial_size;
+	s->buf[0] = '\0';
 	s->count = 0;
 
 	return s;
 }
 
-auto_string* auto_string_append (auto_string* s, char* cstr) {
-	size_t n = strlen (cstr);
+/* makes room for n more chars and the nul */
+static int auto_string_grow (auto_string* s, size_t n) {
+	if ((s->count + n) < s->size) {
+		return 0;
+	}
 
-	if ((s->count + n) >= s->size) {
-		size_t sz = 0;
-		if (n < s->size) {
-			sz = 2 * s->size;
-		} else {
-			sz = (2 * n) + s->size;
-		}
+	if (s->buf == s->small && (s->count + n) < AUTO_STRING_SMALL_SIZE) {
+		s->size = AUTO_STRING_SMALL_SIZE;
+		return 0;
+	}
+
+	size_t sz = 0;
+	if (n < s->size) {
+		sz = 2 * s->size;
+	} else {
+		sz = (2 * n) + s->size;
+	}
+
+	// strings from AUTO_STRING_INITIALIZER take the default allocator when they first allocate
+	if (s->allocator == NULL) {
+		s->allocator = sscont_allocator_get_default ();
+	}
 
-		char* tmp = realloc (s->buf, sz);
+	char* tmp;
+	if (s->buf == s->small) {
+		tmp = sscont_alloc (s->allocator, sz);
 		if (tmp == NULL) {
-			PERR ("realloc");
+			PERR ("malloc");
+			return -1;
+		}
+		memcpy (tmp, s->small, s->count + 1);
+	} else if ((tmp = sscont_realloc (s->allocator, s->buf, sz)) == NULL) {
+		PERR ("realloc");
+		return -1;
+	}
+
+	s->buf = tmp;
+	s->size = sz;
+
+	return 0;
+}
+
+auto_string* auto_string_reserve (auto_string* s, size_t n) {
+	return auto_string_grow (s, n) == -1 ? NULL : s;
+}
+
+auto_string* auto_string_append_n (auto_string* s, const char* data, size_t n) {
+	// data may be part of the buffer, which can move as it grows
+	if (data >= s->buf && data < s->buf + s->size) {
+		size_t offset = data - s->buf;
+		if (auto_string_grow (s, n) == -1) {
 			return NULL;
 		}
+		data = s->buf + offset;
+	} else if (auto_string_grow (s, n) == -1) {
+		return NULL;
+	}
+
+	memcpy (s->buf + s->count, data, n);
+	s->count += n;
+	s->buf[s->count] = '\0';
+
+	return s;
+}
+
+auto_string* auto_string_append (auto_string* s, char* cstr) {
+	return auto_string_append_n (s, cstr, strlen (cstr));
+}
 
-		s->buf = tmp;
-		s->size = sz;
+auto_string* auto_string_append_char (auto_string* s, char c) {
+	if ((s->count + 1) >= s->size && auto_string_grow (s, 1) == -1) {
+		return NULL;
 	}
 
-	if (s->count == 0) {
-		strcpy (s->buf, cstr);
-	} else {
-		strcat (s->buf, cstr);
+	s->buf[s->count++] = c;
+	s->buf[s->count] = '\0';
+
+	return s;
+}
+
+auto_string* auto_string_vappendf (auto_string* s, const char* fmt, va_list ap) {
+	va_list again;
+	va_copy (again, ap);
+
+	if (s->buf == s->small) {
+		s->size = AUTO_STRING_SMALL_SIZE;
+	}
+
+	size_t room = s->size - s->count;
+	int n = vsnprintf (s->buf + s->count, room, fmt, ap);
+
+	if (n >= 0 && (size_t) n >= room) {
+		if (auto_string_grow (s, n) == -1) {
+			n = -1;
+		} else {
+			vsnprintf (s->buf + s->count, s->size - s->count, fmt, again);
+		}
+	}
+
+	va_end (again);
+
+	if (n < 0) {
+		PMSG ("auto_string_vappendf failed");
+		s->buf[s->count] = '\0';
+		return NULL;
 	}
 
 	s->count += n;
+
 	return s;
 }
 
+auto_string* auto_string_appendf (auto_string* s, const char* fmt, ...) {
+	va_list ap;
+
+	va_start (ap, fmt);
+	auto_string* rv = auto_string_vappendf (s, fmt, ap);
+	va_end (ap);
+
+	return rv;
+}
+
+static const char digit_pairs[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+static const uint64_t powers_of_10[20] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+	100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+	10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+	100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+static size_t decimal_digits (uint64_t v) {
+	size_t n = 1;
+
+	while (n < 20 && v >= powers_of_10[n]) {
+		n++;
+	}
+
+	return n;
+}
+
+/* writes the n decimal digits of v, two at a time, ending just before end */
+static void write_digits (char* end, uint64_t v, size_t n) {
+	while (n >= 2) {
+		end -= 2;
+		memcpy (end, digit_pairs + ((v % 100) * 2), 2);
+		v /= 100;
+		n -= 2;
+	}
+
+	if (n == 1) {
+		*--end = '0' + (v % 10);
+	}
+}
+
+/* appends a sign, if negative, then v as n digits, which is at least the number of digits of v */
+static auto_string* append_decimal (auto_string* s, int negative, uint64_t v, size_t n) {
+	if (auto_string_grow (s, n + 1) == -1) {
+		return NULL;
+	}
+
+	if (negative) {
+		s->buf[s->count++] = '-';
+	}
+
+	write_digits (s->buf + s->count + n, v, n);
+	s->count += n;
+	s->buf[s->count] = '\0';
+
+	return s;
+}
+
+auto_string* auto_string_append_uint (auto_string* s, uint64_t v) {
+	return append_decimal (s, 0, v, decimal_digits (v));
+}
+
+auto_string* auto_string_append_int (auto_string* s, int64_t v) {
+	uint64_t magnitude = v < 0 ? (uint64_t) -(v + 1) + 1 : (uint64_t) v;
+
+	return append_decimal (s, v < 0, magnitude, decimal_digits (magnitude));
+}
+
+auto_string* auto_string_append_double (auto_string* s, double v, int precision) {
+	double a = fabs (v);
+
+	if (!(a < 1e15) || precision < 0 || precision > 9) {
+		return auto_string_appendf (s, "%.*f", precision, v);
+	}
+
+	/*
+	 * a - whole and scaled - frac are exact, and fma gives the exact error 
+	 * of the product, so the digits are rounded from the exact value of v. 
+	 * Exact ties round to even, as printf does.
+	 */
+	uint64_t whole = (uint64_t) a;
+	uint64_t scale = powers_of_10[precision];
+	double f = a - whole;
+	double scaled = f * scale;
+	double err = fma (f, (double) scale, -scaled);
+	uint64_t frac = (uint64_t) scaled;
+	double rest = scaled - frac;
+	uint64_t last = precision == 0 ? whole : frac;
+
+	if (rest > 0.5 || (rest == 0.5 && (err > 0 || (err == 0 && (last & 1))))) {
+		frac++;
+	}
+
+	if (frac >= scale) {
+		whole++;
+		frac -= scale;
+	}
+
+	if (append_decimal (s, signbit (v) != 0, whole, decimal_digits (whole)) == NULL) {
+		return NULL;
+	}
+
+	if (precision == 0) {
+		return s;
+	}
+
+	if (auto_string_append_char (s, '.') == NULL) {
+		return NULL;
+	}
+
+	return append_decimal (s, 0, frac, precision);
+}
+
 size_t auto_string_length (auto_string* s) {
-	return strlen (s->buf);
+	return s->count;
+}
+
+void auto_string_release (auto_string* s) {
+	if (s->buf != s->small) {
+		sscont_free (s->allocator, s->buf);
+	}
+
+	s->buf = s->small;
+	s->buf[0] = '\0';
+	s->size = AUTO_STRING_SMALL_SIZE;
+	s->count = 0;
 }
 
 void auto_string_delete (auto_string* s) {
-	free (s->buf);
-	free (s);
+	auto_string_release (s);
+
+	sscont_free (s->allocator, s);
 	s = NULL;
 }
 
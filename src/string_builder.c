@@ -0,0 +1,273 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/uio.h>
+
+#define FIRST_CHUNK_SIZE 4096
+#define MAX_CHUNK_SIZE (1024 * 1024)
+#define WRITE_BATCH 64
+
+string_builder* string_builder_create () {
+	string_builder* sb = calloc (1, sizeof (string_builder));
+	if (sb == NULL) {
+		PERR ("calloc");
+		return NULL;
+	}
+
+	sb->chunk_size = FIRST_CHUNK_SIZE;
+
+	return sb;
+}
+
+static int push_segment (string_builder* sb, const char* data, size_t n, void (*release) (void* data)) {
+	if (sb->segments_count == sb->segments_size) {
+		size_t size = sb->segments_size == 0 ? 16 : sb->segments_size * 2;
+		string_segment* segments = realloc (sb->segments, size * sizeof (string_segment));
+		if (segments == NULL) {
+			PERR ("realloc");
+			return -1;
+		}
+		sb->segments = segments;
+		sb->segments_size = size;
+	}
+
+	sb->segments[sb->segments_count++] = (string_segment) { data, n, release };
+	sb->count += n;
+
+	return 0;
+}
+
+static int push_chunk (string_builder* sb, size_t n) {
+	if (sb->chunks_count == sb->chunks_size) {
+		size_t size = sb->chunks_size == 0 ? 8 : sb->chunks_size * 2;
+		string_chunk* chunks = realloc (sb->chunks, size * sizeof (string_chunk));
+		if (chunks == NULL) {
+			PERR ("realloc");
+			return -1;
+		}
+		sb->chunks = chunks;
+		sb->chunks_size = size;
+	}
+
+	size_t size = n > sb->chunk_size ? n : sb->chunk_size;
+	char* data = malloc (size);
+	if (data == NULL) {
+		PERR ("malloc");
+		return -1;
+	}
+
+	sb->chunks[sb->chunks_count++] = (string_chunk) { data, size };
+	sb->tail = data;
+	sb->room = size;
+
+	if (sb->chunk_size < MAX_CHUNK_SIZE) {
+		sb->chunk_size *= 2;
+	}
+
+	return 0;
+}
+
+// copies n bytes to the tail, which has room for them
+static int copy_to_tail (string_builder* sb, const char* data, size_t n) {
+	memcpy (sb->tail, data, n);
+
+	// bytes following the last segment in the same chunk extend it
+	string_chunk* chunk = &sb->chunks[sb->chunks_count - 1];
+	string_segment* last = sb->segments_count > sb->head ? &sb->segments[sb->segments_count - 1] : NULL;
+	if (last != NULL && last->data >= chunk->data && last->data < chunk->data + chunk->size 
+			&& last->data + last->length == sb->tail) {
+		last->length += n;
+		sb->count += n;
+	} else if (push_segment (sb, sb->tail, n, NULL) == -1) {
+		return -1;
+	}
+
+	sb->tail += n;
+	sb->room -= n;
+
+	return 0;
+}
+
+string_builder* string_builder_append (string_builder* sb, const void* data, size_t n) {
+	const char* bytes = data;
+
+	size_t k = n < sb->room ? n : sb->room;
+	if (k > 0) {
+		if (copy_to_tail (sb, bytes, k) == -1) {
+			return NULL;
+		}
+		bytes += k;
+		n -= k;
+	}
+
+	if (n > 0) {
+		if (push_chunk (sb, n) == -1 || copy_to_tail (sb, bytes, n) == -1) {
+			return NULL;
+		}
+	}
+
+	return sb;
+}
+
+string_builder* string_builder_append_str (string_builder* sb, const char* cstr) {
+	return string_builder_append (sb, cstr, strlen (cstr));
+}
+
+string_builder* string_builder_attach (string_builder* sb, const void* data, size_t n, void (*release) (void* data)) {
+	if (n < STRING_BUILDER_ATTACH_MIN) {
+		if (string_builder_append (sb, data, n) == NULL) {
+			return NULL;
+		}
+		if (release != NULL) {
+			release ((void*) data);
+		}
+		return sb;
+	}
+
+	return push_segment (sb, data, n, release) == -1 ? NULL : sb;
+}
+
+size_t string_builder_length (string_builder* sb) {
+	return sb->count;
+}
+
+// empties the builder, keeping the last chunk
+static void reset (string_builder* sb) {
+	if (sb->chunks_count > 1) {
+		for (size_t i = 0; i < sb->chunks_count - 1; ++i) {
+			free (sb->chunks[i].data);
+		}
+		sb->chunks[0] = sb->chunks[sb->chunks_count - 1];
+		sb->chunks_count = 1;
+	}
+
+	if (sb->chunks_count == 1) {
+		sb->tail = sb->chunks[0].data;
+		sb->room = sb->chunks[0].size;
+	}
+
+	sb->segments_count = 0;
+	sb->head = 0;
+	sb->head_offset = 0;
+	sb->count = 0;
+}
+
+// consumes n written bytes from the head
+static void advance (string_builder* sb, size_t n) {
+	sb->count -= n;
+
+	while (n > 0) {
+		string_segment* seg = &sb->segments[sb->head];
+		size_t rest = seg->length - sb->head_offset;
+		if (n < rest) {
+			sb->head_offset += n;
+			return;
+		}
+
+		n -= rest;
+		if (seg->release != NULL) {
+			seg->release ((void*) seg->data);
+		}
+		sb->head++;
+		sb->head_offset = 0;
+	}
+}
+
+ssize_t string_builder_write (string_builder* sb, int fd) {
+	struct iovec iov[WRITE_BATCH];
+	size_t total = 0;
+
+	while (sb->count > 0) {
+		int iovcnt = 0;
+		for (size_t i = sb->head; i < sb->segments_count && iovcnt < WRITE_BATCH; ++i, ++iovcnt) {
+			size_t offset = i == sb->head ? sb->head_offset : 0;
+			iov[iovcnt].iov_base = (char*) sb->segments[i].data + offset;
+			iov[iovcnt].iov_len = sb->segments[i].length - offset;
+		}
+
+		ssize_t written = writev (fd, iov, iovcnt);
+		if (written == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (total > 0) {
+				return total;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				PERR ("writev");
+			}
+			return -1;
+		}
+
+		advance (sb, written);
+		total += written;
+	}
+
+	reset (sb);
+
+	return total;
+}
+
+auto_string* string_builder_flatten (string_builder* sb, auto_string* out) {
+	if (auto_string_reserve (out, sb->count) == NULL) {
+		return NULL;
+	}
+
+	for (size_t i = sb->head; i < sb->segments_count; ++i) {
+		size_t offset = i == sb->head ? sb->head_offset : 0;
+		auto_string_append_n (out, sb->segments[i].data + offset, sb->segments[i].length - offset);
+	}
+
+	return out;
+}
+
+static void release_unwritten (string_builder* sb) {
+	for (size_t i = sb->head; i < sb->segments_count; ++i) {
+		if (sb->segments[i].release != NULL) {
+			sb->segments[i].release ((void*) sb->segments[i].data);
+		}
+	}
+}
+
+void string_builder_clear (string_builder* sb) {
+	release_unwritten (sb);
+	reset (sb);
+}
+
+void string_builder_delete (string_builder* sb) {
+	release_unwritten (sb);
+
+	for (size_t i = 0; i < sb->chunks_count; ++i) {
+		free (sb->chunks[i].data);
+	}
+	free (sb->chunks);
+	free (sb->segments);
+	free (sb);
+}
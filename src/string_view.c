@@ -0,0 +1,381 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined (__x86_64__)
+#include <immintrin.h>
+#define STRING_VIEW_X86 1
+#endif
+
+#define MAX_SIMD_DELIMS 16
+
+/*
+ * Searches for a byte use memchr, which glibc already vectorizes. Searches
+ * for any of a set of bytes and for a substring have scalar, SSE2 and AVX2
+ * kernels, selected at load time like bitset's. The kernels return n when
+ * there is no match.
+ */
+
+static int is_delim (char c, const char* delims, size_t count) {
+	for (size_t d = 0; d < count; ++d) {
+		if (c == delims[d]) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static size_t find_any_scalar (const char* p, size_t n, const char* delims, size_t count) {
+	if (count > MAX_SIMD_DELIMS) {
+		unsigned char table[256] = { 0 };
+		for (size_t d = 0; d < count; ++d) {
+			table[(unsigned char) delims[d]] = 1;
+		}
+		for (size_t i = 0; i < n; ++i) {
+			if (table[(unsigned char) p[i]]) {
+				return i;
+			}
+		}
+		return n;
+	}
+
+	for (size_t i = 0; i < n; ++i) {
+		if (is_delim (p[i], delims, count)) {
+			return i;
+		}
+	}
+
+	return n;
+}
+
+static size_t find_scalar (const char* p, size_t n, const char* needle, size_t k) {
+	const char* match = memmem (p, n, needle, k);
+
+	return match == NULL ? n : (size_t) (match - p);
+}
+
+#ifdef STRING_VIEW_X86
+
+/* compares each block with every delimiter, up to MAX_SIMD_DELIMS of them */
+static size_t find_any_sse2 (const char* p, size_t n, const char* delims, size_t count) {
+	if (count > MAX_SIMD_DELIMS) {
+		return find_any_scalar (p, n, delims, count);
+	}
+
+	__m128i sets[MAX_SIMD_DELIMS];
+	for (size_t d = 0; d < count; ++d) {
+		sets[d] = _mm_set1_epi8 (delims[d]);
+	}
+
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128 ((const __m128i*) (p + i));
+		__m128i eq = _mm_cmpeq_epi8 (v, sets[0]);
+		for (size_t d = 1; d < count; ++d) {
+			eq = _mm_or_si128 (eq, _mm_cmpeq_epi8 (v, sets[d]));
+		}
+
+		unsigned mask = _mm_movemask_epi8 (eq);
+		if (mask != 0) {
+			return i + __builtin_ctz (mask);
+		}
+	}
+
+	return i + find_any_scalar (p + i, n - i, delims, count);
+}
+
+/* up to 4 delimiters are kept in registers, repeating the first for missing ones */
+__attribute__ ((target ("avx2")))
+static size_t find_any4_avx2 (const char* p, size_t n, const char* delims, size_t count) {
+	const __m256i d0 = _mm256_set1_epi8 (delims[0]);
+	const __m256i d1 = _mm256_set1_epi8 (delims[count > 1 ? 1 : 0]);
+	const __m256i d2 = _mm256_set1_epi8 (delims[count > 2 ? 2 : 0]);
+	const __m256i d3 = _mm256_set1_epi8 (delims[count > 3 ? 3 : 0]);
+
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32) {
+		__m256i v = _mm256_loadu_si256 ((const __m256i*) (p + i));
+		__m256i eq = _mm256_or_si256 (
+				_mm256_or_si256 (_mm256_cmpeq_epi8 (v, d0), _mm256_cmpeq_epi8 (v, d1)),
+				_mm256_or_si256 (_mm256_cmpeq_epi8 (v, d2), _mm256_cmpeq_epi8 (v, d3)));
+
+		unsigned mask = _mm256_movemask_epi8 (eq);
+		if (mask != 0) {
+			return i + __builtin_ctz (mask);
+		}
+	}
+
+	return i + find_any_sse2 (p + i, n - i, delims, count);
+}
+
+__attribute__ ((target ("avx2")))
+static size_t find_any_avx2 (const char* p, size_t n, const char* delims, size_t count) {
+	if (count <= 4) {
+		return find_any4_avx2 (p, n, delims, count);
+	}
+	if (count > MAX_SIMD_DELIMS) {
+		return find_any_scalar (p, n, delims, count);
+	}
+
+	__m256i sets[MAX_SIMD_DELIMS];
+	for (size_t d = 0; d < count; ++d) {
+		sets[d] = _mm256_set1_epi8 (delims[d]);
+	}
+
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32) {
+		__m256i v = _mm256_loadu_si256 ((const __m256i*) (p + i));
+		__m256i eq = _mm256_cmpeq_epi8 (v, sets[0]);
+		for (size_t d = 1; d < count; ++d) {
+			eq = _mm256_or_si256 (eq, _mm256_cmpeq_epi8 (v, sets[d]));
+		}
+
+		unsigned mask = _mm256_movemask_epi8 (eq);
+		if (mask != 0) {
+			return i + __builtin_ctz (mask);
+		}
+	}
+
+	return i + find_any_sse2 (p + i, n - i, delims, count);
+}
+
+/*
+ * Candidates are positions where both the first and the last byte of the
+ * needle match, checked a block at a time; only those are compared in full.
+ * k is at least 2.
+ */
+static size_t find_sse2 (const char* p, size_t n, const char* needle, size_t k) {
+	const __m128i first = _mm_set1_epi8 (needle[0]);
+	const __m128i last = _mm_set1_epi8 (needle[k - 1]);
+	size_t i = 0;
+
+	for (; i + k - 1 + 16 <= n; i += 16) {
+		__m128i block_first = _mm_loadu_si128 ((const __m128i*) (p + i));
+		__m128i block_last = _mm_loadu_si128 ((const __m128i*) (p + i + k - 1));
+		unsigned mask = _mm_movemask_epi8 (_mm_and_si128 (
+					_mm_cmpeq_epi8 (first, block_first), _mm_cmpeq_epi8 (last, block_last)));
+
+		while (mask != 0) {
+			size_t pos = i + __builtin_ctz (mask);
+			if (memcmp (p + pos + 1, needle + 1, k - 2) == 0) {
+				return pos;
+			}
+			mask &= mask - 1;
+		}
+	}
+
+	return i + find_scalar (p + i, n - i, needle, k);
+}
+
+__attribute__ ((target ("avx2")))
+static size_t find_avx2 (const char* p, size_t n, const char* needle, size_t k) {
+	const __m256i first = _mm256_set1_epi8 (needle[0]);
+	const __m256i last = _mm256_set1_epi8 (needle[k - 1]);
+	size_t i = 0;
+
+	for (; i + k - 1 + 32 <= n; i += 32) {
+		__m256i block_first = _mm256_loadu_si256 ((const __m256i*) (p + i));
+		__m256i block_last = _mm256_loadu_si256 ((const __m256i*) (p + i + k - 1));
+		unsigned mask = _mm256_movemask_epi8 (_mm256_and_si256 (
+					_mm256_cmpeq_epi8 (first, block_first), _mm256_cmpeq_epi8 (last, block_last)));
+
+		while (mask != 0) {
+			size_t pos = i + __builtin_ctz (mask);
+			if (memcmp (p + pos + 1, needle + 1, k - 2) == 0) {
+				return pos;
+			}
+			mask &= mask - 1;
+		}
+	}
+
+	return i + find_sse2 (p + i, n - i, needle, k);
+}
+
+#endif // STRING_VIEW_X86
+
+static struct {
+	size_t (*find_any) (const char*, size_t, const char*, size_t);
+	size_t (*find) (const char*, size_t, const char*, size_t);
+} kernels = { find_any_scalar, find_scalar };
+
+__attribute__ ((constructor))
+static void select_kernels () {
+#ifdef STRING_VIEW_X86
+	__builtin_cpu_init ();
+
+	kernels.find_any = find_any_sse2;
+	kernels.find = find_sse2;
+
+	if (__builtin_cpu_supports ("avx2")) {
+		kernels.find_any = find_any_avx2;
+		kernels.find = find_avx2;
+	}
+#endif
+}
+
+string_view string_view_of (const char* data, size_t length) {
+	return (string_view) { data, length };
+}
+
+string_view string_view_from_cstr (const char* cstr) {
+	return (string_view) { cstr, strlen (cstr) };
+}
+
+string_view auto_string_view (auto_string* s) {
+	return (string_view) { s->buf, s->count };
+}
+
+int string_view_equals (string_view a, string_view b) {
+	return a.length == b.length && (a.length == 0 || memcmp (a.data, b.data, a.length) == 0);
+}
+
+ssize_t string_view_find_byte (string_view v, char c) {
+	if (v.length == 0) {
+		return -1;
+	}
+
+	const char* match = memchr (v.data, c, v.length);
+
+	return match == NULL ? -1 : match - v.data;
+}
+
+ssize_t string_view_find_any (string_view v, const char* delims) {
+	size_t count = strlen (delims);
+	if (count == 0 || v.length == 0) {
+		return -1;
+	}
+	if (count == 1) {
+		return string_view_find_byte (v, delims[0]);
+	}
+
+	size_t pos = kernels.find_any (v.data, v.length, delims, count);
+
+	return pos == v.length ? -1 : (ssize_t) pos;
+}
+
+ssize_t string_view_find (string_view v, string_view needle) {
+	if (needle.length == 0) {
+		return 0;
+	}
+	if (needle.length > v.length) {
+		return -1;
+	}
+	if (needle.length == 1) {
+		return string_view_find_byte (v, needle.data[0]);
+	}
+
+	size_t pos = kernels.find (v.data, v.length, needle.data, needle.length);
+
+	return pos == v.length ? -1 : (ssize_t) pos;
+}
+
+static int is_space (char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+string_view string_view_trim (string_view v) {
+	while (v.length > 0 && is_space (v.data[0])) {
+		v.data++;
+		v.length--;
+	}
+
+	while (v.length > 0 && is_space (v.data[v.length - 1])) {
+		v.length--;
+	}
+
+	return v;
+}
+
+int string_view_split (string_view* rest, const char* delims, string_view* field) {
+	if (rest->data == NULL) {
+		return 0;
+	}
+
+	ssize_t pos = string_view_find_any (*rest, delims);
+	if (pos == -1) {
+		*field = *rest;
+		*rest = (string_view) { NULL, 0 };
+		return 1;
+	}
+
+	*field = (string_view) { rest->data, pos };
+	rest->data += pos + 1;
+	rest->length -= pos + 1;
+
+	return 1;
+}
+
+int string_view_next_token (string_view* rest, const char* delims, string_view* token) {
+	size_t count = strlen (delims);
+
+	// runs of delimiters are short, so they're skipped a byte at a time
+	size_t skip = 0;
+	while (skip < rest->length && is_delim (rest->data[skip], delims, count)) {
+		++skip;
+	}
+	rest->data += skip;
+	rest->length -= skip;
+
+	if (rest->length == 0) {
+		return 0;
+	}
+
+	size_t end = count == 0 ? rest->length : kernels.find_any (rest->data, rest->length, delims, count);
+
+	*token = (string_view) { rest->data, end };
+	rest->data += end;
+	rest->length -= end;
+
+	return 1;
+}
+
+int string_view_next_line (string_view* rest, string_view* line) {
+	if (rest->length == 0) {
+		return 0;
+	}
+
+	ssize_t pos = string_view_find_byte (*rest, '\n');
+	size_t end = pos == -1 ? rest->length : (size_t) pos;
+
+	*line = (string_view) { rest->data, end };
+	if (end > 0 && line->data[end - 1] == '\r') {
+		line->length--;
+	}
+
+	if (pos == -1) {
+		rest->data += end;
+		rest->length = 0;
+	} else {
+		rest->data += end + 1;
+		rest->length -= end + 1;
+	}
+
+	return 1;
+}
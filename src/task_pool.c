@@ -0,0 +1,569 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+/*
+ * Deque slot 0 belongs to whichever thread outside the pool claims it first,
+ * and is given up at the end of an outermost task_group_wait if it's empty.
+ * Slots 1 to threads - 1 belong to the workers. The deques follow Lê, Pop,
+ * Cohen and Zappa Nardelli, "Correct and Efficient Work-Stealing for Weak
+ * Memory Models", with seq_cst accesses in place of the fences. Rings
+ * replaced when a deque grows are kept until the pool is deleted, since a
+ * thief may still be reading one.
+ *
+ * A worker that finds no work spins, then yields, then sleeps. Before it
+ * sleeps it counts itself in sleepers and looks once more, and spawning
+ * pushes before it reads sleepers, so one of the two sees the other.
+ */
+
+#define DEQUE_FIRST_SIZE 64
+#define IDLE_SPINS 32
+#define IDLE_YIELDS 64
+
+typedef struct {
+	void (*fn) (void* arg);
+	void (*body) (size_t lo, size_t hi, void* arg);
+	void* arg;
+	task_group* group;
+	size_t lo;
+	size_t hi;
+	size_t grain;
+} task;
+
+typedef struct {
+	int64_t size;
+	task* _Atomic slots[];
+} task_ring;
+
+typedef struct {
+	_Alignas (64) _Atomic int64_t top;
+	_Alignas (64) _Atomic int64_t bottom;
+	task_ring* _Atomic ring;
+	auto_array retired;
+} task_deque;
+
+struct task_pool_shared {
+	task_deque* deques;
+	pthread_t* workers;
+	size_t running;
+	void* _Atomic external;
+	sscont_pool* tasks;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	_Atomic size_t sleepers;
+	_Atomic int shutdown;
+
+	pthread_mutex_t inject_lock;
+	auto_array injected;
+	size_t injected_head;
+	_Atomic size_t injected_count;
+};
+
+/* the deque a thread owns, if any */
+static _Thread_local struct {
+	task_pool_shared* pool;
+	size_t slot;
+	size_t depth;
+	uint64_t seed;
+} self;
+
+static task_ring* ring_create (int64_t size) {
+	task_ring* r = malloc (sizeof (task_ring) + (size * sizeof (task*)));
+	if (r == NULL) {
+		PERR ("malloc");
+		return NULL;
+	}
+	r->size = size;
+
+	return r;
+}
+
+static int deque_push (task_deque* d, task* t) {
+	int64_t b = atomic_load_explicit (&d->bottom, memory_order_relaxed);
+	int64_t top = atomic_load_explicit (&d->top, memory_order_acquire);
+	task_ring* r = atomic_load_explicit (&d->ring, memory_order_relaxed);
+
+	if (b - top >= r->size) {
+		task_ring* bigger = ring_create (r->size * 2);
+		if (bigger == NULL) {
+			return -1;
+		}
+
+		for (int64_t i = top; i < b; ++i) {
+			task* moved = atomic_load_explicit (&r->slots[i & (r->size - 1)], memory_order_relaxed);
+			atomic_store_explicit (&bigger->slots[i & (bigger->size - 1)], moved, memory_order_relaxed);
+		}
+
+		if (auto_array_add (&d->retired, r) <= 0) {
+			free (bigger);
+			return -1;
+		}
+
+		atomic_store_explicit (&d->ring, bigger, memory_order_release);
+		r = bigger;
+	}
+
+	atomic_store_explicit (&r->slots[b & (r->size - 1)], t, memory_order_relaxed);
+	atomic_store_explicit (&d->bottom, b + 1, memory_order_release);
+
+	return 0;
+}
+
+static task* deque_take (task_deque* d) {
+	int64_t b = atomic_load_explicit (&d->bottom, memory_order_relaxed) - 1;
+	task_ring* r = atomic_load_explicit (&d->ring, memory_order_relaxed);
+
+	atomic_store (&d->bottom, b);
+	int64_t top = atomic_load (&d->top);
+
+	if (top > b) {
+		atomic_store_explicit (&d->bottom, b + 1, memory_order_release);
+		return NULL;
+	}
+
+	task* t = atomic_load_explicit (&r->slots[b & (r->size - 1)], memory_order_relaxed);
+	if (top == b) {
+		// the last task, race the thieves for it
+		if (!atomic_compare_exchange_strong (&d->top, &top, top + 1)) {
+			t = NULL;
+		}
+		atomic_store_explicit (&d->bottom, b + 1, memory_order_release);
+	}
+
+	return t;
+}
+
+static task* deque_steal (task_deque* d) {
+	int64_t top = atomic_load (&d->top);
+	int64_t b = atomic_load (&d->bottom);
+
+	if (top >= b) {
+		return NULL;
+	}
+
+	task_ring* r = atomic_load_explicit (&d->ring, memory_order_acquire);
+	task* t = atomic_load_explicit (&r->slots[top & (r->size - 1)], memory_order_relaxed);
+
+	if (!atomic_compare_exchange_strong (&d->top, &top, top + 1)) {
+		return NULL;
+	}
+
+	return t;
+}
+
+static int deque_init (task_deque* d) {
+	atomic_init (&d->top, 0);
+	atomic_init (&d->bottom, 0);
+	d->retired = (auto_array) AUTO_ARRAY_INITIALIZER (d->retired);
+
+	task_ring* r = ring_create (DEQUE_FIRST_SIZE);
+	atomic_init (&d->ring, r);
+
+	return r == NULL ? -1 : 0;
+}
+
+static void deque_release (task_deque* d) {
+	free (atomic_load (&d->ring));
+	auto_array_release (&d->retired, free);
+}
+
+/* the calling thread's deque in the pool, claiming slot 0 if it's free, or -1 */
+static ssize_t own_slot (task_pool_shared* sh) {
+	if (self.pool == sh) {
+		return self.slot;
+	}
+
+	void* none = NULL;
+	if (self.pool == NULL && atomic_load_explicit (&sh->external, memory_order_relaxed) == NULL
+			&& atomic_compare_exchange_strong (&sh->external, &none, &self)) {
+		self.pool = sh;
+		self.slot = 0;
+		return 0;
+	}
+
+	return -1;
+}
+
+static int inject (task_pool_shared* sh, task* t) {
+	pthread_mutex_lock (&sh->inject_lock);
+	int rv = auto_array_add (&sh->injected, t) <= 0 ? -1 : 0;
+	if (rv == 0) {
+		atomic_fetch_add (&sh->injected_count, 1);
+	}
+	pthread_mutex_unlock (&sh->inject_lock);
+
+	return rv;
+}
+
+static task* take_injected (task_pool_shared* sh) {
+	task* t = NULL;
+
+	pthread_mutex_lock (&sh->inject_lock);
+	if (sh->injected_head < sh->injected.count) {
+		t = sh->injected.data[sh->injected_head++];
+		atomic_fetch_sub (&sh->injected_count, 1);
+
+		if (sh->injected_head == sh->injected.count) {
+			sh->injected_head = 0;
+			sh->injected.count = 0;
+		}
+	}
+	pthread_mutex_unlock (&sh->inject_lock);
+
+	return t;
+}
+
+static void wake (task_pool_shared* sh) {
+	atomic_thread_fence (memory_order_seq_cst);
+
+	if (atomic_load (&sh->sleepers) > 0) {
+		pthread_mutex_lock (&sh->lock);
+		pthread_cond_signal (&sh->cond);
+		pthread_mutex_unlock (&sh->lock);
+	}
+}
+
+static int submit (task_pool_shared* sh, task* t) {
+	atomic_fetch_add_explicit (&t->group->pending, 1, memory_order_relaxed);
+
+	ssize_t slot = own_slot (sh);
+	if ((slot == -1 || deque_push (&sh->deques[slot], t) == -1) && inject (sh, t) == -1) {
+		atomic_fetch_sub (&t->group->pending, 1);
+		return -1;
+	}
+
+	wake (sh);
+
+	return 0;
+}
+
+static task* find_task (task_pool* p, ssize_t slot) {
+	task_pool_shared* sh = p->shared;
+	task* t = NULL;
+
+	if (slot != -1 && (t = deque_take (&sh->deques[slot])) != NULL) {
+		return t;
+	}
+
+	if (atomic_load_explicit (&sh->injected_count, memory_order_relaxed) > 0 && (t = take_injected (sh)) != NULL) {
+		return t;
+	}
+
+	// xorshift picks where to start so thieves spread over the victims
+	self.seed ^= self.seed << 13;
+	self.seed ^= self.seed >> 7;
+	self.seed ^= self.seed << 17;
+
+	size_t start = self.seed % p->threads;
+	for (size_t i = 0; i < p->threads; ++i) {
+		size_t victim = (start + i) % p->threads;
+		if ((ssize_t) victim != slot && (t = deque_steal (&sh->deques[victim])) != NULL) {
+			return t;
+		}
+	}
+
+	return NULL;
+}
+
+/* runs [lo, hi) after spawning its upper halves down to the grain */
+static void run_range (task_pool* p, task_group* g, size_t lo, size_t hi, size_t grain,
+		void (*body) (size_t lo, size_t hi, void* arg), void* arg) {
+	while ((hi - lo) > grain) {
+		size_t mid = lo + ((hi - lo) / 2);
+		task* upper = sscont_pool_alloc (p->shared->tasks);
+		if (upper == NULL) {
+			break;
+		}
+
+		*upper = (task) { NULL, body, arg, g, mid, hi, grain };
+		if (submit (p->shared, upper) == -1) {
+			sscont_pool_free (p->shared->tasks, upper);
+			break;
+		}
+		hi = mid;
+	}
+
+	body (lo, hi, arg);
+}
+
+static void run_task (task_pool* p, task* t) {
+	task run = *t;
+	sscont_pool_free (p->shared->tasks, t);
+
+	if (run.fn != NULL) {
+		run.fn (run.arg);
+	} else {
+		run_range (p, run.group, run.lo, run.hi, run.grain, run.body, run.arg);
+	}
+
+	atomic_fetch_sub_explicit (&run.group->pending, 1, memory_order_release);
+}
+
+static int has_work (task_pool_shared* sh, size_t threads) {
+	if (atomic_load (&sh->injected_count) > 0) {
+		return 1;
+	}
+
+	for (size_t i = 0; i < threads; ++i) {
+		if (atomic_load (&sh->deques[i].top) < atomic_load (&sh->deques[i].bottom)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+typedef struct {
+	task_pool* pool;
+	size_t slot;
+} worker_arg;
+
+static void* worker (void* arg) {
+	task_pool* p = ((worker_arg*) arg)->pool;
+	task_pool_shared* sh = p->shared;
+
+	self.pool = sh;
+	self.slot = ((worker_arg*) arg)->slot;
+	self.seed = 0x9e3779b97f4a7c15ULL * (self.slot + 1);
+	free (arg);
+
+	size_t idle = 0;
+	while (!atomic_load_explicit (&sh->shutdown, memory_order_relaxed)) {
+		task* t = find_task (p, self.slot);
+		if (t != NULL) {
+			run_task (p, t);
+			idle = 0;
+			continue;
+		}
+
+		if (++idle < IDLE_SPINS) {
+			continue;
+		}
+		if (idle < IDLE_YIELDS) {
+			sched_yield ();
+			continue;
+		}
+
+		pthread_mutex_lock (&sh->lock);
+		atomic_fetch_add (&sh->sleepers, 1);
+		while (!atomic_load (&sh->shutdown) && !has_work (sh, p->threads)) {
+			pthread_cond_wait (&sh->cond, &sh->lock);
+		}
+		atomic_fetch_sub (&sh->sleepers, 1);
+		pthread_mutex_unlock (&sh->lock);
+		idle = 0;
+	}
+
+	return NULL;
+}
+
+task_pool* task_pool_create (size_t threads) {
+	if (threads == 0) {
+		long n = sysconf (_SC_NPROCESSORS_ONLN);
+		threads = n > 0 ? n : 1;
+	}
+
+	task_pool* p = malloc (sizeof (task_pool));
+	task_pool_shared* sh = calloc (1, sizeof (task_pool_shared));
+	if (p == NULL || sh == NULL) {
+		PERR ("malloc");
+		free (p);
+		free (sh);
+		return NULL;
+	}
+
+	p->threads = threads;
+	p->shared = sh;
+
+	pthread_mutex_init (&sh->lock, NULL);
+	pthread_cond_init (&sh->cond, NULL);
+	pthread_mutex_init (&sh->inject_lock, NULL);
+	sh->injected = (auto_array) AUTO_ARRAY_INITIALIZER (sh->injected);
+	atomic_init (&sh->external, NULL);
+	atomic_init (&sh->sleepers, 0);
+	atomic_init (&sh->shutdown, 0);
+	atomic_init (&sh->injected_count, 0);
+
+	sh->deques = aligned_alloc (64, threads * sizeof (task_deque));
+	sh->workers = calloc (threads, sizeof (pthread_t));
+	sh->tasks = sscont_pool_create (sizeof (task), SSCONT_POOL_THREADED);
+	if (sh->deques == NULL || sh->workers == NULL || sh->tasks == NULL) {
+		PERR ("malloc");
+		free (sh->deques);
+		sh->deques = NULL;
+		task_pool_delete (p);
+		return NULL;
+	}
+
+	int failed = 0;
+	for (size_t i = 0; i < threads; ++i) {
+		failed |= deque_init (&sh->deques[i]) == -1;
+	}
+	if (failed) {
+		task_pool_delete (p);
+		return NULL;
+	}
+
+	for (size_t i = 1; i < threads; ++i) {
+		worker_arg* wa = malloc (sizeof (worker_arg));
+		if (wa == NULL) {
+			PERR ("malloc");
+			task_pool_delete (p);
+			return NULL;
+		}
+		*wa = (worker_arg) { p, i };
+
+		int err = pthread_create (&sh->workers[i], NULL, worker, wa);
+		if (err != 0) {
+			fprintf (stderr, "pthread_create: %s\n", strerror (err));
+			PFL ();
+			free (wa);
+			task_pool_delete (p);
+			return NULL;
+		}
+		sh->running = i;
+	}
+
+	return p;
+}
+
+int task_pool_spawn (task_group* g, void (*fn) (void* arg), void* arg) {
+	task_pool_shared* sh = g->pool->shared;
+
+	task* t = sscont_pool_alloc (sh->tasks);
+	if (t == NULL) {
+		return -1;
+	}
+
+	*t = (task) { fn, NULL, arg, g, 0, 0, 0 };
+	if (submit (sh, t) == -1) {
+		sscont_pool_free (sh->tasks, t);
+		return -1;
+	}
+
+	return 0;
+}
+
+void task_group_wait (task_group* g) {
+	task_pool* p = g->pool;
+	task_pool_shared* sh = p->shared;
+	ssize_t slot = own_slot (sh);
+	size_t spins = 0;
+
+	if (self.seed == 0) {
+		self.seed = (uintptr_t) &self | 1;
+	}
+	self.depth++;
+
+	while (atomic_load_explicit (&g->pending, memory_order_acquire) > 0) {
+		task* t = find_task (p, slot);
+		if (t != NULL) {
+			run_task (p, t);
+			spins = 0;
+		} else if (++spins >= IDLE_SPINS) {
+			sched_yield ();
+		}
+	}
+
+	self.depth--;
+
+	// an outside thread gives its deque back once it has nothing queued in it
+	if (slot == 0 && self.depth == 0
+			&& atomic_load (&sh->deques[0].top) >= atomic_load (&sh->deques[0].bottom)) {
+		self.pool = NULL;
+		atomic_store_explicit (&sh->external, NULL, memory_order_release);
+	}
+}
+
+int task_pool_parallel_for (task_pool* p, size_t n, size_t grain, void (*body) (size_t lo, size_t hi, void* arg), void* arg) {
+	if (n == 0) {
+		return 0;
+	}
+
+	if (p->threads == 1) {
+		body (0, n, arg);
+		return 0;
+	}
+
+	if (grain == 0) {
+		grain = n / (p->threads * 8);
+		if (grain == 0) {
+			grain = 1;
+		}
+	}
+
+	task_group g = TASK_GROUP_INITIALIZER (p);
+
+	// the caller runs the lower halves and helps with the rest while it waits
+	run_range (p, &g, 0, n, grain, body, arg);
+	task_group_wait (&g);
+
+	return 0;
+}
+
+void task_pool_delete (task_pool* p) {
+	task_pool_shared* sh = p->shared;
+
+	pthread_mutex_lock (&sh->lock);
+	atomic_store (&sh->shutdown, 1);
+	pthread_cond_broadcast (&sh->cond);
+	pthread_mutex_unlock (&sh->lock);
+
+	for (size_t i = 1; i <= sh->running; ++i) {
+		pthread_join (sh->workers[i], NULL);
+	}
+
+	if (sh->deques != NULL) {
+		for (size_t i = 0; i < p->threads; ++i) {
+			deque_release (&sh->deques[i]);
+		}
+	}
+
+	if (self.pool == sh) {
+		self.pool = NULL;
+	}
+
+	if (sh->tasks != NULL) {
+		sscont_pool_delete (sh->tasks);
+	}
+	auto_array_release (&sh->injected, NULL);
+	pthread_mutex_destroy (&sh->lock);
+	pthread_cond_destroy (&sh->cond);
+	pthread_mutex_destroy (&sh->inject_lock);
+	free (sh->deques);
+	free (sh->workers);
+	free (sh);
+	free (p);
+}
@@ -0,0 +1,155 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "debug_utils.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#ifdef SSCONT_USDT
+#include <sys/sdt.h>
+#define PROBE3(name, a, b, c) DTRACE_PROBE3 (sscont, name, a, b, c)
+#define PROBE5(name, a, b, c, d, e) DTRACE_PROBE5 (sscont, name, a, b, c, d, e)
+#else
+#define PROBE3(name, a, b, c)
+#define PROBE5(name, a, b, c, d, e)
+#endif
+
+#define DEFAULT_CHAIN_THRESHOLD 8
+
+/*
+ * A hook and its ctx are published together as one record, so an event
+ * racing a replacement sees either the old pair or the new one. Records
+ * are never freed, as an event may still be using a replaced one, and a
+ * pair that is set again reuses its record.
+ */
+typedef struct hook_record {
+	sscont_trace_hook fn;
+	void* ctx;
+	struct hook_record* next;
+} hook_record;
+
+static const hook_record* _Atomic hook = NULL;
+static pthread_mutex_t records_lock = PTHREAD_MUTEX_INITIALIZER;
+static hook_record* records = NULL;
+static _Atomic size_t chain_threshold = DEFAULT_CHAIN_THRESHOLD;
+
+#ifdef SSCONT_USDT
+_Atomic size_t sscont_trace_chain_limit = DEFAULT_CHAIN_THRESHOLD;
+#else
+_Atomic size_t sscont_trace_chain_limit = SIZE_MAX;
+#endif
+
+static void update_chain_limit () {
+#ifdef SSCONT_USDT
+	atomic_store (&sscont_trace_chain_limit, atomic_load (&chain_threshold));
+#else
+	atomic_store (&sscont_trace_chain_limit, atomic_load (&hook) != NULL ? atomic_load (&chain_threshold) : SIZE_MAX);
+#endif
+}
+
+void sscont_trace_set_hook (sscont_trace_hook fn, void* ctx) {
+	if (fn == NULL) {
+		atomic_store (&hook, NULL);
+		update_chain_limit ();
+		return;
+	}
+
+	pthread_mutex_lock (&records_lock);
+
+	hook_record* r = records;
+	while (r != NULL && (r->fn != fn || r->ctx != ctx)) {
+		r = r->next;
+	}
+
+	if (r == NULL) {
+		r = malloc (sizeof (hook_record));
+		if (r == NULL) {
+			PERR ("malloc");
+			pthread_mutex_unlock (&records_lock);
+			return;
+		}
+		*r = (hook_record) { fn, ctx, records };
+		records = r;
+	}
+
+	atomic_store (&hook, r);
+
+	pthread_mutex_unlock (&records_lock);
+
+	update_chain_limit ();
+}
+
+void sscont_trace_set_chain_threshold (size_t threshold) {
+	atomic_store (&chain_threshold, threshold);
+	update_chain_limit ();
+}
+
+static uint64_t now_ns () {
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static void emit (sscont_trace_event event, const char* container, const void* object, size_t old_size, size_t new_size, uint64_t ns) {
+	const hook_record* r = atomic_load_explicit (&hook, memory_order_acquire);
+	if (r != NULL) {
+		sscont_trace_record record = { event, container, object, old_size, new_size, ns };
+		r->fn (&record, r->ctx);
+	}
+}
+
+uint64_t sscont_trace_start () {
+#ifndef SSCONT_USDT
+	if (atomic_load_explicit (&hook, memory_order_relaxed) == NULL) {
+		return 0;
+	}
+#endif
+	return now_ns ();
+}
+
+void sscont_trace_resize (const char* container, const void* object, size_t old_size, size_t new_size, uint64_t start) {
+	if (start == 0) {
+		return;
+	}
+
+	uint64_t ns = now_ns () - start;
+	PROBE5 (resize, container, object, old_size, new_size, ns);
+	emit (SSCONT_TRACE_RESIZE, container, object, old_size, new_size, ns);
+}
+
+void sscont_trace_chain_walk (const void* object, size_t length, size_t bucket) {
+	PROBE3 (chain_walk, object, length, bucket);
+	emit (SSCONT_TRACE_CHAIN_WALK, "hash_table", object, length, bucket, 0);
+}
+
+void sscont_trace_set_overflow (const void* object, size_t count, size_t needed) {
+	PROBE3 (set_overflow, object, count, needed);
+	emit (SSCONT_TRACE_SET_OVERFLOW, "set", object, count, needed, 0);
+}
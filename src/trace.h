@@ -0,0 +1,47 @@
+/*
+*    libsscont - a library of software containers
+*
+*    Copyright (C) 2014 Gregory Ralph Martin
+*    info at softsprocket dot com
+*
+*    This library is free software; you can redistribute it and/or
+*    modify it under the terms of the GNU Lesser General Public
+*    License as published by the Free Software Foundation; either
+*    version 2.1 of the License, or (at your option) any later version.
+*
+*    This library is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*    Lesser General Public License for more details.
+*
+*    You should have received a copy of the GNU Lesser General Public
+*    License along with this library; if not, write to the Free Software
+*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+*    USA
+*/
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "container.h"
+
+#include <stdatomic.h>
+
+/*
+ * The library side of sscont_trace_set_hook. Sites read
+ * sscont_trace_chain_limit directly, it is SIZE_MAX while nothing listens
+ * so the compare never passes, and call into trace.c for the rarer events.
+ */
+
+extern _Atomic size_t sscont_trace_chain_limit;
+
+/* the start time of a resize, 0 if it won't be reported */
+uint64_t sscont_trace_start ();
+
+void sscont_trace_resize (const char* container, const void* object, size_t old_size, size_t new_size, uint64_t start);
+
+void sscont_trace_chain_walk (const void* object, size_t length, size_t bucket);
+
+void sscont_trace_set_overflow (const void* object, size_t count, size_t needed);
+
+#endif // TRACE_H_
@@ -1,22 +1,76 @@
+#define _GNU_SOURCE
+
 #include "debug_utils.h"
 
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include "container.h"
 
 int auto_string_test ();
 int auto_array_test ();
+int auto_array_mapped_test ();
+int small_buffer_test ();
+int parallel_test ();
 int hash_table_test ();
 int set_test ();
+int heap_test ();
+int bitset_ops_test ();
+int set_hashed_test ();
+int sorted_set_test ();
+int subset_iter_test ();
+int roaring_test ();
+int set_into_test ();
+int set_parallel_test ();
+int sketch_test ();
+int auto_string_append_test ();
+int auto_string_format_test ();
+int string_builder_test ();
+int string_view_test ();
+int byte_buffer_test ();
+int escape_test ();
+int allocator_test ();
+int arena_pool_test ();
+int trace_test ();
+int concurrent_array_test ();
+int task_pool_test ();
 
 int main (int argc, char** argv) {
 	int rv = EXIT_SUCCESS;
 
 	rv = rv | auto_string_test ();
 	rv = rv | auto_array_test ();
+	rv = rv | auto_array_mapped_test ();
+	rv = rv | small_buffer_test ();
+	rv = rv | parallel_test ();
 	rv = rv | hash_table_test ();
 	rv = rv | set_test ();
+	rv = rv | heap_test ();
+	rv = rv | bitset_ops_test ();
+	rv = rv | set_hashed_test ();
+	rv = rv | sorted_set_test ();
+	rv = rv | subset_iter_test ();
+	rv = rv | roaring_test ();
+	rv = rv | set_into_test ();
+	rv = rv | set_parallel_test ();
+	rv = rv | sketch_test ();
+	rv = rv | auto_string_append_test ();
+	rv = rv | auto_string_format_test ();
+	rv = rv | string_builder_test ();
+	rv = rv | string_view_test ();
+	rv = rv | byte_buffer_test ();
+	rv = rv | escape_test ();
+	rv = rv | allocator_test ();
+	rv = rv | arena_pool_test ();
+	rv = rv | trace_test ();
+	rv = rv | concurrent_array_test ();
+	rv = rv | task_pool_test ();
 
 	return rv;
 }
@@ -208,6 +262,308 @@ int auto_array_test () {
 	return EXIT_SUCCESS;
 }
 
+int auto_array_mapped_test () {
+	char* path = "/tmp/sscont_mapped_test.bin";
+	remove (path);
+
+	auto_array* aa = auto_array_create_mapped (10, NULL);
+	if (aa == NULL) {
+		PMSG ("auto_array_create_mapped returned NULL");
+		return EXIT_FAILURE;
+	}
+
+	if (aa->size < 10 || aa->backing != AUTO_ARRAY_MAPPED) {
+		PMSG ("auto_array_create_mapped initialization: wrong size or backing");
+		return EXIT_FAILURE;
+	}
+
+	if (auto_array_advise (aa, AUTO_ARRAY_ADVICE_SEQUENTIAL) != 0) {
+		PMSG ("auto_array_advise failed");
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < 100000; ++i) {
+		auto_array_add (aa, (void*) i);
+	}
+
+	for (size_t i = 0; i < 100000; ++i) {
+		size_t v = (size_t) auto_array_get (aa, i);
+		if (v != i) {
+			PDEC ();
+			fprintf (stderr, "auto_array_create_mapped: %lu != %lu\n", v, i);
+			return EXIT_FAILURE;
+		}
+	}
+
+	auto_array_delete (aa, NULL);
+
+	aa = auto_array_create_mapped (0, path);
+	if (aa == NULL) {
+		PMSG ("auto_array_create_mapped with file returned NULL");
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < 5000; ++i) {
+		auto_array_add (aa, (void*) (i * 3));
+	}
+
+	auto_array_delete (aa, NULL);
+
+	aa = auto_array_create_mapped (0, path);
+	if (aa == NULL) {
+		PMSG ("auto_array_create_mapped reopen returned NULL");
+		return EXIT_FAILURE;
+	}
+
+	if (aa->count != 5000) {
+		PDEC ();
+		fprintf (stderr, "auto_array_create_mapped reopen: count %lu != 5000\n", aa->count);
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < 5000; ++i) {
+		size_t v = (size_t) auto_array_get (aa, i);
+		if (v != i * 3) {
+			PDEC ();
+			fprintf (stderr, "auto_array_create_mapped reopen: %lu != %lu\n", v, i * 3);
+			return EXIT_FAILURE;
+		}
+	}
+
+	auto_array_delete (aa, NULL);
+
+	// a truncated file holds fewer items than its header claims
+	if (truncate (path, 4096) == -1 || auto_array_create_mapped (0, path) != NULL) {
+		PMSG ("auto_array_create_mapped accepted a truncated file");
+		return EXIT_FAILURE;
+	}
+	remove (path);
+
+	printf ("auto_array mapped tests pass\n");
+
+	return EXIT_SUCCESS;
+}
+
+int small_buffer_test () {
+	auto_array* aa = auto_array_create (2);
+	if (aa == NULL) {
+		PMSG ("auto_array_create returned NULL");
+		return EXIT_FAILURE;
+	}
+
+	if (aa->data != aa->small || aa->backing != AUTO_ARRAY_INLINE) {
+		PMSG ("auto_array_create: small array not stored inline");
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < 100; ++i) {
+		auto_array_add (aa, (void*) i);
+		if (i < AUTO_ARRAY_SMALL_SIZE && aa->data != aa->small) {
+			PDEC ();
+			fprintf (stderr, "auto_array_add: spilled at %lu\n", i);
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (size_t i = 0; i < 100; ++i) {
+		if ((size_t) auto_array_get (aa, i) != i) {
+			PDEC ();
+			fprintf (stderr, "auto_array_get after spill: %lu != %lu\n", (size_t) auto_array_get (aa, i), i);
+			return EXIT_FAILURE;
+		}
+	}
+
+	auto_array_delete (aa, NULL);
+
+	auto_array tmp = AUTO_ARRAY_INITIALIZER (tmp);
+	auto_array_add (&tmp, "one");
+	auto_array_add (&tmp, "two");
+	if (tmp.count != 2 || strcmp (auto_array_last (&tmp), "two") != 0) {
+		PMSG ("AUTO_ARRAY_INITIALIZER: add failed");
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 0; i < 10; ++i) {
+		auto_array_add (&tmp, "more");
+	}
+
+	auto_array_release (&tmp, NULL);
+	if (tmp.count != 0 || tmp.data != tmp.small) {
+		PMSG ("auto_array_release: not reset");
+		return EXIT_FAILURE;
+	}
+
+	auto_string* as = auto_string_create (8);
+	if (as == NULL) {
+		PMSG ("auto_string_create returned NULL");
+		return EXIT_FAILURE;
+	}
+
+	if (as->buf != as->small || auto_string_length (as) != 0) {
+		PMSG ("auto_string_create: short string not stored inline");
+		return EXIT_FAILURE;
+	}
+
+	auto_string_append (as, "short");
+	if (as->buf != as->small) {
+		PMSG ("auto_string_append: spilled early");
+		return EXIT_FAILURE;
+	}
+
+	char* long_str = "a string that is too long for the inline buffer of an auto_string";
+	auto_string_append (as, long_str);
+	if (as->buf == as->small || strncmp (as->buf, "short", 5) != 0 || strcmp (as->buf + 5, long_str) != 0) {
+		PMSG ("auto_string_append: spill failed");
+		return EXIT_FAILURE;
+	}
+
+	auto_string_delete (as);
+
+	auto_string str = AUTO_STRING_INITIALIZER (str);
+	auto_string_append (&str, "Hello");
+	auto_string_append (&str, ", World");
+	if (strcmp (str.buf, "Hello, World") != 0 || str.buf != str.small) {
+		PMSG ("AUTO_STRING_INITIALIZER: append failed");
+		return EXIT_FAILURE;
+	}
+
+	auto_string_release (&str);
+
+	printf ("small buffer tests pass\n");
+
+	return EXIT_SUCCESS;
+}
+
+void par_mark (void* item, size_t pos, void* ctx) {
+	unsigned char* seen = ctx;
+	seen[pos] = (size_t) item == pos;
+}
+
+void* par_double (void* item, void* ctx) {
+	return (void*) ((size_t) item * 2);
+}
+
+int par_is_odd (void* item, void* ctx) {
+	return (size_t) item & 1;
+}
+
+void* par_sum (void* acc, void* item, void* ctx) {
+	return (void*) ((size_t) acc + (size_t) item);
+}
+
+void* par_reducer (void* arg) {
+	auto_array* aa = arg;
+	size_t n = aa->count;
+
+	for (int i = 0; i < 200; ++i) {
+		if ((size_t) auto_array_reduce (aa, (void*) 0, par_sum, par_sum, NULL) != (n * (n - 1)) / 2) {
+			return arg;
+		}
+	}
+
+	return NULL;
+}
+
+int parallel_test () {
+	size_t n = 100000;
+
+	if (auto_array_parallel_threads (4) != 0) {
+		PMSG ("auto_array_parallel_threads failed");
+		return EXIT_FAILURE;
+	}
+
+	auto_array* aa = auto_array_create (n);
+	if (aa == NULL) {
+		PMSG ("auto_array_create returned NULL");
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < n; ++i) {
+		auto_array_add (aa, (void*) i);
+	}
+
+	unsigned char* seen = calloc (n, 1);
+	if (seen == NULL) {
+		PERR ("calloc");
+		exit (EXIT_FAILURE);
+	}
+
+	if (auto_array_parallel_for (aa, par_mark, seen) != 0) {
+		PMSG ("auto_array_parallel_for failed");
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < n; ++i) {
+		if (!seen[i]) {
+			PDEC ();
+			fprintf (stderr, "auto_array_parallel_for: item %lu not visited\n", i);
+			return EXIT_FAILURE;
+		}
+	}
+
+	free (seen);
+
+	auto_array* doubled = auto_array_map (aa, par_double, NULL);
+	if (doubled == NULL || doubled->count != n) {
+		PMSG ("auto_array_map failed");
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < n; ++i) {
+		if ((size_t) auto_array_get (doubled, i) != i * 2) {
+			PDEC ();
+			fprintf (stderr, "auto_array_map: %lu != %lu\n", (size_t) auto_array_get (doubled, i), i * 2);
+			return EXIT_FAILURE;
+		}
+	}
+
+	auto_array_delete (doubled, NULL);
+
+	auto_array* odd = auto_array_filter (aa, par_is_odd, NULL);
+	if (odd == NULL || odd->count != n / 2) {
+		PMSG ("auto_array_filter failed");
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < odd->count; ++i) {
+		if ((size_t) auto_array_get (odd, i) != (i * 2) + 1) {
+			PDEC ();
+			fprintf (stderr, "auto_array_filter: %lu != %lu\n", (size_t) auto_array_get (odd, i), (i * 2) + 1);
+			return EXIT_FAILURE;
+		}
+	}
+
+	auto_array_delete (odd, NULL);
+
+	size_t sum = (size_t) auto_array_reduce (aa, (void*) 0, par_sum, par_sum, NULL);
+	if (sum != (n * (n - 1)) / 2) {
+		PDEC ();
+		fprintf (stderr, "auto_array_reduce: %lu != %lu\n", sum, (n * (n - 1)) / 2);
+		return EXIT_FAILURE;
+	}
+
+	// calls in flight keep the pool they started on when it is replaced
+	pthread_t reducer;
+	void* failed = NULL;
+	pthread_create (&reducer, NULL, par_reducer, aa);
+	for (int i = 0; i < 20; ++i) {
+		auto_array_parallel_threads (2 + (i % 3));
+	}
+	pthread_join (reducer, &failed);
+	if (failed != NULL) {
+		PMSG ("auto_array_reduce: wrong sum while the pool was replaced");
+		return EXIT_FAILURE;
+	}
+
+	auto_array_delete (aa, NULL);
+
+	auto_array_parallel_threads (1);
+
+	printf ("parallel tests pass\n");
+
+	return EXIT_SUCCESS;
+}
+
 int hash_table_test () {
 	hash_table* ht = hash_table_create (10);
 	if (ht == NULL) {
@@ -310,6 +666,26 @@ int hash_table_test () {
 
 	hash_table_delete (ht, NULL);
 
+	// a single bucket grows past its initial size and stays searchable after removes
+	ht = hash_table_create (1);
+	char many[64][8];
+	for (size_t i = 0; i < 64; ++i) {
+		snprintf (many[i], sizeof (many[i]), "k%zu", i);
+		hash_table_put (ht, many[i], many[i]);
+	}
+	for (size_t i = 0; i < 64; i += 3) {
+		hash_table_remove (ht, many[i]);
+	}
+	for (size_t i = 0; i < 64; ++i) {
+		char* v = hash_table_get (ht, many[i]);
+		if ((i % 3 == 0) != (v == NULL)) {
+			PDEC ();
+			fprintf (stderr, "hash_table_get after remove: %s returned %s\n", many[i], v ? v : "NULL");
+			return EXIT_FAILURE;
+		}
+	}
+	hash_table_delete (ht, NULL);
+
 	printf ("hash_table tests pass\n");
 
 	return EXIT_SUCCESS;
@@ -523,3 +899,2235 @@ int set_test () {
 	return EXIT_SUCCESS;
 }
 
+int int_compare (void* this, void* that) {
+	int* l = this;
+	int* r = that;
+
+	return *l < *r ? -1 : *l > *r;
+}
+
+int heap_test () {
+	int values[1000];
+	heap_node* nodes[1000];
+
+	heap* h = heap_create (10, 3, int_compare);
+	if (h == NULL) {
+		PMSG ("heap_create returned NULL");
+		return EXIT_FAILURE;
+	}
+
+	if (heap_pop (h) != NULL || heap_peek (h) != NULL) {
+		PMSG ("heap_pop: empty heap returned an item");
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 0; i < 1000; ++i) {
+		values[i] = (i * 7919) % 1000;
+		nodes[i] = heap_push (h, &values[i]);
+		if (nodes[i] == NULL) {
+			PMSG ("heap_push returned NULL");
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (heap_count (h) != 1000) {
+		PDEC ();
+		fprintf (stderr, "heap_push: count %lu != 1000\n", heap_count (h));
+		return EXIT_FAILURE;
+	}
+
+	int* first = heap_peek (h);
+	if (*first != 0) {
+		PDEC ();
+		fprintf (stderr, "heap_peek: %d != 0\n", *first);
+		return EXIT_FAILURE;
+	}
+
+	// move one item to the front and one to the back, remove another
+	values[500] = -1;
+	heap_update (h, nodes[500]);
+	int moved = values[10];
+	values[10] = 5000;
+	heap_update (h, nodes[10]);
+
+	int* removed = heap_remove (h, nodes[20]);
+	if (removed != &values[20]) {
+		PMSG ("heap_remove returned the wrong item");
+		return EXIT_FAILURE;
+	}
+
+	int* ip = heap_pop (h);
+	if (*ip != -1) {
+		PDEC ();
+		fprintf (stderr, "heap_update: popped %d != -1\n", *ip);
+		return EXIT_FAILURE;
+	}
+
+	int prev = -1;
+	size_t popped = 1;
+	while ((ip = heap_pop (h)) != NULL) {
+		if (*ip < prev || *ip == moved || *ip == values[20]) {
+			PDEC ();
+			fprintf (stderr, "heap_pop: %d out of order after %d\n", *ip, prev);
+			return EXIT_FAILURE;
+		}
+		prev = *ip;
+		popped++;
+	}
+
+	if (popped != 999 || prev != 5000) {
+		PDEC ();
+		fprintf (stderr, "heap_pop: popped %lu items, last %d\n", popped, prev);
+		return EXIT_FAILURE;
+	}
+
+	heap_delete (h, NULL);
+
+	auto_array* aa = auto_array_create (100);
+	for (int i = 0; i < 1000; ++i) {
+		values[i] = 999 - i;
+		auto_array_add (aa, &values[i]);
+	}
+
+	h = heap_create_from (aa, 0, int_compare);
+	if (h == NULL) {
+		PMSG ("heap_create_from returned NULL");
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 0; i < 1000; ++i) {
+		ip = heap_pop (h);
+		if (ip == NULL || *ip != i) {
+			PDEC ();
+			fprintf (stderr, "heap_create_from: pop %d != %d\n", ip == NULL ? -1 : *ip, i);
+			return EXIT_FAILURE;
+		}
+	}
+
+	heap_delete (h, NULL);
+	auto_array_delete (aa, NULL);
+
+	printf ("heap tests pass\n");
+
+	return EXIT_SUCCESS;
+}
+
+int bitset_ops_test () {
+	bitset* a = bitset_create (10);
+	bitset* b = bitset_create (0);
+	if (a == NULL || b == NULL) {
+		PMSG ("bitset_create returned NULL");
+		return EXIT_FAILURE;
+	}
+
+	if (bitset_first (a) != -1 || bitset_count (a) != 0) {
+		PMSG ("bitset_create: bits not clear");
+		return EXIT_FAILURE;
+	}
+
+	// a holds multiples of 3, b multiples of 5, both past a few simd blocks
+	for (size_t i = 0; i < 3000; i += 3) {
+		bitset_set (a, i);
+	}
+
+	for (size_t i = 0; i < 5000; i += 5) {
+		bitset_set (b, i);
+	}
+
+	if (a->size != 2998 || !bitset_test (a, 2997) || bitset_test (a, 2998) || bitset_test (a, 100000)) {
+		PMSG ("bitset_set: grow failed");
+		return EXIT_FAILURE;
+	}
+
+	if (bitset_count (a) != 1000 || bitset_count (b) != 1000) {
+		PDEC ();
+		fprintf (stderr, "bitset_count: %lu, %lu != 1000\n", bitset_count (a), bitset_count (b));
+		return EXIT_FAILURE;
+	}
+
+	bitset_clear (a, 0);
+	if (bitset_first (a) != 3 || bitset_next (a, 4) != 6 || bitset_next (a, 2998) != -1) {
+		PMSG ("bitset_first/bitset_next failed");
+		return EXIT_FAILURE;
+	}
+	bitset_set (a, 0);
+
+	bitset* c = bitset_create (0);
+	bitset_or (c, a);
+	bitset_and (c, b);
+
+	size_t n = 0;
+	for (ssize_t bit = bitset_first (c); bit != -1; bit = bitset_next (c, bit + 1)) {
+		if (bit % 15 != 0) {
+			PDEC ();
+			fprintf (stderr, "bitset_and: %ld is not a multiple of 15\n", bit);
+			return EXIT_FAILURE;
+		}
+		n++;
+	}
+
+	if (n != 200) {
+		PDEC ();
+		fprintf (stderr, "bitset_and: count %lu != 200\n", n);
+		return EXIT_FAILURE;
+	}
+
+	bitset_or (c, b);
+	if (bitset_count (c) != 1000 || c->size != b->size) {
+		PMSG ("bitset_or failed");
+		return EXIT_FAILURE;
+	}
+
+	bitset_xor (c, a);
+	// multiples of 3 or 5 that aren't multiples of 15
+	if (bitset_count (c) != 1600 || bitset_test (c, 15) || !bitset_test (c, 3)) {
+		PDEC ();
+		fprintf (stderr, "bitset_xor: count %lu != 1600\n", bitset_count (c));
+		return EXIT_FAILURE;
+	}
+
+	bitset_andnot (c, a);
+	if (bitset_count (c) != 800 || bitset_test (c, 3) || !bitset_test (c, 4995)) {
+		PDEC ();
+		fprintf (stderr, "bitset_andnot: count %lu != 800\n", bitset_count (c));
+		return EXIT_FAILURE;
+	}
+
+	bitset_delete (a);
+	bitset_delete (b);
+	bitset_delete (c);
+
+	printf ("bitset tests pass\n");
+
+	return EXIT_SUCCESS;
+}
+
+uint32_t str_hash (void* str) {
+	return SuperFastHash (str, strlen (str));
+}
+
+int set_hashed_test () {
+	char* words[8] = { "zero", "one", "two", "three", "four", "five", "six", "seven" };
+	char* others[4] = { "six", "eight", "zero", "nine" };
+
+	set* s = set_create_hashed (2, str_equals, str_hash);
+	if (s == NULL) {
+		PMSG ("set_create_hashed returned NULL");
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 0; i < 8; ++i) {
+		ssize_t c = set_add_item (s, words[i]);
+		if (c != i + 1) {
+			PDEC ();
+			fprintf (stderr, "set_add_item hashed: returned %ld, not %d\n", c, i + 1);
+			return EXIT_FAILURE;
+		}
+	}
+
+	char dup[] = "three";
+	if (set_add_item (s, dup) != 3 || s->count != 8) {
+		PMSG ("set_add_item hashed: duplicate added");
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 0; i < 8; ++i) {
+		char copy[16];
+		strcpy (copy, words[i]);
+		if (set_get_item_index (s, copy) != i) {
+			PDEC ();
+			fprintf (stderr, "set_get_item_index hashed: %s not at %d\n", copy, i);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (set_get_item_index (s, "eight") != -1) {
+		PMSG ("set_get_item_index hashed: found missing item");
+		return EXIT_FAILURE;
+	}
+
+	set* o = set_create_hashed (4, str_equals, str_hash);
+	if (set_add_items (o, (void**) others, 4) != 4) {
+		PMSG ("set_add_items hashed failed");
+		return EXIT_FAILURE;
+	}
+
+	set* uni = set_union (s, o);
+	if (uni == NULL || uni->count != 10 || uni->hash == NULL) {
+		PMSG ("set_union hashed failed");
+		return EXIT_FAILURE;
+	}
+
+	if (strcmp (set_get_item (uni, 8), "eight") != 0 || set_get_item_index (uni, "nine") != 9 
+			|| set_get_item_index (uni, "four") != 4) {
+		PMSG ("set_union hashed: wrong items");
+		return EXIT_FAILURE;
+	}
+
+	set* inter = set_intersection (s, o);
+	if (inter == NULL || inter->count != 2) {
+		PMSG ("set_intersection hashed failed");
+		return EXIT_FAILURE;
+	}
+
+	if (strcmp (set_get_item (inter, 0), "zero") != 0 || strcmp (set_get_item (inter, 1), "six") != 0) {
+		PMSG ("set_intersection hashed: wrong items");
+		return EXIT_FAILURE;
+	}
+
+	set_delete (inter, NULL);
+	set_delete (uni, NULL);
+	set_delete (o, NULL);
+	set_delete (s, NULL);
+
+	printf ("hashed set tests pass\n");
+
+	return EXIT_SUCCESS;
+}
+
+/* checks a result against membership in the operands, op is '&', '|', '-' or '^' */
+int sorted_set_check (sorted_set* r, sorted_set* a, sorted_set* b, char op, uint32_t limit) {
+	for (size_t i = 1; i < r->count; ++i) {
+		if (r->data[i - 1] >= r->data[i]) {
+			PDEC ();
+			fprintf (stderr, "sorted_set %c: not sorted at %lu\n", op, i);
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (uint32_t v = 0; v < limit; ++v) {
+		int in_a = sorted_set_contains (a, v);
+		int in_b = sorted_set_contains (b, v);
+		int expected = op == '&' ? in_a && in_b 
+			: op == '|' ? in_a || in_b 
+			: op == '-' ? in_a && !in_b 
+			: in_a != in_b;
+
+		if (sorted_set_contains (r, v) != expected) {
+			PDEC ();
+			fprintf (stderr, "sorted_set %c: wrong membership for %u\n", op, v);
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+int sorted_set_test () {
+	uint32_t values[8] = { 9, 3, 7, 3, 1, 9, 5, 0 };
+
+	sorted_set* ss = sorted_set_create_from (values, 8);
+	if (ss == NULL || ss->count != 6 || ss->data[0] != 0 || ss->data[5] != 9) {
+		PMSG ("sorted_set_create_from failed");
+		return EXIT_FAILURE;
+	}
+
+	if (sorted_set_add (ss, 4) != 7 || sorted_set_add (ss, 4) != 7 || sorted_set_add (ss, 20) != 8 
+			|| sorted_set_index (ss, 4) != 3 || sorted_set_index (ss, 6) != -1) {
+		PMSG ("sorted_set_add failed");
+		return EXIT_FAILURE;
+	}
+
+	if (sorted_set_remove (ss, 4) != 7 || sorted_set_remove (ss, 4) != -1 || sorted_set_contains (ss, 4)) {
+		PMSG ("sorted_set_remove failed");
+		return EXIT_FAILURE;
+	}
+	sorted_set_delete (ss);
+
+	// pairs of equal, similar and very different sizes, tried with each kernel
+	size_t sizes[3][2] = { { 1000, 1000 }, { 300, 2000 }, { 20, 5000 } };
+	uint32_t limit = 20000;
+
+	for (int level = SORTED_SET_AVX2; level >= SORTED_SET_SCALAR; --level) {
+		sorted_set_simd (level);
+
+		for (int s = 0; s < 3; ++s) {
+			sorted_set* a = sorted_set_create (0);
+			sorted_set* b = sorted_set_create (0);
+			uint32_t seed = 12345;
+
+			while (a->count < sizes[s][0]) {
+				seed = (seed * 1103515245) + 12345;
+				sorted_set_add (a, (seed >> 8) % limit);
+			}
+
+			while (b->count < sizes[s][1]) {
+				seed = (seed * 1103515245) + 12345;
+				sorted_set_add (b, (seed >> 8) % limit);
+			}
+
+			sorted_set* results[4] = {
+				sorted_set_intersection (a, b),
+				sorted_set_union (b, a),
+				sorted_set_difference (b, a),
+				sorted_set_symmetric_difference (a, b)
+			};
+
+			if (sorted_set_check (results[0], a, b, '&', limit) != EXIT_SUCCESS
+					|| sorted_set_check (results[1], a, b, '|', limit) != EXIT_SUCCESS
+					|| sorted_set_check (results[2], b, a, '-', limit) != EXIT_SUCCESS
+					|| sorted_set_check (results[3], a, b, '^', limit) != EXIT_SUCCESS) {
+				fprintf (stderr, "sizes %lu, %lu at simd level %d\n", sizes[s][0], sizes[s][1], level);
+				return EXIT_FAILURE;
+			}
+
+			if (sorted_set_intersection_size (b, a) != results[0]->count) {
+				PMSG ("sorted_set_intersection_size failed");
+				return EXIT_FAILURE;
+			}
+
+			for (int i = 0; i < 4; ++i) {
+				sorted_set_delete (results[i]);
+			}
+			sorted_set_delete (a);
+			sorted_set_delete (b);
+		}
+	}
+
+	sorted_set_simd (SORTED_SET_AVX2);
+
+	printf ("sorted set tests pass\n");
+
+	return EXIT_SUCCESS;
+}
+
+/* checks that the iterator's items are the items its mask selects, in set order */
+int subset_matches (set_subset_iter* it) {
+	size_t k = 0;
+
+	for (size_t i = 0; i < it->s->count; ++i) {
+		if (it->mask & (1ULL << i)) {
+			if (k >= it->count || it->items[k] != it->s->data[i]) {
+				return 0;
+			}
+			k++;
+		}
+	}
+
+	return k == it->count;
+}
+
+int subset_iter_test () {
+	int values[6] = { 0, 1, 2, 3, 4, 5 };
+	void* buf[6];
+	set_subset_iter it;
+
+	set* s = set_create (6, equals);
+	for (int i = 0; i < 6; ++i) {
+		set_add_item (s, &values[i]);
+	}
+
+	if (set_subset_count (s) != 64 || set_combination_count (s, 2) != 15 || set_combination_count (s, 7) != 0) {
+		PMSG ("set_subset_count/set_combination_count failed");
+		return EXIT_FAILURE;
+	}
+
+	// the whole power set in one pass, then split in 3 uneven ranges
+	uint64_t seen = 0;
+	uint64_t bounds[4] = { 0, 64, 64, 64 };
+
+	for (int pass = 0; pass < 2; ++pass) {
+		for (int range = 0; range < 3; ++range) {
+			if (set_subsets_begin (&it, s, buf, bounds[range], bounds[range + 1]) == -1) {
+				PMSG ("set_subsets_begin failed");
+				return EXIT_FAILURE;
+			}
+
+			uint64_t prev = 0;
+			uint64_t n = 0;
+			while (set_subset_next (&it)) {
+				if (!subset_matches (&it) || (seen & (1ULL << it.mask))) {
+					PDEC ();
+					fprintf (stderr, "set_subset_next: bad subset %lx\n", it.mask);
+					return EXIT_FAILURE;
+				}
+
+				if (n > 0 && (it.toggled == -1 || (prev ^ it.mask) != 1ULL << it.toggled)) {
+					PDEC ();
+					fprintf (stderr, "set_subset_next: %lx to %lx is not one toggle\n", prev, it.mask);
+					return EXIT_FAILURE;
+				}
+
+				seen |= 1ULL << it.mask;
+				prev = it.mask;
+				n++;
+			}
+
+			if (n != bounds[range + 1] - bounds[range]) {
+				PMSG ("set_subset_next: wrong number of subsets");
+				return EXIT_FAILURE;
+			}
+		}
+
+		if (seen != ~0ULL) {
+			PMSG ("set_subset_next: subsets missing");
+			return EXIT_FAILURE;
+		}
+
+		seen = 0;
+		bounds[1] = 5;
+		bounds[2] = 37;
+	}
+
+	if (set_subsets_begin (&it, s, buf, 10, 65) != -1) {
+		PMSG ("set_subsets_begin: accepted a range past the end");
+		return EXIT_FAILURE;
+	}
+
+	// 3 of 6 is 20 subsets, split at 7
+	seen = 0;
+	uint64_t prev = 0;
+	for (uint64_t begin = 0; begin < 20; begin += 7) {
+		set_combinations_begin (&it, s, 3, buf, begin, begin + 7 < 20 ? begin + 7 : 20);
+
+		while (set_subset_next (&it)) {
+			if (it.count != 3 || !subset_matches (&it) || (seen & (1ULL << it.mask)) || it.mask <= prev) {
+				PDEC ();
+				fprintf (stderr, "set_subset_next: bad combination %lx\n", it.mask);
+				return EXIT_FAILURE;
+			}
+			seen |= 1ULL << it.mask;
+			prev = it.mask;
+		}
+	}
+
+	if (__builtin_popcountll (seen) != 20) {
+		PMSG ("set_combinations_begin: combinations missing");
+		return EXIT_FAILURE;
+	}
+
+	set_combinations_begin (&it, s, 0, buf, 0, 1);
+	if (!set_subset_next (&it) || it.count != 0 || set_subset_next (&it)) {
+		PMSG ("set_combinations_begin: k of 0 failed");
+		return EXIT_FAILURE;
+	}
+
+	set_delete (s, NULL);
+
+	printf ("subset iterator tests pass\n");
+
+	return EXIT_SUCCESS;
+}
+
+/* checks a roaring set against a bitset holding the same values */
+int roaring_matches (roaring* r, bitset* bs, const char* what) {
+	if (roaring_cardinality (r) != bitset_count (bs)) {
+		PDEC ();
+		fprintf (stderr, "%s: cardinality %lu != %lu\n", what, roaring_cardinality (r), bitset_count (bs));
+		return 0;
+	}
+
+	uint64_t rank = 0;
+	for (ssize_t b = bitset_first (bs); b != -1; b = bitset_next (bs, b + 1)) {
+		uint32_t v;
+		if (!roaring_contains (r, b) || roaring_select (r, rank, &v) == -1 || v != b || roaring_rank (r, b) != rank + 1) {
+			PDEC ();
+			fprintf (stderr, "%s: %ld missing or misranked\n", what, b);
+			return 0;
+		}
+		rank++;
+	}
+
+	return 1;
+}
+
+int roaring_test () {
+	// 4 chunks: sparse, dense, a long range and a chunk with a range and holes
+	roaring* a = roaring_create ();
+	roaring* b = roaring_create ();
+	bitset* ba = bitset_create (0);
+	bitset* bb = bitset_create (0);
+
+	for (uint32_t v = 7; v < 65536; v += 97) {
+		roaring_add (a, v);
+		bitset_set (ba, v);
+	}
+
+	for (uint32_t v = 65536; v < 131072; v += 3) {
+		roaring_add (a, v);
+		bitset_set (ba, v);
+	}
+
+	roaring_add_range (a, 140000, 200000);
+	for (uint32_t v = 140000; v < 200000; ++v) {
+		bitset_set (ba, v);
+	}
+
+	for (uint32_t v = 0; v < 262144; v += 5) {
+		roaring_add (b, v);
+		bitset_set (bb, v);
+	}
+
+	roaring_add_range (b, 190000, 210000);
+	for (uint32_t v = 190000; v < 210000; ++v) {
+		bitset_set (bb, v);
+	}
+
+	for (uint32_t v = 195000; v < 196000; v += 2) {
+		roaring_remove (b, v);
+		bitset_clear (bb, v);
+	}
+
+	if (roaring_add (a, 7) != 0 || roaring_remove (a, 8) != 0 || roaring_select (a, roaring_cardinality (a), NULL) != -1) {
+		PMSG ("roaring_add/roaring_remove: wrong result for present or absent value");
+		return EXIT_FAILURE;
+	}
+
+	if (!roaring_matches (a, ba, "roaring a") || !roaring_matches (b, bb, "roaring b")) {
+		return EXIT_FAILURE;
+	}
+
+	roaring_optimize (a);
+	if (!roaring_matches (a, ba, "roaring_optimize")) {
+		return EXIT_FAILURE;
+	}
+
+	// split, shorten, join and extend the runs
+	uint32_t removes[3] = { 150000, 150001, 140000 };
+	for (int r = 0; r < 3; ++r) {
+		roaring_remove (a, removes[r]);
+		bitset_clear (ba, removes[r]);
+	}
+
+	uint32_t adds[4] = { 150001, 150000, 139998, 139999 };
+	for (int r = 0; r < 4; ++r) {
+		roaring_add (a, adds[r]);
+		bitset_set (ba, adds[r]);
+	}
+
+	if (!roaring_matches (a, ba, "roaring runs")) {
+		return EXIT_FAILURE;
+	}
+
+	roaring* u = roaring_union (a, b);
+	roaring* i = roaring_intersection (a, b);
+	roaring* d = roaring_andnot (a, b);
+
+	bitset* bu = bitset_create (0);
+	bitset_or (bu, ba);
+	bitset_or (bu, bb);
+	bitset* bi = bitset_create (0);
+	bitset_or (bi, ba);
+	bitset_and (bi, bb);
+	bitset* bd = bitset_create (0);
+	bitset_or (bd, ba);
+	bitset_andnot (bd, bb);
+
+	if (!roaring_matches (u, bu, "roaring_union") || !roaring_matches (i, bi, "roaring_intersection") 
+			|| !roaring_matches (d, bd, "roaring_andnot")) {
+		return EXIT_FAILURE;
+	}
+
+	// round trip each result through the portable format
+	roaring* sets[3] = { u, i, d };
+	bitset* refs[3] = { bu, bi, bd };
+	for (int s = 0; s < 3; ++s) {
+		size_t len = roaring_serialized_size (sets[s]);
+		uint8_t* buf = malloc (len);
+		if (roaring_serialize (sets[s], buf) != len) {
+			PMSG ("roaring_serialize: wrong length");
+			return EXIT_FAILURE;
+		}
+
+		roaring* copy = roaring_deserialize (buf, len);
+		if (copy == NULL || !roaring_matches (copy, refs[s], "roaring_deserialize")) {
+			PMSG ("roaring_deserialize failed");
+			return EXIT_FAILURE;
+		}
+
+		if (roaring_deserialize (buf, len - 1) != NULL) {
+			PMSG ("roaring_deserialize: accepted truncated data");
+			return EXIT_FAILURE;
+		}
+
+		roaring_delete (copy);
+		free (buf);
+	}
+
+	uint32_t* values = malloc (roaring_cardinality (u) * sizeof (uint32_t));
+	size_t n = roaring_to_array (u, values);
+	for (size_t v = 1; v < n; ++v) {
+		if (values[v - 1] >= values[v]) {
+			PMSG ("roaring_to_array: not ascending");
+			return EXIT_FAILURE;
+		}
+	}
+	free (values);
+
+	roaring_delete (a);
+	roaring_delete (b);
+	roaring_delete (u);
+	roaring_delete (i);
+	roaring_delete (d);
+	bitset_delete (ba);
+	bitset_delete (bb);
+	bitset_delete (bu);
+	bitset_delete (bi);
+	bitset_delete (bd);
+
+	printf ("roaring tests pass\n");
+
+	return EXIT_SUCCESS;
+}
+
+uint32_t int_hash (void* item) {
+	return SuperFastHash (item, sizeof (int));
+}
+
+int set_into_test () {
+	int values[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+
+	// plain and hashed versions of evens, multiples of 3 and 10..
+	for (int hashed = 0; hashed < 2; ++hashed) {
+		set* evens = hashed ? set_create_hashed (1, equals, int_hash) : set_create (10, equals);
+		set* threes = hashed ? set_create_hashed (1, equals, int_hash) : set_create (10, equals);
+		set* none = hashed ? set_create_hashed (1, equals, int_hash) : set_create (10, equals);
+
+		for (int i = 0; i < 10; ++i) {
+			if (i % 2 == 0) {
+				set_add_item (evens, &values[i]);
+			}
+			if (i % 3 == 0) {
+				set_add_item (threes, &values[i]);
+			}
+		}
+
+		set* empty = set_intersection (none, evens);
+		if (empty == NULL || empty->count != 0) {
+			PMSG ("set_intersection: empty result is not an empty set");
+			return EXIT_FAILURE;
+		}
+		set_delete (empty, NULL);
+
+		if (set_intersection_size (evens, threes) != 2 || set_intersection_size (threes, evens) != 2 
+				|| set_intersection_size (none, evens) != 0) {
+			PMSG ("set_intersection_size failed");
+			return EXIT_FAILURE;
+		}
+
+		set* diff = set_difference (evens, threes);
+		if (diff == NULL || diff->count != 3 || *(int*) set_get_item (diff, 0) != 2 
+				|| *(int*) set_get_item (diff, 2) != 8) {
+			PMSG ("set_difference failed");
+			return EXIT_FAILURE;
+		}
+
+		// evens | threes = 0 2 4 6 8 3 9, & diff = 2 4 8, - threes = 2 4 8
+		set* acc = hashed ? set_create_hashed (1, equals, int_hash) : set_create (10, equals);
+		if (set_union_into (acc, evens) != 5 || set_union_into (acc, threes) != 7 || set_union_into (acc, acc) != 7) {
+			PMSG ("set_union_into failed");
+			return EXIT_FAILURE;
+		}
+
+		if (set_intersect_into (acc, diff) != 3 || set_difference_into (acc, threes) != 3) {
+			PMSG ("set_intersect_into/set_difference_into: wrong count");
+			return EXIT_FAILURE;
+		}
+
+		for (int i = 0; i < 3; ++i) {
+			int* item = set_get_item (acc, i);
+			if ((*item != 2 && *item != 4 && *item != 8) || set_get_item_index (acc, item) != i) {
+				PDEC ();
+				fprintf (stderr, "set_intersect_into: %d at %d\n", *item, i);
+				return EXIT_FAILURE;
+			}
+		}
+
+		if (set_get_item_index (acc, &values[6]) != -1 || set_difference_into (acc, acc) != 0 
+				|| set_get_item_index (acc, &values[2]) != -1) {
+			PMSG ("set_difference_into: removed items still found");
+			return EXIT_FAILURE;
+		}
+
+		set_delete (acc, NULL);
+		set_delete (diff, NULL);
+		set_delete (none, NULL);
+		set_delete (threes, NULL);
+		set_delete (evens, NULL);
+	}
+
+	// a full plain dest only fails when other has items it lacks
+	set* full = set_create (3, equals);
+	set* sub = set_create (3, equals);
+	set_add_item (full, &values[1]);
+	set_add_item (full, &values[2]);
+	set_add_item (full, &values[3]);
+	set_add_item (sub, &values[2]);
+	if (set_union_into (full, sub) != 3 || set_union_into (full, full) != 3) {
+		PMSG ("set_union_into: full dest rejected a subset");
+		return EXIT_FAILURE;
+	}
+
+	set_add_item (sub, &values[4]);
+	if (set_union_into (full, sub) != -1 || full->count != 3 || set_get_item_index (full, &values[4]) != -1) {
+		PMSG ("set_union_into: overflowing union changed dest");
+		return EXIT_FAILURE;
+	}
+	set_delete (sub, NULL);
+	set_delete (full, NULL);
+
+	// enough items for long probe runs in the index
+	int* many = malloc (3000 * sizeof (int));
+	set* big = set_create_hashed (16, equals, int_hash);
+	set* drop = set_create_hashed (16, equals, int_hash);
+	for (int i = 0; i < 3000; ++i) {
+		many[i] = i;
+		set_add_item (big, &many[i]);
+		if (i % 3 == 0 || i % 7 == 0) {
+			set_add_item (drop, &many[i]);
+		}
+	}
+
+	set_difference_into (big, drop);
+	for (int i = 0; i < 3000; ++i) {
+		ssize_t pos = set_get_item_index (big, &many[i]);
+		if ((pos == -1) != (i % 3 == 0 || i % 7 == 0) || (pos != -1 && set_get_item (big, pos) != &many[i])) {
+			PDEC ();
+			fprintf (stderr, "set_difference_into: %d wrongly indexed\n", i);
+			return EXIT_FAILURE;
+		}
+	}
+
+	set_delete (drop, NULL);
+	set_delete (big, NULL);
+	free (many);
+
+	printf ("in place set tests pass\n");
+
+	return EXIT_SUCCESS;
+}
+
+/* a parallel result must match the serial one item for item and index each item at its position */
+int set_matches (set* got, set* want) {
+	if (got == NULL || got->count != want->count) {
+		return 0;
+	}
+
+	for (size_t i = 0; i < want->count; ++i) {
+		if (got->data[i] != want->data[i] || set_get_item_index (got, want->data[i]) != (ssize_t) i) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+int set_parallel_test () {
+	if (auto_array_parallel_threads (4) != 0) {
+		PMSG ("auto_array_parallel_threads failed");
+		return EXIT_FAILURE;
+	}
+
+	// several chunks for the hashed sets, one for the plain ones
+	size_t sizes[2] = { 500, 60000 };
+	int* values = malloc (90000 * sizeof (int));
+	for (int i = 0; i < 90000; ++i) {
+		values[i] = i;
+	}
+
+	for (int hashed = 0; hashed < 2; ++hashed) {
+		size_t n = sizes[hashed];
+		set* a = hashed ? set_create_hashed (16, equals, int_hash) : set_create (n, equals);
+		set* b = hashed ? set_create_hashed (16, equals, int_hash) : set_create (n, equals);
+
+		for (size_t i = 0; i < n; ++i) {
+			set_add_item (a, &values[i]);
+			set_add_item (b, &values[(i * 3) / 2]);
+		}
+
+		set* (*serial[3]) (set*, set*) = { set_union, set_intersection, set_difference };
+		set* (*parallel[3]) (set*, set*) = { set_parallel_union, set_parallel_intersection, set_parallel_difference };
+
+		for (int op = 0; op < 3; ++op) {
+			set* want = serial[op] (a, b);
+			set* got = parallel[op] (a, b);
+
+			if (!set_matches (got, want)) {
+				PDEC ();
+				fprintf (stderr, "parallel set operation %d failed for %s sets\n", op, hashed ? "hashed" : "plain");
+				return EXIT_FAILURE;
+			}
+
+			set_delete (got, NULL);
+			set_delete (want, NULL);
+		}
+
+		set_delete (b, NULL);
+		set_delete (a, NULL);
+	}
+
+	free (values);
+
+	// skewed sizes so that some pieces of the smaller set are empty
+	uint32_t* va = malloc (300000 * sizeof (uint32_t));
+	uint32_t* vb = malloc (300000 * sizeof (uint32_t));
+	for (uint32_t i = 0; i < 300000; ++i) {
+		va[i] = i * 2;
+		vb[i] = (i % 5 == 0) ? i * 3 : 2000000 + i;
+	}
+
+	sorted_set* sa = sorted_set_create_from (va, 300000);
+	sorted_set* sb = sorted_set_create_from (vb, 1000);
+	sorted_set* sc = sorted_set_create_from (vb, 300000);
+	sorted_set* empty = sorted_set_create (1);
+
+	sorted_set* (*serial[3]) (sorted_set*, sorted_set*) = { 
+		sorted_set_union, sorted_set_intersection, sorted_set_difference };
+	sorted_set* (*parallel[3]) (sorted_set*, sorted_set*) = { 
+		sorted_set_parallel_union, sorted_set_parallel_intersection, sorted_set_parallel_difference };
+	sorted_set* pairs[5][2] = { { sa, sb }, { sb, sa }, { sa, sc }, { sc, sa }, { sa, empty } };
+
+	for (int p = 0; p < 5; ++p) {
+		for (int op = 0; op < 3; ++op) {
+			sorted_set* want = serial[op] (pairs[p][0], pairs[p][1]);
+			sorted_set* got = parallel[op] (pairs[p][0], pairs[p][1]);
+
+			if (got == NULL || got->count != want->count || memcmp (got->data, want->data, want->count * sizeof (uint32_t)) != 0) {
+				PDEC ();
+				fprintf (stderr, "parallel sorted_set operation %d failed for pair %d\n", op, p);
+				return EXIT_FAILURE;
+			}
+
+			sorted_set_delete (got);
+			sorted_set_delete (want);
+		}
+	}
+
+	sorted_set_delete (empty);
+	sorted_set_delete (sc);
+	sorted_set_delete (sb);
+	sorted_set_delete (sa);
+	free (vb);
+	free (va);
+
+	auto_array_parallel_threads (1);
+
+	printf ("parallel set tests pass\n");
+
+	return EXIT_SUCCESS;
+}
+
+int sketch_test () {
+	// distinct counts within 5 standard errors, across the sparse to dense switch
+	size_t counts[5] = { 0, 10, 1000, 20000, 300000 };
+
+	for (int c = 0; c < 5; ++c) {
+		hyperloglog* hll = hyperloglog_create (14);
+		for (uint32_t i = 0; i < counts[c]; ++i) {
+			hyperloglog_add (hll, &i, sizeof (i));
+			hyperloglog_add (hll, &i, sizeof (i));
+		}
+
+		double estimate = hyperloglog_count (hll);
+		double error = counts[c] > 0 ? fabs (estimate - counts[c]) / counts[c] : estimate;
+		if (error > 0.04 || (counts[c] <= 1000) != (hll->registers == NULL)) {
+			PDEC ();
+			fprintf (stderr, "hyperloglog_count: %.0f for %zu items\n", estimate, counts[c]);
+			return EXIT_FAILURE;
+		}
+
+		hyperloglog_delete (hll);
+	}
+
+	// merging halves, sparse into sparse, sparse into dense and dense into sparse
+	hyperloglog* low = hyperloglog_create (12);
+	hyperloglog* high = hyperloglog_create (12);
+	hyperloglog* few = hyperloglog_create (12);
+	hyperloglog* wide = hyperloglog_create (10);
+
+	for (uint32_t i = 0; i < 100000; ++i) {
+		hyperloglog_add (i < 50000 ? low : high, &i, sizeof (i));
+	}
+	for (uint32_t i = 200000; i < 200100; ++i) {
+		hyperloglog_add (few, &i, sizeof (i));
+	}
+
+	if (hyperloglog_merge (low, high) != 0 || hyperloglog_merge (low, few) != 0 || hyperloglog_merge (few, high) != 0) {
+		PMSG ("hyperloglog_merge failed");
+		return EXIT_FAILURE;
+	}
+
+	uint64_t all = hyperloglog_count (low);
+	uint64_t more = hyperloglog_count (few);
+	if (all < 95000 || all > 105000 || more < 47000 || more > 53000) {
+		PDEC ();
+		fprintf (stderr, "hyperloglog_merge: %lu and %lu\n", (unsigned long) all, (unsigned long) more);
+		return EXIT_FAILURE;
+	}
+
+	if (hyperloglog_merge (low, wide) != -1) {
+		PMSG ("hyperloglog_merge accepted a different precision");
+		return EXIT_FAILURE;
+	}
+
+	hyperloglog_delete (wide);
+	hyperloglog_delete (few);
+	hyperloglog_delete (high);
+	hyperloglog_delete (low);
+
+	// item i is added i % 100 + 1 times, item 7777 a million times more
+	count_min* cm = count_min_create (1000, 4);
+	count_min* other = count_min_create (1024, 4);
+	if (cm == NULL || other == NULL || cm->width != 1024 || count_min_create (1024, 0) != NULL) {
+		PMSG ("count_min_create failed");
+		return EXIT_FAILURE;
+	}
+
+	for (uint32_t i = 0; i < 5000; ++i) {
+		count_min_add (i % 2 ? cm : other, &i, sizeof (i), (i % 100) + 1);
+	}
+	uint32_t heavy = 7777;
+	count_min_add (cm, &heavy, sizeof (heavy), 1000000);
+	count_min_merge (cm, other);
+
+	size_t close = 0;
+	for (uint32_t i = 0; i < 5000; ++i) {
+		uint32_t estimate = count_min_estimate (cm, &i, sizeof (i));
+		if (estimate < (i % 100) + 1) {
+			PDEC ();
+			fprintf (stderr, "count_min_estimate: %u for item %u\n", estimate, i);
+			return EXIT_FAILURE;
+		}
+		close += estimate <= (i % 100) + 1 + 100;
+	}
+
+	if (close < 4000 || count_min_estimate (cm, &heavy, sizeof (heavy)) > 1000000 + 500 
+			|| cm->total != 1000000 + (50 * 101 * 50)) {
+		PDEC ();
+		fprintf (stderr, "count_min: %zu close estimates\n", close);
+		return EXIT_FAILURE;
+	}
+
+	count_min_delete (other);
+	count_min_delete (cm);
+
+	printf ("sketch tests pass\n");
+
+	return EXIT_SUCCESS;
+}
+
+int auto_string_append_test () {
+	auto_string str = AUTO_STRING_INITIALIZER (str);
+
+	// chars across the spill from the inline buffer
+	for (int i = 0; i < 100; ++i) {
+		if (auto_string_append_char (&str, 'a' + (i % 26)) == NULL) {
+			PMSG ("auto_string_append_char failed");
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (str.buf == str.small || auto_string_length (&str) != 100 || strlen (str.buf) != 100 || str.buf[99] != 'a' + (99 % 26)) {
+		PMSG ("auto_string_append_char: wrong contents");
+		return EXIT_FAILURE;
+	}
+
+	// appending the string to itself while it grows
+	auto_string_append_n (&str, str.buf, str.count);
+	if (auto_string_length (&str) != 200 || memcmp (str.buf, str.buf + 100, 100) != 0 || str.buf[200] != '\0') {
+		PMSG ("auto_string_append_n: self append failed");
+		return EXIT_FAILURE;
+	}
+
+	// reserved room is used without moving the buffer
+	auto_string_reserve (&str, 10000);
+	char* buf = str.buf;
+	for (int i = 0; i < 1000; ++i) {
+		auto_string_append_n (&str, "0123456789", 10);
+	}
+
+	if (str.buf != buf || auto_string_length (&str) != 10200 || strcmp (str.buf + 10190, "0123456789") != 0) {
+		PMSG ("auto_string_reserve failed");
+		return EXIT_FAILURE;
+	}
+
+	// embedded nuls count towards the length
+	auto_string_release (&str);
+	auto_string_append_n (&str, "ab\0cd", 5);
+	auto_string_append (&str, "ef");
+	if (auto_string_length (&str) != 7 || memcmp (str.buf, "ab\0cdef", 8) != 0) {
+		PMSG ("auto_string_append_n: embedded nul failed");
+		return EXIT_FAILURE;
+	}
+
+	auto_string_release (&str);
+
+	printf ("auto_string append tests pass\n");
+
+	return EXIT_SUCCESS;
+}
+
+int auto_string_format_test () {
+	auto_string str = AUTO_STRING_INITIALIZER (str);
+	char expected[256];
+
+	// the second line spills from the inline buffer and is formatted again
+	auto_string_appendf (&str, "%s=%d;", "short", 42);
+	auto_string_appendf (&str, "%s=%08.3f;%c", "a much longer key that does not fit", 3.14159, 'x');
+	snprintf (expected, sizeof (expected), "%s=%d;%s=%08.3f;%c", "short", 42, "a much longer key that does not fit", 3.14159, 'x');
+
+	if (strcmp (str.buf, expected) != 0 || auto_string_length (&str) != strlen (expected)) {
+		PDEC ();
+		fprintf (stderr, "auto_string_appendf: \"%s\"\n", str.buf);
+		return EXIT_FAILURE;
+	}
+
+	auto_string_release (&str);
+
+	int64_t ints[] = { 0, 7, -1, 10, 99, 100, -12345, 1234567890123LL, INT64_MAX, INT64_MIN };
+	for (size_t i = 0; i < sizeof (ints) / sizeof (ints[0]); ++i) {
+		auto_string_append_int (&str, ints[i]);
+		auto_string_append_char (&str, ' ');
+		auto_string_append_uint (&str, (uint64_t) ints[i]);
+		auto_string_append_char (&str, ' ');
+	}
+
+	expected[0] = '\0';
+	for (size_t i = 0; i < sizeof (ints) / sizeof (ints[0]); ++i) {
+		snprintf (expected + strlen (expected), sizeof (expected) - strlen (expected), "%lld %llu ", 
+				(long long) ints[i], (unsigned long long) ints[i]);
+	}
+
+	if (strcmp (str.buf, expected) != 0) {
+		PDEC ();
+		fprintf (stderr, "auto_string_append_int: \"%s\"\n", str.buf);
+		return EXIT_FAILURE;
+	}
+
+	// exact ties, decimals just off a tie, carries and the printf fallbacks
+	double doubles[] = { 0.0, -0.0, 2.5, 3.5, 0.125, 0.05, 1.005, 9.9996, -123.456, 0.000001, 1e20, INFINITY, NAN };
+	for (size_t i = 0; i < sizeof (doubles) / sizeof (doubles[0]); ++i) {
+		for (int precision = 0; precision <= 10; precision += 1) {
+			auto_string_release (&str);
+			auto_string_append_double (&str, doubles[i], precision);
+			snprintf (expected, sizeof (expected), "%.*f", precision, doubles[i]);
+
+			if (strcmp (str.buf, expected) != 0) {
+				PDEC ();
+				fprintf (stderr, "auto_string_append_double: %s != %s\n", str.buf, expected);
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	auto_string_release (&str);
+
+	printf ("auto_string format tests pass\n");
+
+	return EXIT_SUCCESS;
+}
+
+static int released_count = 0;
+
+static void count_release (void* data) {
+	++released_count;
+	free (data);
+}
+
+int string_builder_test () {
+	string_builder* sb = string_builder_create ();
+	auto_string expected = AUTO_STRING_INITIALIZER (expected);
+	char line[64];
+	int attached = 0;
+
+	// lines span several chunks, with large attached buffers and small copied ones between them
+	for (int i = 0; i < 20000; ++i) {
+		int n = snprintf (line, sizeof (line), "line %d\n", i);
+		string_builder_append (sb, line, n);
+		auto_string_append_n (&expected, line, n);
+
+		if (i % 1000 == 0) {
+			size_t size = i % 2000 == 0 ? 8192 : 16;
+			char* buf = malloc (size);
+			memset (buf, 'a' + (i / 1000) % 26, size);
+			auto_string_append_n (&expected, buf, size);
+			string_builder_attach (sb, buf, size, count_release);
+			++attached;
+		}
+	}
+
+	if (string_builder_length (sb) != auto_string_length (&expected) || released_count != attached / 2) {
+		PDEC ();
+		fprintf (stderr, "string_builder length %zu expected %zu, released %d\n", 
+				string_builder_length (sb), auto_string_length (&expected), released_count);
+		return EXIT_FAILURE;
+	}
+
+	auto_string flat = AUTO_STRING_INITIALIZER (flat);
+	string_builder_flatten (sb, &flat);
+	if (auto_string_length (&flat) != auto_string_length (&expected) || memcmp (flat.buf, expected.buf, flat.count) != 0) {
+		PMSG ("string_builder_flatten failed");
+		return EXIT_FAILURE;
+	}
+	auto_string_release (&flat);
+
+	// a non blocking pipe fills up and forces writes to resume part way through segments
+	int fds[2];
+	if (pipe (fds) == -1) {
+		PERR ("pipe");
+		return EXIT_FAILURE;
+	}
+	fcntl (fds[0], F_SETFL, O_NONBLOCK);
+	fcntl (fds[1], F_SETFL, O_NONBLOCK);
+
+	auto_string received = AUTO_STRING_INITIALIZER (received);
+	char buf[5000];
+	int partial = 0;
+	while (string_builder_length (sb) > 0) {
+		if (string_builder_write (sb, fds[1]) == -1 && errno != EAGAIN) {
+			PERR ("string_builder_write");
+			return EXIT_FAILURE;
+		}
+		partial += string_builder_length (sb) > 0;
+
+		ssize_t n;
+		while ((n = read (fds[0], buf, sizeof (buf))) > 0) {
+			auto_string_append_n (&received, buf, n);
+		}
+	}
+	close (fds[0]);
+	close (fds[1]);
+
+	if (partial == 0 || auto_string_length (&received) != auto_string_length (&expected) 
+			|| memcmp (received.buf, expected.buf, received.count) != 0 || released_count != attached) {
+		PDEC ();
+		fprintf (stderr, "string_builder_write received %zu of %zu bytes in %d writes, released %d of %d\n", 
+				auto_string_length (&received), auto_string_length (&expected), partial + 1, released_count, attached);
+		return EXIT_FAILURE;
+	}
+
+	auto_string_release (&received);
+	auto_string_release (&expected);
+
+	// the emptied builder is reused and releases what it never wrote
+	string_builder_append_str (sb, "again");
+	string_builder_attach (sb, malloc (STRING_BUILDER_ATTACH_MIN), STRING_BUILDER_ATTACH_MIN, count_release);
+	if (string_builder_length (sb) != 5 + STRING_BUILDER_ATTACH_MIN) {
+		PMSG ("string_builder reuse failed");
+		return EXIT_FAILURE;
+	}
+
+	string_builder_delete (sb);
+	if (released_count != attached + 1) {
+		PMSG ("string_builder_delete did not release");
+		return EXIT_FAILURE;
+	}
+
+	printf ("string_builder tests pass\n");
+
+	return EXIT_SUCCESS;
+}
+
+int string_view_test () {
+	char hay[300];
+	char needle[8];
+	uint32_t r = 1;
+
+	// a small alphabet gives partial matches, lengths cover the vector tails
+	for (int round = 0; round < 20000; ++round) {
+		size_t n = round % 300;
+		size_t k = 1 + round % 7;
+		for (size_t i = 0; i < n; ++i) {
+			r = r * 1103515245 + 12345;
+			hay[i] = 'a' + (r >> 16) % 3;
+		}
+		for (size_t i = 0; i < k; ++i) {
+			r = r * 1103515245 + 12345;
+			needle[i] = 'a' + (r >> 16) % 3;
+		}
+		needle[k] = '\0';
+
+		string_view v = string_view_of (hay, n);
+		char* match = memmem (hay, n, needle, k);
+		ssize_t expected = match == NULL ? -1 : match - hay;
+		if (string_view_find (v, string_view_of (needle, k)) != expected) {
+			PDEC ();
+			fprintf (stderr, "string_view_find \"%s\" in %zu bytes: %zd != %zd\n", needle, n, 
+					string_view_find (v, string_view_of (needle, k)), expected);
+			return EXIT_FAILURE;
+		}
+
+		hay[n] = '\0';
+		size_t span = strcspn (hay, "bc");
+		expected = span == n ? -1 : (ssize_t) span;
+		if (string_view_find_any (v, "bc") != expected || string_view_find_any (v, "vwxyzcb") != expected) {
+			PMSG ("string_view_find_any failed");
+			return EXIT_FAILURE;
+		}
+	}
+
+	char text[] = "  GET /index.html\tHTTP/1.1 \r\nHost: example.com\n\nlast";
+	string_view rest = string_view_from_cstr (text);
+	string_view line;
+	const char* lines[] = { "  GET /index.html\tHTTP/1.1 ", "Host: example.com", "", "last" };
+	size_t count = 0;
+	while (string_view_next_line (&rest, &line)) {
+		if (count >= 4 || !string_view_equals (line, string_view_from_cstr (lines[count]))) {
+			PMSG ("string_view_next_line failed");
+			return EXIT_FAILURE;
+		}
+		++count;
+	}
+
+	if (count != 4 || !string_view_equals (string_view_trim (string_view_of (text, 28)), string_view_from_cstr ("GET /index.html\tHTTP/1.1"))) {
+		PMSG ("string_view_trim failed");
+		return EXIT_FAILURE;
+	}
+
+	// tokens match strtok's, and key a hash_table without being copied
+	char copy[sizeof (text)];
+	strcpy (copy, text);
+	hash_table* ht = hash_table_create (16);
+	for (char* tok = strtok (copy, " \t\r\n"); tok != NULL; tok = strtok (NULL, " \t\r\n")) {
+		hash_table_put (ht, tok, tok);
+	}
+
+	rest = string_view_from_cstr (text);
+	string_view token;
+	count = 0;
+	while (string_view_next_token (&rest, " \t\r\n", &token)) {
+		char* tok = hash_table_get_n (ht, token.data, token.length);
+		if (tok == NULL || strlen (tok) != token.length) {
+			PDEC ();
+			fprintf (stderr, "string_view_next_token: \"%.*s\"\n", (int) token.length, token.data);
+			return EXIT_FAILURE;
+		}
+		++count;
+	}
+
+	if (count != 6 || hash_table_get_n (ht, "Host:x", 4) != NULL || hash_table_get_n (ht, "Host:x", 5) == NULL) {
+		PMSG ("hash_table_get_n failed");
+		return EXIT_FAILURE;
+	}
+	hash_table_delete (ht, NULL);
+
+	const char* fields[] = { "a", "", "b", "" };
+	rest = string_view_from_cstr ("a,;b;");
+	string_view field;
+	count = 0;
+	while (string_view_split (&rest, ",;", &field)) {
+		if (count >= 4 || !string_view_equals (field, string_view_from_cstr (fields[count]))) {
+			PMSG ("string_view_split failed");
+			return EXIT_FAILURE;
+		}
+		++count;
+	}
+
+	if (count != 4) {
+		PMSG ("string_view_split field count");
+		return EXIT_FAILURE;
+	}
+
+	printf ("string_view tests pass\n");
+
+	return EXIT_SUCCESS;
+}
+
+int byte_buffer_test () {
+	byte_buffer bb = BYTE_BUFFER_INITIALIZER;
+	const char bin[] = "nul\0inside";
+
+	byte_buffer_put_u8 (&bb, 0xab);
+	byte_buffer_put_u16 (&bb, 0x1234);
+	byte_buffer_put_u32 (&bb, 0xdeadbeef);
+	byte_buffer_put_u64 (&bb, 0x0102030405060708ULL);
+	byte_buffer_put_svarint (&bb, -1);
+	byte_buffer_put_svarint (&bb, INT64_MIN);
+	byte_buffer_put_bytes (&bb, bin, sizeof (bin));
+
+	// little endian whatever the host
+	if (bb.count != 15 + 1 + 10 + 1 + sizeof (bin) || bb.buf[1] != 0x34 || bb.buf[3] != 0xef || bb.buf[7] != 0x08) {
+		PMSG ("byte_buffer fixed width encoding failed");
+		return EXIT_FAILURE;
+	}
+
+	uint8_t u8;
+	uint16_t u16;
+	uint32_t u32;
+	uint64_t u64;
+	int64_t s1, s2;
+	string_view sv;
+	if (byte_buffer_get_u8 (&bb, &u8) == -1 || u8 != 0xab || byte_buffer_get_u16 (&bb, &u16) == -1 || u16 != 0x1234
+			|| byte_buffer_get_u32 (&bb, &u32) == -1 || u32 != 0xdeadbeef 
+			|| byte_buffer_get_u64 (&bb, &u64) == -1 || u64 != 0x0102030405060708ULL
+			|| byte_buffer_get_svarint (&bb, &s1) == -1 || s1 != -1 || byte_buffer_get_svarint (&bb, &s2) == -1 || s2 != INT64_MIN
+			|| byte_buffer_get_bytes (&bb, &sv) == -1 || !string_view_equals (sv, string_view_of (bin, sizeof (bin)))) {
+		PMSG ("byte_buffer round trip failed");
+		return EXIT_FAILURE;
+	}
+
+	if (byte_buffer_remaining (&bb) != 0 || byte_buffer_get_u8 (&bb, &u8) != -1 || byte_buffer_get_varint (&bb, &u64) != -1) {
+		PMSG ("byte_buffer read past the end");
+		return EXIT_FAILURE;
+	}
+
+	// runs of single bytes and every varint length, decoded in bulk and one at a time
+	size_t n = 100000;
+	uint64_t* values = malloc (n * sizeof (uint64_t));
+	uint64_t* decoded = malloc ((n + 1) * sizeof (uint64_t));
+	uint64_t r = 7;
+	for (size_t i = 0; i < n; ++i) {
+		r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+		int bits = (i / 64) % 3 == 0 ? 7 : (int) (r >> 58) + 1;
+		values[i] = bits == 64 ? r : r >> (64 - bits);
+	}
+	values[0] = UINT64_MAX;
+	values[1] = 1ULL << 56;
+
+	byte_buffer_clear (&bb);
+	byte_buffer_put_varints (&bb, values, n / 2);
+	for (size_t i = n / 2; i < n; ++i) {
+		byte_buffer_put_varint (&bb, values[i]);
+	}
+
+	size_t got = 0;
+	for (size_t chunk = 1; got < n; chunk = chunk * 3 + 1) {
+		got += byte_buffer_get_varints (&bb, decoded + got, chunk < n - got ? chunk : n - got);
+	}
+
+	if (got != n || memcmp (values, decoded, n * sizeof (uint64_t)) != 0 || byte_buffer_get_varints (&bb, decoded, 1) != 0) {
+		PMSG ("byte_buffer_get_varints failed");
+		return EXIT_FAILURE;
+	}
+
+	bb.pos = 0;
+	for (size_t i = 0; i < n; ++i) {
+		if (byte_buffer_get_varint (&bb, &u64) == -1 || u64 != values[i]) {
+			PDEC ();
+			fprintf (stderr, "byte_buffer_get_varint %zu: %llu != %llu\n", i, (unsigned long long) u64, (unsigned long long) values[i]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// an 11 byte varint is corrupt and a cut short one incomplete
+	byte_buffer_clear (&bb);
+	byte_buffer_put_varint (&bb, 300);
+	for (int i = 0; i < 11; ++i) {
+		byte_buffer_put_u8 (&bb, 0xff);
+	}
+	byte_buffer_put_u8 (&bb, 0x01);
+	for (int i = 0; i < 20; ++i) {
+		byte_buffer_put_u8 (&bb, 0x05);
+	}
+
+	if (byte_buffer_get_varints (&bb, decoded, n) != 1 || decoded[0] != 300 || byte_buffer_get_varint (&bb, &u64) != -1 || bb.pos != 2) {
+		PMSG ("byte_buffer accepted a corrupt varint");
+		return EXIT_FAILURE;
+	}
+
+	byte_buffer_clear (&bb);
+	byte_buffer_put_u8 (&bb, 0x80);
+	if (byte_buffer_get_varint (&bb, &u64) != -1 || byte_buffer_get_bytes (&bb, &sv) != -1 || bb.pos != 0) {
+		PMSG ("byte_buffer read a cut short varint");
+		return EXIT_FAILURE;
+	}
+
+	free (values);
+	free (decoded);
+	byte_buffer_release (&bb);
+
+	printf ("byte_buffer tests pass\n");
+
+	return EXIT_SUCCESS;
+}
+
+/* decodes code points one at a time to check utf8_validate against */
+static int utf8_reference (const unsigned char* p, size_t n) {
+	for (size_t i = 0; i < n; ) {
+		uint32_t cp;
+		size_t len;
+		if (p[i] < 0x80) {
+			cp = p[i];
+			len = 1;
+		} else if ((p[i] & 0xe0) == 0xc0) {
+			cp = p[i] & 0x1f;
+			len = 2;
+		} else if ((p[i] & 0xf0) == 0xe0) {
+			cp = p[i] & 0x0f;
+			len = 3;
+		} else if ((p[i] & 0xf8) == 0xf0) {
+			cp = p[i] & 0x07;
+			len = 4;
+		} else {
+			return 0;
+		}
+
+		if (i + len > n) {
+			return 0;
+		}
+		for (size_t k = 1; k < len; ++k) {
+			if ((p[i + k] & 0xc0) != 0x80) {
+				return 0;
+			}
+			cp = (cp << 6) | (p[i + k] & 0x3f);
+		}
+
+		uint32_t min[] = { 0, 0, 0x80, 0x800, 0x10000 };
+		if (cp < min[len] || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)) {
+			return 0;
+		}
+		i += len;
+	}
+
+	return 1;
+}
+
+int escape_test () {
+	auto_string str = AUTO_STRING_INITIALIZER (str);
+
+	// the escapes land in the vector blocks and in the tails
+	const char json[] = "plain text long enough for a 32 byte block \"quoted\" back\\slash\ttab\nnew\x01\x1f caf\xc3\xa9";
+	auto_string_append_json_escaped (&str, json, sizeof (json) - 1);
+	const char* json_expected = "plain text long enough for a 32 byte block \\\"quoted\\\" back\\\\slash\\ttab\\nnew\\u0001\\u001F caf\xc3\xa9";
+	if (strcmp (str.buf, json_expected) != 0) {
+		PDEC ();
+		fprintf (stderr, "auto_string_append_json_escaped: %s\n", str.buf);
+		return EXIT_FAILURE;
+	}
+
+	auto_string_release (&str);
+	const char url[] = "Unreserved-chars_stay.put~0123456789abcdefghijklmnopqrstuvwxyz but /?&= and \xc3\xa9 don't";
+	auto_string_append_url_encoded (&str, url, sizeof (url) - 1);
+	const char* url_expected = "Unreserved-chars_stay.put~0123456789abcdefghijklmnopqrstuvwxyz%20but%20%2F%3F%26%3D%20and%20%C3%A9%20don%27t";
+	if (strcmp (str.buf, url_expected) != 0) {
+		PDEC ();
+		fprintf (stderr, "auto_string_append_url_encoded: %s\n", str.buf);
+		return EXIT_FAILURE;
+	}
+	auto_string_release (&str);
+
+	// runs of random code points of every length, then single bytes changed to break them
+	unsigned char text[200];
+	uint32_t r = 5;
+	for (int round = 0; round < 20000; ++round) {
+		size_t n = 0;
+		while (n < sizeof (text) - 4) {
+			r = r * 1103515245 + 12345;
+			uint32_t cp = (r >> 8) % (round % 4 == 0 ? 0x80 : 0x110000);
+			if (cp >= 0xd800 && cp <= 0xdfff) {
+				continue;
+			}
+			if (cp < 0x80) {
+				text[n++] = cp;
+			} else if (cp < 0x800) {
+				text[n++] = 0xc0 | (cp >> 6);
+				text[n++] = 0x80 | (cp & 0x3f);
+			} else if (cp < 0x10000) {
+				text[n++] = 0xe0 | (cp >> 12);
+				text[n++] = 0x80 | ((cp >> 6) & 0x3f);
+				text[n++] = 0x80 | (cp & 0x3f);
+			} else {
+				text[n++] = 0xf0 | (cp >> 18);
+				text[n++] = 0x80 | ((cp >> 12) & 0x3f);
+				text[n++] = 0x80 | ((cp >> 6) & 0x3f);
+				text[n++] = 0x80 | (cp & 0x3f);
+			}
+		}
+
+		r = r * 1103515245 + 12345;
+		size_t len = (r >> 8) % (n + 1);
+		if (round % 2) {
+			r = r * 1103515245 + 12345;
+			text[(r >> 8) % n] = r >> 24;
+		}
+
+		if (utf8_validate ((char*) text, len) != utf8_reference (text, len)) {
+			PDEC ();
+			fprintf (stderr, "utf8_validate round %d of %zu bytes returned %d\n", round, len, utf8_validate ((char*) text, len));
+			return EXIT_FAILURE;
+		}
+	}
+
+	const char* invalid[] = { "\xc0\xaf", "\xe0\x80\xaf", "\xed\xa0\x80", "\xf4\x90\x80\x80", "\xf8\x88\x80\x80\x80", "\x80", "\xe2\x82" };
+	for (size_t i = 0; i < sizeof (invalid) / sizeof (invalid[0]); ++i) {
+		if (utf8_validate (invalid[i], strlen (invalid[i]))) {
+			PDEC ();
+			fprintf (stderr, "utf8_validate accepted invalid sequence %zu\n", i);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// a string escaped onto itself, over more than one block so the buffer moves mid append
+	auto_string* self = auto_string_create (16);
+	for (int i = 0; i < 600; ++i) {
+		auto_string_append (self, "a \"b\"/c");
+	}
+	size_t self_n = self->count;
+	char* copy = strdup (self->buf);
+	for (int url_mode = 0; url_mode < 2; ++url_mode) {
+		auto_string expected = AUTO_STRING_INITIALIZER (expected);
+		auto_string_append_n (&expected, copy, self_n);
+		self->count = self_n;
+		if (url_mode) {
+			auto_string_append_url_encoded (&expected, copy, self_n);
+			auto_string_append_url_encoded (self, self->buf, self_n);
+		} else {
+			auto_string_append_json_escaped (&expected, copy, self_n);
+			auto_string_append_json_escaped (self, self->buf, self_n);
+		}
+		if (self->count != expected.count || strcmp (self->buf, expected.buf) != 0) {
+			PDEC ();
+			fprintf (stderr, "%s appended to itself\n", url_mode ? "auto_string_append_url_encoded" : "auto_string_append_json_escaped");
+			return EXIT_FAILURE;
+		}
+		auto_string_release (&expected);
+	}
+	free (copy);
+	auto_string_delete (self);
+
+	printf ("escape tests pass\n");
+
+	return EXIT_SUCCESS;
+}
+
+typedef struct {
+	size_t allocs;
+	size_t frees;
+} alloc_counts;
+
+static void* counting_alloc (void* ctx, size_t size) {
+	((alloc_counts*) ctx)->allocs++;
+	return malloc (size);
+}
+
+static void* counting_realloc (void* ctx, void* ptr, size_t size) {
+	return realloc (ptr, size);
+}
+
+static void counting_free (void* ctx, void* ptr) {
+	((alloc_counts*) ctx)->frees++;
+	free (ptr);
+}
+
+/* a bump allocator over one buffer, each block preceded by its size */
+typedef struct {
+	char* buf;
+	size_t used;
+	size_t size;
+} test_arena;
+
+static void* arena_alloc (void* ctx, size_t size) {
+	test_arena* a = ctx;
+	size_t need = sizeof (size_t) + ((size + 15) & ~(size_t) 15);
+	if (a->used + need > a->size) {
+		return NULL;
+	}
+
+	size_t* block = (size_t*) (a->buf + a->used);
+	*block = size;
+	a->used += need;
+
+	return block + 1;
+}
+
+static void* arena_realloc (void* ctx, void* ptr, size_t size) {
+	size_t old = ((size_t*) ptr)[-1];
+	void* p = arena_alloc (ctx, size);
+	if (p != NULL) {
+		memcpy (p, ptr, old < size ? old : size);
+	}
+
+	return p;
+}
+
+int allocator_test () {
+	alloc_counts counts = { 0, 0 };
+	sscont_allocator counting = { counting_alloc, counting_realloc, counting_free, &counts };
+
+	auto_array* aa = auto_array_create_with (2, &counting);
+	hash_table* ht = hash_table_create_with (4, &counting);
+	set* a = set_create_hashed_with (2, str_equals, str_hash, &counting);
+	set* b = set_create_with (200, str_equals, &counting);
+	auto_string* str = auto_string_create_with (1, &counting);
+
+	char keys[100][8];
+	for (int i = 0; i < 100; ++i) {
+		snprintf (keys[i], sizeof (keys[i]), "k%d", i);
+		auto_array_add (aa, keys[i]);
+		hash_table_put (ht, keys[i], keys[i]);
+		set_add_item (a, keys[i]);
+		if (i % 2) {
+			set_add_item (b, keys[i]);
+		}
+		auto_string_append (str, keys[i]);
+	}
+	for (int i = 0; i < 100; i += 3) {
+		hash_table_remove (ht, keys[i]);
+	}
+
+	auto_array* ht_keys = hash_table_keys (ht);
+	set* u = set_union (a, b);
+	set* in = set_intersection (b, a);
+	if (ht_keys == NULL || u == NULL || in == NULL || ht_keys->allocator != &counting || u->allocator != &counting || in->allocator != &counting) {
+		PMSG ("containers computed from containers with an allocator don't use it");
+		return EXIT_FAILURE;
+	}
+
+	auto_array* none = auto_array_create_with (1, &counting);
+	auto_array* mapped = auto_array_map (aa, par_double, NULL);
+	auto_array* filtered = auto_array_filter (aa, par_is_odd, NULL);
+	auto_array* empty = auto_array_filter (none, par_is_odd, NULL);
+	if (mapped == NULL || filtered == NULL || empty == NULL || mapped->allocator != &counting 
+			|| filtered->allocator != &counting || empty->allocator != &counting) {
+		PMSG ("auto_array_map/auto_array_filter: result doesn't use the allocator");
+		return EXIT_FAILURE;
+	}
+	auto_array_delete (empty, NULL);
+	auto_array_delete (filtered, NULL);
+	auto_array_delete (mapped, NULL);
+	auto_array_delete (none, NULL);
+
+	if (aa->count != 100 || ht_keys->count != 66 || u->count != 100 || in->count != 50 || strncmp (str->buf, "k0k1k2", 6) != 0) {
+		PDEC ();
+		fprintf (stderr, "containers with an allocator: counts %zu %zu %zu %zu\n", aa->count, ht_keys->count, u->count, in->count);
+		return EXIT_FAILURE;
+	}
+
+	auto_array_delete (ht_keys, NULL);
+	auto_array_delete (aa, NULL);
+	hash_table_delete (ht, NULL);
+	set_delete (u, NULL);
+	set_delete (in, NULL);
+	set_delete (a, NULL);
+	set_delete (b, NULL);
+	auto_string_delete (str);
+
+	if (counts.allocs < 10 || counts.allocs != counts.frees) {
+		PDEC ();
+		fprintf (stderr, "allocator: %zu allocations, %zu frees\n", counts.allocs, counts.frees);
+		return EXIT_FAILURE;
+	}
+
+	// the default allocator is captured by containers created without one
+	counts.allocs = counts.frees = 0;
+	sscont_allocator_set_default (&counting);
+	aa = auto_array_create (0);
+	auto_array tmp = AUTO_ARRAY_INITIALIZER (tmp);
+	auto_string s = AUTO_STRING_INITIALIZER (s);
+	sscont_allocator_set_default (NULL);
+
+	for (int i = 0; i < 100; ++i) {
+		auto_array_add (aa, keys[i]);
+		auto_array_add (&tmp, keys[i]);
+		auto_string_append (&s, keys[i]);
+	}
+	auto_array_delete (aa, NULL);
+	auto_array_release (&tmp, NULL);
+	auto_string_release (&s);
+
+	if (sscont_allocator_get_default () != &sscont_malloc_allocator || counts.allocs < 2 || counts.allocs != counts.frees) {
+		PDEC ();
+		fprintf (stderr, "default allocator: %zu allocations, %zu frees\n", counts.allocs, counts.frees);
+		return EXIT_FAILURE;
+	}
+
+	// an allocator without free reclaims the table at once
+	test_arena arena = { malloc (1 << 20), 0, 1 << 20 };
+	sscont_allocator bump = { arena_alloc, arena_realloc, NULL, &arena };
+	ht = hash_table_create_with (8, &bump);
+	for (int i = 0; i < 100; ++i) {
+		hash_table_put (ht, keys[i], keys[i]);
+	}
+	if (hash_table_get (ht, "k42") != keys[42] || arena.used == 0) {
+		PMSG ("hash_table with an arena allocator");
+		return EXIT_FAILURE;
+	}
+	hash_table_delete (ht, NULL);
+	free (arena.buf);
+
+	printf ("allocator tests pass\n");
+
+	return EXIT_SUCCESS;
+}
+
+static void* pool_thread (void* arg) {
+	sscont_pool* p = arg;
+	uintptr_t* held[100];
+
+	for (int round = 0; round < 200; ++round) {
+		for (int i = 0; i < 100; ++i) {
+			held[i] = sscont_pool_alloc (p);
+			if (held[i] == NULL) {
+				return arg;
+			}
+			held[i][0] = (uintptr_t) &held[i];
+		}
+		for (int i = 0; i < 100; ++i) {
+			if (held[i][0] != (uintptr_t) &held[i]) {
+				return arg;
+			}
+			sscont_pool_free (p, held[i]);
+		}
+	}
+
+	return NULL;
+}
+
+int arena_pool_test () {
+	sscont_arena* a = sscont_arena_create (256);
+	if (a == NULL) {
+		PMSG ("sscont_arena_create returned NULL");
+		return EXIT_FAILURE;
+	}
+
+	char* first = sscont_arena_alloc (a, 10);
+	sscont_arena_mark mark = sscont_arena_get_mark (a);
+	char* second = sscont_arena_alloc (a, 100);
+	char* large = sscont_arena_alloc (a, 1000);
+	if (first == NULL || second == NULL || large == NULL || ((uintptr_t) first | (uintptr_t) second | (uintptr_t) large) % 16 != 0 || second < first + 10) {
+		PMSG ("sscont_arena_alloc");
+		return EXIT_FAILURE;
+	}
+	memset (large, 'x', 1000);
+
+	sscont_arena_rewind (a, mark);
+	if (sscont_arena_alloc (a, 100) != second) {
+		PMSG ("sscont_arena_rewind doesn't reuse the memory after the mark");
+		return EXIT_FAILURE;
+	}
+
+	sscont_arena_reset (a);
+	if (sscont_arena_alloc (a, 10) != first) {
+		PMSG ("sscont_arena_reset doesn't reuse the first block");
+		return EXIT_FAILURE;
+	}
+
+	// containers grow in place at the end of the arena, or move
+	auto_array* aa = auto_array_create_with (8, &a->allocator);
+	auto_string* str = auto_string_create_with (8, &a->allocator);
+	for (uintptr_t i = 0; i < 1000; ++i) {
+		auto_array_add (aa, (void*) i);
+		auto_string_append_char (str, 'a' + (i % 26));
+	}
+	for (uintptr_t i = 0; i < 1000; ++i) {
+		if (auto_array_get (aa, i) != (void*) i || str->buf[i] != 'a' + (i % 26)) {
+			PDEC ();
+			fprintf (stderr, "auto_array in an arena: item %zu\n", (size_t) i);
+			return EXIT_FAILURE;
+		}
+	}
+	auto_array_delete (aa, NULL);
+	auto_string_delete (str);
+	sscont_arena_delete (a);
+
+	sscont_pool* p = sscont_pool_create (20, 0);
+	if (p == NULL || p->object_size != 24) {
+		PMSG ("sscont_pool_create");
+		return EXIT_FAILURE;
+	}
+
+	void* objects[1000];
+	for (int i = 0; i < 1000; ++i) {
+		objects[i] = sscont_pool_alloc (p);
+		if (objects[i] == NULL || (uintptr_t) objects[i] % 8 != 0) {
+			PMSG ("sscont_pool_alloc");
+			return EXIT_FAILURE;
+		}
+		memset (objects[i], i, 24);
+	}
+	for (int i = 0; i < 1000; ++i) {
+		for (int j = 0; j < 24; ++j) {
+			if (((unsigned char*) objects[i])[j] != (unsigned char) i) {
+				PDEC ();
+				fprintf (stderr, "sscont_pool objects overlap at %d\n", i);
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	sscont_pool_free (p, objects[10]);
+	sscont_pool_free (p, objects[20]);
+	void* again = sscont_pool_alloc (p);
+	if (again != objects[20] || sscont_pool_alloc (p) != objects[10]) {
+		PMSG ("sscont_pool_free doesn't reuse freed objects");
+		return EXIT_FAILURE;
+	}
+
+	if (sscont_alloc (&p->allocator, 16) == NULL || sscont_alloc (&p->allocator, 25) != NULL) {
+		PMSG ("sscont_pool allocator sizes");
+		return EXIT_FAILURE;
+	}
+	sscont_pool_delete (p);
+
+	// threads allocate and free through their magazines
+	p = sscont_pool_create (16, SSCONT_POOL_THREADED);
+	pthread_t threads[4];
+	for (int i = 0; i < 4; ++i) {
+		pthread_create (&threads[i], NULL, pool_thread, p);
+	}
+	int failed = 0;
+	for (int i = 0; i < 4; ++i) {
+		void* rv;
+		pthread_join (threads[i], &rv);
+		failed |= rv != NULL;
+	}
+	if (failed || pool_thread (p) != NULL) {
+		PMSG ("threaded sscont_pool");
+		return EXIT_FAILURE;
+	}
+	sscont_pool_delete (p);
+
+	printf ("arena and pool tests pass\n");
+
+	return EXIT_SUCCESS;
+}
+
+typedef struct {
+	size_t resizes[3];
+	size_t chain_walks;
+	size_t longest_walk;
+	size_t overflows;
+} trace_counts;
+
+static void count_trace (const sscont_trace_record* record, void* ctx) {
+	trace_counts* counts = ctx;
+
+	switch (record->event) {
+	case SSCONT_TRACE_RESIZE:
+		counts->resizes[strcmp (record->container, "auto_array") == 0 ? 0 : strcmp (record->container, "hash_table") == 0 ? 1 : 2]++;
+		break;
+	case SSCONT_TRACE_CHAIN_WALK:
+		counts->chain_walks++;
+		if (record->old_size > counts->longest_walk) {
+			counts->longest_walk = record->old_size;
+		}
+		break;
+	case SSCONT_TRACE_SET_OVERFLOW:
+		counts->overflows++;
+		break;
+	}
+}
+
+/* each hook checks that it's called with its own ctx while the main thread swaps them */
+static void trace_hook_a (const sscont_trace_record* record, void* ctx) {
+	if (atomic_load ((_Atomic int*) ctx) != 'a') {
+		atomic_store ((_Atomic int*) ctx + 1, 1);
+	}
+}
+
+static void trace_hook_b (const sscont_trace_record* record, void* ctx) {
+	if (atomic_load ((_Atomic int*) ctx) != 'b') {
+		atomic_store ((_Atomic int*) ctx + 1, 1);
+	}
+}
+
+static void* trace_resizer (void* arg) {
+	for (int r = 0; r < 200; ++r) {
+		auto_array* aa = auto_array_create (1);
+		for (uintptr_t i = 0; i < 256; ++i) {
+			auto_array_add (aa, (void*) i);
+		}
+		auto_array_delete (aa, NULL);
+	}
+
+	return NULL;
+}
+
+int trace_test () {
+	trace_counts counts = { { 0 }, 0, 0, 0 };
+	sscont_trace_set_hook (count_trace, &counts);
+
+	auto_array* aa = auto_array_create (4);
+	for (uintptr_t i = 0; i < 1000; ++i) {
+		auto_array_add (aa, (void*) i);
+	}
+	auto_array_delete (aa, NULL);
+
+	// one bucket, so every lookup walks the chain
+	hash_table* ht = hash_table_create (1);
+	char keys[20][8];
+	for (int i = 0; i < 20; ++i) {
+		snprintf (keys[i], sizeof (keys[i]), "k%d", i);
+		hash_table_put (ht, keys[i], keys[i]);
+	}
+	sscont_trace_set_chain_threshold (10);
+	hash_table_get (ht, keys[5]);
+	hash_table_get (ht, keys[19]);
+	hash_table_get (ht, "missing");
+
+	set* s = set_create (2, str_equals);
+	set_add_item (s, "a");
+	set_add_item (s, "b");
+	set_add_item (s, "c");
+	char* more[] = { "d", "e" };
+	set_add_items (s, (void**) more, 2);
+	set_delete (s, NULL);
+
+	sscont_trace_set_hook (NULL, NULL);
+	sscont_trace_set_chain_threshold (8);
+	hash_table_get (ht, "missing");
+	hash_table_delete (ht, NULL);
+
+	if (counts.resizes[0] == 0 || counts.resizes[1] == 0 || counts.resizes[2] != 0) {
+		PDEC ();
+		fprintf (stderr, "resize events: auto_array %zu hash_table %zu set %zu\n", counts.resizes[0], counts.resizes[1], counts.resizes[2]);
+		return EXIT_FAILURE;
+	}
+
+	if (counts.chain_walks != 2 || counts.longest_walk != 20) {
+		PDEC ();
+		fprintf (stderr, "chain walk events: %zu, longest %zu\n", counts.chain_walks, counts.longest_walk);
+		return EXIT_FAILURE;
+	}
+
+	if (counts.overflows != 2) {
+		PDEC ();
+		fprintf (stderr, "set overflow events: %zu\n", counts.overflows);
+		return EXIT_FAILURE;
+	}
+
+	// both ctx records hold their tag and a flag set on a mismatch
+	static _Atomic int tag_a[2] = { 'a', 0 };
+	static _Atomic int tag_b[2] = { 'b', 0 };
+	pthread_t resizer;
+	pthread_create (&resizer, NULL, trace_resizer, NULL);
+	for (int i = 0; i < 2000; ++i) {
+		if (i % 2) {
+			sscont_trace_set_hook (trace_hook_a, tag_a);
+		} else {
+			sscont_trace_set_hook (trace_hook_b, tag_b);
+		}
+	}
+	pthread_join (resizer, NULL);
+	sscont_trace_set_hook (NULL, NULL);
+
+	if (tag_a[1] || tag_b[1]) {
+		PMSG ("a trace hook was called with another hook's ctx");
+		return EXIT_FAILURE;
+	}
+
+	printf ("trace tests pass\n");
+
+	return EXIT_SUCCESS;
+}
+
+#define CA_PRODUCERS 4
+#define CA_ITEMS 20000
+
+typedef struct {
+	concurrent_array* ca;
+	uintptr_t id;
+} ca_producer;
+
+/* items are id << 32 | sequence + 1 so none is NULL */
+static void* ca_produce (void* arg) {
+	ca_producer* p = arg;
+	void* batch[7];
+
+	for (uintptr_t i = 0; i < CA_ITEMS;) {
+		if (i % 3 == 0 && i + 7 <= CA_ITEMS) {
+			for (int b = 0; b < 7; ++b) {
+				batch[b] = (void*) ((p->id << 32) | (i + b + 1));
+			}
+			if (concurrent_array_add_items (p->ca, batch, 7) == -1) {
+				return (void*) 1;
+			}
+			i += 7;
+		} else {
+			if (concurrent_array_add (p->ca, (void*) ((p->id << 32) | (i + 1))) == -1) {
+				return (void*) 1;
+			}
+			i++;
+		}
+	}
+
+	return NULL;
+}
+
+/* reads the published prefix while the producers run */
+static void* ca_read (void* arg) {
+	concurrent_array* ca = arg;
+	size_t seen = 0;
+
+	while (seen < CA_PRODUCERS * CA_ITEMS) {
+		size_t count = concurrent_array_count (ca);
+		for (; seen < count; ++seen) {
+			if (concurrent_array_get (ca, seen) == NULL) {
+				return (void*) 1;
+			}
+		}
+	}
+
+	return concurrent_array_get (ca, seen) == NULL ? NULL : (void*) 1;
+}
+
+int concurrent_array_test () {
+	concurrent_array* ca = concurrent_array_create (1);
+	if (ca == NULL) {
+		PMSG ("concurrent_array_create returned NULL");
+		return EXIT_FAILURE;
+	}
+
+	pthread_t threads[CA_PRODUCERS + 1];
+	ca_producer producers[CA_PRODUCERS];
+	for (int i = 0; i < CA_PRODUCERS; ++i) {
+		producers[i] = (ca_producer) { ca, i + 1 };
+		pthread_create (&threads[i], NULL, ca_produce, &producers[i]);
+	}
+	pthread_create (&threads[CA_PRODUCERS], NULL, ca_read, ca);
+
+	int failed = 0;
+	for (int i = 0; i <= CA_PRODUCERS; ++i) {
+		void* rv;
+		pthread_join (threads[i], &rv);
+		failed |= rv != NULL;
+	}
+	if (failed) {
+		PMSG ("concurrent_array producers or reader failed");
+		return EXIT_FAILURE;
+	}
+
+	auto_array* aa = concurrent_array_seal (ca);
+	if (aa == NULL || aa->count != CA_PRODUCERS * CA_ITEMS) {
+		PMSG ("concurrent_array_seal");
+		return EXIT_FAILURE;
+	}
+
+	// each producer's items appear once and in the order it added them
+	uintptr_t next[CA_PRODUCERS] = { 0 };
+	for (size_t i = 0; i < aa->count; ++i) {
+		uintptr_t item = (uintptr_t) auto_array_get (aa, i);
+		uintptr_t id = (item >> 32) - 1;
+		if (id >= CA_PRODUCERS || (item & 0xffffffff) != ++next[id]) {
+			PDEC ();
+			fprintf (stderr, "concurrent_array item %zu is %lx\n", i, (unsigned long) item);
+			return EXIT_FAILURE;
+		}
+	}
+	auto_array_delete (aa, NULL);
+
+	ca = concurrent_array_create (16);
+	for (int i = 0; i < 100; ++i) {
+		if (concurrent_array_add (ca, &next[0]) != i) {
+			PMSG ("concurrent_array_add position");
+			return EXIT_FAILURE;
+		}
+	}
+	if (concurrent_array_count (ca) != 100 || concurrent_array_get (ca, 99) != &next[0] || concurrent_array_get (ca, 100) != NULL) {
+		PMSG ("concurrent_array_get");
+		return EXIT_FAILURE;
+	}
+	concurrent_array_delete (ca, NULL);
+
+	printf ("concurrent_array tests pass\n");
+
+	return EXIT_SUCCESS;
+}
+
+typedef struct {
+	task_pool* pool;
+	int n;
+	long result;
+} fib_task;
+
+/* each call spawns one half and waits on it from inside a task */
+static void fib_spawn (void* arg) {
+	fib_task* f = arg;
+	if (f->n < 2) {
+		f->result = f->n;
+		return;
+	}
+
+	fib_task left = { f->pool, f->n - 1, 0 };
+	fib_task right = { f->pool, f->n - 2, 0 };
+	task_group g = TASK_GROUP_INITIALIZER (f->pool);
+	if (task_pool_spawn (&g, fib_spawn, &left) == -1) {
+		fib_spawn (&left);
+	}
+	fib_spawn (&right);
+	task_group_wait (&g);
+
+	f->result = left.result + right.result;
+}
+
+static void count_task (void* arg) {
+	atomic_fetch_add ((_Atomic size_t*) arg, 1);
+}
+
+typedef struct {
+	task_pool* pool;
+	_Atomic size_t count;
+} spawner_arg;
+
+static void* spawner (void* arg) {
+	spawner_arg* sa = arg;
+	task_group g = TASK_GROUP_INITIALIZER (sa->pool);
+
+	for (int i = 0; i < 1000; ++i) {
+		if (task_pool_spawn (&g, count_task, &sa->count) == -1) {
+			return (void*) 1;
+		}
+	}
+	task_group_wait (&g);
+
+	return atomic_load (&sa->count) == 1000 ? NULL : (void*) 1;
+}
+
+static void mark_range (size_t lo, size_t hi, void* arg) {
+	unsigned char* marks = arg;
+	for (size_t i = lo; i < hi; ++i) {
+		marks[i]++;
+	}
+}
+
+int task_pool_test () {
+	size_t threads[] = { 1, 4 };
+
+	for (int t = 0; t < 2; ++t) {
+		task_pool* p = task_pool_create (threads[t]);
+		if (p == NULL || p->threads != threads[t]) {
+			PMSG ("task_pool_create");
+			return EXIT_FAILURE;
+		}
+
+		fib_task f = { p, 18, 0 };
+		task_group g = TASK_GROUP_INITIALIZER (p);
+		task_pool_spawn (&g, fib_spawn, &f);
+		task_group_wait (&g);
+		if (f.result != 2584) {
+			PDEC ();
+			fprintf (stderr, "fib with %zu threads is %ld\n", threads[t], f.result);
+			return EXIT_FAILURE;
+		}
+
+		// threads outside the pool spawning and waiting at once
+		pthread_t tids[3];
+		spawner_arg args[3];
+		for (int i = 0; i < 3; ++i) {
+			args[i].pool = p;
+			atomic_init (&args[i].count, 0);
+			pthread_create (&tids[i], NULL, spawner, &args[i]);
+		}
+		int failed = 0;
+		for (int i = 0; i < 3; ++i) {
+			void* rv;
+			pthread_join (tids[i], &rv);
+			failed |= rv != NULL;
+		}
+		if (failed) {
+			PMSG ("task_pool spawns from several threads");
+			return EXIT_FAILURE;
+		}
+
+		size_t n = 100000;
+		unsigned char* marks = calloc (n, 1);
+		if (task_pool_parallel_for (p, n, 1, mark_range, marks) == -1) {
+			PMSG ("task_pool_parallel_for failed");
+			return EXIT_FAILURE;
+		}
+		for (size_t i = 0; i < n; ++i) {
+			if (marks[i] != 1) {
+				PDEC ();
+				fprintf (stderr, "task_pool_parallel_for visited %zu %d times\n", i, marks[i]);
+				return EXIT_FAILURE;
+			}
+		}
+		free (marks);
+
+		task_pool_delete (p);
+	}
+
+	printf ("task_pool tests pass\n");
+
+	return EXIT_SUCCESS;
+}